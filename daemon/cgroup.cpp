@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unistd.h>
+
+#include "inc/cgroup.hpp"
+#include "utils.hpp"
+
+namespace midas {
+constexpr static char kCgroupV2Roots[][32] = {"/sys/fs/cgroup",
+                                              "/sys/fs/cgroup/unified"};
+
+CGroup::CGroup(const std::string &path) : path_(path) {}
+
+std::unique_ptr<CGroup> CGroup::discover(int pid) {
+  auto path = utils::get_cgroup_path(pid);
+  if (path.empty())
+    return nullptr;
+  auto cgroup = std::make_unique<CGroup>(path);
+  // without the memory controller there is nothing to budget against
+  if (access((path + "/memory.max").c_str(), F_OK) != 0)
+    return nullptr;
+  return cgroup;
+}
+
+const std::string &CGroup::path() const noexcept { return path_; }
+
+uint64_t CGroup::read_limit(const std::string &file) const {
+  std::ifstream ifs(path_ + "/" + file);
+  std::string value;
+  if (!(ifs >> value) || value == "max")
+    return kUnlimited;
+  return std::stoull(value);
+}
+
+uint64_t CGroup::memory_max() const { return read_limit("memory.max"); }
+
+uint64_t CGroup::memory_high() const { return read_limit("memory.high"); }
+
+uint64_t CGroup::memory_current() const {
+  std::ifstream ifs(path_ + "/memory.current");
+  uint64_t current = 0;
+  ifs >> current;
+  return current;
+}
+
+CGroup::Events CGroup::memory_events() const {
+  Events events;
+  std::ifstream ifs(path_ + "/memory.events");
+  std::string key;
+  uint64_t value;
+  while (ifs >> key >> value) {
+    if (key == "high")
+      events.high = value;
+    else if (key == "max")
+      events.max = value;
+    else if (key == "oom")
+      events.oom = value;
+    else if (key == "oom_kill")
+      events.oom_kill = value;
+  }
+  return events;
+}
+
+uint64_t CGroup::region_cap(uint64_t nr_soft_regions) const {
+  uint64_t limit = std::min(memory_max(), memory_high());
+  if (limit == kUnlimited)
+    return kUnlimited;
+  // soft memory pages are charged to the client that touches them
+  uint64_t soft_bytes = nr_soft_regions * kRegionSize;
+  uint64_t current = memory_current();
+  uint64_t other_bytes = current > soft_bytes ? current - soft_bytes : 0;
+  uint64_t budget = limit * kFillRatio;
+  if (budget <= other_bytes)
+    return 1;
+  return std::max<uint64_t>(1, (budget - other_bytes) / kRegionSize);
+}
+
+namespace utils {
+std::string get_cgroup_path(int pid) {
+  std::ifstream ifs("/proc/" + std::to_string(pid) + "/cgroup");
+  std::string line;
+  while (std::getline(ifs, line)) {
+    if (line.rfind("0::", 0) != 0) // only the cgroup v2 hierarchy
+      continue;
+    auto rel_path = line.substr(3);
+    for (const auto &root : kCgroupV2Roots) {
+      auto path = std::string(root) + (rel_path == "/" ? "" : rel_path);
+      if (access((path + "/cgroup.controllers").c_str(), F_OK) == 0)
+        return path;
+    }
+  }
+  return "";
+}
+} // namespace utils
+
+} // namespace midas
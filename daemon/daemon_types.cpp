@@ -1,14 +1,22 @@
+#include <algorithm>
 #include <atomic>
 #include <boost/interprocess/exceptions.hpp>
+#include <cerrno>
 #include <chrono>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <deque>
 #include <fstream>
 #include <future>
 #include <memory>
 #include <mutex>
+#include <poll.h>
+#include <shared_mutex>
+#include <sys/syscall.h>
 #include <sys/sysinfo.h>
 #include <thread>
+#include <unistd.h>
 
 #include "inc/daemon_types.hpp"
 #include "logging.hpp"
@@ -30,6 +38,15 @@ constexpr static bool kEnableProfiler = true;
 constexpr static bool kEnableRebalancer = true;
 /** Monitor related */
 constexpr static uint32_t kMonitorInteral = 1; // in seconds
+/** PSI related */
+constexpr static bool kEnablePSI = true;
+constexpr static float kPSIMinShrink = 0.02; // shrink ratio per event
+constexpr static float kPSIMaxShrink = 0.25;
+constexpr static uint32_t kPSIHoldTime = 10; // in seconds
+/** cgroup related */
+constexpr static bool kEnableCGroup = true;
+// shrink the cap by this ratio on every memory.high/max breach
+constexpr static float kCGroupBreachShrink = 0.1;
 /** Profiler related */
 constexpr static float kPerfZeroThresh = 1;
 constexpr static uint32_t kProfInterval = 5; // in seconds
@@ -38,24 +55,61 @@ constexpr static float KProfWDecay = 0.3;
 constexpr static float kExpandFactor = 0.5;
 constexpr static uint32_t kMaxExpandThresh = 128;
 constexpr static int32_t kWarmupRounds = 2;
+/** MRC policy related */
+// the victim cache tracks up to 64MB evicted objects beyond a client's size
+constexpr static uint64_t kMRCGhostRegions = (64ull << 20) / kRegionSize;
+constexpr static int64_t kMRCMaxStep = 64; // max #regions to move per round
+constexpr static int64_t kMRCDeadband = 4; // skip tiny moves to avoid jitter
 /** Server related */
 constexpr static uint32_t kAliveTimeout = 3;   // in seconds
 constexpr static uint32_t kReclaimTimeout = 5; // in seconds
 constexpr static uint32_t kServeTimeout = 1;   // in seconds
+// serve workers the ctrl queue is sharded onto by client id
+constexpr static uint32_t kNrServeWorkers = 8;
+constexpr static uint32_t kNrProfThreads = 16;
 
 /** Client */
 Client::Client(Daemon *daemon, uint64_t id_, uint64_t region_limit)
-    : daemon_(daemon), status(ClientStatusCode::INIT), id(id_), region_cnt_(0),
-      region_limit_(region_limit), weight_(1), warmup_ttl_(0),
-      lat_critical_(false), cq(utils::get_ackq_name(kNameCtrlQ, id), false),
-      txqp(std::to_string(id), false) {
+    : Client(daemon, id_, region_limit,
+             std::make_shared<QSingle>(utils::get_ackq_name(kNameCtrlQ, id_),
+                                       false),
+             std::make_shared<QPair>(std::to_string(id_), false)) {
+  stats_board_ = std::make_unique<StatsBoard>(id, false);
+  if (!stats_board_->valid()) { // fall back to PROF_STATS requests
+    MIDAS_LOG(kInfo) << "Client " << id << " has no stats board";
+    stats_board_.reset();
+  }
+  if (!kEnableCGroup)
+    return;
+  cgroup_ = CGroup::discover(utils::get_client_pid(id));
+  if (!cgroup_)
+    return;
+  cgroup_events_ = cgroup_->memory_events();
+  uint64_t cap = cgroup_->region_cap(0);
+  cgroup_cap_ = cap;
+  if (region_limit_ > cap) {
+    daemon_->uncharge(region_limit_ - cap);
+    region_limit_ = cap;
+  }
+  MIDAS_LOG(kInfo) << "Client " << id << " runs in cgroup " << cgroup_->path()
+                   << ", capped at " << cap << " regions";
+}
+
+Client::Client(Daemon *daemon, uint64_t id_, uint64_t region_limit,
+               std::shared_ptr<QSingle> cq_, std::shared_ptr<QPair> txqp_)
+    : id(id_), status(ClientStatusCode::INIT), cq(cq_), txqp(txqp_),
+      board_stats_(), cgroup_cap_(CGroup::kUnlimited), daemon_(daemon),
+      region_cnt_(0), region_limit_(region_limit), weight_(1), warmup_ttl_(0),
+      lat_critical_(false) {
   daemon_->charge(region_limit_);
 }
 
 Client::~Client() {
   daemon_->uncharge(region_limit_);
-  cq.destroy();
-  txqp.destroy();
+  if (cq)
+    cq->destroy();
+  if (txqp)
+    txqp->destroy();
   destroy();
 }
 
@@ -63,14 +117,14 @@ void Client::connect() {
   CtrlMsg ack{.op = CtrlOpCode::CONNECT,
               .ret = CtrlRetCode::CONN_SUCC,
               .mmsg{.size = region_limit_ * kRegionSize}};
-  cq.send(&ack, sizeof(ack));
+  cq->send(&ack, sizeof(ack));
   status = ClientStatusCode::CONNECTED;
 }
 
 void Client::disconnect() {
   status = ClientStatusCode::DISCONNECTED;
   CtrlMsg ret_msg{.op = CtrlOpCode::DISCONNECT, .ret = CtrlRetCode::CONN_SUCC};
-  cq.send(&ret_msg, sizeof(ret_msg));
+  cq->send(&ret_msg, sizeof(ret_msg));
 }
 
 /** @overcommit: evacuator might request several overcommitted regions for
@@ -110,7 +164,7 @@ bool Client::alloc_region_(bool overcommit) {
   }
 
   CtrlMsg ret_msg{.op = CtrlOpCode::ALLOC, .ret = ret, .mmsg = mm};
-  cq.send(&ret_msg, sizeof(ret_msg));
+  cq->send(&ret_msg, sizeof(ret_msg));
   return ret == CtrlRetCode::MEM_SUCC;
 }
 
@@ -138,7 +192,7 @@ bool Client::free_region(int64_t region_id) {
   }
 
   CtrlMsg ack{.op = CtrlOpCode::FREE, .ret = ret, .mmsg = mm};
-  cq.send(&ack, sizeof(ack));
+  cq->send(&ack, sizeof(ack));
   return ret == CtrlRetCode::MEM_SUCC;
 }
 
@@ -154,20 +208,36 @@ void Client::set_lat_critical(bool value) {
 }
 
 bool Client::update_limit(uint64_t new_limit) {
+  std::unique_lock<std::mutex> ul(tx_mtx);
+  return update_limit_(new_limit);
+}
+
+bool Client::shrink_to_cgroup_cap() {
+  std::unique_lock<std::mutex> ul(tx_mtx);
+  uint64_t cap = cgroup_cap_;
+  if (region_limit_ <= cap)
+    return true;
+  MIDAS_LOG(kInfo) << "Client " << id << " shrinks to its cgroup cap "
+                   << region_limit_ << " -> " << cap;
+  return update_limit_(cap);
+}
+
+/* Must be called with tx_mtx held, which orders the limit updates of the
+ * client, whether from the monitor, the rebalancer or a shard worker. */
+bool Client::update_limit_(uint64_t new_limit) {
+  new_limit = std::min(new_limit, cgroup_cap_.load());
   if (new_limit + kForceReclaimThresh < region_limit_)
-    return force_reclaim(new_limit);
+    return force_reclaim_(new_limit);
   if (new_limit == region_limit_)
     return true;
   daemon_->charge(new_limit - region_limit_);
   region_limit_ = new_limit;
 
-  std::unique_lock<std::mutex> ul(tx_mtx);
   CtrlMsg msg{.op = CtrlOpCode::UPDLIMIT,
               .ret = CtrlRetCode::MEM_FAIL,
               .mmsg{.size = region_limit_}};
-  txqp.send(&msg, sizeof(msg));
   CtrlMsg ack;
-  if (txqp.timed_recv(&ack, sizeof(ack), kReclaimTimeout) != 0) {
+  if (request(msg, &ack, sizeof(ack), kReclaimTimeout) != 0) {
     MIDAS_LOG(kError) << "Client " << id << " timed out!";
     return false;
   }
@@ -183,18 +253,22 @@ bool Client::update_limit(uint64_t new_limit) {
 }
 
 bool Client::force_reclaim(uint64_t new_limit) {
+  std::unique_lock<std::mutex> ul(tx_mtx);
+  return force_reclaim_(new_limit);
+}
+
+/* Must be called with tx_mtx held. */
+bool Client::force_reclaim_(uint64_t new_limit) {
   if (new_limit == region_limit_)
     return true;
   daemon_->charge(new_limit - region_limit_);
   region_limit_ = new_limit;
 
-  std::unique_lock<std::mutex> ul(tx_mtx);
   CtrlMsg msg{.op = CtrlOpCode::FORCE_RECLAIM,
               .ret = CtrlRetCode::MEM_FAIL,
               .mmsg{.size = region_limit_}};
-  txqp.send(&msg, sizeof(msg));
   CtrlMsg ack;
-  if (txqp.timed_recv(&ack, sizeof(ack), kReclaimTimeout) != 0) {
+  if (request(msg, &ack, sizeof(ack), kReclaimTimeout) != 0) {
     MIDAS_LOG(kError) << "Client " << id << " timed out!";
     return false;
   }
@@ -206,21 +280,64 @@ bool Client::force_reclaim(uint64_t new_limit) {
   return true;
 }
 
+bool Client::read_stats_board(StatsMsg *statsmsg, uint64_t *saved_cycles) {
+  StatsSnapshot snapshot;
+  if (!stats_board_ || !stats_board_->read(&snapshot))
+    return false;
+  // a client that stops publishing might be dead; ask it directly
+  if (StatsBoard::now_us() - snapshot.timestamp > kAliveTimeout * 1000000ull)
+    return false;
+  auto miss_cycles = snapshot.miss_cycles - board_stats_.miss_cycles;
+  auto miss_bytes = snapshot.miss_bytes - board_stats_.miss_bytes;
+  statsmsg->hits = snapshot.hits - board_stats_.hits;
+  statsmsg->misses = snapshot.misses - board_stats_.misses;
+  statsmsg->miss_penalty =
+      miss_bytes ? static_cast<double>(miss_cycles) / miss_bytes : 0.;
+  statsmsg->vhits = snapshot.vhits - board_stats_.vhits;
+  statsmsg->headroom = snapshot.headroom;
+  *saved_cycles = snapshot.saved_cycles - board_stats_.saved_cycles;
+  auto ctier_lookups = snapshot.ctier_lookups - board_stats_.ctier_lookups;
+  if (ctier_lookups) {
+    auto hits = snapshot.ctier_hits - board_stats_.ctier_hits;
+    auto raw_bytes = snapshot.ctier_raw_bytes - board_stats_.ctier_raw_bytes;
+    auto compressed_bytes =
+        snapshot.ctier_compressed_bytes - board_stats_.ctier_compressed_bytes;
+    auto cycles =
+        snapshot.ctier_decompress_cycles - board_stats_.ctier_decompress_cycles;
+    MIDAS_LOG(kDebug) << "Client " << id << " compressed tier: hit ratio "
+                      << static_cast<double>(hits) / ctier_lookups
+                      << ", compress ratio "
+                      << (compressed_bytes ? static_cast<double>(raw_bytes) /
+                                                 compressed_bytes
+                                           : 0.)
+                      << ", decompress time "
+                      << (hits ? static_cast<double>(cycles) / hits / kCPUFreq
+                               : 0.)
+                      << "us";
+  }
+  board_stats_ = snapshot;
+  return true;
+}
+
 bool Client::profile_stats() {
-  std::unique_lock<std::mutex> ul(tx_mtx);
-  CtrlMsg msg{.op = CtrlOpCode::PROF_STATS};
-  txqp.send(&msg, sizeof(msg));
   StatsMsg statsmsg;
-  int ret = txqp.timed_recv(&statsmsg, sizeof(statsmsg), kAliveTimeout);
-  if (ret != 0) {
-    MIDAS_LOG(kWarning) << "Client " << id << " is dead!";
-    return false;
+  uint64_t saved_cycles = 0; // only published on the stats board
+  std::unique_lock<std::mutex> ul(tx_mtx);
+  if (!read_stats_board(&statsmsg, &saved_cycles)) {
+    CtrlMsg msg{.op = CtrlOpCode::PROF_STATS};
+    int ret = request(msg, &statsmsg, sizeof(statsmsg), kAliveTimeout);
+    if (ret != 0) {
+      MIDAS_LOG(kWarning) << "Client " << id << " is dead!";
+      return false;
+    }
   }
   if (statsmsg.hits || statsmsg.misses) {
     MIDAS_LOG(kDebug) << "Client " << id << " " << statsmsg.hits << " "
                       << statsmsg.misses << " " << statsmsg.miss_penalty << " "
-                      << statsmsg.vhits;
+                      << statsmsg.vhits << " " << saved_cycles;
   }
+  mrc_.record(region_cnt_, statsmsg.hits, statsmsg.misses, statsmsg.vhits,
+              kMRCGhostRegions);
   // update historical stats
   stats.hits = stats.hits * KProfWDecay + statsmsg.hits * (1 - KProfWDecay);
   stats.misses =
@@ -230,14 +347,47 @@ bool Client::profile_stats() {
       stats.penalty * KProfWDecay + statsmsg.miss_penalty * (1 - KProfWDecay);
   stats.perf_gain = weight_ * stats.penalty * stats.vhits;
   stats.headroom = std::max<int32_t>(1, statsmsg.headroom);
+  stats.saved_cycles = saved_cycles;
+  stats.total_saved += saved_cycles;
   return true;
 }
 
+bool Client::check_cgroup() {
+  if (!cgroup_)
+    return false;
+  auto events = cgroup_->memory_events();
+  bool breached = events.high > cgroup_events_.high ||
+                  events.max > cgroup_events_.max ||
+                  events.oom > cgroup_events_.oom;
+  cgroup_events_ = events;
+
+  uint64_t cap = cgroup_->region_cap(region_cnt_);
+  if (breached) {
+    // the kernel is already reclaiming or OOMing the cgroup; back off below
+    // the current usage rather than trusting memory.current
+    cap = std::min<uint64_t>(cap, region_cnt_ * (1 - kCGroupBreachShrink));
+    MIDAS_LOG(kWarning) << "Client " << id << " cgroup " << cgroup_->path()
+                        << " breached its limit (high " << events.high
+                        << ", max " << events.max << ", oom " << events.oom
+                        << "), cap at " << cap << " regions";
+  }
+  cgroup_cap_ = std::max<uint64_t>(cap, 1);
+  return breached;
+}
+
+int Client::request(const CtrlMsg &msg, void *reply, size_t reply_size,
+                    int timeout) {
+  txqp->send(&msg, sizeof(msg));
+  return txqp->timed_recv(reply, reply_size, timeout);
+}
+
 void Client::destroy() {
   for (const auto &kv : regions) {
     const std::string name = utils::get_region_name(id, kv.first);
     SharedMemObj::remove(name.c_str());
   }
+  if (stats_board_) // in case the client died without removing it
+    StatsBoard::remove(id);
 }
 
 bool Client::almost_full() noexcept {
@@ -247,18 +397,33 @@ bool Client::almost_full() noexcept {
 
 /** Daemon */
 Daemon::Daemon(const std::string ctrlq_name)
-    : ctrlq_name_(utils::get_rq_name(ctrlq_name, true)),
-      ctrlq_(ctrlq_name_, true, kDaemonQDepth, kMaxMsgSize), region_cnt_(0),
-      region_limit_(kMaxRegions), terminated_(false),
-      status_(MemStatus::NORMAL), policy(kDefaultPolicy), monitor_(nullptr),
-      profiler_(nullptr), rebalancer_(nullptr) {
+    : status_(MemStatus::NORMAL), terminated_(false), policy(kDefaultPolicy),
+      monitor_(nullptr), profiler_(nullptr), rebalancer_(nullptr),
+      ctrlq_name_(utils::get_rq_name(ctrlq_name, true)),
+      ctrlq_(std::make_shared<QSingle>(ctrlq_name_, true, kDaemonQDepth,
+                                       kMaxMsgSize)),
+      region_cnt_(0), region_limit_(kMaxRegions), psi_region_cap_(kMaxRegions),
+      pressure_ts_(0) {
+  for (uint32_t i = 0; i < kNrServeWorkers; i++) {
+    auto &shard = shards_.emplace_back(std::make_unique<ServeShard>());
+    workers_.emplace_back(std::make_shared<std::thread>(
+        [&, &shard = *shard] { serve_worker(shard); }));
+  }
   monitor_ = std::make_shared<std::thread>([&] { monitor(); });
-  if (kEnableProfiler)
+  if (kEnableProfiler) {
+    prof_pool_ = std::make_unique<ThreadPool>(kNrProfThreads);
     profiler_ = std::make_shared<std::thread>([&] { profiler(); });
+  }
   if (kEnableRebalancer)
     rebalancer_ = std::make_shared<std::thread>([&] { rebalancer(); });
 }
 
+Daemon::Daemon(Policy policy_, uint64_t region_limit)
+    : status_(MemStatus::NORMAL), terminated_(false), policy(policy_),
+      monitor_(nullptr), profiler_(nullptr), rebalancer_(nullptr),
+      ctrlq_(nullptr), region_cnt_(0), region_limit_(region_limit),
+      psi_region_cap_(kMaxRegions), pressure_ts_(0) {}
+
 Daemon::~Daemon() {
   terminated_ = true;
   {
@@ -271,24 +436,34 @@ Daemon::~Daemon() {
     profiler_->join();
   if (rebalancer_)
     rebalancer_->join();
+  for (auto &shard : shards_)
+    shard->cv.notify_all();
+  for (auto &worker : workers_)
+    worker->join();
+  prof_pool_.reset();
   clients_.clear();
-  MsgQueue::remove(ctrlq_name_.c_str());
+  for (auto &[_, store] : shkvs_) { // attached processes keep their mappings
+    for (auto &[_, pidfd] : store.attachers)
+      if (pidfd >= 0)
+        close(pidfd);
+    SharedMemObj::remove(store.name.c_str());
+  }
+  if (ctrlq_)
+    MsgQueue::remove(ctrlq_name_.c_str());
 }
 
 int Daemon::do_connect(const CtrlMsg &msg) {
   try {
-    std::unique_lock<std::mutex> ul(mtx_);
-    if (clients_.find(msg.id) != clients_.cend()) {
+    if (get_client(msg.id)) {
       MIDAS_LOG(kError) << "Client " << msg.id << " connected twice!";
       /* TODO: this might be some stale client. Probably we could try to
        * send the ack back */
       return -1;
     }
-    ul.unlock();
     auto client = std::make_shared<Client>(this, msg.id, kInitRegions);
     client->connect();
     MIDAS_LOG(kInfo) << "Client " << msg.id << " connected.";
-    ul.lock();
+    std::unique_lock<std::shared_mutex> ul(mtx_);
     clients_.insert(std::make_pair(msg.id, std::move(client)));
     ul.unlock();
   } catch (boost::interprocess::interprocess_exception &e) {
@@ -300,7 +475,7 @@ int Daemon::do_connect(const CtrlMsg &msg) {
 
 int Daemon::do_disconnect(const CtrlMsg &msg) {
   try {
-    std::unique_lock<std::mutex> ul(mtx_);
+    std::unique_lock<std::shared_mutex> ul(mtx_);
     auto client_iter = clients_.find(msg.id);
     if (client_iter == clients_.cend()) {
       /* TODO: this might be some unregistered client. Probably we could try to
@@ -320,17 +495,22 @@ int Daemon::do_disconnect(const CtrlMsg &msg) {
   return 0;
 }
 
+std::shared_ptr<Client> Daemon::get_client(uint64_t id) {
+  std::shared_lock<std::shared_mutex> ul(mtx_);
+  auto client_iter = clients_.find(id);
+  if (client_iter == clients_.cend())
+    return nullptr;
+  return client_iter->second;
+}
+
 int Daemon::do_alloc(const CtrlMsg &msg) {
   assert(msg.mmsg.size == kRegionSize);
-  std::unique_lock<std::mutex> ul(mtx_);
-  auto client_iter = clients_.find(msg.id);
-  if (client_iter == clients_.cend()) {
+  auto client = get_client(msg.id);
+  if (!client) {
     /* TODO: same as in do_disconnect */
     MIDAS_LOG(kError) << "Client " << msg.id << " doesn't exist!";
     return -1;
   }
-  ul.unlock();
-  auto &client = client_iter->second;
   assert(msg.id == client->id);
   client->alloc_region();
 
@@ -339,15 +519,12 @@ int Daemon::do_alloc(const CtrlMsg &msg) {
 
 int Daemon::do_overcommit(const CtrlMsg &msg) {
   assert(msg.mmsg.size == kRegionSize);
-  std::unique_lock<std::mutex> ul(mtx_);
-  auto client_iter = clients_.find(msg.id);
-  if (client_iter == clients_.cend()) {
+  auto client = get_client(msg.id);
+  if (!client) {
     /* TODO: same as in do_disconnect */
     MIDAS_LOG(kError) << "Client " << msg.id << " doesn't exist!";
     return -1;
   }
-  ul.unlock();
-  auto &client = client_iter->second;
   assert(msg.id == client->id);
   client->overcommit_region();
 
@@ -355,73 +532,184 @@ int Daemon::do_overcommit(const CtrlMsg &msg) {
 }
 
 int Daemon::do_free(const CtrlMsg &msg) {
-  auto client_iter = clients_.find(msg.id);
-  std::unique_lock<std::mutex> ul(mtx_);
-  if (client_iter == clients_.cend()) {
+  auto client = get_client(msg.id);
+  if (!client) {
     /* TODO: same as in do_disconnect */
     MIDAS_LOG(kError) << "Client " << msg.id << " doesn't exist!";
     return -1;
   }
-  ul.unlock();
   uint64_t region_id = msg.mmsg.region_id;
-  size_t region_size = msg.mmsg.size;
-  auto &client = client_iter->second;
   client->free_region(region_id);
 
   return 0;
 }
 
 int Daemon::do_update_limit_req(const CtrlMsg &msg) {
-  std::unique_lock<std::mutex> ul(mtx_);
-  auto client_iter = clients_.find(msg.id);
-  if (client_iter == clients_.cend()) {
+  auto client = get_client(msg.id);
+  if (!client) {
     /* TODO: same as in do_disconnect */
     MIDAS_LOG(kError) << "Client " << msg.id << " doesn't exist!";
     return -1;
   }
-  ul.unlock();
   auto upd_region_lim = std::min(msg.mmsg.size / kRegionSize, region_limit_);
-  auto &client = client_iter->second;
-  if (upd_region_lim != client->region_limit_) {
-    bool succ = client->update_limit(upd_region_lim);
-  }
+  if (upd_region_lim != client->region_limit_)
+    client->update_limit(upd_region_lim);
 
   return 0;
 }
 
 int Daemon::do_set_weight(const CtrlMsg &msg) {
-  std::unique_lock<std::mutex> ul(mtx_);
-  auto client_iter = clients_.find(msg.id);
-  if (client_iter == clients_.cend()) {
+  auto client = get_client(msg.id);
+  if (!client) {
     /* TODO: same as in do_disconnect */
     MIDAS_LOG(kError) << "Client " << msg.id << " doesn't exist!";
     return -1;
   }
-  ul.unlock();
   float weight = msg.mmsg.weight;
-  auto &client = client_iter->second;
   client->set_weight(weight);
   return 0;
 }
 
 int Daemon::do_set_lat_critical(const CtrlMsg &msg) {
-  std::unique_lock<std::mutex> ul(mtx_);
-  auto client_iter = clients_.find(msg.id);
-  if (client_iter == clients_.cend()) {
+  auto client = get_client(msg.id);
+  if (!client) {
     /* TODO: same as in do_disconnect */
     MIDAS_LOG(kError) << "Client " << msg.id << " doesn't exist!";
     return -1;
   }
-  ul.unlock();
   bool lat_critical = msg.mmsg.lat_critical;
-  auto &client = client_iter->second;
   client->set_lat_critical(lat_critical);
   return 0;
 }
 
+/* Shared KV attachers are not clients and only have an ack queue. */
+static void reply_shared_kv(const CtrlMsg &msg, CtrlRetCode ret,
+                            uint64_t size) {
+  CtrlMsg ack{.id = msg.id,
+              .op = msg.op,
+              .ret = ret,
+              .mmsg{.region_id = msg.mmsg.region_id, .size = size}};
+  try {
+    MsgQueue ackq(boost::interprocess::open_only,
+                  utils::get_ackq_name(kNameCtrlQ, msg.id).c_str());
+    ackq.send(&ack, sizeof(ack), /* prio = */ 0);
+  } catch (boost::interprocess::interprocess_exception &e) {
+    MIDAS_LOG(kError) << e.what();
+  }
+}
+
+/* The store is named by the hash in region_id and sized by its first
+ * attacher, which is told to set it up. Its size is charged in regions. */
+int Daemon::do_shkv_attach(const CtrlMsg &msg) {
+  using namespace boost::interprocess;
+  const uint64_t key = msg.mmsg.region_id;
+  CtrlRetCode ret = CtrlRetCode::MEM_SUCC;
+  std::unique_lock<std::mutex> ul(shkv_mtx_);
+  auto iter = shkvs_.find(key);
+  if (iter == shkvs_.cend()) {
+    SharedKVStore store{utils::get_shared_kv_name(key), msg.mmsg.size,
+                        static_cast<int64_t>((msg.mmsg.size + kRegionSize - 1) /
+                                             kRegionSize)};
+    try {
+      if (store.size == 0)
+        throw interprocess_exception("the store does not exist");
+      permissions perms;
+      perms.set_unrestricted();
+      SharedMemObj::remove(store.name.c_str()); // left by a previous daemon
+      SharedMemObj shm(create_only, store.name.c_str(), read_write, perms);
+      shm.truncate(store.size);
+      store.meta = std::make_unique<mapped_region>(shm, read_write, 0,
+                                                   sizeof(uint32_t));
+    } catch (interprocess_exception &e) {
+      MIDAS_LOG(kError) << "Failed to create shared KV " << key << ": "
+                        << e.what();
+      SharedMemObj::remove(store.name.c_str());
+      ul.unlock();
+      reply_shared_kv(msg, CtrlRetCode::MEM_FAIL, 0);
+      return -1;
+    }
+    charge(store.nr_regions);
+    MIDAS_LOG(kInfo) << "Created shared KV " << key << " of "
+                     << store.nr_regions << " regions";
+    iter = shkvs_.emplace(key, std::move(store)).first;
+    ret = CtrlRetCode::CONN_SUCC;
+  }
+  auto &store = iter->second;
+  const uint64_t size = store.size;
+  int pidfd = syscall(SYS_pidfd_open, utils::get_client_pid(msg.id), 0);
+  if (pidfd >= 0 || errno != ESRCH) {
+    if (pidfd < 0)
+      MIDAS_LOG(kWarning) << "Cannot watch shared KV attacher " << msg.id
+                          << ": " << strerror(errno);
+    store.attachers[msg.id] = pidfd;
+  }
+  update_shared_kv(iter);
+  ul.unlock();
+  reply_shared_kv(msg, ret, size);
+  return 0;
+}
+
+int Daemon::do_shkv_detach(const CtrlMsg &msg) {
+  std::unique_lock<std::mutex> ul(shkv_mtx_);
+  auto iter = shkvs_.find(msg.mmsg.region_id);
+  if (iter == shkvs_.cend() || !iter->second.attachers.count(msg.id)) {
+    ul.unlock();
+    MIDAS_LOG(kError) << "Client " << msg.id << " is not attached to shared KV "
+                      << msg.mmsg.region_id;
+    reply_shared_kv(msg, CtrlRetCode::MEM_FAIL, 0);
+    return -1;
+  }
+  auto &attachers = iter->second.attachers;
+  auto pidfd = attachers[msg.id];
+  if (pidfd >= 0)
+    close(pidfd);
+  attachers.erase(msg.id);
+  update_shared_kv(iter);
+  ul.unlock();
+  reply_shared_kv(msg, CtrlRetCode::CONN_SUCC, 0);
+  return 0;
+}
+
+void Daemon::update_shared_kv(
+    std::unordered_map<uint64_t, SharedKVStore>::iterator iter) {
+  auto &store = iter->second;
+  if (!store.attachers.empty()) {
+    auto nr_attached =
+        reinterpret_cast<std::atomic_uint32_t *>(store.meta->get_address());
+    nr_attached->store(store.attachers.size());
+    return;
+  }
+  SharedMemObj::remove(store.name.c_str());
+  uncharge(store.nr_regions);
+  MIDAS_LOG(kInfo) << "Removed shared KV " << iter->first;
+  shkvs_.erase(iter);
+}
+
+void Daemon::reap_shared_kvs() {
+  std::unique_lock<std::mutex> ul(shkv_mtx_);
+  for (auto iter = shkvs_.begin(); iter != shkvs_.end();) {
+    auto next = std::next(iter);
+    auto &attachers = iter->second.attachers;
+    const auto nr_attached = attachers.size();
+    for (auto it = attachers.begin(); it != attachers.end();) {
+      struct pollfd pfd { it->second, POLLIN, 0 };
+      if (it->second < 0 || poll(&pfd, 1, 0) <= 0) {
+        ++it;
+        continue;
+      }
+      MIDAS_LOG(kWarning) << "Shared KV attacher " << it->first << " died";
+      close(it->second);
+      it = attachers.erase(it);
+    }
+    if (attachers.size() != nr_attached)
+      update_shared_kv(iter);
+    iter = next;
+  }
+}
+
 void Daemon::charge(int64_t nr_regions) {
-  region_cnt_ += nr_regions;
-  if (region_cnt_ > region_limit_) {
+  int64_t region_cnt = region_cnt_.fetch_add(nr_regions) + nr_regions;
+  if (region_cnt > static_cast<int64_t>(region_limit_)) {
     std::unique_lock<std::mutex> ul(rbl_mtx_);
     status_ = MemStatus::NEED_SHRINK;
     rbl_cv_.notify_one();
@@ -429,8 +717,8 @@ void Daemon::charge(int64_t nr_regions) {
 }
 
 void Daemon::uncharge(int64_t nr_regions) {
-  region_cnt_ -= nr_regions;
-  if (region_cnt_ < region_limit_) {
+  int64_t region_cnt = region_cnt_.fetch_sub(nr_regions) - nr_regions;
+  if (region_cnt < static_cast<int64_t>(region_limit_)) {
     std::unique_lock<std::mutex> ul(rbl_mtx_);
     status_ = MemStatus::NEED_EXPAND;
     rbl_cv_.notify_one();
@@ -438,82 +726,179 @@ void Daemon::uncharge(int64_t nr_regions) {
 }
 
 void Daemon::monitor() {
+  using clock = std::chrono::steady_clock;
+  std::unique_ptr<PSITrigger> psi;
+  if (kEnablePSI)
+    psi = std::make_unique<PSITrigger>();
+
+  const auto interval = std::chrono::seconds(kMonitorInteral);
+  auto next_poll = clock::now();
   while (!terminated_) {
-    // monitor & update mem limit
-    auto upd_mem_limit = kEnableMemPressureSimu ? utils::check_file_avail_mem()
-                                                : utils::check_sys_avail_mem();
-    uint64_t upd_region_limit = upd_mem_limit / kRegionSize;
-    if (region_limit_ != upd_region_limit) {
-      if (kEnableMemPressureSimu)
-        MIDAS_LOG(kDebug) << region_limit_ << " -> " << upd_region_limit;
-      region_limit_ = upd_region_limit;
-      if (region_cnt_ > region_limit_) { // invoke rebalancer
-        std::unique_lock<std::mutex> ul(rbl_mtx_);
-        status_ = MemStatus::NEED_SHRINK;
-        rbl_cv_.notify_one();
+    if (clock::now() >= next_poll) {
+      next_poll = clock::now() + interval;
+      // monitor & update mem limit
+      auto upd_mem_limit = kEnableMemPressureSimu
+                               ? utils::check_file_avail_mem()
+                               : utils::check_sys_avail_mem();
+      uint64_t upd_region_limit = upd_mem_limit / kRegionSize;
+      if (psi_region_cap_ < upd_region_limit) {
+        // hold the shrunk limit for a while after the last pressure event
+        if (clock::now() - last_pressure_ >
+            std::chrono::seconds(kPSIHoldTime))
+          psi_region_cap_ = kMaxRegions;
+        else
+          upd_region_limit = psi_region_cap_;
+      }
+      update_region_limit(upd_region_limit);
+      check_cgroups();
+
+      // monitor & update policy
+      auto new_policy = utils::check_policy();
+      if (new_policy >= Policy::Static && new_policy < Policy::NumPolicy &&
+          new_policy != policy) {
+        MIDAS_LOG(kError) << "Policy changed " << policy << " -> "
+                          << new_policy;
+        policy = static_cast<Policy>(new_policy);
       }
     }
 
-    // monitor & update policy
-    auto new_policy = utils::check_policy();
-    if (new_policy >= Policy::Static && new_policy < Policy::NumPolicy &&
-        new_policy != policy) {
-      MIDAS_LOG(kError) << "Policy changed " << policy << " -> " << new_policy;
-      policy = static_cast<Policy>(new_policy);
+    if (psi && psi->valid()) { // the periodic poll above is the fallback
+      auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(
+          next_poll - clock::now());
+      if (psi->wait(std::max<int64_t>(0, timeout.count())) > 0)
+        on_mem_pressure(psi->some_avg10());
+    } else {
+      std::this_thread::sleep_until(next_poll);
     }
+  }
+}
+
+/** Invoked by PSI triggers when tasks start to stall on memory. Shrink the
+ * total grant in proportion to the stall time right away, instead of waiting
+ * for the next poll of available memory.
+ */
+void Daemon::on_mem_pressure(float some_avg10) {
+  using clock = std::chrono::steady_clock;
+  last_pressure_ = clock::now();
+  pressure_ts_ = last_pressure_.time_since_epoch().count();
+
+  // step down from the limit, but never below what is charged minus a step,
+  // so a mild stall cannot collapse a barely used grant
+  float shrink_ratio =
+      std::clamp(some_avg10 / 100.f, kPSIMinShrink, kPSIMaxShrink);
+  int64_t limit = region_limit_;
+  int64_t step = std::max<int64_t>(1, limit * shrink_ratio);
+  int64_t region_cnt = region_cnt_;
+  uint64_t upd_region_limit = std::clamp<int64_t>(
+      std::max(limit - step, region_cnt - step), 1, limit);
+  MIDAS_LOG(kWarning) << "Memory pressure detected (some avg10 = "
+                      << some_avg10 << "%), shrink " << region_limit_ << " -> "
+                      << upd_region_limit;
+  update_region_limit(upd_region_limit);
+  if (region_cnt <= static_cast<int64_t>(upd_region_limit)) {
+    pressure_ts_ = 0; // nothing to shrink, so no reaction to time
+    return;
+  }
+  psi_region_cap_ = std::min(psi_region_cap_, upd_region_limit);
+}
 
-    std::this_thread::sleep_for(std::chrono::seconds(kMonitorInteral));
+/** Tenants' cgroup limits bind before host memory does. Keep each client's
+ * limit within its cgroup cap so soft memory fills the headroom of the
+ * container without triggering the kernel OOM killer.
+ */
+void Daemon::check_cgroups() {
+  if (!kEnableCGroup)
+    return;
+  std::vector<std::shared_ptr<Client>> capped_clients;
+  std::shared_lock<std::shared_mutex> ul(mtx_);
+  for (auto &[_, client] : clients_) {
+    client->check_cgroup();
+    if (client->region_limit_ > client->cgroup_cap_)
+      capped_clients.emplace_back(client);
+  }
+  ul.unlock();
+  // the limit may have moved since, so the client checks it again
+  for (auto client : capped_clients)
+    client->shrink_to_cgroup_cap();
+}
+
+void Daemon::update_region_limit(uint64_t upd_region_limit) {
+  if (region_limit_ == upd_region_limit)
+    return;
+  if (kEnableMemPressureSimu)
+    MIDAS_LOG(kDebug) << region_limit_ << " -> " << upd_region_limit;
+  region_limit_ = upd_region_limit;
+  if (region_cnt_ > region_limit_) { // invoke rebalancer
+    std::unique_lock<std::mutex> ul(rbl_mtx_);
+    status_ = MemStatus::NEED_SHRINK;
+    rbl_cv_.notify_one();
   }
 }
 
 void Daemon::profiler() {
   while (!terminated_) {
     std::this_thread::sleep_for(std::chrono::seconds(kProfInterval));
-    std::atomic_int_fast32_t nr_active_clients{0};
-    std::mutex dead_mtx;
-    std::vector<uint64_t> dead_clients;
-    std::vector<std::future<void>> futures;
-    std::unique_lock<std::mutex> ul(mtx_);
-    for (auto &[_, client] : clients_) {
-      auto future = std::async(std::launch::async, [&, &client = client] {
-        bool alive = client->profile_stats();
-        if (!alive) {
-          std::unique_lock<std::mutex> ul(dead_mtx);
-          dead_clients.emplace_back(client->id);
-          return;
-        }
-        if (client->stats.perf_gain > kPerfZeroThresh)
-          nr_active_clients++;
-      });
-      futures.emplace_back(std::move(future));
-    }
-    ul.unlock();
-    for (auto &f : futures)
-      f.get();
-    ul.lock();
-    for (const auto &cid : dead_clients)
-      clients_.erase(cid);
-    dead_clients.clear();
-    ul.unlock();
+    profile_clients();
+  }
+}
 
-    // invoke rebalancer
-    if (region_cnt_ < region_limit_) {
-      if (nr_active_clients > 0) {
-        std::unique_lock<std::mutex> ul(rbl_mtx_);
-        status_ = MemStatus::NEED_EXPAND;
-        rbl_cv_.notify_one();
+void Daemon::profile_clients() {
+  std::atomic_int_fast32_t nr_active_clients{0};
+  std::atomic_uint64_t saved_cycles{0};
+  std::mutex dead_mtx;
+  std::vector<uint64_t> dead_clients;
+  std::vector<std::shared_ptr<Client>> clients;
+  std::shared_lock<std::shared_mutex> sl(mtx_);
+  for (auto &[_, client] : clients_)
+    clients.emplace_back(client);
+  sl.unlock();
+  for (auto &client : clients) {
+    auto profile = [&, &client = client] {
+      bool alive = client->profile_stats();
+      if (!alive) {
+        std::unique_lock<std::mutex> ul(dead_mtx);
+        dead_clients.emplace_back(client->id);
+        return;
       }
-    } else if (region_cnt_ == region_limit_) {
-      std::unique_lock<std::mutex> ul(rbl_mtx_);
-      status_ = MemStatus::NEED_REBALANCE;
-      rbl_cv_.notify_one();
-    } else if (region_cnt_ > region_limit_) {
+      if (client->stats.perf_gain > kPerfZeroThresh)
+        nr_active_clients++;
+      saved_cycles += client->stats.saved_cycles;
+    };
+    if (prof_pool_)
+      prof_pool_->submit(profile);
+    else // simulated clients answer right away
+      profile();
+  }
+  if (prof_pool_)
+    prof_pool_->wait();
+  std::unique_lock<std::shared_mutex> ul(mtx_);
+  for (const auto &cid : dead_clients)
+    clients_.erase(cid);
+  dead_clients.clear();
+  ul.unlock();
+  reap_shared_kvs();
+  if (saved_cycles)
+    MIDAS_LOG(kInfo) << "Hits saved clients "
+                     << saved_cycles / kCPUFreq / 1000000.
+                     << "s of miss penalty in the last round";
+
+  // invoke rebalancer
+  if (region_cnt_ < region_limit_) {
+    if (nr_active_clients > 0) {
       std::unique_lock<std::mutex> ul(rbl_mtx_);
-      status_ = MemStatus::NEED_SHRINK;
+      status_ = MemStatus::NEED_EXPAND;
       rbl_cv_.notify_one();
-    } else {
-      MIDAS_ABORT("Impossible to reach here!");
     }
+  } else if (region_cnt_ == region_limit_) {
+    std::unique_lock<std::mutex> ul(rbl_mtx_);
+    status_ = MemStatus::NEED_REBALANCE;
+    rbl_cv_.notify_one();
+  } else if (region_cnt_ > region_limit_) {
+    std::unique_lock<std::mutex> ul(rbl_mtx_);
+    status_ = MemStatus::NEED_SHRINK;
+    rbl_cv_.notify_one();
+  } else {
+    MIDAS_ABORT("Impossible to reach here!");
   }
 }
 
@@ -526,29 +911,41 @@ void Daemon::rebalancer() {
     }
     if (terminated_)
       break;
-    switch (status_) {
-    case MemStatus::NEED_SHRINK:
-      on_mem_shrink();
-      break;
-    case MemStatus::NEED_EXPAND:
+    rebalance();
+  }
+}
+
+void Daemon::rebalance() {
+  switch (status_) {
+  case MemStatus::NEED_SHRINK:
+    on_mem_shrink();
+    break;
+  case MemStatus::NEED_EXPAND:
+    if (policy == Policy::MRC)
+      on_mem_rebalance_mrc();
+    else
       on_mem_expand();
-      break;
-    case MemStatus::NEED_REBALANCE:
-      if (policy == Policy::Static) {
-        /* do nothing */
-      } else if (policy == Policy::Midas)
-        on_mem_rebalance();
-      else if (policy == Policy::CliffHanger)
-        on_mem_rebalance_cliffhanger();
-      else {
-        on_mem_rebalance();
-      }
-      break;
-    default:
-      MIDAS_LOG(kError) << "Memory rebalancer is waken up for unknown reason";
+    break;
+  case MemStatus::NEED_REBALANCE:
+    if (policy == Policy::Static) {
+      /* do nothing */
+    } else if (policy == Policy::Midas)
+      on_mem_rebalance();
+    else if (policy == Policy::CliffHanger)
+      on_mem_rebalance_cliffhanger();
+    else if (policy == Policy::MRC)
+      on_mem_rebalance_mrc();
+    else {
+      on_mem_rebalance();
     }
-    status_ = MemStatus::NORMAL;
+    break;
+  default:
+    MIDAS_LOG(kError) << "Memory rebalancer is waken up for unknown reason";
   }
+  // a pressure event not followed by a shrink has been superseded
+  if (status_ != MemStatus::NEED_SHRINK)
+    pressure_ts_ = 0;
+  status_ = MemStatus::NORMAL;
 }
 
 void Daemon::on_mem_shrink() {
@@ -558,7 +955,7 @@ void Daemon::on_mem_shrink() {
 
     std::vector<std::shared_ptr<Client>> inactive_clients;
     std::vector<std::shared_ptr<Client>> active_clients;
-    std::unique_lock<std::mutex> ul(mtx_);
+    std::shared_lock<std::shared_mutex> ul(mtx_);
     for (auto &[_, client] : clients_) {
       if (client->stats.perf_gain < kPerfZeroThresh)
         inactive_clients.emplace_back(client);
@@ -570,7 +967,7 @@ void Daemon::on_mem_shrink() {
       int64_t old_limit = client->region_limit_;
       int64_t nr_reclaimed = std::ceil(nr_reclaim_ratio * old_limit);
       int64_t new_limit = std::max(1l, old_limit - nr_reclaimed);
-      bool succ = client->update_limit(new_limit);
+      client->update_limit(new_limit);
       nr_to_reclaim -= nr_reclaimed;
       MIDAS_LOG_PRINTF(kInfo, "Reclaimed client %lu %ld regions, %lu -> %lu\n",
                        client->id, nr_reclaimed, old_limit, new_limit);
@@ -587,7 +984,7 @@ void Daemon::on_mem_shrink() {
           std::ceil(reciprocal_gain / total_reciprocal_gain * nr_to_reclaim),
           1);
       int64_t new_limit = std::max(1l, old_limit - nr_reclaimed);
-      bool succ = client->update_limit(new_limit);
+      client->update_limit(new_limit);
       nr_to_reclaim -= nr_reclaimed;
       MIDAS_LOG_PRINTF(kInfo, "Reclaimed client %lu %ld regions, %lu -> %lu\n",
                        client->id, nr_reclaimed, old_limit, new_limit);
@@ -595,7 +992,13 @@ void Daemon::on_mem_shrink() {
   }
   MIDAS_LOG(kInfo) << "Memory shrink done! Total regions: " << region_cnt_
                    << "/" << region_limit_;
-  std::unique_lock<std::mutex> ul(mtx_);
+  auto pressure_ts = pressure_ts_.exchange(0);
+  if (pressure_ts) {
+    auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    MIDAS_LOG(kInfo) << "Reacted to memory pressure in "
+                     << (now - pressure_ts) / 1000000.0 << " ms";
+  }
+  std::shared_lock<std::shared_mutex> ul(mtx_);
   for (auto &[_, client] : clients_) {
     MIDAS_LOG(kInfo) << "Client " << client->id
                      << " regions: " << client->region_cnt_ << "/"
@@ -615,7 +1018,7 @@ void Daemon::on_mem_expand() {
   std::vector<std::shared_ptr<Client>> active_clients;
   std::vector<std::shared_ptr<Client>> empty_clients;
   {
-    std::unique_lock<std::mutex> ul(mtx_);
+    std::shared_lock<std::shared_mutex> ul(mtx_);
     for (auto &[_, client] : clients_) {
       if (client->stats.perf_gain > kPerfZeroThresh && client->almost_full())
         active_clients.emplace_back(client);
@@ -639,7 +1042,6 @@ void Daemon::on_mem_expand() {
       }
     }
 
-    int64_t nr_per_client = nr_to_grant / active_clients.size();
     double total_gain = 0.0;
     for (auto client : active_clients)
       total_gain += std::log2(client->stats.perf_gain);
@@ -680,7 +1082,7 @@ void Daemon::on_mem_expand() {
             nr_to_grant);
         nr_granted = std::min<int64_t>(nr_granted, kMaxExpandThresh);
         auto new_limit = old_limit + nr_granted;
-        bool succ = client->update_limit(new_limit);
+        client->update_limit(new_limit);
         nr_to_grant -= nr_granted;
         expanded = true;
         MIDAS_LOG_PRINTF(kInfo, "Grant client %lu %ld regions, %lu -> %lu\n",
@@ -692,7 +1094,7 @@ void Daemon::on_mem_expand() {
   if (expanded) {
     MIDAS_LOG(kInfo) << "Memory expansion done! Total regions: " << region_cnt_
                      << "/" << region_limit_;
-    std::unique_lock<std::mutex> ul(mtx_);
+    std::shared_lock<std::shared_mutex> ul(mtx_);
     for (auto &[_, client] : clients_) {
       MIDAS_LOG(kInfo) << "Client " << client->id
                        << " regions: " << client->region_cnt_ << "/"
@@ -711,7 +1113,7 @@ void Daemon::on_mem_rebalance() {
   std::vector<std::shared_ptr<Client>> victims;
   std::vector<std::shared_ptr<Client>> candidates;
   {
-    std::unique_lock<std::mutex> ul(mtx_);
+    std::shared_lock<std::shared_mutex> ul(mtx_);
     for (auto &[_, client] : clients_) {
       if (client->region_limit_ <= 1)
         continue;
@@ -842,7 +1244,7 @@ void Daemon::on_mem_rebalance() {
   if (rebalanced) {
     MIDAS_LOG(kInfo) << "Memory rebalance done! Total regions: " << region_cnt_
                      << "/" << region_limit_;
-    std::unique_lock<std::mutex> ul(mtx_);
+    std::shared_lock<std::shared_mutex> ul(mtx_);
     for (auto &[_, client] : clients_) {
       MIDAS_LOG(kInfo) << "Client " << client->id
                        << " regions: " << client->region_cnt_ << "/"
@@ -858,7 +1260,7 @@ void Daemon::on_mem_rebalance_cliffhanger() {
 
   std::vector<std::shared_ptr<Client>> clients;
   {
-    std::unique_lock<std::mutex> ul(mtx_);
+    std::shared_lock<std::shared_mutex> ul(mtx_);
     for (auto &[_, client] : clients_) {
       if (client->region_limit_ <= 1)
         continue;
@@ -913,7 +1315,7 @@ void Daemon::on_mem_rebalance_cliffhanger() {
   if (rebalanced) {
     MIDAS_LOG(kInfo) << "Memory rebalance done! Total regions: " << region_cnt_
                      << "/" << region_limit_;
-    std::unique_lock<std::mutex> ul(mtx_);
+    std::shared_lock<std::shared_mutex> ul(mtx_);
     for (auto &[_, client] : clients_) {
       MIDAS_LOG(kInfo) << "Client " << client->id
                        << " regions: " << client->region_cnt_ << "/"
@@ -922,48 +1324,175 @@ void Daemon::on_mem_rebalance_cliffhanger() {
   }
 }
 
+/** Solve for the allocation that maximizes the total saved penalty under
+ * region_limit_ given clients' miss-ratio curves, then move towards it in
+ * bounded steps so that noisy curves cannot make clients oscillate.
+ */
+void Daemon::on_mem_rebalance_mrc() {
+  if (!kEnableDynamicRebalance)
+    return;
+
+  std::vector<std::shared_ptr<Client>> clients;
+  {
+    std::shared_lock<std::shared_mutex> ul(mtx_);
+    for (auto &[_, client] : clients_)
+      clients.emplace_back(client);
+  }
+  if (clients.empty())
+    return;
+
+  const auto nr_clients = clients.size();
+  std::vector<mrc::Demand> demands(nr_clients);
+  for (size_t i = 0; i < nr_clients; i++) {
+    auto client = clients[i];
+    auto &demand = demands[i];
+    demand.hull = client->mrc_.convex_hull();
+    demand.cost_per_miss =
+        client->weight_ * std::max<double>(client->stats.penalty, 1.0);
+    demand.min_regions = 1;
+    demand.max_regions = kMaxRegions;
+    bool frozen = demand.hull.empty() || client->warmup_ttl_ > 0 ||
+                  (client->lat_critical_ && client->almost_full());
+    if (client->warmup_ttl_ > 0)
+      client->warmup_ttl_--;
+    if (frozen) // nothing learned yet, or must not be touched
+      demand.min_regions = demand.max_regions = client->region_limit_;
+  }
+
+  auto targets = mrc::solve(demands, region_limit_);
+
+  // Curves only extend to what clients have seen. Hand the spare budget to
+  // full clients whose curves are still falling so they can explore further.
+  int64_t nr_spare = region_limit_;
+  for (auto target : targets)
+    nr_spare -= target;
+  std::vector<size_t> explorers;
+  for (size_t i = 0; i < nr_clients; i++) {
+    const auto &hull = demands[i].hull;
+    if (hull.size() >= 2 && clients[i]->almost_full() &&
+        targets[i] >= hull.back().nr_regions &&
+        hull[hull.size() - 2].misses > hull.back().misses)
+      explorers.emplace_back(i);
+  }
+  // frozen clients' minimums may already exceed the budget
+  if (nr_spare > 0)
+    for (auto i : explorers)
+      targets[i] += std::min<int64_t>(
+          kMRCMaxStep, nr_spare / static_cast<int64_t>(explorers.size()));
+
+  std::vector<int64_t> plan_adjusts(nr_clients);
+  for (size_t i = 0; i < nr_clients; i++) {
+    int64_t nr_adjust = static_cast<int64_t>(targets[i]) -
+                        static_cast<int64_t>(clients[i]->region_limit_);
+    nr_adjust = std::max(-kMRCMaxStep, std::min(kMRCMaxStep, nr_adjust));
+    if (std::abs(nr_adjust) < kMRCDeadband)
+      nr_adjust = 0;
+    plan_adjusts[i] = nr_adjust;
+  }
+
+  // applying: reclaim first so that grants never overshoot region_limit_
+  bool rebalanced = false;
+  for (size_t i = 0; i < nr_clients; i++) {
+    if (plan_adjusts[i] >= 0)
+      continue;
+    auto client = clients[i];
+    client->update_limit(client->region_limit_ + plan_adjusts[i]);
+    rebalanced = true;
+  }
+  for (size_t i = 0; i < nr_clients; i++) {
+    int64_t nr_avail = region_limit_ - region_cnt_;
+    int64_t nr_granted = std::min(plan_adjusts[i], nr_avail);
+    if (nr_granted <= 0)
+      continue;
+    auto client = clients[i];
+    client->update_limit(client->region_limit_ + nr_granted);
+    rebalanced = true;
+  }
+
+  if (rebalanced) {
+    MIDAS_LOG(kInfo) << "Memory rebalance (MRC) done! Total regions: "
+                     << region_cnt_ << "/" << region_limit_;
+    for (size_t i = 0; i < nr_clients; i++) {
+      auto client = clients[i];
+      MIDAS_LOG(kInfo) << "Client " << client->id
+                       << " regions: " << client->region_cnt_ << "/"
+                       << client->region_limit_ << " target: " << targets[i]
+                       << " saved penalty: "
+                       << mrc::saved_penalty(demands[i], targets[i]);
+    }
+  }
+}
+
 void Daemon::serve() {
   MIDAS_LOG(kInfo) << "Daemon starts listening...";
 
   while (!terminated_) {
     CtrlMsg msg;
-    if (ctrlq_.timed_recv(&msg, sizeof(CtrlMsg), kServeTimeout) != 0)
+    if (ctrlq_->timed_recv(&msg, sizeof(CtrlMsg), kServeTimeout) != 0)
       continue;
 
     MIDAS_LOG(kDebug) << "Daemon recved msg " << msg.op;
-    switch (msg.op) {
-    case CONNECT:
-      do_connect(msg);
-      break;
-    case DISCONNECT:
-      do_disconnect(msg);
-      break;
-    case ALLOC:
-      do_alloc(msg);
-      break;
-    case OVERCOMMIT:
-      do_overcommit(msg);
-      break;
-    case FREE:
-      do_free(msg);
-      break;
-    case UPDLIMIT_REQ:
-      do_update_limit_req(msg);
-      break;
-    case SET_WEIGHT:
-      do_set_weight(msg);
-      break;
-    case SET_LAT_CRITICAL:
-      do_set_lat_critical(msg);
-      break;
-    default:
-      MIDAS_LOG(kError) << "Recved unknown message: " << msg.op;
-    }
+    // a client always lands on the same shard so its requests stay in order
+    auto &shard = *shards_[msg.id % shards_.size()];
+    std::unique_lock<std::mutex> ul(shard.mtx);
+    shard.msgs.emplace_back(msg);
+    ul.unlock();
+    shard.cv.notify_one();
   }
 
   MIDAS_LOG(kInfo) << "Daemon stopped to serve...";
 }
 
+void Daemon::serve_worker(ServeShard &shard) {
+  while (!terminated_) {
+    std::unique_lock<std::mutex> ul(shard.mtx);
+    if (!shard.cv.wait_for(ul, std::chrono::seconds(kServeTimeout),
+                           [&] { return !shard.msgs.empty(); }))
+      continue;
+    CtrlMsg msg = shard.msgs.front();
+    shard.msgs.pop_front();
+    ul.unlock();
+    handle(msg);
+  }
+}
+
+void Daemon::handle(const CtrlMsg &msg) {
+  switch (msg.op) {
+  case CONNECT:
+    do_connect(msg);
+    break;
+  case DISCONNECT:
+    do_disconnect(msg);
+    break;
+  case ALLOC:
+    do_alloc(msg);
+    break;
+  case OVERCOMMIT:
+    do_overcommit(msg);
+    break;
+  case FREE:
+    do_free(msg);
+    break;
+  case UPDLIMIT_REQ:
+    do_update_limit_req(msg);
+    break;
+  case SET_WEIGHT:
+    do_set_weight(msg);
+    break;
+  case SET_LAT_CRITICAL:
+    do_set_lat_critical(msg);
+    break;
+  case SHKV_ATTACH:
+    do_shkv_attach(msg);
+    break;
+  case SHKV_DETACH:
+    do_shkv_detach(msg);
+    break;
+  default:
+    MIDAS_LOG(kError) << "Recved unknown message: " << msg.op;
+  }
+}
+
 namespace utils {
 uint64_t check_sys_avail_mem() {
   struct sysinfo info;
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+
+namespace midas {
+
+/** Memory controller view of a cgroup v2. Tenants run in their own slices,
+ * so a client's binding constraint is its slice's memory.max/memory.high
+ * rather than host memory.
+ */
+class CGroup {
+public:
+  struct Events {
+    uint64_t high{0};
+    uint64_t max{0};
+    uint64_t oom{0};
+    uint64_t oom_kill{0};
+  };
+
+  CGroup(const std::string &path);
+
+  /* Returns nullptr if @pid is not in a memory-limited cgroup v2. */
+  static std::unique_ptr<CGroup> discover(int pid);
+
+  const std::string &path() const noexcept;
+  uint64_t memory_max() const;
+  uint64_t memory_high() const;
+  uint64_t memory_current() const;
+  Events memory_events() const;
+
+  /* #regions soft memory may take given it already holds @nr_soft_regions,
+   * so that the cgroup stays below memory.high/memory.max. */
+  uint64_t region_cap(uint64_t nr_soft_regions) const;
+
+  constexpr static uint64_t kUnlimited = std::numeric_limits<uint64_t>::max();
+
+private:
+  uint64_t read_limit(const std::string &file) const;
+
+  constexpr static float kFillRatio = 0.9; // leave a margin to the limit
+
+  std::string path_;
+};
+
+namespace utils {
+/* Path of the cgroup v2 dir the process belongs to, or "" if not found. */
+std::string get_cgroup_path(int pid);
+/* Clients' ids embed their pids. See get_unique_id() in resource_manager. */
+inline int get_client_pid(uint64_t client_id) {
+  return client_id / 1'000'000'000'000ull;
+}
+} // namespace utils
+
+} // namespace midas
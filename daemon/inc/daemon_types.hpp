@@ -5,15 +5,26 @@
 #include <boost/interprocess/mapped_region.hpp>
 #include <boost/interprocess/permissions.hpp>
 #include <boost/interprocess/shared_memory_object.hpp>
+#include <chrono>
 #include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <string>
 #include <thread>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
+#include "cgroup.hpp"
+#include "mrc.hpp"
+#include "psi.hpp"
 #include "qpair.hpp"
 #include "shm_types.hpp"
+#include "stats_board.hpp"
+#include "thread_pool.hpp"
 #include "utils.hpp"
 
 namespace midas {
@@ -35,14 +46,28 @@ struct CacheStats {
   uint64_t vcache_size{0};
   double perf_gain{0.};
   int32_t headroom{0};
+  uint64_t saved_cycles{0}; // miss penalty saved in the last round
+  uint64_t total_saved{0};
 };
 
 class Daemon;
 
+/* A shared KV store, created by the daemon on its first attach and charged
+ * to the budget until its last attacher detaches or dies. */
+struct SharedKVStore {
+  std::string name;
+  uint64_t size;
+  int64_t nr_regions;
+  // maps the store's attacher count, which the daemon keeps
+  std::unique_ptr<boost::interprocess::mapped_region> meta;
+  // attacher id -> pidfd, readable once the attacher has exited
+  std::unordered_map<uint64_t, int> attachers;
+};
+
 class Client {
 public:
   Client(Daemon *daemon, uint64_t id_, uint64_t region_limit);
-  ~Client();
+  virtual ~Client();
 
   uint64_t id;
   ClientStatusCode status;
@@ -53,28 +78,57 @@ public:
   bool overcommit_region();
   bool free_region(int64_t region_id);
   bool update_limit(uint64_t new_limit);
+  /* Lowers the limit to the cgroup cap if it is above it. */
+  bool shrink_to_cgroup_cap();
   void set_weight(float weight);
   void set_lat_critical(bool value);
   bool force_reclaim(uint64_t new_limit);
   bool profile_stats();
   bool almost_full() noexcept;
+  /* Refreshes the cap from the client's cgroup. Returns true if the cgroup
+   * hit its memory.high/memory.max since the last check. */
+  bool check_cgroup();
+
+protected:
+  /* Clients without queues are only used by the policy simulator. */
+  Client(Daemon *daemon, uint64_t id_, uint64_t region_limit,
+         std::shared_ptr<QSingle> cq_, std::shared_ptr<QPair> txqp_);
+  /* Sends @msg to the client and waits for its reply. Returns 0 on success,
+   * like QPair::timed_recv(). */
+  virtual int request(const CtrlMsg &msg, void *reply, size_t reply_size,
+                      int timeout);
+
+  /* Reads the stats published since the last round from the client's stats
+   * board. Returns false if the board is missing or stale. */
+  bool read_stats_board(StatsMsg *statsmsg, uint64_t *saved_cycles);
 
-private:
   inline int64_t new_region_id_() noexcept;
   inline void destroy();
 
   bool alloc_region_(bool overcommit);
+  bool update_limit_(uint64_t new_limit);
+  bool force_reclaim_(uint64_t new_limit);
 
   std::mutex tx_mtx;
-  QSingle cq; // per-client completion queue for the ctrl queue
-  QPair txqp;
+  std::shared_ptr<QSingle> cq; // per-client completion queue for the ctrl queue
+  std::shared_ptr<QPair> txqp;
   std::unordered_map<int64_t, std::shared_ptr<SharedMemObj>> regions;
 
   CacheStats stats;
+  MissRatioCurve mrc_;
+  std::unique_ptr<StatsBoard> stats_board_;
+  StatsSnapshot board_stats_; // last snapshot read from the board
+
+  // cgroup v2 the client runs in, if memory-limited
+  std::unique_ptr<CGroup> cgroup_;
+  // max #regions that fit in the cgroup; set by the monitor, read by the
+  // rebalancer
+  std::atomic_uint64_t cgroup_cap_;
+  CGroup::Events cgroup_events_;
 
   Daemon *daemon_;
   uint64_t region_cnt_;
-  uint64_t region_limit_;
+  uint64_t region_limit_; // written under tx_mtx
   float weight_;
   int32_t warmup_ttl_;
   bool lat_critical_;
@@ -84,12 +138,6 @@ private:
 
 class Daemon {
 public:
-  Daemon(const std::string ctrlq_name = kNameCtrlQ);
-  ~Daemon();
-  void serve();
-
-  static Daemon *get_daemon();
-
   enum Policy {
     Invalid = -1,
     Static = 0,
@@ -97,10 +145,30 @@ public:
     CliffHanger,
     RobinHood,
     ExpandOnly,
+    MRC,
     NumPolicy
   };
 
+  Daemon(const std::string ctrlq_name = kNameCtrlQ);
+  ~Daemon();
+  void serve();
+
+  static Daemon *get_daemon();
+
 private:
+  /* A daemon without ctrl queue and background threads, driven step by step
+   * by the policy simulator on a virtual clock. */
+  Daemon(Policy policy_, uint64_t region_limit);
+
+  struct ServeShard {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<CtrlMsg> msgs;
+  };
+  void serve_worker(ServeShard &shard);
+  void handle(const CtrlMsg &msg);
+  std::shared_ptr<Client> get_client(uint64_t id);
+
   int do_connect(const CtrlMsg &msg);
   int do_disconnect(const CtrlMsg &msg);
   int do_alloc(const CtrlMsg &msg);
@@ -109,6 +177,8 @@ private:
   int do_update_limit_req(const CtrlMsg &msg);
   int do_set_weight(const CtrlMsg &msg);
   int do_set_lat_critical(const CtrlMsg &msg);
+  int do_shkv_attach(const CtrlMsg &msg);
+  int do_shkv_detach(const CtrlMsg &msg);
 
   void charge(int64_t nr_regions);
   void uncharge(int64_t nr_regions);
@@ -117,10 +187,23 @@ private:
   void profiler();
   void rebalancer();
 
+  void update_region_limit(uint64_t upd_region_limit);
+  void on_mem_pressure(float some_avg10);
+  void check_cgroups();
+  void profile_clients();
+  /* Drops the attachers of shared KV stores that have died. */
+  void reap_shared_kvs();
+  /* Publishes the store's attacher count, or removes it if it has none.
+   * shkv_mtx_ must be held. */
+  void update_shared_kv(
+      std::unordered_map<uint64_t, SharedKVStore>::iterator iter);
+  void rebalance();
+
   void on_mem_shrink();
   void on_mem_expand();
   void on_mem_rebalance();
   void on_mem_rebalance_cliffhanger();
+  void on_mem_rebalance_mrc();
 
   enum class MemStatus {
     NORMAL,
@@ -138,17 +221,28 @@ private:
   std::shared_ptr<std::thread> rebalancer_;
 
   const std::string ctrlq_name_;
-  QSingle ctrlq_;
-  std::mutex mtx_;
+  std::shared_ptr<QSingle> ctrlq_;
+  std::vector<std::unique_ptr<ServeShard>> shards_;
+  std::vector<std::shared_ptr<std::thread>> workers_;
+  std::unique_ptr<ThreadPool> prof_pool_;
+  std::shared_mutex mtx_; // guards clients_
   std::unordered_map<uint64_t, std::shared_ptr<Client>> clients_;
+  std::mutex shkv_mtx_; // guards shkvs_
+  std::unordered_map<uint64_t, SharedKVStore> shkvs_; // by name hash
 
   std::atomic_int_fast64_t region_cnt_;
   uint64_t region_limit_;
+  // PSI: cap on region_limit_ after pressure, and when the pending pressure
+  // event arrived (steady_clock ticks, 0 if none) for reaction latency.
+  uint64_t psi_region_cap_;
+  std::atomic_int64_t pressure_ts_;
+  std::chrono::steady_clock::time_point last_pressure_;
   // For simluation
   constexpr static uint64_t kInitRegions = (100ull << 20) / kRegionSize;// 100MB
   constexpr static uint64_t kMaxRegions = (100ull << 30) / kRegionSize; // 100GB
 
   friend class Client;
+  friend class PolicySimulator;
 };
 
 namespace utils {
@@ -3,8 +3,9 @@
 namespace midas {
 
 inline int64_t Client::new_region_id_() noexcept {
-  static int64_t region_id = 0;
-  return region_id++;
+  // shared by all serve workers
+  static std::atomic_int64_t region_id{0};
+  return region_id.fetch_add(1, std::memory_order_relaxed);
 }
 
 inline bool Client::alloc_region() {
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace midas {
+
+/** Online miss-ratio curve (MRC) of a client. Each profiling round contributes
+ * a sample (#regions -> #misses per round) at the client's current size, plus
+ * a ghost sample at (#regions + victim cache size) derived from victim hits.
+ * The curve is anchored at (0, #accesses) since everything misses without
+ * memory. Samples are bucketed and smoothed with EWMA.
+ */
+class MissRatioCurve {
+public:
+  struct Point {
+    uint64_t nr_regions;
+    double misses;
+  };
+
+  MissRatioCurve();
+
+  void record(uint64_t nr_regions, uint64_t hits, uint64_t misses,
+              uint64_t vhits, uint64_t nr_ghost_regions);
+  void reset();
+  bool empty() const noexcept;
+
+  /* Lower convex hull of the (monotonically non-increasing) curve. Marginal
+   * gains along the hull are non-increasing, which is what makes the greedy
+   * allocation optimal. */
+  std::vector<Point> convex_hull() const;
+  /* Interpolated #misses at @nr_regions along the hull. */
+  double misses_at(uint64_t nr_regions) const;
+
+private:
+  constexpr static uint64_t kBucketSize = 4; // in regions
+  constexpr static double kDecay = 0.3;      // same as the profiler
+
+  void record_sample(uint64_t nr_regions, double misses);
+
+  double accesses_;
+  std::map<uint64_t, double> samples_; // bucket -> EWMA(#misses)
+};
+
+namespace mrc {
+struct Demand {
+  std::vector<MissRatioCurve::Point> hull;
+  double cost_per_miss; // weight * miss penalty
+  uint64_t min_regions;
+  uint64_t max_regions;
+};
+
+/* Greedy marginal-gain solver. Starting from every client's min_regions, hand
+ * out the remaining budget hull segment by hull segment in descending order
+ * of saved penalty per region. Optimal when every curve is convex (which the
+ * hull guarantees). Budget the curves do not ask for is left unallocated. */
+std::vector<uint64_t> solve(const std::vector<Demand> &demands,
+                            uint64_t budget);
+
+/* Saved penalty of giving @nr_regions to @demand, relative to no memory. */
+double saved_penalty(const Demand &demand, uint64_t nr_regions);
+double hull_misses_at(const std::vector<MissRatioCurve::Point> &hull,
+                      uint64_t nr_regions);
+} // namespace mrc
+
+} // namespace midas
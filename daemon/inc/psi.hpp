@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace midas {
+
+/** Linux pressure stall information (PSI) trigger on memory. The kernel
+ * wakes poll() up as soon as tasks stall on memory for more than the
+ * threshold within a window, which is much faster than polling free memory.
+ * Prefers the daemon's own cgroup (memory.pressure) and falls back to the
+ * system-wide /proc/pressure/memory.
+ */
+class PSITrigger {
+public:
+  PSITrigger(uint64_t stall_us = kStallUs, uint64_t window_us = kWindowUs);
+  ~PSITrigger();
+
+  bool valid() const noexcept;
+  const std::string &path() const noexcept;
+
+  /* Returns 1 on a pressure event, 0 on timeout, and -1 on errors. */
+  int wait(int timeout_ms);
+  /* Share of time (in %) some tasks stalled on memory in the last 10s. */
+  float some_avg10() const;
+
+private:
+  bool arm(const std::string &path);
+
+  constexpr static uint64_t kStallUs = 100 * 1000;       // 100ms
+  constexpr static uint64_t kWindowUs = 1000 * 1000;     // 1s
+  constexpr static uint64_t kUnprivWindowUs = 2000 * 1000; // 2s
+
+  uint64_t stall_us_;
+  uint64_t window_us_;
+  int fd_;
+  std::string path_;
+};
+
+} // namespace midas
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "daemon_types.hpp"
+#include "shm_types.hpp"
+
+namespace midas {
+
+/** Synthetic workload of a simulated client. Its hit ratio with x regions is
+ * min(1, x / wss)^alpha, where alpha < 1 models skewed (Zipf-like) accesses
+ * and alpha > 1 models cliffs, e.g., loops slightly larger than the cache.
+ */
+struct SimWorkload {
+  std::string name;
+  double reqs{10000};     // #requests per second
+  double penalty{1000};   // cycles per miss
+  uint64_t wss{512};      // working set size, in regions
+  double alpha{0.5};
+  double alloc_rate{32};  // #regions the client can fill per second
+  uint64_t request{0};    // #regions asked for on arrival, 0 means wss
+  float weight{1};
+  bool lat_critical{false};
+  double start{0};        // arrival time, in seconds
+  double end{-1};         // departure time, in seconds. <0 means never
+
+  double miss_ratio(uint64_t nr_regions) const;
+};
+
+/* One round of a recorded stats stream, as seen by the daemon profiler. */
+struct SimRecord {
+  double time; // in seconds
+  StatsMsg stats;
+};
+
+/** A client that answers the daemon's requests from a workload model (or a
+ * recorded stats stream) instead of over message queues. */
+class SimClient : public Client {
+public:
+  SimClient(Daemon *daemon, uint64_t id, uint64_t region_limit,
+            const SimWorkload &workload, std::vector<SimRecord> records);
+
+  void advance(double now, double dt);
+
+protected:
+  int request(const CtrlMsg &msg, void *reply, size_t reply_size,
+              int timeout) override;
+
+private:
+  SimWorkload workload_;
+  std::vector<SimRecord> records_;
+  size_t next_record_;
+
+  double filled_; // #regions populated so far
+  // stats since the last profiling round
+  double hits_;
+  double misses_;
+  double vhits_;
+  // stats since arrival
+  double total_reqs_;
+  double total_misses_;
+  double total_penalty_;
+  double limit_integral_; // for the average allocation
+
+  friend class PolicySimulator;
+};
+
+/** Drives the daemon's policy logic against simulated clients on a virtual
+ * clock: no sleeps, no message queues, no shared memory. */
+class PolicySimulator {
+public:
+  struct Config {
+    Daemon::Policy policy{Daemon::Policy::Midas};
+    uint64_t region_limit{4096};
+    double duration{3600};      // in seconds
+    double tick{1};             // in seconds
+    uint32_t prof_interval{5};  // in seconds, same as the daemon profiler
+    std::vector<std::pair<double, uint64_t>> limit_changes; // time, #regions
+    std::string trajectory_file; // optional CSV output
+  };
+
+  struct ClientSpec {
+    SimWorkload workload;
+    std::vector<SimRecord> records;
+  };
+
+  PolicySimulator(const Config &config);
+  ~PolicySimulator();
+
+  void add_client(const SimWorkload &workload,
+                  std::vector<SimRecord> records = {});
+  void run();
+  void report(std::ostream &os) const;
+
+  double aggregate_penalty() const noexcept;
+  double max_convergence_time() const noexcept;
+  int nr_unconverged() const noexcept;
+
+private:
+  void on_event(double now);
+  void track_changes(double now);
+  void record_trajectory(double now);
+
+  constexpr static int64_t kConvergeDelta = 4; // in regions
+
+  Config config_;
+  std::unique_ptr<Daemon> daemon_;
+  std::vector<ClientSpec> specs_;
+  std::vector<std::shared_ptr<SimClient>> clients_; // by spec index
+  std::vector<uint64_t> last_limits_;
+
+  // (event time, last allocation change after it)
+  std::vector<std::pair<double, double>> convergence_;
+  std::vector<std::pair<double, std::vector<uint64_t>>> trajectory_;
+  std::unique_ptr<std::ostream> trajectory_os_;
+};
+
+namespace utils {
+const char *policy_name(Daemon::Policy policy);
+Daemon::Policy parse_policy(const std::string &name);
+} // namespace utils
+
+} // namespace midas
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace midas {
+
+/** Fixed set of worker threads that outlive individual tasks, so periodic
+ * jobs (e.g., profiling every client) do not spawn a thread per task. */
+class ThreadPool {
+public:
+  ThreadPool(uint32_t nr_threads);
+  ~ThreadPool();
+
+  void submit(std::function<void()> task);
+  /* Blocks until all submitted tasks have finished. */
+  void wait();
+
+private:
+  void run();
+
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::condition_variable done_cv_;
+  std::deque<std::function<void()>> tasks_;
+  uint64_t nr_unfinished_;
+  bool stop_;
+  std::vector<std::thread> threads_;
+};
+
+} // namespace midas
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "inc/mrc.hpp"
+
+namespace midas {
+
+MissRatioCurve::MissRatioCurve() : accesses_(0.) {}
+
+void MissRatioCurve::record(uint64_t nr_regions, uint64_t hits,
+                            uint64_t misses, uint64_t vhits,
+                            uint64_t nr_ghost_regions) {
+  if (hits + misses == 0) // idle round, nothing learned
+    return;
+  const double accesses = hits + misses;
+  accesses_ = accesses_ == 0. ? accesses
+                              : accesses_ * kDecay + accesses * (1 - kDecay);
+  record_sample(nr_regions, misses);
+  // the victim cache tells how many misses extra memory would have saved
+  if (nr_ghost_regions)
+    record_sample(nr_regions + nr_ghost_regions,
+                  misses > vhits ? misses - vhits : 0);
+}
+
+void MissRatioCurve::record_sample(uint64_t nr_regions, double misses) {
+  const uint64_t bucket = (nr_regions + kBucketSize / 2) / kBucketSize;
+  auto iter = samples_.find(bucket);
+  if (iter == samples_.cend())
+    samples_[bucket] = misses;
+  else
+    iter->second = iter->second * kDecay + misses * (1 - kDecay);
+}
+
+void MissRatioCurve::reset() {
+  accesses_ = 0.;
+  samples_.clear();
+}
+
+bool MissRatioCurve::empty() const noexcept { return samples_.empty(); }
+
+std::vector<MissRatioCurve::Point> MissRatioCurve::convex_hull() const {
+  std::vector<Point> points;
+  if (empty())
+    return points;
+  points.push_back({0, accesses_});
+  for (const auto &[bucket, misses] : samples_) {
+    Point p{bucket * kBucketSize, misses};
+    // more memory never hurts: enforce a non-increasing curve
+    p.misses = std::min(p.misses, points.back().misses);
+    if (p.nr_regions == points.back().nr_regions)
+      points.back().misses = p.misses;
+    else
+      points.push_back(p);
+  }
+
+  auto cross = [](const Point &o, const Point &a, const Point &b) {
+    const double ax = static_cast<double>(a.nr_regions) - o.nr_regions;
+    const double bx = static_cast<double>(b.nr_regions) - o.nr_regions;
+    return ax * (b.misses - o.misses) - (a.misses - o.misses) * bx;
+  };
+  std::vector<Point> hull;
+  for (const auto &p : points) {
+    while (hull.size() >= 2 &&
+           cross(hull[hull.size() - 2], hull.back(), p) <= 0)
+      hull.pop_back();
+    hull.push_back(p);
+  }
+  return hull;
+}
+
+double MissRatioCurve::misses_at(uint64_t nr_regions) const {
+  return mrc::hull_misses_at(convex_hull(), nr_regions);
+}
+
+namespace mrc {
+double hull_misses_at(const std::vector<MissRatioCurve::Point> &hull,
+                      uint64_t nr_regions) {
+  if (hull.empty())
+    return 0.;
+  if (nr_regions <= hull.front().nr_regions)
+    return hull.front().misses;
+  for (size_t i = 1; i < hull.size(); i++) {
+    const auto &a = hull[i - 1];
+    const auto &b = hull[i];
+    if (nr_regions <= b.nr_regions) {
+      const double frac = static_cast<double>(nr_regions - a.nr_regions) /
+                          (b.nr_regions - a.nr_regions);
+      return a.misses + (b.misses - a.misses) * frac;
+    }
+  }
+  return hull.back().misses;
+}
+
+double saved_penalty(const Demand &demand, uint64_t nr_regions) {
+  return (hull_misses_at(demand.hull, 0) -
+          hull_misses_at(demand.hull, nr_regions)) *
+         demand.cost_per_miss;
+}
+
+std::vector<uint64_t> solve(const std::vector<Demand> &demands,
+                            uint64_t budget) {
+  struct Segment {
+    size_t idx;
+    uint64_t length;
+    double rate; // saved penalty per region
+  };
+
+  const size_t nr_demands = demands.size();
+  std::vector<uint64_t> alloc(nr_demands);
+  uint64_t nr_used = 0;
+  for (size_t i = 0; i < nr_demands; i++) {
+    alloc[i] = std::min(demands[i].min_regions, demands[i].max_regions);
+    nr_used += alloc[i];
+  }
+  if (nr_used >= budget)
+    return alloc;
+
+  std::vector<Segment> segments;
+  for (size_t i = 0; i < nr_demands; i++) {
+    const auto &demand = demands[i];
+    const auto &hull = demand.hull;
+    for (size_t j = 1; j < hull.size(); j++) {
+      const auto &a = hull[j - 1];
+      const auto &b = hull[j];
+      uint64_t lo = std::max(a.nr_regions, alloc[i]);
+      uint64_t hi = std::min(b.nr_regions, demand.max_regions);
+      if (hi <= lo)
+        continue;
+      double rate = (a.misses - b.misses) / (b.nr_regions - a.nr_regions) *
+                    demand.cost_per_miss;
+      if (rate <= 0)
+        continue;
+      segments.push_back({i, hi - lo, rate});
+    }
+  }
+  // segments of a client are already ordered by x, and with a convex curve
+  // also by rate, so a stable sort keeps each client's segments contiguous.
+  std::stable_sort(segments.begin(), segments.end(),
+                   [](const Segment &s1, const Segment &s2) {
+                     return s1.rate > s2.rate;
+                   });
+
+  uint64_t nr_remain = budget - nr_used;
+  for (const auto &seg : segments) {
+    uint64_t nr_taken = std::min(seg.length, nr_remain);
+    alloc[seg.idx] += nr_taken;
+    nr_remain -= nr_taken;
+    if (nr_remain == 0)
+      break;
+  }
+  return alloc;
+}
+} // namespace mrc
+
+} // namespace midas
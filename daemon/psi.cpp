@@ -0,0 +1,98 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <poll.h>
+#include <string>
+#include <unistd.h>
+
+#include "inc/cgroup.hpp"
+#include "inc/psi.hpp"
+#include "logging.hpp"
+
+namespace midas {
+constexpr static char kSysPressureFile[] = "/proc/pressure/memory";
+constexpr static char kCgroupPressureFile[] = "memory.pressure";
+
+PSITrigger::PSITrigger(uint64_t stall_us, uint64_t window_us)
+    : stall_us_(stall_us), window_us_(window_us), fd_(-1) {
+  auto cgroup = utils::get_cgroup_path(getpid());
+  if (!cgroup.empty() && arm(cgroup + "/" + kCgroupPressureFile))
+    return;
+  if (arm(kSysPressureFile))
+    return;
+  MIDAS_LOG(kWarning) << "PSI triggers are not available, "
+                         "fall back to periodic memory polling";
+}
+
+PSITrigger::~PSITrigger() {
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+bool PSITrigger::arm(const std::string &path) {
+  int fd = open(path.c_str(), O_RDWR | O_NONBLOCK);
+  if (fd < 0)
+    return false;
+
+  char trigger[64];
+  auto try_write = [&](uint64_t stall_us, uint64_t window_us) {
+    int len = snprintf(trigger, sizeof(trigger), "some %lu %lu", stall_us,
+                       window_us);
+    return write(fd, trigger, len + 1) >= 0;
+  };
+  bool succ = try_write(stall_us_, window_us_);
+  if (!succ && errno == EINVAL && window_us_ < kUnprivWindowUs) {
+    // unprivileged triggers need windows in multiples of 2s
+    succ = try_write(stall_us_ * kUnprivWindowUs / window_us_,
+                     kUnprivWindowUs);
+  }
+  if (!succ) {
+    MIDAS_LOG(kDebug) << "Failed to register PSI trigger on " << path << ": "
+                      << strerror(errno);
+    close(fd);
+    return false;
+  }
+
+  fd_ = fd;
+  path_ = path;
+  MIDAS_LOG(kInfo) << "PSI trigger \"" << trigger << "\" registered on "
+                   << path_;
+  return true;
+}
+
+bool PSITrigger::valid() const noexcept { return fd_ >= 0; }
+
+const std::string &PSITrigger::path() const noexcept { return path_; }
+
+int PSITrigger::wait(int timeout_ms) {
+  if (fd_ < 0)
+    return -1;
+  struct pollfd pfd {
+    .fd = fd_, .events = POLLPRI
+  };
+  int ret = poll(&pfd, 1, timeout_ms);
+  if (ret < 0)
+    return errno == EINTR ? 0 : -1;
+  if (ret == 0)
+    return 0;
+  if (pfd.revents & POLLERR) { // event source is gone, e.g., cgroup removed
+    MIDAS_LOG(kError) << "PSI trigger on " << path_ << " is gone";
+    close(fd_);
+    fd_ = -1;
+    return -1;
+  }
+  return (pfd.revents & POLLPRI) ? 1 : 0;
+}
+
+float PSITrigger::some_avg10() const {
+  std::ifstream ifs(path_.empty() ? kSysPressureFile : path_);
+  std::string some, avg10;
+  if (!(ifs >> some >> avg10) || some != "some" ||
+      avg10.rfind("avg10=", 0) != 0)
+    return 0.;
+  return std::stof(avg10.substr(strlen("avg10=")));
+}
+
+} // namespace midas
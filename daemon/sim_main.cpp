@@ -0,0 +1,302 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "inc/simulator.hpp"
+
+/** Trace-driven simulator of the daemon's rebalancing policies.
+ *
+ * Usage: daemon_sim [-c config] [-p policy|all] [-o trajectory.csv] [-v]
+ *
+ * Config file, one directive per line:
+ *   policy <name|id|all>
+ *   memory <#regions> [<time>]      # initial limit, or a change at <time>
+ *   duration <seconds>
+ *   tick <seconds>
+ *   prof_interval <seconds>
+ *   client [count=N] name=.. reqs=.. penalty=.. wss=.. alpha=.. alloc=..
+ *          request=.. weight=.. lat_critical=0|1 start=.. end=..
+ *   trace <path> [alloc=..] [wss=..] # recorded stats stream, lines of
+ *                                    # <time> <client> <hits> <misses>
+ *                                    # <penalty> <vhits>
+ * Without a config, a 40-tenant host with churn and memory pressure is used.
+ */
+
+using namespace midas;
+
+struct SimSetup {
+  PolicySimulator::Config config;
+  std::vector<PolicySimulator::ClientSpec> clients;
+  bool all_policies{true};
+};
+
+static void default_setup(SimSetup &setup) {
+  constexpr static int kNumTenants = 40;
+  auto &config = setup.config;
+  config.region_limit = kNumTenants * 128;
+  config.duration = 4 * 3600;
+  config.limit_changes = {{1 * 3600, kNumTenants * 96},
+                          {3 * 3600, kNumTenants * 128}};
+
+  std::mt19937 mt(0);
+  std::uniform_real_distribution<double> alpha(0.3, 3.0);
+  std::uniform_int_distribution<uint64_t> wss(32, 512);
+  std::lognormal_distribution<double> reqs(9, 1);
+  std::lognormal_distribution<double> penalty(7, 1);
+  std::uniform_real_distribution<double> churn(0, config.duration);
+  for (int i = 0; i < kNumTenants; i++) {
+    SimWorkload wl;
+    wl.name = "tenant" + std::to_string(i);
+    wl.alpha = alpha(mt);
+    wl.wss = wss(mt);
+    wl.reqs = reqs(mt);
+    wl.penalty = penalty(mt);
+    wl.lat_critical = i % 10 == 0;
+    if (i % 8 == 7) { // some tenants come and go
+      wl.start = churn(mt);
+      wl.end = std::min(config.duration, wl.start + 3600);
+    }
+    setup.clients.push_back({wl, {}});
+  }
+}
+
+static bool parse_kv(const std::string &token, std::string &key,
+                     std::string &value) {
+  auto pos = token.find('=');
+  if (pos == std::string::npos)
+    return false;
+  key = token.substr(0, pos);
+  value = token.substr(pos + 1);
+  return true;
+}
+
+static bool apply_kv(SimWorkload &wl, const std::string &key,
+                     const std::string &value) {
+  if (key == "name")
+    wl.name = value;
+  else if (key == "reqs")
+    wl.reqs = std::stod(value);
+  else if (key == "penalty")
+    wl.penalty = std::stod(value);
+  else if (key == "wss")
+    wl.wss = std::stoull(value);
+  else if (key == "alpha")
+    wl.alpha = std::stod(value);
+  else if (key == "alloc")
+    wl.alloc_rate = std::stod(value);
+  else if (key == "request")
+    wl.request = std::stoull(value);
+  else if (key == "weight")
+    wl.weight = std::stof(value);
+  else if (key == "lat_critical")
+    wl.lat_critical = std::stoi(value);
+  else if (key == "start")
+    wl.start = std::stod(value);
+  else if (key == "end")
+    wl.end = std::stod(value);
+  else
+    return false;
+  return true;
+}
+
+static bool load_trace(const std::string &path, const SimWorkload &base,
+                       std::vector<PolicySimulator::ClientSpec> &clients) {
+  std::ifstream ifs(path);
+  if (!ifs.is_open()) {
+    std::cerr << "Cannot open trace " << path << std::endl;
+    return false;
+  }
+  std::map<std::string, std::vector<SimRecord>> streams;
+  std::string line;
+  while (std::getline(ifs, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream iss(line);
+    std::string client;
+    SimRecord rec{};
+    if (iss >> rec.time >> client >> rec.stats.hits >> rec.stats.misses >>
+        rec.stats.miss_penalty >> rec.stats.vhits)
+      streams[client].push_back(rec);
+  }
+  for (auto &[client, records] : streams) {
+    SimWorkload wl = base;
+    wl.name = client;
+    clients.push_back({wl, std::move(records)});
+  }
+  return true;
+}
+
+static bool load_config(const std::string &path, SimSetup &setup) {
+  std::ifstream ifs(path);
+  if (!ifs.is_open()) {
+    std::cerr << "Cannot open config " << path << std::endl;
+    return false;
+  }
+  auto &config = setup.config;
+  std::string line;
+  int lineno = 0;
+  while (std::getline(ifs, line)) {
+    lineno++;
+    std::istringstream iss(line);
+    std::string directive;
+    if (!(iss >> directive) || directive[0] == '#')
+      continue;
+    if (directive == "policy") {
+      std::string name;
+      iss >> name;
+      setup.all_policies = name == "all";
+      if (!setup.all_policies) {
+        config.policy = utils::parse_policy(name);
+        if (config.policy == Daemon::Policy::Invalid)
+          goto error;
+      }
+    } else if (directive == "memory") {
+      uint64_t nr_regions;
+      double time;
+      if (!(iss >> nr_regions))
+        goto error;
+      if (iss >> time)
+        config.limit_changes.emplace_back(time, nr_regions);
+      else
+        config.region_limit = nr_regions;
+    } else if (directive == "duration") {
+      iss >> config.duration;
+    } else if (directive == "tick") {
+      iss >> config.tick;
+    } else if (directive == "prof_interval") {
+      iss >> config.prof_interval;
+    } else if (directive == "client" || directive == "trace") {
+      SimWorkload wl;
+      int count = 1;
+      std::string trace_path;
+      if (directive == "trace" && !(iss >> trace_path))
+        goto error;
+      std::string token, key, value;
+      while (iss >> token) {
+        if (!parse_kv(token, key, value))
+          goto error;
+        if (key == "count")
+          count = std::stoi(value);
+        else if (!apply_kv(wl, key, value))
+          goto error;
+      }
+      if (directive == "trace") {
+        if (!load_trace(trace_path, wl, setup.clients))
+          return false;
+        continue;
+      }
+      if (wl.name.empty())
+        wl.name = "client" + std::to_string(setup.clients.size());
+      for (int i = 0; i < count; i++) {
+        SimWorkload copy = wl;
+        if (count > 1)
+          copy.name += "." + std::to_string(i);
+        setup.clients.push_back({copy, {}});
+      }
+    } else {
+      goto error;
+    }
+  }
+  return true;
+
+error:
+  std::cerr << path << ":" << lineno << ": cannot parse \"" << line << "\""
+            << std::endl;
+  return false;
+}
+
+int main(int argc, char *argv[]) {
+  SimSetup setup;
+  std::string config_path;
+  std::string policy_name;
+  bool verbose = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "c:p:o:v")) != -1) {
+    switch (opt) {
+    case 'c':
+      config_path = optarg;
+      break;
+    case 'p':
+      policy_name = optarg;
+      break;
+    case 'o':
+      setup.config.trajectory_file = optarg;
+      break;
+    case 'v':
+      verbose = true;
+      break;
+    default:
+      std::cerr << "Usage: " << argv[0]
+                << " [-c config] [-p policy|all] [-o trajectory.csv] [-v]"
+                << std::endl;
+      return -1;
+    }
+  }
+
+  if (config_path.empty())
+    default_setup(setup);
+  else if (!load_config(config_path, setup))
+    return -1;
+  if (!policy_name.empty()) {
+    setup.all_policies = policy_name == "all";
+    if (!setup.all_policies) {
+      setup.config.policy = utils::parse_policy(policy_name);
+      if (setup.config.policy == Daemon::Policy::Invalid) {
+        std::cerr << "Unknown policy " << policy_name << std::endl;
+        return -1;
+      }
+    }
+  }
+  if (!verbose) // the daemon logs every single rebalancing step
+    std::freopen("/dev/null", "w", stderr);
+
+  std::vector<Daemon::Policy> policies;
+  if (setup.all_policies)
+    for (int p = Daemon::Policy::Static; p < Daemon::Policy::NumPolicy; p++)
+      policies.push_back(static_cast<Daemon::Policy>(p));
+  else
+    policies.push_back(setup.config.policy);
+
+  struct Summary {
+    Daemon::Policy policy;
+    double penalty;
+    double convergence;
+    int nr_unconverged;
+  };
+  std::vector<Summary> summaries;
+  for (auto policy : policies) {
+    auto config = setup.config;
+    config.policy = policy;
+    if (setup.all_policies && !config.trajectory_file.empty())
+      config.trajectory_file += "." + std::string(utils::policy_name(policy));
+    PolicySimulator sim(config);
+    for (const auto &client : setup.clients)
+      sim.add_client(client.workload, client.records);
+    sim.run();
+    sim.report(std::cout);
+    std::cout << std::endl;
+    summaries.push_back({policy, sim.aggregate_penalty(),
+                         sim.max_convergence_time(), sim.nr_unconverged()});
+  }
+
+  if (summaries.size() > 1) {
+    std::cout << std::setw(12) << "Policy" << std::setw(16) << "Penalty"
+              << std::setw(16) << "Convergence(s)" << std::setw(14)
+              << "Unconverged" << std::endl;
+    for (const auto &s : summaries)
+      std::cout << std::setw(12) << utils::policy_name(s.policy)
+                << std::setw(16) << std::scientific << std::setprecision(4)
+                << s.penalty << std::fixed << std::setw(16)
+                << std::setprecision(0) << s.convergence << std::setw(14)
+                << s.nr_unconverged << std::endl;
+  }
+  return 0;
+}
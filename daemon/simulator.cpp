@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "inc/daemon_types.hpp"
+#include "inc/simulator.hpp"
+#include "logging.hpp"
+#include "shm_types.hpp"
+#include "utils.hpp"
+
+namespace midas {
+// the victim cache tracks up to 64MB evicted objects beyond a client's size
+constexpr static uint64_t kSimGhostRegions = (64ull << 20) / kRegionSize;
+constexpr static int kSimNumSnapshots = 10;
+
+double SimWorkload::miss_ratio(uint64_t nr_regions) const {
+  if (wss == 0)
+    return 0.;
+  double x = std::min(1.0, static_cast<double>(nr_regions) / wss);
+  return 1. - std::pow(x, alpha);
+}
+
+/** SimClient */
+SimClient::SimClient(Daemon *daemon, uint64_t id, uint64_t region_limit,
+                     const SimWorkload &workload,
+                     std::vector<SimRecord> records)
+    : Client(daemon, id, region_limit, nullptr, nullptr), workload_(workload),
+      records_(std::move(records)), next_record_(0), filled_(0), hits_(0),
+      misses_(0), vhits_(0), total_reqs_(0), total_misses_(0),
+      total_penalty_(0), limit_integral_(0) {
+  status = ClientStatusCode::CONNECTED;
+  weight_ = workload_.weight;
+  lat_critical_ = workload_.lat_critical;
+}
+
+void SimClient::advance(double now, double dt) {
+  // a cache never grows beyond its working set
+  filled_ = std::min<double>(filled_ + workload_.alloc_rate * dt,
+                             std::min(workload_.wss, region_limit_));
+  region_cnt_ = filled_;
+  limit_integral_ += region_limit_ * dt;
+
+  if (!records_.empty()) { // replay the recorded stream as is
+    while (next_record_ < records_.size() &&
+           records_[next_record_].time <= now) {
+      const auto &stats = records_[next_record_].stats;
+      hits_ += stats.hits;
+      misses_ += stats.misses;
+      vhits_ += stats.vhits;
+      total_reqs_ += stats.hits + stats.misses;
+      total_misses_ += stats.misses;
+      total_penalty_ += stats.misses * stats.miss_penalty;
+      workload_.penalty = stats.miss_penalty;
+      next_record_++;
+    }
+    return;
+  }
+
+  const double reqs = workload_.reqs * dt;
+  const double miss_ratio = workload_.miss_ratio(region_cnt_);
+  const double misses = reqs * miss_ratio;
+  hits_ += reqs - misses;
+  misses_ += misses;
+  vhits_ += reqs * (miss_ratio -
+                    workload_.miss_ratio(region_cnt_ + kSimGhostRegions));
+  total_reqs_ += reqs;
+  total_misses_ += misses;
+  total_penalty_ += misses * workload_.penalty;
+}
+
+int SimClient::request(const CtrlMsg &msg, void *reply, size_t reply_size,
+                       int timeout) {
+  switch (msg.op) {
+  case UPDLIMIT:
+  case FORCE_RECLAIM: {
+    // reclaim is instant on the virtual clock
+    region_cnt_ = std::min(region_cnt_, msg.mmsg.size);
+    filled_ = std::min<double>(filled_, region_cnt_);
+    CtrlMsg ack{.id = id,
+                .op = msg.op,
+                .ret = CtrlRetCode::MEM_SUCC,
+                .mmsg{.size = region_cnt_}};
+    std::memcpy(reply, &ack, std::min(reply_size, sizeof(ack)));
+    return 0;
+  }
+  case PROF_STATS: {
+    StatsMsg stats{.hits = static_cast<uint64_t>(hits_),
+                   .misses = static_cast<uint64_t>(misses_),
+                   .miss_penalty = workload_.penalty,
+                   .vhits = static_cast<uint32_t>(vhits_),
+                   .headroom = static_cast<uint32_t>(
+                       std::max(1.0, workload_.alloc_rate))};
+    hits_ = misses_ = vhits_ = 0;
+    std::memcpy(reply, &stats, std::min(reply_size, sizeof(stats)));
+    return 0;
+  }
+  default:
+    MIDAS_LOG(kError) << "Simulated client " << id << " got unknown request "
+                      << msg.op;
+  }
+  return -1;
+}
+
+/** PolicySimulator */
+PolicySimulator::PolicySimulator(const Config &config)
+    : config_(config),
+      daemon_(new Daemon(config.policy, config.region_limit)) {
+  std::sort(config_.limit_changes.begin(), config_.limit_changes.end());
+  if (!config_.trajectory_file.empty())
+    trajectory_os_ = std::make_unique<std::ofstream>(config_.trajectory_file);
+}
+
+PolicySimulator::~PolicySimulator() {
+  daemon_->clients_.clear();
+  clients_.clear();
+}
+
+void PolicySimulator::add_client(const SimWorkload &workload,
+                                 std::vector<SimRecord> records) {
+  specs_.push_back({workload, std::move(records)});
+}
+
+void PolicySimulator::run() {
+  const auto nr_specs = specs_.size();
+  clients_.resize(nr_specs);
+  last_limits_.assign(nr_specs, 0);
+  if (trajectory_os_)
+    *trajectory_os_ << "time,client,limit,used" << std::endl;
+
+  size_t next_change = 0;
+  double last_prof = 0;
+  on_event(0);
+  for (double now = 0; now < config_.duration; now += config_.tick) {
+    while (next_change < config_.limit_changes.size() &&
+           config_.limit_changes[next_change].first <= now) {
+      daemon_->update_region_limit(config_.limit_changes[next_change].second);
+      next_change++;
+      on_event(now);
+    }
+    for (size_t i = 0; i < nr_specs; i++) {
+      const auto &wl = specs_[i].workload;
+      auto &client = clients_[i];
+      if (!client && wl.start <= now && (wl.end < 0 || wl.end > now)) {
+        client = std::make_shared<SimClient>(daemon_.get(), i + 1,
+                                             Daemon::kInitRegions, wl,
+                                             specs_[i].records);
+        std::unique_lock<std::shared_mutex> ul(daemon_->mtx_);
+        daemon_->clients_[client->id] = client;
+        ul.unlock();
+        // apps size their pools right after connecting
+        CtrlMsg msg{.id = client->id,
+                    .op = CtrlOpCode::UPDLIMIT_REQ,
+                    .mmsg{.size = (wl.request ? wl.request : wl.wss) *
+                                  kRegionSize}};
+        daemon_->do_update_limit_req(msg);
+        on_event(now);
+      } else if (client && client->status == ClientStatusCode::CONNECTED &&
+                 wl.end >= 0 && wl.end <= now) {
+        client->status = ClientStatusCode::DISCONNECTED;
+        std::unique_lock<std::shared_mutex> ul(daemon_->mtx_);
+        daemon_->clients_.erase(client->id);
+        ul.unlock();
+        // departed clients keep their stats but no longer hold memory
+        daemon_->uncharge(client->region_limit_);
+        client->region_limit_ = client->region_cnt_ = 0;
+        on_event(now);
+      }
+    }
+
+    for (auto &client : clients_)
+      if (client && client->status == ClientStatusCode::CONNECTED)
+        client->advance(now, config_.tick);
+
+    if (now - last_prof >= config_.prof_interval) {
+      daemon_->profile_clients();
+      last_prof = now;
+      record_trajectory(now);
+    }
+    // the rebalancer reacts right away to whatever woke it up
+    if (daemon_->status_ != Daemon::MemStatus::NORMAL)
+      daemon_->rebalance();
+    track_changes(now);
+  }
+}
+
+void PolicySimulator::on_event(double now) {
+  convergence_.emplace_back(now, now);
+}
+
+void PolicySimulator::track_changes(double now) {
+  for (size_t i = 0; i < clients_.size(); i++) {
+    const auto &client = clients_[i];
+    uint64_t limit = client && client->status == ClientStatusCode::CONNECTED
+                         ? client->region_limit_
+                         : 0;
+    if (std::abs(static_cast<int64_t>(limit) -
+                 static_cast<int64_t>(last_limits_[i])) >= kConvergeDelta)
+      convergence_.back().second = now;
+    last_limits_[i] = limit;
+  }
+}
+
+void PolicySimulator::record_trajectory(double now) {
+  std::vector<uint64_t> limits(clients_.size(), 0);
+  for (size_t i = 0; i < clients_.size(); i++) {
+    const auto &client = clients_[i];
+    if (!client || client->status != ClientStatusCode::CONNECTED)
+      continue;
+    limits[i] = client->region_limit_;
+    if (trajectory_os_)
+      *trajectory_os_ << now << "," << specs_[i].workload.name << ","
+                      << client->region_limit_ << "," << client->region_cnt_
+                      << "\n";
+  }
+  trajectory_.emplace_back(now, std::move(limits));
+}
+
+double PolicySimulator::aggregate_penalty() const noexcept {
+  double penalty = 0;
+  for (const auto &client : clients_)
+    if (client)
+      penalty += client->total_penalty_ * client->workload_.weight;
+  return penalty;
+}
+
+/* Convergence of an event is the time until the last allocation change
+ * before the next event. If allocations are still moving right before the
+ * next event, the event never converged. */
+double PolicySimulator::max_convergence_time() const noexcept {
+  double max_time = 0;
+  for (const auto &[event, last_change] : convergence_)
+    max_time = std::max(max_time, last_change - event);
+  return max_time;
+}
+
+int PolicySimulator::nr_unconverged() const noexcept {
+  int nr = 0;
+  for (size_t i = 0; i < convergence_.size(); i++) {
+    double window_end = i + 1 < convergence_.size()
+                            ? convergence_[i + 1].first
+                            : config_.duration;
+    if (window_end - convergence_[i].second <= 2 * config_.prof_interval &&
+        convergence_[i].second > convergence_[i].first)
+      nr++;
+  }
+  return nr;
+}
+
+void PolicySimulator::report(std::ostream &os) const {
+  os << "Policy " << utils::policy_name(config_.policy) << ", "
+     << specs_.size() << " clients, " << config_.duration << "s simulated"
+     << std::endl;
+
+  os << std::setw(16) << "client" << std::setw(10) << "avg_lim"
+     << std::setw(10) << "final" << std::setw(10) << "hit%" << std::setw(16)
+     << "penalty" << std::endl;
+  for (size_t i = 0; i < clients_.size(); i++) {
+    const auto &client = clients_[i];
+    if (!client)
+      continue;
+    const double lifetime =
+        std::min(config_.duration, client->workload_.end < 0
+                                       ? config_.duration
+                                       : client->workload_.end) -
+        client->workload_.start;
+    const double hit_ratio =
+        client->total_reqs_
+            ? 1. - client->total_misses_ / client->total_reqs_
+            : 0.;
+    os << std::setw(16) << specs_[i].workload.name << std::setw(10)
+       << std::fixed << std::setprecision(0)
+       << client->limit_integral_ / std::max(lifetime, config_.tick)
+       << std::setw(10)
+       << (client->status == ClientStatusCode::CONNECTED
+               ? client->region_limit_
+               : 0)
+       << std::setw(10) << std::setprecision(1) << hit_ratio * 100
+       << std::setw(16) << std::scientific << std::setprecision(3)
+       << client->total_penalty_ << std::fixed << std::endl;
+  }
+
+  os << "Allocation trajectory (#regions per client):" << std::endl;
+  const size_t stride =
+      std::max<size_t>(1, trajectory_.size() / kSimNumSnapshots);
+  for (size_t i = 0; i < trajectory_.size(); i += stride) {
+    const auto &[time, limits] = trajectory_[i];
+    os << "  t=" << std::setw(8) << std::setprecision(0) << time << ":";
+    for (auto limit : limits)
+      os << " " << limit;
+    os << std::endl;
+  }
+
+  os << "Aggregate penalty: " << std::scientific << std::setprecision(4)
+     << aggregate_penalty() << std::fixed << std::endl;
+  os << "Max convergence time: " << std::setprecision(0)
+     << max_convergence_time() << "s over " << convergence_.size()
+     << " events, " << nr_unconverged() << " not converged" << std::endl;
+}
+
+namespace utils {
+const char *policy_name(Daemon::Policy policy) {
+  switch (policy) {
+  case Daemon::Policy::Static:
+    return "Static";
+  case Daemon::Policy::Midas:
+    return "Midas";
+  case Daemon::Policy::CliffHanger:
+    return "CliffHanger";
+  case Daemon::Policy::RobinHood:
+    return "RobinHood";
+  case Daemon::Policy::ExpandOnly:
+    return "ExpandOnly";
+  case Daemon::Policy::MRC:
+    return "MRC";
+  default:
+    return "Invalid";
+  }
+}
+
+Daemon::Policy parse_policy(const std::string &name) {
+  for (int p = Daemon::Policy::Static; p < Daemon::Policy::NumPolicy; p++) {
+    auto policy = static_cast<Daemon::Policy>(p);
+    if (name == policy_name(policy) || name == std::to_string(p))
+      return policy;
+  }
+  return Daemon::Policy::Invalid;
+}
+} // namespace utils
+
+} // namespace midas
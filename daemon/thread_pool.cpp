@@ -0,0 +1,56 @@
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "inc/thread_pool.hpp"
+
+namespace midas {
+
+ThreadPool::ThreadPool(uint32_t nr_threads) : nr_unfinished_(0), stop_(false) {
+  for (uint32_t i = 0; i < nr_threads; i++)
+    threads_.emplace_back([&] { run(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> ul(mtx_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto &thd : threads_)
+    thd.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  {
+    std::unique_lock<std::mutex> ul(mtx_);
+    tasks_.emplace_back(std::move(task));
+    nr_unfinished_++;
+  }
+  cv_.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> ul(mtx_);
+  done_cv_.wait(ul, [&] { return nr_unfinished_ == 0; });
+}
+
+void ThreadPool::run() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> ul(mtx_);
+      cv_.wait(ul, [&] { return stop_ || !tasks_.empty(); });
+      if (tasks_.empty()) // stopped and drained
+        return;
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+    std::unique_lock<std::mutex> ul(mtx_);
+    if (--nr_unfinished_ == 0)
+      done_cv_.notify_all();
+  }
+}
+
+} // namespace midas
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace midas {
+
+/** W-TinyLFU admission for inserts of new keys. A count-min sketch of 4-bit
+ * counters (kDepth per key, all in one word) estimates how often each key
+ * hash has been accessed recently; every kSampleRatio x capacity recorded
+ * accesses, all counters are halved so that the history ages. A new key is
+ * admitted if it has been accessed before (the insert itself counts as one),
+ * or through the window: up to kWindowPct% of the inserts are admitted
+ * regardless, so that new keys can still earn hits. One-hit wonders, such as
+ * the keys of a scan, are rejected and never allocated. */
+class AdmissionFilter {
+public:
+  /* @capacity is the expected number of distinct keys in the cache. */
+  AdmissionFilter(size_t capacity);
+
+  void record(uint64_t key_hash) noexcept;
+  uint32_t estimate(uint64_t key_hash) const noexcept;
+  /* Records the insert and decides whether to let it in. */
+  bool admit(uint64_t key_hash) noexcept;
+
+  uint64_t nr_rejected() const noexcept;
+
+private:
+  static uint64_t round_capacity(size_t capacity) noexcept;
+  uint64_t word_idx(uint64_t key_hash, int row) const noexcept;
+  static int nibble_shift(uint64_t key_hash, int row) noexcept;
+  void age() noexcept;
+
+  constexpr static int kDepth = 4;
+  constexpr static uint32_t kMaxCount = 15;
+  constexpr static uint32_t kAdmitCount = 2;
+  constexpr static uint64_t kSampleRatio = 10;
+  constexpr static uint64_t kWindowPct = 1;
+
+  const uint64_t mask_;
+  const uint64_t sample_size_;
+  std::unique_ptr<std::atomic_uint64_t[]> table_; // 16 counters per word
+  std::atomic_uint64_t nr_samples_{0};
+  // window budget, reset when aging
+  std::atomic_uint64_t nr_inserts_{0};
+  std::atomic_uint64_t nr_window_{0};
+  std::atomic_uint64_t nr_rejected_{0};
+};
+
+} // namespace midas
+
+#include "impl/admission.ipp"
@@ -5,19 +5,26 @@
 
 #include "cache_manager.hpp"
 #include "object.hpp"
+#include "pinned_view.hpp"
 
 namespace midas {
-template <typename T> class Array {
+/** Ptr is ObjectPtr or CompactObjectPtr; the latter halves the per-slot cost
+ * for large arrays at the price of not using the victim cache. */
+template <typename T, typename Ptr = ObjectPtr> class Array {
 public:
   Array(int n);
   Array(CachePool *pool, int n);
   ~Array();
   std::unique_ptr<T> get(int idx);
   bool set(int idx, const T &t);
+  /* Zero-copy read; an empty view on misses. */
+  PinnedView get_view(int idx);
+  /* Tags the slot with the cycles to rebuild its value (see CostTable). */
+  void set_cost(int idx, uint64_t cycles);
 
 private:
   CachePool *pool_;
-  ObjectPtr *data_;
+  Ptr *data_;
   int len_;
 };
 } // namespace midas
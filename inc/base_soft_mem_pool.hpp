@@ -1,9 +1,19 @@
 #pragma once
 
+#include <mutex>
+
+#include "admission.hpp"
+#include "compressed_tier.hpp"
 #include "evacuator.hpp"
+#include "evict_notify.hpp"
+#include "eviction_policy.hpp"
+#include "expiry.hpp"
 #include "log.hpp"
 #include "resource_manager.hpp"
+#include "runtime.hpp"
 #include "shm_types.hpp"
+#include "spill_tier.hpp"
+#include "stats_board.hpp"
 #include "time.hpp"
 #include "victim_cache.hpp"
 
@@ -11,7 +21,7 @@ namespace midas {
 
 class BaseSoftMemPool {
 public:
-  virtual ~BaseSoftMemPool() = default;
+  inline virtual ~BaseSoftMemPool();
 
   // Config
   inline void update_limit(size_t limit_in_bytes);
@@ -20,10 +30,66 @@ public:
 
   // Profiling
   inline void inc_cache_hit() noexcept;
+  /* Also credits the saved penalty with the object's cost, if tagged. */
+  inline void inc_cache_hit(uint64_t key_id) noexcept;
   inline void inc_cache_miss() noexcept;
   inline void inc_cache_victim_hit(ObjectPtr *optr_addr = nullptr) noexcept;
+  inline void inc_cache_victim_hit(CompactObjectPtr *optr_addr) noexcept;
   inline void record_miss_penalty(uint64_t cycles, uint64_t bytes) noexcept;
+  /* Reports the stats since the last call. */
   inline void profile_stats(StatsMsg *msg = nullptr) noexcept;
+  /* Adds the counters since the last call to the cumulative ones in
+   * @snapshot. Independent of profile_stats(). */
+  inline void collect_stats(StatsSnapshot *snapshot) noexcept;
+
+  // Eviction notification
+  inline void set_evict_batch_func(EvictBatchFunc func);
+  inline EvictQueue *enable_evict_queue(size_t capacity = kEvictQueueCap);
+  inline EvictQueue *get_evict_queue() const noexcept;
+  inline void set_evict_tag(bool enable) noexcept;
+  inline bool evict_notify_enabled() const noexcept;
+  inline bool evict_tag_enabled() const noexcept;
+  inline void notify_evicted(EvictBatch &batch) noexcept;
+
+  // Eviction policy, CLOCK by default. Can be switched at any time; the
+  // state of the previous policy is dropped.
+  inline void set_evict_policy(EvictPolicyType type);
+  inline std::shared_ptr<EvictionPolicy> get_evict_policy() const noexcept;
+
+  // Per-object miss costs, used by GDSF and the saved penalty stats. Enable
+  // them (or GDSF) at any time; tagging is a no-op until then.
+  inline void enable_obj_costs();
+  inline bool obj_costs_enabled() const noexcept;
+  inline void set_obj_cost(uint64_t key_id, uint64_t cycles) noexcept;
+  inline uint64_t get_obj_cost(uint64_t key_id) const noexcept;
+
+  // Per-object deadlines (see ExpiryTable), so that GC frees expired objects
+  // rather than keeping or stashing them. The table is created on first use.
+  inline void set_obj_expiry(const void *optr_addr,
+                             uint64_t deadline_us) noexcept;
+  inline std::shared_ptr<ExpiryTable> get_obj_expiry() const noexcept;
+
+  // Admission of new keys (W-TinyLFU), off by default. Enable it before the
+  // pool is in use. Once the pool is full, data structures only allocate for
+  // new keys that the filter admits; accesses are recorded all along.
+  inline AdmissionFilter *enable_admission(size_t capacity = kAdmitCapacity);
+  inline AdmissionFilter *get_admission() const noexcept;
+  inline void record_access(uint64_t key_hash) noexcept;
+  inline bool admit(uint64_t key_hash) noexcept;
+
+  // Compressed tier for evicted objects, off by default. Enable it before
+  // the pool is in use. It holds up to @capacity bytes of compressed data in
+  // DRAM on top of the pool's soft memory limit.
+  inline CompressedTier *enable_compressed_tier(size_t capacity);
+  inline CompressedTier *get_compressed_tier() const noexcept;
+  // Spill tier on local disk for evicted objects that cost at least
+  // @min_cost cycles to rebuild (all if 0), off by default. Enable it before
+  // the pool is in use; the file at @path is truncated and owned by the tier.
+  inline SpillTier *enable_spill_tier(const std::string &path, size_t capacity,
+                                      uint64_t min_cost = 0);
+  inline SpillTier *get_spill_tier() const noexcept;
+  /* Brings @optr's evicted object back from the compressed or spill tier. */
+  inline bool restore_evicted(ObjectPtr *optr);
 
   inline VictimCache *get_vcache() const noexcept;
   inline ResourceManager *get_rmanager() const noexcept;
@@ -39,21 +105,57 @@ protected:
     std::atomic_uint_fast64_t miss_cycles{0};
     std::atomic_uint_fast64_t miss_bytes{0};
     std::atomic_uint_fast64_t victim_hits{0};
+    std::atomic_uint_fast64_t cost_hits{0}; // hits on cost-tagged objects
+    std::atomic_uint_fast64_t saved_cycles{0}; // costs of cost_hits
     uint64_t timestamp{0};
 
-    inline void reset() noexcept;
+    /* The counters are never reset. Each reader keeps the values it saw last
+     * time and diffs against them. */
+    struct Counters {
+      uint64_t hits{0};
+      uint64_t misses{0};
+      uint64_t miss_cycles{0};
+      uint64_t miss_bytes{0};
+      uint64_t victim_hits{0};
+      uint64_t cost_hits{0};
+      uint64_t saved_cycles{0};
+    };
+    /* Returns the counters' growth since @last, and moves @last to now. */
+    inline Counters delta(Counters *last) const noexcept;
+    /* Estimated cycles that hits saved the app from spending on misses. */
+    static inline uint64_t saved_penalty(uint64_t hits, uint64_t misses,
+                                         uint64_t miss_cycles,
+                                         uint64_t cost_hits,
+                                         uint64_t saved_cycles) noexcept;
   } stats;
+  std::mutex profile_mtx_;
+  CacheStats::Counters profiled_;  // as of the last profile_stats()
+  CacheStats::Counters published_; // as of the last collect_stats()
+  CompressedTier::Stats published_ctier_{};
 
   std::unique_ptr<VictimCache> vcache_;
   std::shared_ptr<ResourceManager> rmanager_;
   std::shared_ptr<LogAllocator> allocator_;
   std::unique_ptr<Evacuator> evacuator_;
 
+  EvictBatchFunc evict_batch_func_;
+  std::unique_ptr<EvictQueue> evict_queue_;
+  bool evict_tag_{false};
+  std::shared_ptr<EvictionPolicy> evict_policy_{
+      std::make_shared<ClockPolicy>()};
+  std::shared_ptr<CostTable> obj_costs_;
+  std::shared_ptr<ExpiryTable> obj_expiry_;
+  std::unique_ptr<AdmissionFilter> admission_;
+  std::unique_ptr<CompressedTier> ctier_;
+  std::unique_ptr<SpillTier> spill_;
+
   friend class CacheManager;
   friend class ResourceManager;
 
   static constexpr uint64_t kVCacheSizeLimit = 64 * 1024 * 1024; // 64 MB
   static constexpr uint64_t kVCacheCountLimit = 500000;
+  static constexpr size_t kEvictQueueCap = 64 * 1024;
+  static constexpr size_t kAdmitCapacity = 256 * 1024;
 };
 
 } // namespace midas
@@ -54,7 +54,9 @@ public:
   // Allocator shortcuts
   inline std::optional<ObjectPtr> alloc(size_t size);
   inline bool alloc_to(size_t size, ObjectPtr *dst);
+  inline bool alloc_to(size_t size, CompactObjectPtr *dst);
   inline bool free(ObjectPtr &ptr);
+  inline bool free(CompactObjectPtr &ptr);
 
   static inline CachePool *global_cache_pool();
 
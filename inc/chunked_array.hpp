@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+
+#include "cache_manager.hpp"
+#include "object.hpp"
+
+namespace midas {
+
+constexpr static size_t kChunkedArrayChunkSize = 4096; // bytes per soft object
+
+/** Array that packs K contiguous elements into one soft object. A chunk is
+ * the unit of allocation and eviction, so the per-element metadata of Array
+ * (a 16B ObjectPtr plus an object header) is amortized over K elements.
+ * Which elements of a chunk have been set is tracked in a bitmap so that
+ * partially written chunks never return garbage.
+ */
+template <typename T,
+          int K = std::max<int>(1, kChunkedArrayChunkSize / sizeof(T))>
+class ChunkedArray {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "ChunkedArray elements must be trivially copyable");
+  static_assert(K > 0, "ChunkedArray needs at least one element per chunk");
+
+public:
+  ChunkedArray(int n);
+  ChunkedArray(CachePool *pool, int n);
+  ~ChunkedArray();
+
+  std::unique_ptr<T> get(int idx);
+  bool set(int idx, const T &t);
+  /* Copies up to @n elements from @idx on into @dst, stopping at the first
+   * missing element. Each chunk is copied under one lock with one copy, and
+   * the next chunk is prefetched meanwhile. Returns #elements copied. */
+  int get_range(int idx, int n, T *dst);
+  /* Writes @n elements from @src to @idx on. Returns #elements written. */
+  int set_range(int idx, int n, const T *src);
+
+  int size() const noexcept;
+  constexpr static int chunk_len() noexcept { return K; }
+
+private:
+  constexpr static int kNumLocks = 1 << 10;
+  constexpr static int kPresentWords = (K + 63) / 64;
+
+  struct Chunk {
+    ObjectPtr optr;
+    uint64_t present[kPresentWords]; // elements that have been set
+  };
+
+  int read_chunk(int cid, int off, int n, T *dst);
+  int write_chunk(int cid, int off, int n, const T *src);
+  int chunk_size(int cid) const noexcept; // #elements, last one can be short
+  std::mutex &chunk_lock(int cid) noexcept;
+  static int present_run(const Chunk &chunk, int off, int n) noexcept;
+  static void mark_present(Chunk &chunk, int off, int n) noexcept;
+  static void clear_present(Chunk &chunk) noexcept;
+
+  CachePool *pool_;
+  Chunk *chunks_;
+  int len_;
+  int nr_chunks_;
+  std::mutex locks_[kNumLocks];
+};
+} // namespace midas
+
+#include "impl/chunked_array.ipp"
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "object.hpp"
+
+namespace midas {
+
+/** Serialization trait of values stored in soft memory containers.
+ * A Codec<T> provides:
+ *    kFixedSize            whether every T encodes to sizeof(T) bytes
+ *    size(v)               encoded size of v
+ *    contiguous(v)         pointer to v's encoding if it already sits
+ *                          contiguously in memory, otherwise nullptr
+ *    encode(v, buf, len)   writes exactly size(v) == len bytes into buf
+ *    decode(v, buf, len)   rebuilds v from len bytes at buf
+ * The default codec covers flat (trivially copyable) structs. Specialize
+ * Codec for other types; std::string and vectors of flat types are built in.
+ */
+template <typename T, typename Enable = void> struct Codec {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "Specialize midas::Codec<T> for non-flat types");
+  constexpr static bool kFixedSize = true;
+  static size_t size(const T &v) noexcept;
+  static const void *contiguous(const T &v) noexcept;
+  static bool encode(const T &v, void *buf, size_t len) noexcept;
+  static bool decode(T &v, const void *buf, size_t len) noexcept;
+};
+
+template <> struct Codec<std::string> {
+  constexpr static bool kFixedSize = false;
+  static size_t size(const std::string &v) noexcept;
+  static const void *contiguous(const std::string &v) noexcept;
+  static bool encode(const std::string &v, void *buf, size_t len) noexcept;
+  static bool decode(std::string &v, const void *buf, size_t len);
+};
+
+template <typename E>
+struct Codec<std::vector<E>,
+             std::enable_if_t<std::is_trivially_copyable_v<E>>> {
+  constexpr static bool kFixedSize = false;
+  static size_t size(const std::vector<E> &v) noexcept;
+  static const void *contiguous(const std::vector<E> &v) noexcept;
+  static bool encode(const std::vector<E> &v, void *buf, size_t len) noexcept;
+  static bool decode(std::vector<E> &v, const void *buf, size_t len);
+};
+
+/** Helpers used by the containers to move encoded values into soft objects.
+ * Reads decode out of a PinnedView. */
+namespace codec_utils {
+/* Contiguous encoding of @v, through a thread-local buffer if needed. The
+ * result is valid until the next call on the same thread. */
+template <typename T> const void *flatten(const T &v, size_t &len);
+/* Bytes an encoding can take at @offset of @optr. An object keeps the size
+ * it was allocated with, so this can exceed the length stored last. */
+inline size_t capacity(ObjectPtr &optr, int64_t offset);
+} // namespace codec_utils
+
+} // namespace midas
+
+#include "impl/codec.ipp"
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace midas {
+
+/** A second, denser tier for objects evicted by GC. The evacuator compresses
+ * a cold small object (with lz::compress) before freeing it and appends it
+ * to the current compressed segment; a later miss on the same reference
+ * decompresses it back into soft memory instead of re-constructing it.
+ * Segments are reclaimed whole, oldest first, once the tier exceeds its
+ * capacity. Entries are keyed by the app's ObjectPtr address and dropped on
+ * restore, on free, and when the object is evicted again. */
+class CompressedTier {
+public:
+  CompressedTier(size_t capacity);
+
+  /* Replaces @key's entry; incompressible data is dropped. */
+  bool put(const void *key, const void *data, size_t len);
+  /* Decompresses @key's entry into @buf and drops it. */
+  bool take(const void *key, std::vector<char> &buf);
+  void remove(const void *key) noexcept;
+
+  struct Stats {
+    uint64_t nr_stored;
+    uint64_t raw_bytes;        // of the stored objects
+    uint64_t compressed_bytes; // of the stored objects
+    uint64_t nr_lookups;
+    uint64_t nr_hits;
+    uint64_t decompress_cycles;
+  };
+  Stats get_stats() const noexcept;
+  size_t capacity() const noexcept;
+  size_t size() const noexcept; // bytes of allocated segments
+
+private:
+  struct Entry {
+    uint64_t seg_id;
+    uint32_t offset;
+    uint32_t len;
+    uint32_t raw_len;
+  };
+  struct Segment {
+    uint64_t id;
+    uint32_t used;
+    std::unique_ptr<char[]> data;
+    std::vector<const void *> keys; // entries appended, possibly stale
+  };
+  void drop_oldest_locked() noexcept;
+
+  constexpr static uint32_t kSegmentSize = 1024 * 1024; // 1MB
+
+  const size_t max_segments_;
+  mutable std::mutex mtx_;
+  std::deque<Segment> segments_; // oldest first
+  uint64_t next_seg_id_{0};
+  std::unordered_map<const void *, Entry> map_;
+
+  std::atomic_uint64_t nr_stored_{0};
+  std::atomic_uint64_t raw_bytes_{0};
+  std::atomic_uint64_t compressed_bytes_{0};
+  std::atomic_uint64_t nr_lookups_{0};
+  std::atomic_uint64_t nr_hits_{0};
+  std::atomic_uint64_t decompress_cycles_{0};
+};
+
+} // namespace midas
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+namespace midas {
+
+/** Epoch-based protection of soft memory regions.
+ * Mutators wrap each access to soft memory in a short critical section
+ * (EpochGuard), which records the global epoch it started in. The evacuator
+ * unlinks a segment, advances the epoch, and frees the region only after
+ * every critical section started before that point has finished. Regions
+ * are therefore never unmapped under a running rmemcpy, and mutators only
+ * fall back to fault-based recovery on externally forced reclamation.
+ */
+class EpochManager {
+public:
+  constexpr static uint64_t kQuiescent = std::numeric_limits<uint64_t>::max();
+
+  inline void enter() noexcept;
+  inline void exit() noexcept;
+
+  /* Starts a new epoch and returns the previous one. Anything unlinked
+   * before the call can be freed once min_active() exceeds the return. */
+  uint64_t advance() noexcept;
+  /* The oldest epoch that is still in a critical section. */
+  uint64_t min_active() noexcept;
+
+  static inline EpochManager *global_epoch_manager() noexcept;
+
+private:
+  struct alignas(64) Record {
+    std::atomic_uint64_t epoch{kQuiescent};
+    std::atomic_bool in_use{false};
+  };
+  struct LocalRecord {
+    Record *record{nullptr};
+    int32_t depth{0}; // critical sections nest
+    bool exhausted{false};
+    ~LocalRecord();
+  };
+
+  Record *acquire_record() noexcept;
+
+  constexpr static int32_t kMaxRecords = 4096;
+
+  std::atomic_uint64_t global_epoch_{0};
+  std::atomic_int32_t nr_records_{0}; // high watermark of records in use
+  Record records_[kMaxRecords];
+
+  static thread_local LocalRecord local_;
+};
+
+class EpochGuard {
+public:
+  inline EpochGuard() noexcept;
+  inline ~EpochGuard() noexcept;
+  EpochGuard(const EpochGuard &) = delete;
+  EpochGuard &operator=(const EpochGuard &) = delete;
+};
+
+} // namespace midas
+
+#include "impl/epoch.ipp"
@@ -19,8 +19,11 @@ class SegmentList;  // defined in log.hpp
 class LogAllocator; // defined in log.hpp
 
 class BaseSoftMemPool; // defined in base_soft_mem_pool.hpp
+class EvictBatch;      // defined in evict_notify.hpp
+class EvictionPolicy;  // defined in eviction_policy.hpp
 
 class ResourceManager; // defined in resource_manager.hpp
+class Runtime;         // defined in runtime.hpp
 
 class Evacuator {
 public:
@@ -34,6 +37,8 @@ public:
 
 private:
   void init();
+  /* One GC round, run by the own GC thread or the shared runtime's. */
+  void run_gc();
 
   int64_t gc(SegmentList &stash_list);
 
@@ -46,10 +51,15 @@ private:
   bool segment_ready(LogSegment *segment);
   using RetCode = ObjectPtr::RetCode;
   RetCode iterate_segment(LogSegment *segment, uint64_t &pos, ObjectPtr &optr);
+  void track_evicted(EvictBatch *batch, ObjectPtr &optr);
+  void stash_evicted(ObjectPtr &optr);
+  bool policy_evicts(EvictionPolicy *policy, MetaObjectHdr &meta_hdr,
+                     ObjectPtr &optr);
 
   BaseSoftMemPool *pool_;
   std::shared_ptr<LogAllocator> allocator_;
   std::shared_ptr<ResourceManager> rmanager_;
+  Runtime *runtime_; // GC threads are shared across pools if not nullptr
 
   bool terminated_;
 
@@ -57,8 +67,7 @@ private:
   std::condition_variable gc_cv_;
   std::mutex gc_mtx_;
 
+  friend class Runtime;
 };
 
-} // namespace midas
-
-#include "impl/evacuator.ipp"
\ No newline at end of file
+} // namespace midas
\ No newline at end of file
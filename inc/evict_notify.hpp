@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "object.hpp"
+
+namespace midas {
+
+/** An object evicted by GC. The app's reference has already been reset by
+ * the time it is delivered, so rref identifies the entry but must not be
+ * dereferenced as soft memory. It is the address of the app's ObjectPtr, or
+ * of its CompactObjectPtr if the object was allocated to one. */
+struct EvictedObject {
+  void *rref;
+  uint64_t size; // data size (head segment only for large objects)
+  uint64_t tag;  // first 8 data bytes when tagging is enabled, 0 otherwise
+};
+
+/* Called from GC threads, possibly concurrently, once per scanned segment. */
+using EvictBatchFunc = std::function<void(const EvictedObject *objs, size_t nr)>;
+
+/** Bounded multi-producer multi-consumer queue of eviction notices, for apps
+ * that drain evictions on their own threads instead of in GC threads.
+ * Notices are dropped (and counted) when the queue is full, in which case
+ * the app should resynchronize its mirror. */
+class EvictQueue {
+public:
+  EvictQueue(size_t capacity);
+
+  size_t push(const EvictedObject *objs, size_t nr) noexcept;
+  /* Pops up to @max notices into @out and returns the number popped. */
+  size_t drain(EvictedObject *out, size_t max) noexcept;
+
+  size_t capacity() const noexcept;
+  uint64_t nr_dropped() const noexcept;
+
+private:
+  bool push_one(const EvictedObject &obj) noexcept;
+  static uint64_t round_capacity(size_t capacity) noexcept;
+
+  struct alignas(64) Slot {
+    std::atomic_uint64_t seq;
+    EvictedObject obj;
+  };
+
+  const uint64_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  alignas(64) std::atomic_uint64_t head_{0}; // next to pop
+  alignas(64) std::atomic_uint64_t tail_{0}; // next to push
+  alignas(64) std::atomic_uint64_t nr_dropped_{0};
+};
+
+/** Per-segment accumulator used by the evacuator. */
+class EvictBatch {
+public:
+  void add(void *rref, uint64_t size, uint64_t tag) noexcept;
+  bool empty() const noexcept;
+  void deliver(const EvictBatchFunc &func, EvictQueue *queue) noexcept;
+
+private:
+  std::vector<EvictedObject> objs_;
+};
+
+} // namespace midas
+
+#include "impl/evict_notify.ipp"
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "object.hpp"
+
+namespace midas {
+
+enum class EvictPolicyType { Clock, LFUAging, S3FIFO, LRUK, GDSF };
+
+/** Per-object miss costs, i.e. the cycles it takes the app to rebuild an
+ * object, tagged at construct or set time. A cost is kept as a class of one
+ * byte (4 classes per power of two, within 25% of the cycles), keyed by the
+ * object's key id like the policies' side tables. Class 0 means untagged. */
+class CostTable {
+public:
+  CostTable();
+  void set(uint64_t key, uint64_t cycles) noexcept;
+  /* The cost rounded to its class, 0 if untagged. */
+  uint64_t get(uint64_t key) const noexcept;
+
+  static uint8_t to_class(uint64_t cycles) noexcept;
+  static uint64_t to_cycles(uint8_t cost_class) noexcept;
+
+private:
+  constexpr static int kTableBits = 20;
+  std::unique_ptr<std::atomic_uint8_t[]> classes_;
+};
+
+/** Decides which objects the scanner evicts. The scanner calls scan() on
+ * every present object head (locked, header loaded) of the segment it is
+ * deactivating; the policy updates its state in the header's accessed bits
+ * (stored back by the scanner) and/or in its own side tables, and returns
+ * whether to evict the object. @size is the object's data size (its head
+ * segment for large objects). Reads and writes bump the accessed bits, so
+ * a freshly inserted object has been accessed once. Side tables are keyed by
+ * the object's key id (see ObjectPtr::key_id()), which is stable across moves
+ * and, for containers that tag their pointers, across evictions and
+ * re-inserts of the key; collisions only skew decisions. Scan may be called
+ * concurrently by several GC threads. */
+class EvictionPolicy {
+public:
+  virtual ~EvictionPolicy() = default;
+  virtual EvictPolicyType type() const noexcept = 0;
+  virtual bool scan(MetaObjectHdr &hdr, uint64_t key,
+                    size_t size) noexcept = 0;
+
+  /* @costs is only used by cost-aware policies. */
+  static std::shared_ptr<EvictionPolicy>
+  create(EvictPolicyType type, std::shared_ptr<CostTable> costs = nullptr);
+  static const char *name(EvictPolicyType type) noexcept;
+  /* Indexes the side tables with the top bits. */
+  static uint64_t key_hash(uint64_t key) noexcept;
+};
+
+/** The 2-bit CLOCK: age the accessed bits by one, evict once they hit 0. */
+class ClockPolicy : public EvictionPolicy {
+public:
+  EvictPolicyType type() const noexcept override;
+  bool scan(MetaObjectHdr &hdr, uint64_t key,
+            size_t size) noexcept override;
+};
+
+/** LFU with exponential aging: each scan ages an 8-bit frequency counter in
+ * a side table by 1/8 (at least 1), adds the accessed bits to it, and evicts
+ * once it decays to 0. The margin grows with the steady access rate: about
+ * 11 idle scans for an object accessed 3+ times per interval, where CLOCK
+ * gives 3 to anything accessed that often. */
+class LFUAgingPolicy : public EvictionPolicy {
+public:
+  LFUAgingPolicy();
+  EvictPolicyType type() const noexcept override;
+  bool scan(MetaObjectHdr &hdr, uint64_t key,
+            size_t size) noexcept override;
+
+private:
+  constexpr static int kTableBits = 20;
+  std::unique_ptr<std::atomic_uint8_t[]> freqs_;
+};
+
+/** S3-FIFO over the log. Objects that have not survived a scan yet form the
+ * small (probationary) FIFO: they move to main if accessed again after their
+ * insertion or if they were recently evicted from small (ghost hit), and are
+ * evicted otherwise. Main objects are aged like CLOCK. Main membership is a
+ * bitmap and the ghost a direct-mapped table of fingerprints, both keyed by
+ * key id. */
+class S3FIFOPolicy : public EvictionPolicy {
+public:
+  S3FIFOPolicy();
+  EvictPolicyType type() const noexcept override;
+  bool scan(MetaObjectHdr &hdr, uint64_t key,
+            size_t size) noexcept override;
+
+private:
+  bool test_main(uint64_t hash) const noexcept;
+  void set_main(uint64_t hash, bool in_main) noexcept;
+  bool ghost_hit(uint64_t hash) noexcept;
+  void ghost_add(uint64_t hash) noexcept;
+
+  constexpr static int kMainBits = 22;
+  constexpr static int kGhostBits = 18;
+  std::unique_ptr<std::atomic_uint64_t[]> main_;
+  std::unique_ptr<std::atomic_uint32_t[]> ghost_;
+};
+
+/** LRU-2 approximation at scan-interval granularity: a side table keeps,
+ * per object, the number of intervals since its last and its second-to-last
+ * access (4 bits each, saturating at "never"). An object is evicted once its
+ * second-to-last access, i.e. its backward 2-distance, is kWindow intervals
+ * old. Objects referenced only once are evicted first, which keeps large
+ * scans from flushing the working set. */
+class LRUKPolicy : public EvictionPolicy {
+public:
+  LRUKPolicy();
+  EvictPolicyType type() const noexcept override;
+  bool scan(MetaObjectHdr &hdr, uint64_t key,
+            size_t size) noexcept override;
+
+private:
+  constexpr static uint8_t kNever = 0xf;
+  constexpr static uint8_t kWindow = 4;
+  constexpr static int kTableBits = 20;
+  std::unique_ptr<std::atomic_uint8_t[]> ages_;
+};
+
+/** GreedyDual-Size-Frequency. An object's priority is freq x cost / size,
+ * and the scanner's passes are the inflation clock: each scan charges an
+ * object one credit and evicts it once it has none left, while an accessed
+ * object gets its credit raised to its priority, scaled so that an object of
+ * average priority gets kBaseCredit scans. Expensive, small and frequently
+ * used objects thus outlive cheap, large and cold ones. Untagged objects are
+ * priced at the average cost per byte of the tagged ones. */
+class GDSFPolicy : public EvictionPolicy {
+public:
+  GDSFPolicy(std::shared_ptr<CostTable> costs);
+  EvictPolicyType type() const noexcept override;
+  bool scan(MetaObjectHdr &hdr, uint64_t key,
+            size_t size) noexcept override;
+
+private:
+  static void update_avg(std::atomic<double> &avg, double sample) noexcept;
+
+  constexpr static double kBaseCredit = 2.;
+  constexpr static double kAvgWeight = 1. / 1024;
+  constexpr static int kTableBits = 20;
+  std::shared_ptr<CostTable> costs_;
+  // | freq (8b) | credit (8b) |, freq is halved on every scan
+  std::unique_ptr<std::atomic_uint16_t[]> entries_;
+  std::atomic<double> avg_density_{1.}; // cycles per byte of tagged objects
+  std::atomic<double> avg_priority_{0.};
+};
+
+} // namespace midas
+
+#include "impl/eviction_policy.ipp"
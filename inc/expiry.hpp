@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace midas {
+
+/** Hashed hierarchical timer wheel: kNrLevels wheels of kSlots slots each,
+ * where a slot of level l spans kSlots^l ticks. A timer is placed in the
+ * lowest level whose range covers its deadline and cascades down a level
+ * each time the wheel below wraps around, so add() is O(1) and every timer
+ * is moved at most kNrLevels times. Deadlines beyond the top level are
+ * parked in its farthest slot and re-placed when they get there. Timers are
+ * not cancellable: owners validate the fired items. Not thread-safe. */
+template <typename T> class TimerWheel {
+public:
+  TimerWheel(uint64_t tick_us, uint64_t now_us);
+
+  void add(uint64_t deadline_us, T item);
+  /* Appends the items due by @now_us to @due. */
+  void advance(uint64_t now_us, std::vector<T> &due);
+  size_t size() const noexcept;
+
+private:
+  struct Timer {
+    uint64_t tick;
+    T item;
+  };
+  void place(Timer &&timer);
+  void process(uint64_t tick, std::vector<T> &due);
+
+  constexpr static int kLevelBits = 6;
+  constexpr static int kNrLevels = 4;
+  constexpr static uint64_t kSlots = 1ull << kLevelBits;
+  constexpr static uint64_t kMaxTicks = 1ull << (kLevelBits * kNrLevels);
+
+  const uint64_t tick_us_;
+  uint64_t curr_tick_; // the next tick to process
+  size_t nr_timers_{0};
+  std::vector<Timer> slots_[kNrLevels][kSlots];
+};
+
+/** Per-object deadlines for the scanner, which treats expired objects as
+ * dead. A direct-mapped table keyed by the address of the object's pointer,
+ * i.e. its rref, which each slot stores in full: unlike the policies' hints,
+ * a false match would free a live object. Owners must clear an object's
+ * deadline before freeing it. A colliding key overwrites the slot, so
+ * deadlines may be lost (the object is kept until its owner expires it) but
+ * never misattributed. Slots are updated under a per-slot seqlock. */
+class ExpiryTable {
+public:
+  ExpiryTable();
+  /* A @deadline_us of 0 clears @key's deadline. */
+  void set(const void *key, uint64_t deadline_us) noexcept;
+  bool expired(const void *key, uint64_t now_us) const noexcept;
+
+private:
+  struct Slot {
+    std::atomic_uint64_t key; // 0 if empty
+    // | version (16b) | deadline in ms (48b) |, version is odd while the
+    // slot is being updated
+    std::atomic_uint64_t meta;
+  };
+  Slot &slot(const void *key) const noexcept;
+
+  constexpr static int kTableBits = 18;
+  constexpr static int kDeadlineBits = 48;
+  constexpr static uint64_t kDeadlineMask = (1ull << kDeadlineBits) - 1;
+  constexpr static uint64_t kVersionOne = 1ull << kDeadlineBits;
+  std::unique_ptr<Slot[]> slots_;
+};
+
+} // namespace midas
+
+#include "impl/expiry.ipp"
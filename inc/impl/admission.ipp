@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+
+#include "robinhood.h"
+
+namespace midas {
+
+inline uint64_t AdmissionFilter::round_capacity(size_t capacity) noexcept {
+  uint64_t cap = 64;
+  while (cap < capacity)
+    cap <<= 1;
+  return cap;
+}
+
+inline AdmissionFilter::AdmissionFilter(size_t capacity)
+    : mask_(round_capacity(capacity) - 1),
+      sample_size_(kSampleRatio * (mask_ + 1)),
+      table_(std::make_unique<std::atomic_uint64_t[]>(mask_ + 1)) {}
+
+/* Each row hashes to its own word and to a nibble among its own four of it,
+ * so the counters of a key never overlap. */
+inline uint64_t AdmissionFilter::word_idx(uint64_t key_hash,
+                                          int row) const noexcept {
+  return robin_hood::hash_int(key_hash + row * 0x9e3779b97f4a7c15ull) & mask_;
+}
+
+inline int AdmissionFilter::nibble_shift(uint64_t key_hash, int row) noexcept {
+  return (row * 4 + ((key_hash >> (row * 8)) & 3)) * 4;
+}
+
+inline void AdmissionFilter::record(uint64_t key_hash) noexcept {
+  for (int row = 0; row < kDepth; row++) {
+    auto &word = table_[word_idx(key_hash, row)];
+    auto shift = nibble_shift(key_hash, row);
+    auto val = word.load(std::memory_order_relaxed);
+    while (((val >> shift) & 0xf) < kMaxCount &&
+           !word.compare_exchange_weak(val, val + (1ull << shift),
+                                       std::memory_order_relaxed))
+      ;
+  }
+  if (nr_samples_.fetch_add(1, std::memory_order_relaxed) + 1 == sample_size_)
+    age();
+}
+
+inline uint32_t AdmissionFilter::estimate(uint64_t key_hash) const noexcept {
+  uint32_t count = kMaxCount;
+  for (int row = 0; row < kDepth; row++) {
+    auto val = table_[word_idx(key_hash, row)].load(std::memory_order_relaxed);
+    auto counter = (val >> nibble_shift(key_hash, row)) & 0xf;
+    count = std::min<uint32_t>(count, counter);
+  }
+  return count;
+}
+
+inline bool AdmissionFilter::admit(uint64_t key_hash) noexcept {
+  record(key_hash);
+  auto nr_inserts = nr_inserts_.fetch_add(1, std::memory_order_relaxed) + 1;
+  if (estimate(key_hash) >= kAdmitCount)
+    return true;
+  if (nr_window_.load(std::memory_order_relaxed) * 100 <
+      nr_inserts * kWindowPct) {
+    nr_window_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  nr_rejected_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+/* Only the thread that completes a sample ages, while others keep counting.
+ * Halving races with concurrent increments, which may get lost. */
+inline void AdmissionFilter::age() noexcept {
+  for (uint64_t i = 0; i <= mask_; i++) {
+    auto val = table_[i].load(std::memory_order_relaxed);
+    table_[i].store((val >> 1) & 0x7777777777777777ull,
+                    std::memory_order_relaxed);
+  }
+  nr_samples_.fetch_sub(sample_size_ / 2, std::memory_order_relaxed);
+  nr_inserts_.store(0, std::memory_order_relaxed);
+  nr_window_.store(0, std::memory_order_relaxed);
+}
+
+inline uint64_t AdmissionFilter::nr_rejected() const noexcept {
+  return nr_rejected_.load(std::memory_order_relaxed);
+}
+
+} // namespace midas
@@ -1,19 +1,19 @@
 #pragma once
 
 namespace midas {
-template <typename T> Array<T>::Array(int n) : len_(n) {
+template <typename T, typename Ptr> Array<T, Ptr>::Array(int n) : len_(n) {
   pool_ = CachePool::global_cache_pool();
-  data_ = new ObjectPtr[len_];
+  data_ = new Ptr[len_];
   assert(data_);
 }
 
-template <typename T>
-Array<T>::Array(CachePool *pool, int n) : pool_(pool), len_(n) {
-  data_ = new ObjectPtr[len_];
+template <typename T, typename Ptr>
+Array<T, Ptr>::Array(CachePool *pool, int n) : pool_(pool), len_(n) {
+  data_ = new Ptr[len_];
   assert(data_);
 }
 
-template <typename T> Array<T>::~Array() {
+template <typename T, typename Ptr> Array<T, Ptr>::~Array() {
   if (data_) {
     for (int i = 0; i < len_; i++) {
       if (!data_[i].null())
@@ -24,7 +24,8 @@ template <typename T> Array<T>::~Array() {
   }
 }
 
-template <typename T> std::unique_ptr<T> Array<T>::get(int idx) {
+template <typename T, typename Ptr>
+std::unique_ptr<T> Array<T, Ptr>::get(int idx) {
   if (idx >= len_)
     return nullptr;
   T *t = nullptr;
@@ -35,7 +36,7 @@ template <typename T> std::unique_ptr<T> Array<T>::get(int idx) {
   t = reinterpret_cast<T *>(::operator new(sizeof(T)));
   if (!optr.copy_to(t, sizeof(T)))
     goto faulted;
-  pool_->inc_cache_hit();
+  pool_->inc_cache_hit(optr.key_id());
   pool_->get_allocator()->count_access();
   return std::unique_ptr<T>(t);
 
@@ -49,7 +50,25 @@ missed:
   return nullptr;
 }
 
-template <typename T> bool Array<T>::set(int idx, const T &t) {
+template <typename T, typename Ptr>
+PinnedView Array<T, Ptr>::get_view(int idx) {
+  if (idx >= len_)
+    return PinnedView();
+  auto &optr = data_[idx];
+  PinnedView view(optr, sizeof(T));
+  if (!view) {
+    if (optr.is_victim())
+      pool_->inc_cache_victim_hit(&optr);
+    pool_->inc_cache_miss();
+    return view;
+  }
+  pool_->inc_cache_hit(optr.key_id());
+  pool_->get_allocator()->count_access();
+  return view;
+}
+
+template <typename T, typename Ptr>
+bool Array<T, Ptr>::set(int idx, const T &t) {
   if (idx >= len_)
     return false;
   auto &optr = data_[idx];
@@ -61,4 +80,11 @@ template <typename T> bool Array<T>::set(int idx, const T &t) {
   pool_->get_allocator()->count_access();
   return true;
 }
+
+template <typename T, typename Ptr>
+void Array<T, Ptr>::set_cost(int idx, uint64_t cycles) {
+  if (idx < len_)
+    pool_->set_obj_cost(data_[idx].key_id(), cycles);
+}
+
 } // namespace midas
\ No newline at end of file
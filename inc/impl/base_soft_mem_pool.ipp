@@ -2,12 +2,35 @@
 
 namespace midas {
 
-inline void BaseSoftMemPool::CacheStats::reset() noexcept {
-  hits = 0;
-  misses = 0;
-  miss_cycles = 0;
-  miss_bytes = 0;
-  victim_hits = 0;
+/* GC may still be scanning with the eviction state declared after the
+ * evacuator, so stop it before that state is destroyed. */
+inline BaseSoftMemPool::~BaseSoftMemPool() { evacuator_.reset(); }
+
+inline BaseSoftMemPool::CacheStats::Counters
+BaseSoftMemPool::CacheStats::delta(Counters *last) const noexcept {
+  Counters curr{hits,        misses,    miss_cycles, miss_bytes,
+                victim_hits, cost_hits, saved_cycles};
+  Counters diff{curr.hits - last->hits,
+                curr.misses - last->misses,
+                curr.miss_cycles - last->miss_cycles,
+                curr.miss_bytes - last->miss_bytes,
+                curr.victim_hits - last->victim_hits,
+                curr.cost_hits - last->cost_hits,
+                curr.saved_cycles - last->saved_cycles};
+  *last = curr;
+  return diff;
+}
+
+/* Hits on untagged objects are credited with the average miss penalty. */
+inline uint64_t
+BaseSoftMemPool::CacheStats::saved_penalty(uint64_t hits, uint64_t misses,
+                                           uint64_t miss_cycles,
+                                           uint64_t cost_hits,
+                                           uint64_t saved_cycles) noexcept {
+  if (!misses || hits <= cost_hits)
+    return saved_cycles;
+  return saved_cycles +
+         static_cast<double>(miss_cycles) / misses * (hits - cost_hits);
 }
 
 inline void BaseSoftMemPool::update_limit(size_t limit_in_bytes) {
@@ -24,6 +47,18 @@ inline void BaseSoftMemPool::set_lat_critical(bool value) {
 
 inline void BaseSoftMemPool::inc_cache_hit() noexcept { stats.hits++; }
 
+inline void BaseSoftMemPool::inc_cache_hit(uint64_t key_id) noexcept {
+  stats.hits++;
+  auto costs = std::atomic_load(&obj_costs_);
+  if (!costs)
+    return;
+  auto cost = costs->get(key_id);
+  if (cost) {
+    stats.cost_hits++;
+    stats.saved_cycles += cost;
+  }
+}
+
 inline void BaseSoftMemPool::inc_cache_miss() noexcept { stats.misses++; }
 
 inline void
@@ -33,12 +68,176 @@ BaseSoftMemPool::inc_cache_victim_hit(ObjectPtr *optr_addr) noexcept {
     vcache_->get(optr_addr);
 }
 
+/* Compact pointers are not tracked by the victim cache. */
+inline void
+BaseSoftMemPool::inc_cache_victim_hit(CompactObjectPtr *optr_addr) noexcept {
+  stats.victim_hits++;
+}
+
 inline void BaseSoftMemPool::record_miss_penalty(uint64_t cycles,
                                                  uint64_t bytes) noexcept {
   stats.miss_cycles += cycles;
   stats.miss_bytes += bytes;
 }
 
+inline void BaseSoftMemPool::set_evict_batch_func(EvictBatchFunc func) {
+  evict_batch_func_ = func;
+}
+
+inline EvictQueue *BaseSoftMemPool::enable_evict_queue(size_t capacity) {
+  if (!evict_queue_)
+    evict_queue_ = std::make_unique<EvictQueue>(capacity);
+  return evict_queue_.get();
+}
+
+inline EvictQueue *BaseSoftMemPool::get_evict_queue() const noexcept {
+  return evict_queue_.get();
+}
+
+inline void BaseSoftMemPool::set_evict_tag(bool enable) noexcept {
+  evict_tag_ = enable;
+}
+
+inline bool BaseSoftMemPool::evict_notify_enabled() const noexcept {
+  return evict_batch_func_ || evict_queue_;
+}
+
+inline bool BaseSoftMemPool::evict_tag_enabled() const noexcept {
+  return evict_tag_;
+}
+
+inline void BaseSoftMemPool::notify_evicted(EvictBatch &batch) noexcept {
+  batch.deliver(evict_batch_func_, evict_queue_.get());
+}
+
+/* Swapped atomically as GC threads may be scanning with the old policy. */
+inline void BaseSoftMemPool::set_evict_policy(EvictPolicyType type) {
+  if (type == EvictPolicyType::GDSF)
+    enable_obj_costs();
+  auto policy = EvictionPolicy::create(type, std::atomic_load(&obj_costs_));
+  std::atomic_store(&evict_policy_, policy);
+}
+
+inline std::shared_ptr<EvictionPolicy>
+BaseSoftMemPool::get_evict_policy() const noexcept {
+  return std::atomic_load(&evict_policy_);
+}
+
+/* Data structures may be tagging and GC reading costs concurrently. */
+inline void BaseSoftMemPool::enable_obj_costs() {
+  std::shared_ptr<CostTable> costs;
+  std::atomic_compare_exchange_strong(&obj_costs_, &costs,
+                                      std::make_shared<CostTable>());
+}
+
+inline bool BaseSoftMemPool::obj_costs_enabled() const noexcept {
+  return std::atomic_load(&obj_costs_) != nullptr;
+}
+
+/* @key_id is the key_id() of the object's ObjectPtr or CompactObjectPtr,
+ * which is how the scanner identifies it. */
+inline void BaseSoftMemPool::set_obj_cost(uint64_t key_id,
+                                          uint64_t cycles) noexcept {
+  auto costs = std::atomic_load(&obj_costs_);
+  if (costs)
+    costs->set(key_id, cycles);
+}
+
+inline uint64_t BaseSoftMemPool::get_obj_cost(uint64_t key_id) const noexcept {
+  auto costs = std::atomic_load(&obj_costs_);
+  return costs ? costs->get(key_id) : 0;
+}
+
+/* Created lazily as TTLs are rare; GC may be reading it concurrently. */
+inline void BaseSoftMemPool::set_obj_expiry(const void *optr_addr,
+                                            uint64_t deadline_us) noexcept {
+  auto expiry = std::atomic_load(&obj_expiry_);
+  if (!expiry) {
+    if (!deadline_us)
+      return;
+    auto created = std::make_shared<ExpiryTable>();
+    if (std::atomic_compare_exchange_strong(&obj_expiry_, &expiry, created))
+      expiry = created;
+  }
+  expiry->set(optr_addr, deadline_us);
+}
+
+inline std::shared_ptr<ExpiryTable>
+BaseSoftMemPool::get_obj_expiry() const noexcept {
+  return std::atomic_load(&obj_expiry_);
+}
+
+inline AdmissionFilter *BaseSoftMemPool::enable_admission(size_t capacity) {
+  if (!admission_)
+    admission_ = std::make_unique<AdmissionFilter>(capacity);
+  return admission_.get();
+}
+
+inline AdmissionFilter *BaseSoftMemPool::get_admission() const noexcept {
+  return admission_.get();
+}
+
+inline void BaseSoftMemPool::record_access(uint64_t key_hash) noexcept {
+  if (admission_)
+    admission_->record(key_hash);
+}
+
+/* While the pool has room, everything is admitted as nothing gets evicted
+ * for it. */
+inline bool BaseSoftMemPool::admit(uint64_t key_hash) noexcept {
+  if (!admission_)
+    return true;
+  if (!rmanager_->reclaim_trigger()) {
+    admission_->record(key_hash);
+    return true;
+  }
+  return admission_->admit(key_hash);
+}
+
+inline CompressedTier *
+BaseSoftMemPool::enable_compressed_tier(size_t capacity) {
+  if (!ctier_)
+    ctier_ = std::make_unique<CompressedTier>(capacity);
+  return ctier_.get();
+}
+
+inline CompressedTier *BaseSoftMemPool::get_compressed_tier() const noexcept {
+  return ctier_.get();
+}
+
+inline SpillTier *BaseSoftMemPool::enable_spill_tier(const std::string &path,
+                                                     size_t capacity,
+                                                     uint64_t min_cost) {
+  if (!spill_) {
+    auto spill = std::make_unique<SpillTier>(path, capacity, min_cost);
+    if (!spill->ready())
+      return nullptr;
+    spill_ = std::move(spill);
+  }
+  return spill_.get();
+}
+
+inline SpillTier *BaseSoftMemPool::get_spill_tier() const noexcept {
+  return spill_.get();
+}
+
+/* Must be called with @optr's owner locked against concurrent accesses. */
+inline bool BaseSoftMemPool::restore_evicted(ObjectPtr *optr) {
+  static thread_local std::vector<char> buf;
+  if ((!ctier_ && !spill_) || !optr->null())
+    return false;
+  if (!(ctier_ && ctier_->take(optr, buf)) &&
+      !(spill_ && spill_->take(optr, buf)))
+    return false;
+  if (!allocator_->alloc_to(buf.size(), optr))
+    return false;
+  if (!optr->copy_from(buf.data(), buf.size())) {
+    allocator_->free(*optr);
+    return false;
+  }
+  return true;
+}
+
 inline VictimCache *BaseSoftMemPool::get_vcache() const noexcept {
   return vcache_.get();
 }
@@ -55,28 +254,57 @@ inline ResourceManager *BaseSoftMemPool::get_rmanager() const noexcept {
   return rmanager_.get();
 }
 
+inline void BaseSoftMemPool::collect_stats(StatsSnapshot *snapshot) noexcept {
+  auto diff = stats.delta(&published_);
+  snapshot->hits += diff.hits;
+  snapshot->misses += diff.misses;
+  snapshot->miss_cycles += diff.miss_cycles;
+  snapshot->miss_bytes += diff.miss_bytes;
+  snapshot->vhits += diff.victim_hits;
+  snapshot->saved_cycles +=
+      CacheStats::saved_penalty(diff.hits, diff.misses, diff.miss_cycles,
+                                diff.cost_hits, diff.saved_cycles);
+  if (!ctier_)
+    return;
+  auto tstats = ctier_->get_stats();
+  auto &last = published_ctier_;
+  snapshot->ctier_lookups += tstats.nr_lookups - last.nr_lookups;
+  snapshot->ctier_hits += tstats.nr_hits - last.nr_hits;
+  snapshot->ctier_raw_bytes += tstats.raw_bytes - last.raw_bytes;
+  snapshot->ctier_compressed_bytes +=
+      tstats.compressed_bytes - last.compressed_bytes;
+  snapshot->ctier_decompress_cycles +=
+      tstats.decompress_cycles - last.decompress_cycles;
+  last = tstats;
+}
+
 inline void BaseSoftMemPool::profile_stats(StatsMsg *msg) noexcept {
   auto curr_ts = Time::get_us_stt();
-  auto hit_ratio = static_cast<float>(stats.hits) / (stats.hits + stats.misses);
+  // both the stats publisher and the daemon's fallback poll profile
+  std::unique_lock<std::mutex> ul(profile_mtx_);
+  auto diff = stats.delta(&profiled_);
+  auto hit_ratio = static_cast<float>(diff.hits) / (diff.hits + diff.misses);
   auto miss_penalty =
-      stats.miss_bytes
-          ? (static_cast<float>(stats.miss_cycles) / stats.miss_bytes)
-          : 0.0;
+      diff.miss_bytes ? (static_cast<float>(diff.miss_cycles) / diff.miss_bytes)
+                      : 0.0;
   auto recon_time =
-      static_cast<float>(stats.miss_cycles) / stats.misses / kCPUFreq;
-  auto victim_hit_ratio = static_cast<float>(stats.hits + stats.victim_hits) /
-                          (stats.hits + stats.victim_hits + stats.misses);
-  auto victim_hits = stats.victim_hits.load();
+      static_cast<float>(diff.miss_cycles) / diff.misses / kCPUFreq;
+  auto victim_hit_ratio = static_cast<float>(diff.hits + diff.victim_hits) /
+                          (diff.hits + diff.victim_hits + diff.misses);
+  auto victim_hits = diff.victim_hits;
   auto perf_gain = victim_hits * miss_penalty;
+  auto saved_penalty =
+      CacheStats::saved_penalty(diff.hits, diff.misses, diff.miss_cycles,
+                                diff.cost_hits, diff.saved_cycles);
 
   if (msg) {
-    msg->hits = stats.hits;
-    msg->misses = stats.misses;
+    msg->hits = diff.hits;
+    msg->misses = diff.misses;
     msg->miss_penalty = miss_penalty;
     msg->vhits = victim_hits;
   }
 
-  if (stats.hits > 0 || stats.misses > 0 || stats.victim_hits > 0)
+  if (diff.hits > 0 || diff.misses > 0 || diff.victim_hits > 0)
     MIDAS_LOG_PRINTF(kInfo,
                      "CachePool %s:\n"
                      "\t     Region used: %ld/%ld\n"
@@ -85,6 +313,7 @@ inline void BaseSoftMemPool::profile_stats(StatsMsg *msg) noexcept {
                      "\t construct time:  %.2f\n"
                      "\t     hit counts:  %lu\n"
                      "\t    miss counts:  %lu\n"
+                     "\t  saved penalty:  %lu\n"
                      "\tVictim hit ratio: %.4f\n"
                      "\t       hit count: %lu\n"
                      "\t       perf gain: %.4f\n"
@@ -92,11 +321,37 @@ inline void BaseSoftMemPool::profile_stats(StatsMsg *msg) noexcept {
                      "\t            size: %lu\n",
                      name_.c_str(), get_rmanager()->NumRegionInUse(),
                      get_rmanager()->NumRegionLimit(), hit_ratio, miss_penalty,
-                     recon_time, stats.hits.load(), stats.misses.load(),
-                     victim_hit_ratio, victim_hits, perf_gain, vcache_->count(),
-                     vcache_->size());
+                     recon_time, diff.hits, diff.misses,
+                     saved_penalty, victim_hit_ratio, victim_hits, perf_gain,
+                     vcache_->count(), vcache_->size());
+  // the tiers may not have been looked up or hit yet
+  auto ratio = [](uint64_t num, uint64_t den) {
+    return den ? static_cast<float>(num) / den : 0.f;
+  };
+  if (ctier_) {
+    auto tstats = ctier_->get_stats();
+    MIDAS_LOG_PRINTF(kInfo,
+                     "\tCompressed tier:  %lu/%lu bytes\n"
+                     "\t       hit ratio: %.4f\n"
+                     "\t compress ratio:  %.2f\n"
+                     "\t decompress time: %.2f\n",
+                     ctier_->size(), ctier_->capacity(),
+                     ratio(tstats.nr_hits, tstats.nr_lookups),
+                     ratio(tstats.raw_bytes, tstats.compressed_bytes),
+                     ratio(tstats.decompress_cycles, tstats.nr_hits) /
+                         kCPUFreq);
+  }
+  if (spill_) {
+    auto sstats = spill_->get_stats();
+    MIDAS_LOG_PRINTF(kInfo,
+                     "\tSpill tier:       %lu objs, %lu bytes spilled\n"
+                     "\t       hit ratio: %.4f\n"
+                     "\t       read time: %.2f\n",
+                     sstats.nr_spilled, sstats.spilled_bytes,
+                     ratio(sstats.nr_hits, sstats.nr_lookups),
+                     ratio(sstats.read_cycles, sstats.nr_hits) / kCPUFreq);
+  }
 
   stats.timestamp = curr_ts;
-  stats.reset();
 }
 } // namespace midas
\ No newline at end of file
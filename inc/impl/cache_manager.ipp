@@ -5,7 +5,10 @@ inline CachePool::CachePool(std::string name) : construct_(nullptr) {
   name_ = name;
   vcache_ = std::make_unique<VictimCache>(kVCacheSizeLimit, kVCacheCountLimit);
   allocator_ = std::make_shared<LogAllocator>(this);
-  rmanager_ = std::make_shared<ResourceManager>(this);
+  rmanager_ = Runtime::enabled()
+                  ? std::make_shared<ResourceManager>(
+                        this, Runtime::global_runtime_shared_ptr())
+                  : std::make_shared<ResourceManager>(this);
   evacuator_ = std::make_unique<Evacuator>(this, rmanager_, allocator_);
 }
 
@@ -72,12 +75,24 @@ inline bool CachePool::alloc_to(size_t size, ObjectPtr *dst) {
   return allocator_->alloc_to(size, dst);
 }
 
+inline bool CachePool::alloc_to(size_t size, CompactObjectPtr *dst) {
+  return allocator_->alloc_to(size, dst);
+}
+
 inline bool CachePool::free(ObjectPtr &ptr) {
   if (ptr.is_victim())
     vcache_->remove(&ptr);
+  if (ctier_)
+    ctier_->remove(&ptr);
+  if (spill_)
+    spill_->remove(&ptr);
   return allocator_->free(ptr);
 }
 
+inline bool CachePool::free(CompactObjectPtr &ptr) {
+  return ptr.free() == RetCode::Succ;
+}
+
 
 inline CacheManager::~CacheManager() {
   terminated_ = true;
@@ -0,0 +1,164 @@
+#pragma once
+
+namespace midas {
+template <typename T, int K>
+ChunkedArray<T, K>::ChunkedArray(int n)
+    : ChunkedArray(CachePool::global_cache_pool(), n) {}
+
+template <typename T, int K>
+ChunkedArray<T, K>::ChunkedArray(CachePool *pool, int n)
+    : pool_(pool), len_(n), nr_chunks_((n + K - 1) / K) {
+  chunks_ = new Chunk[nr_chunks_];
+  assert(chunks_);
+  for (int i = 0; i < nr_chunks_; i++)
+    clear_present(chunks_[i]);
+}
+
+template <typename T, int K> ChunkedArray<T, K>::~ChunkedArray() {
+  if (chunks_) {
+    for (int i = 0; i < nr_chunks_; i++) {
+      if (!chunks_[i].optr.null())
+        pool_->free(chunks_[i].optr);
+    }
+    delete[] chunks_;
+    chunks_ = nullptr;
+  }
+}
+
+template <typename T, int K> int ChunkedArray<T, K>::size() const noexcept {
+  return len_;
+}
+
+template <typename T, int K>
+std::unique_ptr<T> ChunkedArray<T, K>::get(int idx) {
+  auto t = reinterpret_cast<T *>(::operator new(sizeof(T)));
+  if (get_range(idx, 1, t) != 1) {
+    ::operator delete(t);
+    return nullptr;
+  }
+  return std::unique_ptr<T>(t);
+}
+
+template <typename T, int K> bool ChunkedArray<T, K>::set(int idx, const T &t) {
+  return set_range(idx, 1, &t) == 1;
+}
+
+template <typename T, int K>
+int ChunkedArray<T, K>::get_range(int idx, int n, T *dst) {
+  if (idx < 0 || idx >= len_ || n <= 0)
+    return 0;
+  n = std::min(n, len_ - idx);
+  int nr_copied = 0;
+  while (nr_copied < n) {
+    int cid = (idx + nr_copied) / K;
+    int off = (idx + nr_copied) % K;
+    int cnt = std::min(K - off, n - nr_copied);
+    if (nr_copied + cnt < n) // overlap the next chunk's misses with this copy
+      chunks_[cid + 1].optr.prefetch(
+          std::min(K, n - nr_copied - cnt) * sizeof(T));
+    int ret = read_chunk(cid, off, cnt, dst + nr_copied);
+    nr_copied += ret;
+    if (ret < cnt)
+      break;
+  }
+  return nr_copied;
+}
+
+template <typename T, int K>
+int ChunkedArray<T, K>::set_range(int idx, int n, const T *src) {
+  if (idx < 0 || idx >= len_ || n <= 0)
+    return 0;
+  n = std::min(n, len_ - idx);
+  int nr_written = 0;
+  while (nr_written < n) {
+    int cid = (idx + nr_written) / K;
+    int off = (idx + nr_written) % K;
+    int cnt = std::min(K - off, n - nr_written);
+    if (write_chunk(cid, off, cnt, src + nr_written) < cnt)
+      break;
+    nr_written += cnt;
+  }
+  return nr_written;
+}
+
+template <typename T, int K>
+int ChunkedArray<T, K>::read_chunk(int cid, int off, int n, T *dst) {
+  auto &chunk = chunks_[cid];
+  std::unique_lock<std::mutex> ul(chunk_lock(cid));
+  int run = 0;
+  if (chunk.optr.null())
+    goto evicted;
+  run = present_run(chunk, off, n);
+  if (run == 0)
+    goto missed;
+  if (!chunk.optr.copy_to(dst, run * sizeof(T), off * sizeof(T)))
+    goto evicted;
+  pool_->inc_cache_hit();
+  pool_->get_allocator()->count_access();
+  return run;
+
+evicted:
+  // the whole chunk is gone together with all its elements
+  clear_present(chunk);
+  if (chunk.optr.is_victim())
+    pool_->inc_cache_victim_hit(&chunk.optr);
+missed:
+  pool_->inc_cache_miss();
+  return 0;
+}
+
+template <typename T, int K>
+int ChunkedArray<T, K>::write_chunk(int cid, int off, int n, const T *src) {
+  auto &chunk = chunks_[cid];
+  std::unique_lock<std::mutex> ul(chunk_lock(cid));
+  if (!chunk.optr.null() &&
+      chunk.optr.copy_from(src, n * sizeof(T), off * sizeof(T))) {
+    mark_present(chunk, off, n);
+    pool_->get_allocator()->count_access();
+    return n;
+  }
+
+  // absent or just evicted: start over with a fresh chunk
+  clear_present(chunk);
+  auto allocator = pool_->get_allocator();
+  if (!chunk.optr.null())
+    pool_->free(chunk.optr);
+  if (!allocator->alloc_to(chunk_size(cid) * sizeof(T), &chunk.optr) ||
+      !chunk.optr.copy_from(src, n * sizeof(T), off * sizeof(T)))
+    return 0;
+  mark_present(chunk, off, n);
+  allocator->count_access();
+  return n;
+}
+
+template <typename T, int K>
+int ChunkedArray<T, K>::chunk_size(int cid) const noexcept {
+  return std::min(K, len_ - cid * K);
+}
+
+template <typename T, int K>
+std::mutex &ChunkedArray<T, K>::chunk_lock(int cid) noexcept {
+  return locks_[cid % kNumLocks];
+}
+
+template <typename T, int K>
+int ChunkedArray<T, K>::present_run(const Chunk &chunk, int off,
+                                    int n) noexcept {
+  int run = 0;
+  for (int i = off; i < off + n; i++, run++)
+    if (!(chunk.present[i / 64] & (1ull << (i % 64))))
+      break;
+  return run;
+}
+
+template <typename T, int K>
+void ChunkedArray<T, K>::mark_present(Chunk &chunk, int off, int n) noexcept {
+  for (int i = off; i < off + n; i++)
+    chunk.present[i / 64] |= 1ull << (i % 64);
+}
+
+template <typename T, int K>
+void ChunkedArray<T, K>::clear_present(Chunk &chunk) noexcept {
+  std::fill(chunk.present, chunk.present + kPresentWords, 0);
+}
+} // namespace midas
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstring>
+
+#include "pinned_view.hpp"
+
+namespace midas {
+
+/** Flat structs */
+template <typename T, typename Enable>
+inline size_t Codec<T, Enable>::size(const T &v) noexcept {
+  return sizeof(T);
+}
+
+template <typename T, typename Enable>
+inline const void *Codec<T, Enable>::contiguous(const T &v) noexcept {
+  return &v;
+}
+
+template <typename T, typename Enable>
+inline bool Codec<T, Enable>::encode(const T &v, void *buf,
+                                     size_t len) noexcept {
+  if (len != sizeof(T))
+    return false;
+  std::memcpy(buf, &v, sizeof(T));
+  return true;
+}
+
+template <typename T, typename Enable>
+inline bool Codec<T, Enable>::decode(T &v, const void *buf,
+                                     size_t len) noexcept {
+  if (len != sizeof(T))
+    return false;
+  std::memcpy(&v, buf, sizeof(T));
+  return true;
+}
+
+/** std::string */
+inline size_t Codec<std::string>::size(const std::string &v) noexcept {
+  return v.size();
+}
+
+inline const void *
+Codec<std::string>::contiguous(const std::string &v) noexcept {
+  return v.data();
+}
+
+inline bool Codec<std::string>::encode(const std::string &v, void *buf,
+                                       size_t len) noexcept {
+  if (len != v.size())
+    return false;
+  std::memcpy(buf, v.data(), len);
+  return true;
+}
+
+inline bool Codec<std::string>::decode(std::string &v, const void *buf,
+                                       size_t len) {
+  v.assign(reinterpret_cast<const char *>(buf), len);
+  return true;
+}
+
+/** std::vector of flat elements */
+template <typename E>
+inline size_t
+Codec<std::vector<E>, std::enable_if_t<std::is_trivially_copyable_v<E>>>::size(
+    const std::vector<E> &v) noexcept {
+  return v.size() * sizeof(E);
+}
+
+template <typename E>
+inline const void *
+Codec<std::vector<E>, std::enable_if_t<std::is_trivially_copyable_v<E>>>::
+    contiguous(const std::vector<E> &v) noexcept {
+  return v.data();
+}
+
+template <typename E>
+inline bool
+Codec<std::vector<E>, std::enable_if_t<std::is_trivially_copyable_v<E>>>::
+    encode(const std::vector<E> &v, void *buf, size_t len) noexcept {
+  if (len != v.size() * sizeof(E))
+    return false;
+  std::memcpy(buf, v.data(), len);
+  return true;
+}
+
+template <typename E>
+inline bool
+Codec<std::vector<E>, std::enable_if_t<std::is_trivially_copyable_v<E>>>::
+    decode(std::vector<E> &v, const void *buf, size_t len) {
+  if (len % sizeof(E))
+    return false;
+  v.resize(len / sizeof(E));
+  if (len)
+    std::memcpy(v.data(), buf, len);
+  return true;
+}
+
+/** Helpers */
+namespace codec_utils {
+template <typename T> inline const void *flatten(const T &v, size_t &len) {
+  using C = Codec<T>;
+  len = C::size(v);
+  auto src = C::contiguous(v);
+  if (src)
+    return src;
+  static thread_local std::vector<char> scratch;
+  scratch.resize(len);
+  if (!C::encode(v, scratch.data(), len))
+    return nullptr;
+  return scratch.data();
+}
+
+inline size_t capacity(ObjectPtr &optr, int64_t offset) {
+  size_t data_size = optr.is_small_obj()
+                         ? optr.data_size_in_segment()
+                         : optr.large_data_size().value_or(0);
+  return data_size > static_cast<size_t>(offset) ? data_size - offset : 0;
+}
+} // namespace codec_utils
+
+} // namespace midas
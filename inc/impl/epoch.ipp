@@ -0,0 +1,42 @@
+#pragma once
+
+namespace midas {
+
+inline void EpochManager::enter() noexcept {
+  auto &local = local_;
+  if (local.depth++ > 0)
+    return;
+  if (!local.record) {
+    if (local.exhausted) // out of records, rely on the fault handler
+      return;
+    local.record = acquire_record();
+    if (!local.record)
+      return;
+  }
+  local.record->epoch.store(global_epoch_.load(std::memory_order_acquire),
+                            std::memory_order_relaxed);
+  // publish the epoch before any soft memory pointer is loaded
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+inline void EpochManager::exit() noexcept {
+  auto &local = local_;
+  if (--local.depth > 0 || !local.record)
+    return;
+  local.record->epoch.store(kQuiescent, std::memory_order_release);
+}
+
+inline EpochManager *EpochManager::global_epoch_manager() noexcept {
+  static EpochManager manager_;
+  return &manager_;
+}
+
+inline EpochGuard::EpochGuard() noexcept {
+  EpochManager::global_epoch_manager()->enter();
+}
+
+inline EpochGuard::~EpochGuard() noexcept {
+  EpochManager::global_epoch_manager()->exit();
+}
+
+} // namespace midas
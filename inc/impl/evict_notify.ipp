@@ -0,0 +1,99 @@
+#pragma once
+
+namespace midas {
+
+/** EvictQueue */
+inline uint64_t EvictQueue::round_capacity(size_t capacity) noexcept {
+  uint64_t cap = 2;
+  while (cap < capacity)
+    cap <<= 1;
+  return cap;
+}
+
+inline EvictQueue::EvictQueue(size_t capacity)
+    : mask_(round_capacity(capacity) - 1),
+      slots_(std::make_unique<Slot[]>(mask_ + 1)) {
+  for (uint64_t i = 0; i <= mask_; i++)
+    slots_[i].seq.store(i, std::memory_order_relaxed);
+}
+
+/* A slot is free to push at tail when its seq equals tail, and ready to pop
+ * at head when its seq equals head + 1. */
+inline bool EvictQueue::push_one(const EvictedObject &obj) noexcept {
+  auto pos = tail_.load(std::memory_order_relaxed);
+  while (true) {
+    auto &slot = slots_[pos & mask_];
+    auto seq = slot.seq.load(std::memory_order_acquire);
+    auto diff = static_cast<int64_t>(seq - pos);
+    if (diff == 0) {
+      if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        break;
+    } else if (diff < 0) { // full
+      return false;
+    } else {
+      pos = tail_.load(std::memory_order_relaxed);
+    }
+  }
+  auto &slot = slots_[pos & mask_];
+  slot.obj = obj;
+  slot.seq.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+inline size_t EvictQueue::push(const EvictedObject *objs, size_t nr) noexcept {
+  size_t nr_pushed = 0;
+  while (nr_pushed < nr && push_one(objs[nr_pushed]))
+    nr_pushed++;
+  if (nr_pushed < nr)
+    nr_dropped_.fetch_add(nr - nr_pushed, std::memory_order_relaxed);
+  return nr_pushed;
+}
+
+inline size_t EvictQueue::drain(EvictedObject *out, size_t max) noexcept {
+  size_t nr_popped = 0;
+  auto pos = head_.load(std::memory_order_relaxed);
+  while (nr_popped < max) {
+    auto &slot = slots_[pos & mask_];
+    auto seq = slot.seq.load(std::memory_order_acquire);
+    auto diff = static_cast<int64_t>(seq - (pos + 1));
+    if (diff == 0) {
+      if (!head_.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed))
+        continue;
+      out[nr_popped++] = slot.obj;
+      slot.seq.store(pos + mask_ + 1, std::memory_order_release);
+      pos++;
+    } else if (diff < 0) { // empty
+      break;
+    } else {
+      pos = head_.load(std::memory_order_relaxed);
+    }
+  }
+  return nr_popped;
+}
+
+inline size_t EvictQueue::capacity() const noexcept { return mask_ + 1; }
+
+inline uint64_t EvictQueue::nr_dropped() const noexcept {
+  return nr_dropped_.load(std::memory_order_relaxed);
+}
+
+/** EvictBatch */
+inline void EvictBatch::add(void *rref, uint64_t size, uint64_t tag) noexcept {
+  objs_.push_back(EvictedObject{rref, size, tag});
+}
+
+inline bool EvictBatch::empty() const noexcept { return objs_.empty(); }
+
+inline void EvictBatch::deliver(const EvictBatchFunc &func,
+                                EvictQueue *queue) noexcept {
+  if (objs_.empty())
+    return;
+  if (func)
+    func(objs_.data(), objs_.size());
+  if (queue)
+    queue->push(objs_.data(), objs_.size());
+  objs_.clear();
+}
+
+} // namespace midas
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "robinhood.h"
+
+namespace midas {
+
+inline uint64_t EvictionPolicy::key_hash(uint64_t key) noexcept {
+  // the high bits of hash_int are well mixed, index tables with them
+  return robin_hood::hash_int(key);
+}
+
+/** CLOCK */
+inline EvictPolicyType ClockPolicy::type() const noexcept {
+  return EvictPolicyType::Clock;
+}
+
+inline bool ClockPolicy::scan(MetaObjectHdr &hdr, uint64_t key,
+                              size_t size) noexcept {
+  if (!hdr.is_accessed())
+    return true;
+  hdr.dec_accessed();
+  return false;
+}
+
+} // namespace midas
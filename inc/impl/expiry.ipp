@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+
+#include "eviction_policy.hpp"
+
+namespace midas {
+
+template <typename T>
+TimerWheel<T>::TimerWheel(uint64_t tick_us, uint64_t now_us)
+    : tick_us_(std::max<uint64_t>(tick_us, 1)),
+      curr_tick_(now_us / tick_us_) {}
+
+/* Rounded up to a tick so that no item fires early. */
+template <typename T> void TimerWheel<T>::add(uint64_t deadline_us, T item) {
+  place(Timer{(deadline_us + tick_us_ - 1) / tick_us_, std::move(item)});
+  nr_timers_++;
+}
+
+template <typename T> void TimerWheel<T>::place(Timer &&timer) {
+  auto tick = std::max(timer.tick, curr_tick_);
+  tick = std::min(tick, curr_tick_ + kMaxTicks - 1);
+  auto diff = tick - curr_tick_;
+  int level = 0;
+  while (level < kNrLevels - 1 && diff >= (1ull << (kLevelBits * (level + 1))))
+    level++;
+  auto slot = (tick >> (kLevelBits * level)) & (kSlots - 1);
+  slots_[level][slot].emplace_back(std::move(timer));
+}
+
+/* Higher levels cascade first, as their timers may land in lower slots that
+ * are due at @tick as well. */
+template <typename T>
+void TimerWheel<T>::process(uint64_t tick, std::vector<T> &due) {
+  for (int level = kNrLevels - 1; level > 0; level--) {
+    if (tick & ((1ull << (kLevelBits * level)) - 1))
+      continue;
+    auto &slot = slots_[level][(tick >> (kLevelBits * level)) & (kSlots - 1)];
+    auto timers = std::move(slot);
+    slot.clear();
+    for (auto &timer : timers)
+      place(std::move(timer));
+  }
+  auto &slot = slots_[0][tick & (kSlots - 1)];
+  auto timers = std::move(slot);
+  slot.clear();
+  for (auto &timer : timers) {
+    if (timer.tick > tick) { // parked beyond the top level
+      place(std::move(timer));
+      continue;
+    }
+    due.emplace_back(std::move(timer.item));
+    nr_timers_--;
+  }
+}
+
+template <typename T>
+void TimerWheel<T>::advance(uint64_t now_us, std::vector<T> &due) {
+  auto target = now_us / tick_us_;
+  for (; curr_tick_ <= target; curr_tick_++) {
+    if (!nr_timers_) { // nothing to cascade or fire
+      curr_tick_ = target + 1;
+      break;
+    }
+    process(curr_tick_, due);
+  }
+}
+
+template <typename T> size_t TimerWheel<T>::size() const noexcept {
+  return nr_timers_;
+}
+
+inline ExpiryTable::ExpiryTable()
+    : slots_(std::make_unique<Slot[]>(1ull << kTableBits)) {}
+
+inline ExpiryTable::Slot &ExpiryTable::slot(const void *key) const noexcept {
+  auto hash = EvictionPolicy::key_hash(reinterpret_cast<uint64_t>(key));
+  return slots_[hash >> (64 - kTableBits)];
+}
+
+/* Deadlines are rounded up to ms so that nothing expires early. */
+inline void ExpiryTable::set(const void *key, uint64_t deadline_us) noexcept {
+  auto &slot = this->slot(key);
+  auto addr = reinterpret_cast<uint64_t>(key);
+  auto meta = slot.meta.load(std::memory_order_relaxed);
+  do {
+    while (meta & kVersionOne) // another update is in progress
+      meta = slot.meta.load(std::memory_order_relaxed);
+  } while (!slot.meta.compare_exchange_weak(meta, meta + kVersionOne,
+                                            std::memory_order_relaxed));
+  std::atomic_thread_fence(std::memory_order_release);
+  auto version = (meta & ~kDeadlineMask) + 2 * kVersionOne;
+  if (!deadline_us) { // only clear our own entry
+    bool own = slot.key.load(std::memory_order_relaxed) == addr;
+    if (own)
+      slot.key.store(0, std::memory_order_relaxed);
+    slot.meta.store(version | (own ? 0 : meta & kDeadlineMask),
+                    std::memory_order_release);
+    return;
+  }
+  auto deadline_ms = std::min((deadline_us + 999) / 1000, kDeadlineMask);
+  slot.key.store(addr, std::memory_order_relaxed);
+  slot.meta.store(version | deadline_ms, std::memory_order_release);
+}
+
+/* Torn reads count as not expired. */
+inline bool ExpiryTable::expired(const void *key,
+                                 uint64_t now_us) const noexcept {
+  auto &slot = this->slot(key);
+  auto meta = slot.meta.load(std::memory_order_acquire);
+  if (meta & kVersionOne)
+    return false;
+  auto stored = slot.key.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (slot.meta.load(std::memory_order_relaxed) != meta)
+    return false;
+  auto deadline_ms = meta & kDeadlineMask;
+  return stored == reinterpret_cast<uint64_t>(key) && deadline_ms &&
+         now_us / 1000 >= deadline_ms;
+}
+
+} // namespace midas
@@ -75,11 +75,22 @@ inline bool LogAllocator::alloc_to(size_t size, ObjectPtr *dst) {
   if (!optptr)
     return false;
   auto &ptr = *optptr;
+  ptr.key_tag_ = dst->key_tag_;
   *dst = ptr;
   ptr.set_rref(dst);
   return true;
 }
 
+inline bool LogAllocator::alloc_to(size_t size, CompactObjectPtr *dst) {
+  auto optptr = alloc(size);
+  if (!optptr)
+    return false;
+  auto &ptr = *optptr;
+  dst->store(ptr);
+  ptr.set_rref(dst);
+  return true;
+}
+
 inline bool LogAllocator::free(ObjectPtr &ptr) {
   return ptr.free() == RetCode::Succ;
 }
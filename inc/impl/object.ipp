@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <string>
 
@@ -41,6 +42,9 @@ inline void MetaObjectHdr::clr_present() noexcept {
 inline bool MetaObjectHdr::is_accessed() const noexcept {
   return flags & kAccessedMask;
 }
+inline uint32_t MetaObjectHdr::get_accessed() const noexcept {
+  return (flags & kAccessedMask) >> kAccessedBit;
+}
 inline void MetaObjectHdr::inc_accessed() noexcept {
   int64_t accessed = (flags & kAccessedMask) >> kAccessedBit;
   accessed = std::min<int64_t>(accessed + 1, 3ll);
@@ -189,7 +193,7 @@ inline uint32_t LargeObjectHdr::get_flags() const noexcept { return flags; }
 /** ObjectPtr */
 inline ObjectPtr::ObjectPtr()
     : small_obj_(true), head_obj_(true), victim_(false), size_(0),
-      deref_cnt_(0), obj_() {}
+      key_tag_(0), obj_() {}
 
 inline bool ObjectPtr::null() const noexcept { return obj_.null(); }
 
@@ -198,8 +202,7 @@ inline void ObjectPtr::reset() noexcept {
   head_obj_ = true;
   victim_ = false;
   size_ = 0;
-  deref_cnt_ = 0;
-  obj_.reset();
+  obj_.reset(); // keeps key_tag_ for the next object of the same key
 }
 
 inline size_t ObjectPtr::obj_size(size_t data_size) noexcept {
@@ -256,7 +259,6 @@ using RetCode = ObjectPtr::RetCode;
 inline RetCode ObjectPtr::init_small(uint64_t stt_addr, size_t data_size) {
   small_obj_ = true;
   size_ = round_up_to_align(data_size, kSmallObjSizeUnit);
-  deref_cnt_ = 0;
 
   SmallObjectHdr hdr;
   hdr.init(size_);
@@ -271,7 +273,6 @@ inline RetCode ObjectPtr::init_large(uint64_t stt_addr, size_t data_size,
   small_obj_ = false;
   head_obj_ = is_head;
   size_ = data_size; // YIFAN: check this later!!
-  deref_cnt_ = 0;
 
   LargeObjectHdr hdr;
   hdr.init(data_size, is_head, head, next);
@@ -280,7 +281,6 @@ inline RetCode ObjectPtr::init_large(uint64_t stt_addr, size_t data_size,
 }
 
 inline RetCode ObjectPtr::init_from_soft(TransientPtr soft_ptr) {
-  deref_cnt_ = 0;
 
   MetaObjectHdr hdr;
   obj_ = soft_ptr;
@@ -319,9 +319,7 @@ inline RetCode ObjectPtr::free_small() noexcept {
     return RetCode::Fail;
   meta_hdr.clr_present();
   auto ret = store_hdr(meta_hdr, *this) ? RetCode::Succ : RetCode::FaultLocal;
-  auto rref = reinterpret_cast<ObjectPtr *>(get_rref());
-  if (rref)
-    rref->obj_.reset();
+  reset_rref(load_rref());
   return ret;
 }
 
@@ -341,9 +339,7 @@ inline RetCode ObjectPtr::free_large() noexcept {
   if (ret != RetCode::Succ)
     return ret;
 
-  auto rref = reinterpret_cast<ObjectPtr *>(get_rref());
-  if (rref)
-    rref->obj_.reset();
+  reset_rref(load_rref());
 
   auto next = hdr.get_next();
   while (!next.null()) {
@@ -383,27 +379,59 @@ inline bool ObjectPtr::set_rref(ObjectPtr *addr) noexcept {
   return set_rref(reinterpret_cast<uint64_t>(addr));
 }
 
-inline ObjectPtr *ObjectPtr::get_rref() noexcept {
+inline bool ObjectPtr::set_rref(CompactObjectPtr *addr) noexcept {
+  return set_rref(reinterpret_cast<uint64_t>(addr) | kCompactRRefBit);
+}
+
+/* Raw rref in the header, tagged if it points to a CompactObjectPtr. 0 on
+ * faults. */
+inline uint64_t ObjectPtr::load_rref() noexcept {
   assert(!null());
   if (is_small_obj()) {
     SmallObjectHdr hdr;
     if (!load_hdr(hdr, *this))
-      return nullptr;
-    return reinterpret_cast<ObjectPtr *>(hdr.get_rref());
+      return 0;
+    return hdr.get_rref();
   } else {
     LargeObjectHdr hdr;
     if (!load_hdr(hdr, *this))
-      return nullptr;
-    return reinterpret_cast<ObjectPtr *>(hdr.get_rref());
+      return 0;
+    return hdr.get_rref();
   }
   MIDAS_ABORT("impossible to reach here!");
-  return nullptr;
+  return 0;
+}
+
+inline void ObjectPtr::reset_rref(uint64_t rref) noexcept {
+  if (!rref)
+    return;
+  if (rref & kCompactRRefBit)
+    reinterpret_cast<CompactObjectPtr *>(rref & ~kCompactRRefBit)->reset();
+  else
+    reinterpret_cast<ObjectPtr *>(rref)->obj_.reset();
+}
+
+inline ObjectPtr *ObjectPtr::get_rref() noexcept {
+  auto rref = load_rref();
+  if (rref & kCompactRRefBit)
+    return nullptr;
+  return reinterpret_cast<ObjectPtr *>(rref);
+}
+
+inline void *ObjectPtr::get_rref_addr() noexcept {
+  return reinterpret_cast<void *>(load_rref() & ~kCompactRRefBit);
 }
 
 inline RetCode ObjectPtr::upd_rref() noexcept {
-  auto *ref = get_rref();
-  if (!ref)
+  auto rref = load_rref();
+  if (!rref)
     return RetCode::Fail;
+  if (rref & kCompactRRefBit) {
+    auto ref = reinterpret_cast<CompactObjectPtr *>(rref & ~kCompactRRefBit);
+    ref->store(*this);
+    return RetCode::Succ;
+  }
+  auto *ref = reinterpret_cast<ObjectPtr *>(rref);
   /* We should update obj_ and size_ atomically. As size_ can be protected by
    * the object lock, the bottomline is to update obj_ atomically. So far we
    * rely on 64bit CPU to do so. */
@@ -413,24 +441,67 @@ inline RetCode ObjectPtr::upd_rref() noexcept {
   return RetCode::Succ;
 }
 
+inline void ObjectPtr::set_key_hash(uint64_t key_hash) noexcept {
+  key_tag_ = static_cast<uint32_t>(key_hash ^ (key_hash >> 32)) | 1;
+}
+
+/* Tagged ids are apart from addresses, which never have the top bit set. */
+inline uint64_t ObjectPtr::key_id() const noexcept {
+  return key_tag_ ? (1ull << 63) | key_tag_ : reinterpret_cast<uint64_t>(this);
+}
+
+inline uint64_t ObjectPtr::rref_key_id() noexcept {
+  auto rref = load_rref();
+  if (!rref || (rref & kCompactRRefBit))
+    return rref & ~kCompactRRefBit;
+  return reinterpret_cast<ObjectPtr *>(rref)->key_id();
+}
+
 inline bool ObjectPtr::cmpxchg(int64_t offset, uint64_t oldval,
                                uint64_t newval) {
+  EpochGuard guard;
   if (null())
     return false;
   return obj_.cmpxchg(hdr_size() + offset, oldval, newval);
 }
 
 inline bool ObjectPtr::copy_from(const void *src, size_t len, int64_t offset) {
+  EpochGuard guard;
   return is_small_obj() ? copy_from_small(src, len, offset)
                         : copy_from_large(src, len, offset);
 }
 
 inline bool ObjectPtr::copy_to(void *dst, size_t len, int64_t offset) {
+  EpochGuard guard;
   return is_small_obj() ? copy_to_small(dst, len, offset)
                         : copy_to_large(dst, len, offset);
 }
 
+inline bool ObjectPtr::copy_from_iov(const ObjectIOVec *iov, int nr_iov) {
+  EpochGuard guard;
+  return is_small_obj() ? copy_iov_small(iov, nr_iov, /* to_obj = */ true)
+                        : copy_iov_large(iov, nr_iov, /* to_obj = */ true);
+}
+
+inline bool ObjectPtr::copy_to_iov(const ObjectIOVec *iov, int nr_iov) {
+  EpochGuard guard;
+  return is_small_obj() ? copy_iov_small(iov, nr_iov, /* to_obj = */ false)
+                        : copy_iov_large(iov, nr_iov, /* to_obj = */ false);
+}
+
+inline void ObjectPtr::prefetch(size_t len) const noexcept {
+  constexpr static size_t kCacheLineSize = 64;
+  if (null())
+    return;
+  // prefetches never fault, so a stale or just evicted obj_ is harmless
+  auto addr = reinterpret_cast<const char *>(obj_.to_normal_address());
+  len = std::min(len + hdr_size(), obj_size());
+  for (size_t off = 0; off < len; off += kCacheLineSize)
+    __builtin_prefetch(addr + off);
+}
+
 inline RetCode ObjectPtr::move_from(ObjectPtr &src) {
+  EpochGuard guard;
   if (null() || src.null())
     return RetCode::Fail;
 
@@ -500,6 +571,117 @@ inline const std::string ObjectPtr::to_string() noexcept {
   return sstream.str();
 }
 
+/** CompactObjectPtr */
+inline CompactObjectPtr::CompactObjectPtr() noexcept : raw_(0) {}
+
+inline uint64_t CompactObjectPtr::load() const noexcept {
+  return __atomic_load_n(&raw_, __ATOMIC_RELAXED);
+}
+
+inline bool CompactObjectPtr::null() const noexcept {
+  return !(load() & kNonNullBit);
+}
+
+inline void CompactObjectPtr::reset() noexcept {
+  __atomic_store_n(&raw_, 0, __ATOMIC_RELAXED);
+}
+
+inline bool CompactObjectPtr::packable(const ObjectPtr &optr) noexcept {
+  if (optr.null())
+    return true;
+  auto addr = optr.obj_.to_normal_address();
+  return addr >= kVolatileSttAddr && addr < kVolatileEndAddr &&
+         addr % kSmallObjSizeUnit == 0 && optr.size_ <= kSizeMask;
+}
+
+inline uint64_t CompactObjectPtr::pack(const ObjectPtr &optr) noexcept {
+  if (optr.null())
+    return 0;
+  assert(packable(optr));
+  uint64_t offset = optr.obj_.to_normal_address() - kVolatileSttAddr;
+  return (offset / kSmallObjSizeUnit) << kAddrShift |
+         static_cast<uint64_t>(optr.size_) << kSizeShift |
+         (optr.small_obj_ ? kSmallObjBit : 0) |
+         (optr.head_obj_ ? kHeadObjBit : 0) | kNonNullBit;
+}
+
+inline ObjectPtr CompactObjectPtr::unpack(uint64_t raw) noexcept {
+  ObjectPtr optr;
+  if (!(raw & kNonNullBit))
+    return optr;
+  optr.small_obj_ = raw & kSmallObjBit;
+  optr.head_obj_ = raw & kHeadObjBit;
+  optr.size_ = (raw >> kSizeShift) & kSizeMask;
+  auto addr = kVolatileSttAddr + (raw >> kAddrShift) * kSmallObjSizeUnit;
+  optr.obj_ = TransientPtr(addr, optr.obj_size());
+  return optr;
+}
+
+inline ObjectPtr CompactObjectPtr::get() const noexcept {
+  return unpack(load());
+}
+
+inline void CompactObjectPtr::store(const ObjectPtr &optr) noexcept {
+  __atomic_store_n(&raw_, pack(optr), __ATOMIC_RELAXED);
+}
+
+inline bool CompactObjectPtr::is_small_obj() const noexcept {
+  return load() & kSmallObjBit;
+}
+
+inline size_t CompactObjectPtr::data_size_in_segment() const noexcept {
+  return (load() >> kSizeShift) & kSizeMask;
+}
+
+inline bool CompactObjectPtr::is_victim() const noexcept { return false; }
+
+inline uint64_t CompactObjectPtr::key_id() const noexcept {
+  return reinterpret_cast<uint64_t>(this);
+}
+
+template <typename Op> inline bool CompactObjectPtr::apply(Op &&op) {
+  // keeps the old location from being reused while op may still access it
+  EpochGuard guard;
+  while (true) {
+    auto raw = load();
+    if (!(raw & kNonNullBit))
+      return false;
+    auto optr = unpack(raw);
+    if (op(optr))
+      return true;
+    if (load() == raw) // not moved or freed by GC
+      return false;
+  }
+}
+
+inline bool CompactObjectPtr::copy_from(const void *src, size_t len,
+                                        int64_t offset) {
+  return apply(
+      [&](ObjectPtr &optr) { return optr.copy_from(src, len, offset); });
+}
+
+inline bool CompactObjectPtr::copy_to(void *dst, size_t len, int64_t offset) {
+  return apply([&](ObjectPtr &optr) { return optr.copy_to(dst, len, offset); });
+}
+
+inline bool CompactObjectPtr::copy_from_iov(const ObjectIOVec *iov,
+                                            int nr_iov) {
+  return apply(
+      [&](ObjectPtr &optr) { return optr.copy_from_iov(iov, nr_iov); });
+}
+
+inline bool CompactObjectPtr::copy_to_iov(const ObjectIOVec *iov,
+                                          int nr_iov) {
+  return apply([&](ObjectPtr &optr) { return optr.copy_to_iov(iov, nr_iov); });
+}
+
+inline bool CompactObjectPtr::cmpxchg(int64_t offset, uint64_t oldval,
+                                      uint64_t newval) {
+  return apply([&](ObjectPtr &optr) {
+    return optr.cmpxchg(offset, oldval, newval);
+  });
+}
+
 template <class T> inline bool load_hdr(T &hdr, TransientPtr &tptr) noexcept {
   return tptr.copy_to(&hdr, sizeof(hdr));
 }
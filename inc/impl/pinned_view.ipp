@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstring>
+
+#include "logging.hpp"
+#include "time.hpp"
+
+namespace midas {
+
+/** SegmentPins */
+inline SegmentPins::SegmentPins() {}
+
+inline std::atomic_int64_t &SegmentPins::slot(uint64_t addr) noexcept {
+  return slots_[((addr & kLogSegmentMask) / kLogSegmentSize) % kNumSlots].cnt;
+}
+
+inline bool SegmentPins::pin(uint64_t addr) noexcept {
+  auto &cnt = slot(addr);
+  // pairs with the cmpxchg in lock(): either side sees the other
+  if (cnt.fetch_add(1) & kLockedBit) {
+    cnt.fetch_sub(1);
+    return false;
+  }
+  return true;
+}
+
+inline void SegmentPins::unpin(uint64_t addr) noexcept {
+  slot(addr).fetch_sub(1);
+}
+
+inline bool SegmentPins::pinned(uint64_t addr) noexcept {
+  return (slot(addr).load() & ~kLockedBit) != 0;
+}
+
+inline bool SegmentPins::lock(uint64_t addr) noexcept {
+  int64_t expected = 0;
+  return slot(addr).compare_exchange_strong(expected, kLockedBit);
+}
+
+inline void SegmentPins::unlock(uint64_t addr) noexcept {
+  slot(addr).fetch_sub(kLockedBit);
+}
+
+inline SegmentPins *SegmentPins::global_segment_pins() noexcept {
+  static SegmentPins pins_;
+  return &pins_;
+}
+
+/** PinnedView */
+inline PinnedView::PinnedView() noexcept
+    : data_(nullptr), size_(0), pinned_addr_(0), pin_stt_us_(0) {}
+
+inline PinnedView::PinnedView(ObjectPtr &optr, size_t len, int64_t offset)
+    : PinnedView() {
+  if (optr.null())
+    return;
+  if (kEnablePinning && pin(optr, len, offset))
+    return;
+  // fall back to a private copy
+  copy_ = std::make_unique<char[]>(len);
+  if (!optr.copy_to(copy_.get(), len, offset)) {
+    copy_.reset();
+    return;
+  }
+  data_ = copy_.get();
+  size_ = len;
+}
+
+inline PinnedView::PinnedView(CompactObjectPtr &optr, size_t len,
+                              int64_t offset)
+    : PinnedView() {
+  optr.apply([&](ObjectPtr &unpacked) {
+    *this = PinnedView(unpacked, len, offset);
+    return data_ != nullptr;
+  });
+}
+
+/* A pinned object cannot move, so an address read without its lock is good
+ * enough to check it. */
+inline bool PinnedView::viewed(ObjectPtr &optr) noexcept {
+  uint64_t addr = optr.obj_.to_normal_address();
+  return addr && SegmentPins::global_segment_pins()->pinned(addr);
+}
+
+inline PinnedView::PinnedView(PinnedView &&other) noexcept
+    : data_(other.data_), size_(other.size_),
+      pinned_addr_(other.pinned_addr_), pin_stt_us_(other.pin_stt_us_),
+      copy_(std::move(other.copy_)) {
+  other.data_ = nullptr;
+  other.size_ = 0;
+  other.pinned_addr_ = 0;
+}
+
+inline PinnedView &PinnedView::operator=(PinnedView &&other) noexcept {
+  if (this != &other) {
+    reset();
+    data_ = other.data_;
+    size_ = other.size_;
+    pinned_addr_ = other.pinned_addr_;
+    pin_stt_us_ = other.pin_stt_us_;
+    copy_ = std::move(other.copy_);
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.pinned_addr_ = 0;
+  }
+  return *this;
+}
+
+inline PinnedView::~PinnedView() { reset(); }
+
+inline void PinnedView::reset() noexcept {
+  if (pinned_addr_) {
+    SegmentPins::global_segment_pins()->unpin(pinned_addr_);
+    auto dur_us = Time::get_us() - pin_stt_us_;
+    if (dur_us > kPinWarnUs)
+      MIDAS_LOG(kWarning) << "Segment pinned for " << dur_us
+                          << "us, which holds back GC";
+    pinned_addr_ = 0;
+  }
+  copy_.reset();
+  data_ = nullptr;
+  size_ = 0;
+}
+
+/* Pins the segment first and then validates, under the object lock, that
+ * the object still lives there. An evacuator that moved it in between must
+ * have locked the segment, so either pin() fails or the check below does. */
+inline bool PinnedView::pin(ObjectPtr &optr, size_t len, int64_t offset) {
+  EpochGuard guard;
+  auto pins = SegmentPins::global_segment_pins();
+  uint64_t addr = optr.obj_.to_normal_address();
+  if (addr == 0 || !pins->pin(addr))
+    return false;
+
+  bool succ = false;
+  auto lock_id = optr.lock();
+  if (lock_id == INV_LOCK_ID)
+    goto done;
+  if (!optr.null() && optr.obj_.to_normal_address() == addr &&
+      offset + len <= optr.data_size_in_segment()) {
+    MetaObjectHdr meta_hdr;
+    if (!load_hdr(meta_hdr, optr) || !meta_hdr.is_present() ||
+        meta_hdr.is_continue())
+      goto unlock;
+    meta_hdr.inc_accessed();
+    if (!store_hdr(meta_hdr, optr))
+      goto unlock;
+    data_ = reinterpret_cast<const void *>(addr + optr.hdr_size() + offset);
+    size_ = len;
+    pinned_addr_ = addr;
+    pin_stt_us_ = Time::get_us();
+    succ = true;
+  }
+unlock:
+  optr.unlock(lock_id);
+done:
+  if (!succ)
+    pins->unpin(addr);
+  return succ;
+}
+
+inline const void *PinnedView::data() const noexcept { return data_; }
+
+inline size_t PinnedView::size() const noexcept { return size_; }
+
+template <typename T> inline const T *PinnedView::as() const noexcept {
+  return reinterpret_cast<const T *>(data_);
+}
+
+inline bool PinnedView::pinned() const noexcept { return pinned_addr_ != 0; }
+
+inline PinnedView::operator bool() const noexcept { return data_ != nullptr; }
+
+} // namespace midas
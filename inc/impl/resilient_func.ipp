@@ -35,4 +35,22 @@ inline bool ResilientFunc::contain(uint64_t fault_ip) {
   return stt_ip < fault_ip && fault_ip < end_ip;
 }
 
+inline uint64_t ResilientFunc::start_ip() const noexcept { return stt_ip; }
+
+inline bool rmemcpy(void *dst, const void *src, size_t len) {
+  auto &cfg = rmemcpy_config;
+  if (UNLIKELY(len >= cfg.stream_threshold.load(std::memory_order_relaxed)))
+    return cfg.stream.load(std::memory_order_relaxed)(dst, src, len);
+  if (len >= cfg.rep_threshold.load(std::memory_order_relaxed))
+    return rmemcpy_rep(dst, src, len);
+  return cfg.copy.load(std::memory_order_relaxed)(dst, src, len);
+}
+
+inline bool rmemcpy_nt(void *dst, const void *src, size_t len) {
+  if (len >= kNTCopyMinLen)
+    return rmemcpy_config.stream.load(std::memory_order_relaxed)(dst, src,
+                                                                 len);
+  return rmemcpy(dst, src, len);
+}
+
 } // namespace midas
\ No newline at end of file
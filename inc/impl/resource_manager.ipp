@@ -40,6 +40,10 @@ inline int64_t ResourceManager::NumRegionAvail() const noexcept {
   return static_cast<int64_t>(NumRegionLimit()) - NumRegionInUse();
 }
 
+inline Runtime *ResourceManager::runtime() const noexcept {
+  return runtime_.get();
+}
+
 inline ResourceManager *ResourceManager::global_manager() noexcept {
   return global_manager_shared_ptr().get();
 }
@@ -0,0 +1,21 @@
+#pragma once
+
+namespace midas {
+
+template <typename K, typename V>
+std::unique_ptr<V> SharedKV::get(const K &k) {
+  auto v = std::make_unique<V>();
+  if (!get(&k, sizeof(K), v.get(), sizeof(V)))
+    return nullptr;
+  return v;
+}
+
+template <typename K, typename V> bool SharedKV::set(const K &k, const V &v) {
+  return set(&k, sizeof(K), &v, sizeof(V));
+}
+
+template <typename K> bool SharedKV::remove(const K &k) {
+  return remove(&k, sizeof(K));
+}
+
+} // namespace midas
@@ -8,7 +8,10 @@ SoftMemPool<T, ReconArgs...>::SoftMemPool(std::string name, ReconFunc recon_fun)
   name_ = name;
   vcache_ = std::make_unique<VictimCache>(kVCacheSizeLimit, kVCacheCountLimit);
   allocator_ = std::make_shared<LogAllocator>(this);
-  rmanager_ = std::make_shared<ResourceManager>(this);
+  rmanager_ = Runtime::enabled()
+                  ? std::make_shared<ResourceManager>(
+                        this, Runtime::global_runtime_shared_ptr())
+                  : std::make_shared<ResourceManager>(this);
   evacuator_ = std::make_unique<Evacuator>(this, rmanager_, allocator_);
 }
 
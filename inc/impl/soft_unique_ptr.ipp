@@ -55,6 +55,15 @@ T SoftUniquePtr<T, ReconArgs...>::read(ReconArgs... args) {
   return value;
 }
 
+template <typename T, typename... ReconArgs>
+PinnedView SoftUniquePtr<T, ReconArgs...>::view(ReconArgs... args) {
+  PinnedView view(ptr_, sizeof(T));
+  if (view)
+    return view;
+  write(pool_->reconstruct(args...));
+  return PinnedView(ptr_, sizeof(T));
+}
+
 template <typename T, typename... ReconArgs>
 void SoftUniquePtr<T, ReconArgs...>::write(const T &value) {
   if (ptr_.null())
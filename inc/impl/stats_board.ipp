@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <cstring>
+
+#include "logging.hpp"
+
+namespace midas {
+
+inline StatsBoard::StatsBoard(uint64_t id, bool create) noexcept
+    : id_(id), owner_(create), page_(nullptr) {
+  using namespace boost::interprocess;
+  const auto name = utils::get_stats_board_name(id_);
+  try {
+    if (create) {
+      permissions perms;
+      perms.set_unrestricted();
+      shared_memory_object shm(open_or_create, name.c_str(), read_write,
+                               perms);
+      shm.truncate(sizeof(Page));
+      region_ = std::make_unique<mapped_region>(shm, read_write);
+      page_ = new (region_->get_address()) Page();
+    } else {
+      shared_memory_object shm(open_only, name.c_str(), read_only);
+      region_ = std::make_unique<mapped_region>(shm, read_only);
+      page_ = reinterpret_cast<Page *>(region_->get_address());
+    }
+  } catch (interprocess_exception &e) {
+    MIDAS_LOG(kDebug) << "Failed to map stats board " << name << ": "
+                      << e.what();
+    region_.reset();
+    page_ = nullptr;
+  }
+}
+
+inline StatsBoard::~StatsBoard() noexcept {
+  region_.reset();
+  if (owner_)
+    remove(id_);
+}
+
+inline bool StatsBoard::valid() const noexcept { return page_ != nullptr; }
+
+inline void StatsBoard::publish(const StatsSnapshot &snapshot) noexcept {
+  auto seq = page_->seq.load(std::memory_order_relaxed);
+  page_->seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(&page_->data, &snapshot, sizeof(snapshot));
+  page_->seq.store(seq + 2, std::memory_order_release);
+}
+
+inline bool StatsBoard::read(StatsSnapshot *snapshot) const noexcept {
+  for (int i = 0; i < kMaxReadRetry; i++) {
+    auto seq = page_->seq.load(std::memory_order_acquire);
+    if (seq & 1)
+      continue;
+    std::memcpy(snapshot, &page_->data, sizeof(*snapshot));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (page_->seq.load(std::memory_order_relaxed) == seq)
+      return seq != 0; // 0 means nothing has been published yet
+  }
+  return false;
+}
+
+inline uint64_t StatsBoard::now_us() noexcept {
+  // CLOCK_MONOTONIC is system-wide so it is comparable across processes
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+inline void StatsBoard::remove(uint64_t id) noexcept {
+  boost::interprocess::shared_memory_object::remove(
+      utils::get_stats_board_name(id).c_str());
+}
+
+} // namespace midas
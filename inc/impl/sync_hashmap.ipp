@@ -28,6 +28,12 @@ template <size_t NBuckets, typename Key, typename Tp, typename Hash,
 template <typename K1>
 std::unique_ptr<Tp>
 SyncHashMap<NBuckets, Key, Tp, Hash, Pred, Alloc, Lock>::get(K1 &&k) {
+  if constexpr (!kFixedValue) {
+    auto v = std::make_unique<Tp>();
+    if (get(std::forward<K1>(k), *v))
+      return v;
+    return nullptr;
+  }
   Tp *stored_v = reinterpret_cast<Tp *>(::operator new(sizeof(Tp)));
   if (get(std::forward<K1>(k), *stored_v))
     return std::unique_ptr<Tp>(stored_v);
@@ -61,7 +67,7 @@ bool SyncHashMap<NBuckets, Key, Tp, Hash, Pred, Alloc, Lock>::get(K1 &&k,
     goto failed;
   }
   assert(node);
-  if (node->pair.null() || !node->pair.copy_to(&v, sizeof(Tp), sizeof(Key))) {
+  if (node->pair.null() || !load_value(node->pair, v)) {
     if (node->pair.is_victim())
       pool_->inc_cache_victim_hit(&node->pair);
     node = delete_node(prev_next, node);
@@ -69,7 +75,8 @@ bool SyncHashMap<NBuckets, Key, Tp, Hash, Pred, Alloc, Lock>::get(K1 &&k,
     goto failed;
   }
   ul.unlock();
-  pool_->inc_cache_hit();
+  pool_->inc_cache_hit(node->pair.key_id());
+  pool_->record_access(key_hash);
   LogAllocator::count_access();
   return true;
 failed:
@@ -84,11 +91,54 @@ failed:
     set(k, v);
     pool_->construct_add(sizeof(v), plug);
     pool_->construct_end(plug);
+    if (pool_->obj_costs_enabled())
+      set_cost(k, plug.end_cycles - plug.stt_cycles);
     return succ;
   }
   return false;
 }
 
+template <size_t NBuckets, typename Key, typename Tp, typename Hash,
+          typename Pred, typename Alloc, typename Lock>
+template <typename K1>
+PinnedView
+SyncHashMap<NBuckets, Key, Tp, Hash, Pred, Alloc, Lock>::get_view(K1 &&k) {
+  auto hasher = Hash();
+  auto key_hash = hasher(k);
+  auto bucket_idx = key_hash % NBuckets;
+
+  auto ul = std::unique_lock(locks_[bucket_idx]);
+
+  auto prev_next = &buckets_[bucket_idx];
+  BNPtr node = buckets_[bucket_idx];
+  bool found = false;
+  while (node) {
+    found = iterate_list(key_hash, k, prev_next, node);
+    if (found)
+      break;
+  }
+  if (!found) {
+    ul.unlock();
+    pool_->inc_cache_miss();
+    return PinnedView();
+  }
+  assert(node);
+  auto view = view_value(node->pair);
+  if (!view) {
+    if (node->pair.is_victim())
+      pool_->inc_cache_victim_hit(&node->pair);
+    node = delete_node(prev_next, node);
+    ul.unlock();
+    pool_->inc_cache_miss();
+    return view;
+  }
+  ul.unlock();
+  pool_->inc_cache_hit(node->pair.key_id());
+  pool_->record_access(key_hash);
+  LogAllocator::count_access();
+  return view;
+}
+
 template <size_t NBuckets, typename Key, typename Tp, typename Hash,
           typename Pred, typename Alloc, typename Lock>
 template <typename K1>
@@ -133,11 +183,12 @@ bool SyncHashMap<NBuckets, Key, Tp, Hash, Pred, Alloc, Lock>::set(
     auto found = iterate_list(key_hash, k, prev_next, node);
     if (found) {
       // Tp tmp_v = v;
-      assert(sizeof(v) <= sizeof(Tp));
-      // try to set in place
-      if (!node->pair.null() &&
-          node->pair.copy_from(&v, sizeof(Tp1), sizeof(Key))) {
+      assert(!kFixedValue || sizeof(v) <= sizeof(Tp));
+      // try to set in place if no view is reading the old value
+      if (!node->pair.null() && !PinnedView::viewed(node->pair) &&
+          store_value(node->pair, v, /* fresh = */ false)) {
         ul.unlock();
+        pool_->record_access(key_hash);
         LogAllocator::count_access();
         return true;
       } else {
@@ -147,6 +198,8 @@ bool SyncHashMap<NBuckets, Key, Tp, Hash, Pred, Alloc, Lock>::set(
     }
   }
 
+  if (!pool_->admit(key_hash)) // rejected, as if evicted right away
+    return true;
   auto new_node = create_node(key_hash, k, v);
   if (!new_node)
     return false;
@@ -156,6 +209,28 @@ bool SyncHashMap<NBuckets, Key, Tp, Hash, Pred, Alloc, Lock>::set(
   return true;
 }
 
+template <size_t NBuckets, typename Key, typename Tp, typename Hash,
+          typename Pred, typename Alloc, typename Lock>
+template <typename K1>
+bool SyncHashMap<NBuckets, Key, Tp, Hash, Pred, Alloc, Lock>::set_cost(
+    K1 &&k, uint64_t cycles) {
+  auto hasher = Hash();
+  auto key_hash = hasher(k);
+  auto bucket_idx = key_hash % NBuckets;
+
+  auto ul = std::unique_lock(locks_[bucket_idx]);
+
+  auto prev_next = &buckets_[bucket_idx];
+  auto node = buckets_[bucket_idx];
+  while (node) {
+    if (iterate_list(key_hash, k, prev_next, node)) {
+      pool_->set_obj_cost(node->pair.key_id(), cycles);
+      return true;
+    }
+  }
+  return false;
+}
+
 template <size_t NBuckets, typename Key, typename Tp, typename Hash,
           typename Pred, typename Alloc, typename Lock>
 bool SyncHashMap<NBuckets, Key, Tp, Hash, Pred, Alloc, Lock>::clear() {
@@ -184,13 +259,12 @@ SyncHashMap<NBuckets, Key, Tp, Hash, Pred, Alloc, Lock>::create_node(
     uint64_t key_hash, K1 &&k, Tp1 &&v) {
   // Tp tmp_v = v;
   assert(sizeof(k) <= sizeof(Key));
-  assert(sizeof(v) <= sizeof(Tp));
   // auto allocator = pool_->get_allocator();
 
   auto *new_node = new BucketNode();
-  if (!pool_->alloc_to(sizeof(Key) + sizeof(Tp), &new_node->pair) ||
-      !new_node->pair.copy_from(&k, sizeof(Key)) ||
-      !new_node->pair.copy_from(&v, sizeof(Tp1), sizeof(Key))) {
+  new_node->pair.set_key_hash(key_hash); // kept by alloc_to()
+  if (!pool_->alloc_to(kValueOffset + value_size(v), &new_node->pair) ||
+      !store_value(new_node->pair, v, /* fresh = */ true, &k)) {
     delete new_node;
     return nullptr;
   }
@@ -205,6 +279,85 @@ SyncHashMap<NBuckets, Key, Tp, Hash, Pred, Alloc, Lock>::create_node(
   return new_node;
 }
 
+/** Value (de)serialization */
+template <size_t NBuckets, typename Key, typename Tp, typename Hash,
+          typename Pred, typename Alloc, typename Lock>
+template <typename Tp1>
+inline size_t
+SyncHashMap<NBuckets, Key, Tp, Hash, Pred, Alloc, Lock>::value_size(
+    const Tp1 &v) {
+  if constexpr (kFixedValue) {
+    assert(sizeof(v) <= sizeof(Tp));
+    return sizeof(Tp);
+  } else {
+    const Tp &tv = v;
+    return Codec<Tp>::size(tv);
+  }
+}
+
+template <size_t NBuckets, typename Key, typename Tp, typename Hash,
+          typename Pred, typename Alloc, typename Lock>
+inline bool SyncHashMap<NBuckets, Key, Tp, Hash, Pred, Alloc, Lock>::load_value(
+    ObjectPtr &pair, Tp &v) {
+  if constexpr (kFixedValue) {
+    return pair.copy_to(&v, sizeof(Tp), kValueOffset);
+  } else {
+    size_t vn = 0;
+    if (!pair.copy_to(&vn, sizeof(size_t), sizeof(Key)))
+      return false;
+    PinnedView view(pair, vn, kValueOffset);
+    if (!view && vn)
+      return false;
+    return Codec<Tp>::decode(v, view.data(), vn);
+  }
+}
+
+template <size_t NBuckets, typename Key, typename Tp, typename Hash,
+          typename Pred, typename Alloc, typename Lock>
+template <typename Tp1>
+inline bool
+SyncHashMap<NBuckets, Key, Tp, Hash, Pred, Alloc, Lock>::store_value(
+    ObjectPtr &pair, const Tp1 &v, bool fresh, const void *k) {
+  // the key (if any) goes along with the value under a single lock
+  ObjectIOVec iov[3];
+  int nr_iov = 0;
+  if (k)
+    iov[nr_iov++] = {const_cast<void *>(k), sizeof(Key), 0};
+  if constexpr (kFixedValue) {
+    iov[nr_iov++] = {const_cast<Tp1 *>(&v), sizeof(Tp1), kValueOffset};
+    return pair.copy_from_iov(iov, nr_iov);
+  } else {
+    const Tp &tv = v;
+    size_t vn = Codec<Tp>::size(tv);
+    // in place only if it fits in the object, which may be larger than the
+    // value stored last
+    if (!fresh && vn > codec_utils::capacity(pair, kValueOffset))
+      return false;
+    // encode first, so that the length and the value go out in one copy
+    auto src = codec_utils::flatten(tv, vn);
+    if (!src)
+      return false;
+    iov[nr_iov++] = {&vn, sizeof(size_t), sizeof(Key)};
+    iov[nr_iov++] = {const_cast<void *>(src), vn, kValueOffset};
+    return pair.copy_from_iov(iov, nr_iov);
+  }
+}
+
+template <size_t NBuckets, typename Key, typename Tp, typename Hash,
+          typename Pred, typename Alloc, typename Lock>
+inline PinnedView
+SyncHashMap<NBuckets, Key, Tp, Hash, Pred, Alloc, Lock>::view_value(
+    ObjectPtr &pair) {
+  if constexpr (kFixedValue) {
+    return PinnedView(pair, sizeof(Tp), kValueOffset);
+  } else {
+    size_t vn = 0;
+    if (!pair.copy_to(&vn, sizeof(size_t), sizeof(Key)))
+      return PinnedView();
+    return PinnedView(pair, vn, kValueOffset);
+  }
+}
+
 /** remove bucket_node from the list */
 // should always use as `node = delete_node()` when iterating the list
 template <size_t NBuckets, typename Key, typename Tp, typename Hash,
@@ -241,7 +394,8 @@ SyncHashMap<NBuckets, Key, Tp, Hash, Pred, Alloc, Lock>::iterate_list(
   }
   std::byte k_buf[sizeof(Key)];
   auto tmp_k = std::launder(reinterpret_cast<Key *>(&k_buf));
-  if (node->pair.null() || !node->pair.copy_to(tmp_k, sizeof(Key))) {
+  if ((node->pair.null() && !pool_->restore_evicted(&node->pair)) ||
+      !node->pair.copy_to(tmp_k, sizeof(Key))) {
     if (node->pair.is_victim())
       pool_->inc_cache_victim_hit(&node->pair);
     // prev remains the same when current node is deleted.
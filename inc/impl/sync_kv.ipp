@@ -3,18 +3,21 @@
 namespace midas {
 
 template <size_t NBuckets, typename Alloc, typename Lock>
-SyncKV<NBuckets, Alloc, Lock>::SyncKV() {
+SyncKV<NBuckets, Alloc, Lock>::SyncKV()
+    : wheel_(kExpiryTickMs * 1000, Time::get_us()) {
   pool_ = CachePool::global_cache_pool();
   memset(buckets_, 0, sizeof(buckets_));
 }
 
 template <size_t NBuckets, typename Alloc, typename Lock>
-SyncKV<NBuckets, Alloc, Lock>::SyncKV(CachePool *pool) : pool_(pool) {
+SyncKV<NBuckets, Alloc, Lock>::SyncKV(CachePool *pool)
+    : pool_(pool), wheel_(kExpiryTickMs * 1000, Time::get_us()) {
   memset(buckets_, 0, sizeof(buckets_));
 }
 
 template <size_t NBuckets, typename Alloc, typename Lock>
 SyncKV<NBuckets, Alloc, Lock>::~SyncKV() {
+  stop_expiry();
   clear();
 }
 
@@ -101,6 +104,82 @@ bool SyncKV<NBuckets, Alloc, Lock>::remove(const void *k, size_t kn) {
   return true;
 }
 
+template <size_t NBuckets, typename Alloc, typename Lock>
+bool SyncKV<NBuckets, Alloc, Lock>::set_cost(const void *k, size_t kn,
+                                             uint64_t cycles) {
+  auto key_hash = hash_(k, kn);
+  auto bucket_idx = key_hash % NBuckets;
+
+  auto ul = std::unique_lock(locks_[bucket_idx]);
+
+  auto prev_next = &buckets_[bucket_idx];
+  BNPtr node = buckets_[bucket_idx];
+  while (node) {
+    if (iterate_list(key_hash, k, kn, nullptr, prev_next, node)) {
+      pool_->set_obj_cost(node->pair.key_id(), cycles);
+      return true;
+    }
+  }
+  return false;
+}
+
+template <size_t NBuckets, typename Alloc, typename Lock>
+template <typename K>
+bool SyncKV<NBuckets, Alloc, Lock>::set_cost(const K &k, uint64_t cycles) {
+  return set_cost(&k, sizeof(K), cycles);
+}
+
+template <size_t NBuckets, typename Alloc, typename Lock>
+bool SyncKV<NBuckets, Alloc, Lock>::expire(const void *k, size_t kn,
+                                           uint64_t ttl_ms) {
+  auto key_hash = hash_(k, kn);
+  auto bucket_idx = key_hash % NBuckets;
+
+  auto ul = std::unique_lock(locks_[bucket_idx]);
+
+  auto prev_next = &buckets_[bucket_idx];
+  BNPtr node = buckets_[bucket_idx];
+  while (node) {
+    if (iterate_list(key_hash, k, kn, nullptr, prev_next, node)) {
+      set_expiry(node, ttl_ms);
+      return true;
+    }
+  }
+  return false;
+}
+
+template <size_t NBuckets, typename Alloc, typename Lock>
+template <typename K>
+bool SyncKV<NBuckets, Alloc, Lock>::expire(const K &k, uint64_t ttl_ms) {
+  return expire(&k, sizeof(K), ttl_ms);
+}
+
+template <size_t NBuckets, typename Alloc, typename Lock>
+int64_t SyncKV<NBuckets, Alloc, Lock>::ttl(const void *k, size_t kn) {
+  auto key_hash = hash_(k, kn);
+  auto bucket_idx = key_hash % NBuckets;
+
+  auto ul = std::unique_lock(locks_[bucket_idx]);
+
+  auto prev_next = &buckets_[bucket_idx];
+  BNPtr node = buckets_[bucket_idx];
+  while (node) {
+    if (iterate_list(key_hash, k, kn, nullptr, prev_next, node)) {
+      if (!node->expire_at)
+        return -1;
+      auto now = Time::get_us();
+      return now < node->expire_at ? (node->expire_at - now + 999) / 1000 : 0;
+    }
+  }
+  return -2;
+}
+
+template <size_t NBuckets, typename Alloc, typename Lock>
+template <typename K>
+int64_t SyncKV<NBuckets, Alloc, Lock>::ttl(const K &k) {
+  return ttl(&k, sizeof(K));
+}
+
 template <size_t NBuckets, typename Alloc, typename Lock>
 bool SyncKV<NBuckets, Alloc, Lock>::remove(const kv_types::Key &k) {
   return remove(k.data, k.size);
@@ -139,7 +218,10 @@ bool SyncKV<NBuckets, Alloc, Lock>::inc(const void *k, size_t kn, V offset,
       !node->pair.copy_to(value, sizeof(V), layout::v_offset(kn)))
     return false;
   *value = *value + offset;
-  if (!node->pair.copy_from(value, sizeof(V), layout::v_offset(kn)))
+  if (PinnedView::viewed(node->pair)) { // leave the old value to its views
+    if (!refill_node(node, k, kn, value, sizeof(V)))
+      return false;
+  } else if (!node->pair.copy_from(value, sizeof(V), layout::v_offset(kn)))
     return false;
   ul.unlock();
   LogAllocator::count_access();
@@ -162,6 +244,8 @@ int SyncKV<NBuckets, Alloc, Lock>::add(const void *k, size_t kn, const void *v,
     if (found)
       return kv_types::RetCode::Duplicated;
   }
+  if (!pool_->admit(key_hash)) // rejected, as if evicted right away
+    return kv_types::RetCode::Succ;
   auto new_node = create_node(key_hash, k, kn, v, vn);
   if (!new_node)
     return kv_types::RetCode::Failed;
@@ -173,7 +257,7 @@ int SyncKV<NBuckets, Alloc, Lock>::add(const void *k, size_t kn, const void *v,
 
 template <size_t NBuckets, typename Alloc, typename Lock>
 bool SyncKV<NBuckets, Alloc, Lock>::set(const void *k, size_t kn, const void *v,
-                                        size_t vn) {
+                                        size_t vn, uint64_t ttl_ms) {
   auto key_hash = hash_(k, kn);
   auto bucket_idx = key_hash % NBuckets;
 
@@ -185,9 +269,17 @@ bool SyncKV<NBuckets, Alloc, Lock>::set(const void *k, size_t kn, const void *v,
   while (node) {
     auto found = iterate_list(key_hash, k, kn, &stored_vn, prev_next, node);
     if (found) {
-      if (vn <= stored_vn && !node->pair.null() && // try to set in place if fit
-          node->pair.copy_from(&vn, sizeof(size_t), layout::vlen_offset()) &&
-          node->pair.copy_from(v, vn, layout::v_offset(kn))) {
+      ObjectIOVec iov[] = {
+          {&vn, sizeof(size_t), static_cast<int64_t>(layout::vlen_offset())},
+          {const_cast<void *>(v), vn,
+           static_cast<int64_t>(layout::v_offset(kn))}};
+      // try to set in place if fit and no view is reading the old value
+      if (!node->pair.null() &&
+          vn <= codec_utils::capacity(node->pair, layout::v_offset(kn)) &&
+          !PinnedView::viewed(node->pair) &&
+          node->pair.copy_from_iov(iov, 2)) {
+        set_expiry(node, ttl_ms);
+        pool_->record_access(key_hash);
         LogAllocator::count_access();
         return true;
       } else {
@@ -197,10 +289,13 @@ bool SyncKV<NBuckets, Alloc, Lock>::set(const void *k, size_t kn, const void *v,
     }
   }
 
+  if (!pool_->admit(key_hash)) // rejected, as if evicted right away
+    return true;
   auto new_node = create_node(key_hash, k, kn, v, vn);
   if (!new_node)
     return false;
   *prev_next = new_node;
+  set_expiry(new_node, ttl_ms);
   ul.unlock();
   LogAllocator::count_access();
   return true;
@@ -208,20 +303,128 @@ bool SyncKV<NBuckets, Alloc, Lock>::set(const void *k, size_t kn, const void *v,
 
 template <size_t NBuckets, typename Alloc, typename Lock>
 bool SyncKV<NBuckets, Alloc, Lock>::set(const kv_types::Key &k,
-                                        const kv_types::CValue &v) {
-  return set(k.data, k.size, v.data, v.size);
+                                        const kv_types::CValue &v,
+                                        uint64_t ttl_ms) {
+  return set(k.data, k.size, v.data, v.size, ttl_ms);
 }
 
 template <size_t NBuckets, typename Alloc, typename Lock>
 template <typename K>
-bool SyncKV<NBuckets, Alloc, Lock>::set(const K &k, const kv_types::CValue &v) {
-  return set(&k, sizeof(K), v.data, v.size);
+bool SyncKV<NBuckets, Alloc, Lock>::set(const K &k, const kv_types::CValue &v,
+                                        uint64_t ttl_ms) {
+  return set(&k, sizeof(K), v.data, v.size, ttl_ms);
+}
+
+template <size_t NBuckets, typename Alloc, typename Lock>
+template <typename K, typename V>
+bool SyncKV<NBuckets, Alloc, Lock>::set(const K &k, const V &v,
+                                        uint64_t ttl_ms) {
+  return set(&k, sizeof(K), &v, sizeof(V), ttl_ms);
 }
 
+/** Typed Interfaces */
 template <size_t NBuckets, typename Alloc, typename Lock>
 template <typename K, typename V>
-bool SyncKV<NBuckets, Alloc, Lock>::set(const K &k, const V &v) {
-  return set(&k, sizeof(K), &v, sizeof(V));
+bool SyncKV<NBuckets, Alloc, Lock>::get_as(const K &key, V &v) {
+  size_t kn = 0;
+  auto k = codec_utils::flatten(key, kn);
+  if (!k)
+    return false;
+  auto key_hash = hash_(k, kn);
+  auto bucket_idx = key_hash % NBuckets;
+
+  auto ul = std::unique_lock(locks_[bucket_idx]);
+
+  size_t stored_vn = 0;
+  auto prev_next = &buckets_[bucket_idx];
+  BNPtr node = buckets_[bucket_idx];
+  bool found = false;
+  while (node) {
+    found = iterate_list(key_hash, k, kn, &stored_vn, prev_next, node);
+    if (found)
+      break;
+  }
+  if (!found) {
+    ul.unlock();
+    pool_->inc_cache_miss();
+    return false;
+  }
+  assert(node);
+  PinnedView view(node->pair, stored_vn, layout::v_offset(kn));
+  if (!view && stored_vn) {
+    if (node->pair.is_victim())
+      pool_->inc_cache_victim_hit(&node->pair);
+    node = delete_node(prev_next, node);
+    ul.unlock();
+    pool_->inc_cache_miss();
+    return false;
+  }
+  // decode under the bucket lock so that in-place updates cannot tear it
+  bool decoded = Codec<V>::decode(v, view.data(), stored_vn);
+  ul.unlock();
+  pool_->inc_cache_hit(node->pair.key_id());
+  pool_->record_access(key_hash);
+  LogAllocator::count_access();
+  return decoded;
+}
+
+template <size_t NBuckets, typename Alloc, typename Lock>
+template <typename K, typename V>
+bool SyncKV<NBuckets, Alloc, Lock>::set_as(const K &key, const V &v) {
+  size_t kn = 0;
+  auto k = codec_utils::flatten(key, kn);
+  if (!k)
+    return false;
+  // encode before taking the lock, so that the value is copied only once
+  size_t vn = Codec<V>::size(v);
+  auto src = Codec<V>::contiguous(v);
+  if (!src) {
+    static thread_local std::vector<char> scratch;
+    scratch.resize(vn);
+    if (!Codec<V>::encode(v, scratch.data(), vn))
+      return false;
+    src = scratch.data();
+  }
+  auto key_hash = hash_(k, kn);
+  auto bucket_idx = key_hash % NBuckets;
+
+  auto ul = std::unique_lock(locks_[bucket_idx]);
+
+  size_t stored_vn = 0;
+  auto prev_next = &buckets_[bucket_idx];
+  auto node = buckets_[bucket_idx];
+  while (node) {
+    auto found = iterate_list(key_hash, k, kn, &stored_vn, prev_next, node);
+    if (found) {
+      ObjectIOVec iov[] = {
+          {&vn, sizeof(size_t), static_cast<int64_t>(layout::vlen_offset())},
+          {const_cast<void *>(src), vn,
+           static_cast<int64_t>(layout::v_offset(kn))}};
+      // try to set in place if fit and no view is reading the old value
+      if (!node->pair.null() &&
+          vn <= codec_utils::capacity(node->pair, layout::v_offset(kn)) &&
+          !PinnedView::viewed(node->pair) &&
+          node->pair.copy_from_iov(iov, 2)) {
+        set_expiry(node, 0);
+        pool_->record_access(key_hash);
+        LogAllocator::count_access();
+        return true;
+      } else {
+        node = delete_node(prev_next, node);
+        break;
+      }
+    }
+  }
+
+  if (!pool_->admit(key_hash)) // rejected, as if evicted right away
+    return true;
+  auto new_node = create_node(key_hash, k, kn, src, vn);
+  if (!new_node)
+    return false;
+  *prev_next = new_node;
+  ul.unlock();
+  LogAllocator::count_access();
+  return true;
 }
 
 template <size_t NBuckets, typename Alloc, typename Lock>
@@ -238,6 +441,129 @@ bool SyncKV<NBuckets, Alloc, Lock>::clear() {
   return true;
 }
 
+/** Warm Restart */
+template <size_t NBuckets, typename Alloc, typename Lock>
+int64_t SyncKV<NBuckets, Alloc, Lock>::dump(const std::string &path) {
+  SnapshotWriter writer(path);
+  if (!writer.ready())
+    return -1;
+  // pairs are copied out under the bucket lock and written after it, as
+  // writing may flush a whole block to the file
+  struct Entry {
+    size_t kn;
+    size_t vn;
+    uint64_t deadline_ms;
+    uint32_t hotness;
+  };
+  std::vector<Entry> entries;
+  std::vector<char> buf;
+  for (size_t idx = 0; idx < NBuckets; idx++) {
+    entries.clear();
+    buf.clear();
+    auto ul = std::unique_lock(locks_[idx]);
+    auto now_us = Time::get_us();
+    for (auto node = buckets_[idx]; node; node = node->next) {
+      size_t kn = 0;
+      size_t vn = 0;
+      ObjectIOVec lens[] = {
+          {&kn, sizeof(size_t), static_cast<int64_t>(layout::klen_offset())},
+          {&vn, sizeof(size_t), static_cast<int64_t>(layout::vlen_offset())}};
+      MetaObjectHdr hdr;
+      // evicted pairs are left out rather than faulted back in
+      if (expired(node, now_us) || node->pair.null() ||
+          !node->pair.copy_to_iov(lens, 2) || !load_hdr(hdr, node->pair))
+        continue;
+      auto pos = buf.size();
+      buf.resize(pos + kn + vn);
+      if (!node->pair.copy_to(buf.data() + pos, kn + vn, layout::k_offset())) {
+        buf.resize(pos);
+        continue;
+      }
+      uint64_t deadline_ms = 0;
+      if (node->expire_at)
+        deadline_ms = snapshot::now_ms() + (node->expire_at - now_us) / 1000;
+      entries.push_back(Entry{kn, vn, deadline_ms, hdr.get_accessed()});
+    }
+    ul.unlock();
+    size_t pos = 0;
+    for (const auto &entry : entries) {
+      auto key = buf.data() + pos;
+      snapshot::Record record{key, entry.kn, key + entry.kn, entry.vn,
+                              entry.deadline_ms};
+      if (!writer.add(record, entry.hotness))
+        return -1;
+      pos += entry.kn + entry.vn;
+    }
+  }
+  if (!writer.finish())
+    return -1;
+  return writer.nr_records();
+}
+
+template <size_t NBuckets, typename Alloc, typename Lock>
+int64_t SyncKV<NBuckets, Alloc, Lock>::load(const std::string &path,
+                                            int nr_threads) {
+  SnapshotReader reader(path);
+  if (!reader.ready())
+    return -1;
+  // what fits in the pool's limit, so that loading does not evict
+  auto rmanager = pool_->get_rmanager();
+  std::atomic_int64_t budget{
+      static_cast<int64_t>(rmanager->NumRegionLimit() -
+                           rmanager->NumRegionInUse()) *
+      kRegionSize};
+  std::atomic_size_t next_block{0};
+  std::atomic_int64_t nr_loaded{0};
+  std::atomic_bool full{false};
+  // each thread allocates from its own segment, so threads rarely contend
+  auto loader = [&] {
+    std::vector<char> buf;
+    snapshot::Record record;
+    std::vector<kv_types::Key> keys;
+    std::vector<kv_types::CValue> values;
+    std::vector<uint64_t> ttls_ms;
+    while (!full) {
+      auto idx = next_block.fetch_add(1);
+      if (idx >= reader.nr_blocks())
+        break;
+      if (!reader.read_block(idx, buf))
+        continue;
+      keys.clear();
+      values.clear();
+      ttls_ms.clear();
+      auto now_ms = snapshot::now_ms();
+      size_t offset = 0;
+      while (SnapshotReader::next_record(buf, offset, &record)) {
+        if (record.deadline_ms && record.deadline_ms <= now_ms)
+          continue;
+        // as allocated, headers included
+        auto size = ObjectPtr::obj_size(layout::v_offset(record.klen) +
+                                        record.vlen);
+        if (budget.fetch_sub(size) <= 0) {
+          full = true;
+          break;
+        }
+        keys.emplace_back(record.key, record.klen);
+        values.emplace_back(record.value, record.vlen);
+        ttls_ms.emplace_back(record.deadline_ms ? record.deadline_ms - now_ms
+                                                : 0);
+      }
+      nr_loaded += bload(keys, values, ttls_ms);
+    }
+  };
+  // each thread fills a segment of its own; leave the GC room to work in
+  nr_threads = std::max<int64_t>(
+      1, std::min<int64_t>(nr_threads, rmanager->NumRegionAvail() / 2));
+  std::vector<std::thread> thds;
+  for (int i = 0; i < nr_threads; i++)
+    thds.emplace_back(loader);
+  for (auto &thd : thds)
+    thd.join();
+  MIDAS_LOG(kInfo) << "Loaded " << nr_loaded << " pairs from " << path
+                   << (full ? ", stopped at the pool's limit" : "");
+  return nr_loaded;
+}
+
 /** Ordered Set */
 /** Value Format:
  *    | NumEle (8B) | Len<V1> (8B) | Score<V1> (8B) | V1 (Len<V1>) | ...
@@ -521,6 +847,78 @@ int SyncKV<NBuckets, Alloc, Lock>::bset(const std::vector<K> &keys,
   return succ;
 }
 
+template <size_t NBuckets, typename Alloc, typename Lock>
+int SyncKV<NBuckets, Alloc, Lock>::bload(
+    const std::vector<kv_types::Key> &keys,
+    const std::vector<kv_types::CValue> &values,
+    const std::vector<uint64_t> &ttls_ms) {
+  assert(keys.size() == values.size());
+  assert(ttls_ms.empty() || ttls_ms.size() == keys.size());
+  auto nr_pairs = keys.size();
+  // objects are packed back to back into this thread's segment
+  std::vector<BNPtr> nodes;
+  nodes.reserve(nr_pairs);
+  for (size_t i = 0; i < nr_pairs; i++) {
+    const auto &k = keys[i];
+    auto node = create_node(hash_(k.data, k.size), k.data, k.size,
+                            values[i].data, values[i].size);
+    if (!node)
+      break;
+    nodes.emplace_back(node);
+  }
+
+  int succ = 0;
+  auto nr_nodes = nodes.size();
+  for (size_t i = 0; i < nr_nodes; i++) {
+    if (i + kLoadPrefetchDist < nr_nodes) {
+      auto next_idx = nodes[i + kLoadPrefetchDist]->key_hash % NBuckets;
+      __builtin_prefetch(&locks_[next_idx]);
+      __builtin_prefetch(&buckets_[next_idx]);
+    }
+    auto new_node = nodes[i];
+    const auto &k = keys[i];
+    auto bucket_idx = new_node->key_hash % NBuckets;
+
+    auto ul = std::unique_lock(locks_[bucket_idx]);
+
+    auto prev_next = &buckets_[bucket_idx];
+    auto node = buckets_[bucket_idx];
+    bool found = false;
+    while (node && !found)
+      found = iterate_list(new_node->key_hash, k.data, k.size, nullptr,
+                           prev_next, node);
+    if (found) { // keep the existing pair
+      ul.unlock();
+      pool_->free(new_node->pair);
+      delete new_node;
+      continue;
+    }
+    *prev_next = new_node;
+    if (!ttls_ms.empty())
+      set_expiry(new_node, ttls_ms[i]);
+    ul.unlock();
+    LogAllocator::count_access();
+    succ++;
+  }
+  return succ;
+}
+
+template <size_t NBuckets, typename Alloc, typename Lock>
+template <typename K, typename V>
+int SyncKV<NBuckets, Alloc, Lock>::bload(const std::vector<K> &keys,
+                                         const std::vector<V> &values) {
+  assert(keys.size() == values.size());
+  std::vector<kv_types::Key> raw_keys;
+  std::vector<kv_types::CValue> raw_values;
+  raw_keys.reserve(keys.size());
+  raw_values.reserve(values.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    raw_keys.emplace_back(&keys[i], sizeof(K));
+    raw_values.emplace_back(&values[i], sizeof(V));
+  }
+  return bload(raw_keys, raw_values);
+}
+
 template <size_t NBuckets, typename Alloc, typename Lock>
 int SyncKV<NBuckets, Alloc, Lock>::bremove(
     const std::vector<kv_types::Key> &keys) {
@@ -652,7 +1050,8 @@ void *SyncKV<NBuckets, Alloc, Lock>::get_(const void *k, size_t kn, void *v,
     plug->hits++;
     plug->batch_size++;
   } else
-    pool_->inc_cache_hit();
+    pool_->inc_cache_hit(node->pair.key_id());
+  pool_->record_access(key_hash);
   LogAllocator::count_access();
   return stored_v;
 
@@ -681,6 +1080,8 @@ failed:
     set(k, kn, stored_v, stored_vn);
     pool_->construct_add(stored_vn, plug);
     pool_->construct_end(plug);
+    if (pool_->obj_costs_enabled())
+      set_cost(k, kn, plug.end_cycles - plug.stt_cycles);
     if (vn)
       *vn = stored_vn;
     return stored_v;
@@ -689,7 +1090,48 @@ failed:
 }
 
 template <size_t NBuckets, typename Alloc, typename Lock>
-using BNPtr = typename SyncKV<NBuckets, Alloc, Lock>::BucketNode *;
+PinnedView SyncKV<NBuckets, Alloc, Lock>::get_view(const void *k, size_t kn) {
+  auto key_hash = hash_(k, kn);
+  auto bucket_idx = key_hash % NBuckets;
+
+  auto ul = std::unique_lock(locks_[bucket_idx]);
+
+  size_t stored_vn = 0;
+  auto prev_next = &buckets_[bucket_idx];
+  BNPtr node = buckets_[bucket_idx];
+  bool found = false;
+  while (node) {
+    found = iterate_list(key_hash, k, kn, &stored_vn, prev_next, node);
+    if (found)
+      break;
+  }
+  if (!found) {
+    ul.unlock();
+    pool_->inc_cache_miss();
+    return PinnedView();
+  }
+  assert(node);
+  PinnedView view(node->pair, stored_vn, layout::v_offset(kn));
+  if (!view) {
+    if (node->pair.is_victim())
+      pool_->inc_cache_victim_hit(&node->pair);
+    node = delete_node(prev_next, node);
+    ul.unlock();
+    pool_->inc_cache_miss();
+    return view;
+  }
+  ul.unlock();
+  pool_->inc_cache_hit(node->pair.key_id());
+  pool_->record_access(key_hash);
+  LogAllocator::count_access();
+  return view;
+}
+
+template <size_t NBuckets, typename Alloc, typename Lock>
+template <typename K>
+PinnedView SyncKV<NBuckets, Alloc, Lock>::get_view(const K &k) {
+  return get_view(&k, sizeof(K));
+}
 
 template <size_t NBuckets, typename Alloc, typename Lock>
 inline uint64_t SyncKV<NBuckets, Alloc, Lock>::hash_(const void *k, size_t kn) {
@@ -699,14 +1141,18 @@ inline uint64_t SyncKV<NBuckets, Alloc, Lock>::hash_(const void *k, size_t kn) {
 }
 
 template <size_t NBuckets, typename Alloc, typename Lock>
-inline BNPtr<NBuckets, Alloc, Lock> SyncKV<NBuckets, Alloc, Lock>::create_node(
+inline typename SyncKV<NBuckets, Alloc, Lock>::BNPtr
+SyncKV<NBuckets, Alloc, Lock>::create_node(
     uint64_t key_hash, const void *k, size_t kn, const void *v, size_t vn) {
+  size_t lens[] = {kn, vn}; // adjacent, so written with one copy
+  ObjectIOVec iov[] = {
+      {lens, sizeof(lens), static_cast<int64_t>(layout::klen_offset())},
+      {const_cast<void *>(k), kn, static_cast<int64_t>(layout::k_offset())},
+      {const_cast<void *>(v), vn, static_cast<int64_t>(layout::v_offset(kn))}};
   auto *new_node = new BucketNode();
+  new_node->pair.set_key_hash(key_hash); // kept by alloc_to()
   if (!pool_->alloc_to(sizeof(size_t) * 2 + kn + vn, &new_node->pair) ||
-      !new_node->pair.copy_from(&kn, sizeof(size_t), layout::klen_offset()) ||
-      !new_node->pair.copy_from(&vn, sizeof(size_t), layout::vlen_offset()) ||
-      !new_node->pair.copy_from(k, kn, layout::k_offset()) ||
-      !new_node->pair.copy_from(v, vn, layout::v_offset(kn))) {
+      !new_node->pair.copy_from_iov(iov, 3)) {
     delete new_node;
     return nullptr;
   }
@@ -718,19 +1164,44 @@ inline BNPtr<NBuckets, Alloc, Lock> SyncKV<NBuckets, Alloc, Lock>::create_node(
   }
   new_node->key_hash = key_hash;
   new_node->next = nullptr;
+  new_node->expire_at = 0;
   return new_node;
 }
 
+/* Moves the node to a new object holding @v, leaving the old one intact
+ * until it is reclaimed. */
+template <size_t NBuckets, typename Alloc, typename Lock>
+bool SyncKV<NBuckets, Alloc, Lock>::refill_node(BNPtr node, const void *k,
+                                                size_t kn, const void *v,
+                                                size_t vn) {
+  if (node->expire_at)
+    pool_->set_obj_expiry(&node->pair, 0);
+  pool_->free(node->pair);
+  size_t lens[] = {kn, vn};
+  ObjectIOVec iov[] = {
+      {lens, sizeof(lens), static_cast<int64_t>(layout::klen_offset())},
+      {const_cast<void *>(k), kn, static_cast<int64_t>(layout::k_offset())},
+      {const_cast<void *>(v), vn, static_cast<int64_t>(layout::v_offset(kn))}};
+  if (!pool_->alloc_to(sizeof(size_t) * 2 + kn + vn, &node->pair) ||
+      !node->pair.copy_from_iov(iov, 3))
+    return false; // reads as evicted
+  if (node->expire_at)
+    pool_->set_obj_expiry(&node->pair, node->expire_at);
+  return true;
+}
+
 /** remove bucket_node from the list */
 // should always use as `node = delete_node()` when iterating the list
 template <size_t NBuckets, typename Alloc, typename Lock>
-inline BNPtr<NBuckets, Alloc, Lock>
+inline typename SyncKV<NBuckets, Alloc, Lock>::BNPtr
 SyncKV<NBuckets, Alloc, Lock>::delete_node(BNPtr *prev_next, BNPtr node) {
   assert(*prev_next == node);
   if (!node)
     return nullptr;
   auto next = node->next;
 
+  if (node->expire_at) // the slot's next object has no deadline of its own
+    pool_->set_obj_expiry(&node->pair, 0);
   pool_->free(node->pair);
   delete node;
 
@@ -738,6 +1209,91 @@ SyncKV<NBuckets, Alloc, Lock>::delete_node(BNPtr *prev_next, BNPtr node) {
   return next;
 }
 
+/** Expiration */
+template <size_t NBuckets, typename Alloc, typename Lock>
+inline bool SyncKV<NBuckets, Alloc, Lock>::expired(BNPtr node,
+                                                   uint64_t now_us) {
+  return node->expire_at && node->expire_at <= now_us;
+}
+
+/* Must be called with the node's bucket locked. Extending a TTL schedules
+ * nothing: the pending timer reschedules itself when it fires. */
+template <size_t NBuckets, typename Alloc, typename Lock>
+void SyncKV<NBuckets, Alloc, Lock>::set_expiry(BNPtr node, uint64_t ttl_ms) {
+  uint64_t expire_at = ttl_ms ? Time::get_us() + ttl_ms * 1000 : 0;
+  auto prev = node->expire_at;
+  if (!expire_at && !prev)
+    return;
+  node->expire_at = expire_at;
+  pool_->set_obj_expiry(&node->pair, expire_at);
+  if (expire_at && (!prev || expire_at < prev))
+    schedule_expiry(ExpiryTimer{node->key_hash, node, expire_at});
+}
+
+template <size_t NBuckets, typename Alloc, typename Lock>
+void SyncKV<NBuckets, Alloc, Lock>::schedule_expiry(
+    const ExpiryTimer &timer) {
+  std::unique_lock<std::mutex> ul(expiry_mtx_);
+  wheel_.add(timer.expire_at, timer);
+  if (!expiry_thd_ && !expiry_terminated_)
+    expiry_thd_ = std::make_shared<std::thread>([this] { expiry_loop(); });
+}
+
+/* The node may be gone, or even reallocated for another key, by now. */
+template <size_t NBuckets, typename Alloc, typename Lock>
+void SyncKV<NBuckets, Alloc, Lock>::expire_node(const ExpiryTimer &timer,
+                                                uint64_t now_us) {
+  auto bucket_idx = timer.key_hash % NBuckets;
+
+  auto ul = std::unique_lock(locks_[bucket_idx]);
+
+  auto prev_next = &buckets_[bucket_idx];
+  auto node = buckets_[bucket_idx];
+  while (node && node != timer.node) {
+    prev_next = &(node->next);
+    node = node->next;
+  }
+  if (!node || node->key_hash != timer.key_hash || !node->expire_at)
+    return;
+  if (expired(node, now_us))
+    delete_node(prev_next, node);
+  else if (node->expire_at > timer.expire_at) // extended since
+    schedule_expiry(ExpiryTimer{node->key_hash, node, node->expire_at});
+}
+
+template <size_t NBuckets, typename Alloc, typename Lock>
+void SyncKV<NBuckets, Alloc, Lock>::expiry_loop() {
+  std::vector<ExpiryTimer> due;
+  std::unique_lock<std::mutex> ul(expiry_mtx_);
+  while (!expiry_terminated_) {
+    expiry_cv_.wait_for(ul, std::chrono::milliseconds(kExpiryTickMs));
+    if (expiry_terminated_)
+      break;
+    auto now = Time::get_us();
+    wheel_.advance(now, due);
+    if (due.empty())
+      continue;
+    ul.unlock(); // bucket locks are taken before the wheel's
+    for (const auto &timer : due)
+      expire_node(timer, now);
+    due.clear();
+    ul.lock();
+  }
+}
+
+template <size_t NBuckets, typename Alloc, typename Lock>
+void SyncKV<NBuckets, Alloc, Lock>::stop_expiry() {
+  {
+    std::unique_lock<std::mutex> ul(expiry_mtx_);
+    expiry_terminated_ = true;
+  }
+  expiry_cv_.notify_all();
+  if (expiry_thd_) {
+    expiry_thd_->join();
+    expiry_thd_.reset();
+  }
+}
+
 /** return: <equal, valid> */
 template <size_t NBuckets, typename Alloc, typename Lock>
 inline bool
@@ -745,37 +1301,38 @@ SyncKV<NBuckets, Alloc, Lock>::iterate_list(uint64_t key_hash, const void *k,
                                             size_t kn, size_t *vn,
                                             BNPtr *&prev_next, BNPtr &node) {
   size_t stored_kn = 0;
-  void *stored_k = nullptr;
+  size_t stored_vn = 0;
+  int cmp = 0;
+  ObjectIOVec lens[] = {
+      {&stored_kn, sizeof(size_t), static_cast<int64_t>(layout::klen_offset())},
+      {&stored_vn, sizeof(size_t), static_cast<int64_t>(layout::vlen_offset())}};
   if (key_hash != node->key_hash)
     goto notequal;
-  if (node->pair.null() ||
-      !node->pair.copy_to(&stored_kn, sizeof(size_t), layout::klen_offset()))
+  if (expired(node, Time::get_us()))
+    goto dead;
+  if (node->pair.null() && !pool_->restore_evicted(&node->pair))
+    goto faulted;
+  if (!node->pair.copy_to_iov(lens, 2))
     goto faulted;
   if (stored_kn != kn)
     goto notequal;
-  stored_k = malloc(kn);
-  if (!node->pair.copy_to(stored_k, kn, layout::k_offset()))
+  // compare in place rather than copying the stored key out
+  if (!node->pair.compare(k, kn, layout::k_offset(), &cmp))
     goto faulted;
-  if (strncmp(reinterpret_cast<const char *>(k),
-              reinterpret_cast<const char *>(stored_k), kn) != 0)
+  if (cmp != 0)
     goto notequal;
-  if (vn && !node->pair.copy_to(vn, sizeof(size_t), layout::vlen_offset()))
-    goto faulted;
-  if (stored_k)
-    free(stored_k);
+  if (vn)
+    *vn = stored_vn;
   return true;
 
 faulted:
-  if (stored_k)
-    free(stored_k);
   if (node->pair.is_victim())
     pool_->inc_cache_victim_hit(&node->pair);
+dead:
   // prev remains the same when current node is deleted.
   node = delete_node(prev_next, node);
   return false;
 notequal:
-  if (stored_k)
-    free(stored_k);
   prev_next = &(node->next);
   node = node->next;
   return false;
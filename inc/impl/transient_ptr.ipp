@@ -99,8 +99,8 @@ inline bool TransientPtr::copy_from(const TransientPtr &src, size_t len,
     return false;
   }
 #endif // BOUND_CHECK
-  bool ret = rmemcpy(reinterpret_cast<void *>(this->ptr_ + to_offset),
-                     reinterpret_cast<void *>(src.ptr_ + from_offset), len);
+  bool ret = rmemcpy_nt(reinterpret_cast<void *>(this->ptr_ + to_offset),
+                        reinterpret_cast<void *>(src.ptr_ + from_offset), len);
   return ret;
 }
 
@@ -114,8 +114,9 @@ inline bool TransientPtr::copy_to(TransientPtr &dst, size_t len,
     return false;
   }
 #endif // BOUND_CHECK
-  bool ret = rmemcpy(reinterpret_cast<void *>(dst.ptr_ + to_offset),
-                     reinterpret_cast<void *>(this->ptr_ + from_offset), len);
+  bool ret = rmemcpy_nt(reinterpret_cast<void *>(dst.ptr_ + to_offset),
+                        reinterpret_cast<void *>(this->ptr_ + from_offset),
+                        len);
   return ret;
 }
 
@@ -25,7 +25,9 @@ public:
               TransientPtr prev_addr);
   bool free(ObjectPtr &ptr);
   void seal() noexcept;
-  void destroy() noexcept;
+  /* Deferred destruction frees the region only after all mutators that may
+   * still access it are gone (see epoch.hpp). */
+  void destroy(bool deferred = true) noexcept;
 
   uint32_t size() const noexcept;
   bool sealed() const noexcept;
@@ -75,6 +77,7 @@ public:
   LogAllocator(BaseSoftMemPool *pool);
   std::optional<ObjectPtr> alloc(size_t size);
   bool alloc_to(size_t size, ObjectPtr *dst);
+  bool alloc_to(size_t size, CompactObjectPtr *dst);
   bool free(ObjectPtr &ptr);
 
   // accessing internal counters
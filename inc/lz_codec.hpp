@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+namespace midas {
+namespace lz {
+
+/** A small LZ77 block codec in the LZ4 sequence format: each sequence is a
+ * token (literal length | match length - 4, 4 bits each, extended by 255-
+ * runs), the literals, and a 2-byte offset into the last 64KB of output. The
+ * last sequence only has literals. Meant for the compressed tier, so it
+ * favours speed over ratio; decompression checks every bound. */
+
+/* Worst-case compressed size of @len bytes. */
+constexpr size_t bound(size_t len) { return len + len / 255 + 16; }
+
+/* Returns the compressed size, or 0 if it does not fit in @cap bytes. */
+size_t compress(const void *src, size_t len, void *dst, size_t cap) noexcept;
+/* Decompresses into exactly @len bytes; false on malformed input. */
+bool decompress(const void *src, size_t clen, void *dst, size_t len) noexcept;
+
+} // namespace lz
+} // namespace midas
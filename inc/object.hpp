@@ -4,6 +4,7 @@
 #include <optional>
 #include <string>
 
+#include "epoch.hpp"
 #include "transient_ptr.hpp"
 #include "utils.hpp"
 
@@ -11,6 +12,10 @@ namespace midas {
 
 constexpr static uint32_t kSmallObjThreshold = kSmallObjSizeUnit << 10;
 
+/* Tags reverse references to CompactObjectPtrs. User-space addresses never
+ * have bit 47 set, so it is free in the 48-bit rref fields of headers. */
+constexpr static uint64_t kCompactRRefBit = 1ull << 47;
+
 /** flags = 0, size = 0; rref = 0x1f1f1f1f1f1f */
 constexpr static uint64_t kInvalidHdr = 0x0'000'1f1f1f1f1f1f;
 constexpr static uint64_t kInvalidFlags = 0;
@@ -31,6 +36,7 @@ public:
   void set_present() noexcept;
   void clr_present() noexcept;
   bool is_accessed() const noexcept;
+  uint32_t get_accessed() const noexcept;
   void inc_accessed() noexcept;
   void dec_accessed() noexcept;
   void clr_accessed() noexcept;
@@ -159,6 +165,16 @@ private:
 static_assert(sizeof(LargeObjectHdr) <= 24,
               "LargeObjHdr is not correctly aligned!");
 
+/** One piece of a scatter-gather copy. Like struct iovec, buf is only read
+ * when copying into the object. */
+struct ObjectIOVec {
+  void *buf;
+  size_t len;
+  int64_t offset; // data offset in the object
+};
+
+struct CompactObjectPtr;
+
 struct ObjectPtr {
 public:
   ObjectPtr();
@@ -205,15 +221,42 @@ public:
 
   bool set_rref(uint64_t addr) noexcept;
   bool set_rref(ObjectPtr *addr) noexcept;
+  bool set_rref(CompactObjectPtr *addr) noexcept;
+  /* nullptr if the object is referenced by a CompactObjectPtr. */
   ObjectPtr *get_rref() noexcept;
+  /* Address of the referencing ObjectPtr or CompactObjectPtr. */
+  void *get_rref_addr() noexcept;
 
   RetCode upd_rref() noexcept;
 
+  /** Key identity, which side tables (eviction state, costs, deadlines) are
+   * keyed by. Containers tag the pointer with the hash of the key it stores,
+   * so that state follows the key rather than the pointer, which is
+   * re-created when the key is inserted back. The tag survives frees and
+   * allocations into the pointer. Untagged pointers go by their address. */
+  void set_key_hash(uint64_t key_hash) noexcept;
+  uint64_t key_id() const noexcept;
+  /* key_id() of the pointer referencing the object. */
+  uint64_t rref_key_id() noexcept;
+
   /** Data related */
   bool cmpxchg(int64_t offset, uint64_t oldval, uint64_t newval);
 
   bool copy_from(const void *src, size_t len, int64_t offset = 0);
   bool copy_to(void *dst, size_t len, int64_t offset = 0);
+  /* Scatter-gather versions that copy all pieces under one lock and one
+   * header update. They fail as a whole on any failed piece. */
+  bool copy_from_iov(const ObjectIOVec *iov, int nr_iov);
+  bool copy_to_iov(const ObjectIOVec *iov, int nr_iov);
+  /* In-place kernels over [offset, offset + len) of the data; compare()
+   * reports like memcmp(data, buf). Ranges of large objects that span
+   * segments are copied out first. */
+  bool compare(const void *buf, size_t len, int64_t offset, int *result);
+  bool hash(size_t len, int64_t offset, uint64_t *hash);
+  bool find(const void *needle, size_t nlen, size_t len, int64_t offset,
+            int64_t *pos);
+  /* Hint only: prefetches the first @len bytes of data into CPU caches. */
+  void prefetch(size_t len) const noexcept;
 
   /** Evacuation related */
   RetCode move_from(ObjectPtr &src);
@@ -233,27 +276,108 @@ private:
   bool copy_to_small(void *dst, size_t len, int64_t offset);
   bool copy_from_large(const void *src, size_t len, int64_t offset);
   bool copy_to_large(void *dst, size_t len, int64_t offset);
+  bool copy_iov_small(const ObjectIOVec *iov, int nr_iov, bool to_obj);
+  bool copy_iov_large(const ObjectIOVec *iov, int nr_iov, bool to_obj);
+  bool copy_large_locked(const ObjectIOVec &vec, bool to_obj);
+  template <typename Kernel>
+  bool run_kernel(size_t len, int64_t offset, Kernel &&kernel);
   static RetCode iter_large(ObjectPtr &obj);
   RetCode copy_from_large(const TransientPtr &src, size_t len,
                           int64_t from_offset, int64_t to_offset);
   RetCode move_large(ObjectPtr &src) noexcept;
+  uint64_t load_rref() noexcept;
+  static void reset_rref(uint64_t rref) noexcept;
 
 #pragma pack(push, 1)
   bool small_obj_ : 1;
   bool head_obj_ : 1;
   bool victim_: 1;
   uint32_t size_ : 29; // Support up to 2^29 = 512MB.
-  uint32_t deref_cnt_; // not in use for now.
+  uint32_t key_tag_; // folded key hash, 0 if untagged
   TransientPtr obj_;
 #pragma pack(pop)
 
   template <class T> friend bool load_hdr(T &hdr, ObjectPtr &optr) noexcept;
   template <class T>
   friend bool store_hdr(const T &hdr, ObjectPtr &optr) noexcept;
+  friend class PinnedView;
+  friend class Evacuator;
+  friend struct CompactObjectPtr;
+  friend class LogAllocator;
 };
 
 static_assert(sizeof(ObjectPtr) <= 16, "ObjectPtr is not correctly aligned!");
 
+/** An 8-byte alternative to ObjectPtr for large indexes, e.g., an Array with
+ * 100M slots. It packs what ObjectPtr keeps of a soft object, relying on
+ * objects being 8B-aligned within the volatile range and smaller than a
+ * segment per segment.
+ *
+ * The object may be moved by GC while a mutator works on an unpacked copy,
+ * so data operations unpack it under an EpochGuard and retry if the pointer
+ * changed meanwhile. CompactObjectPtrs do not take part in the victim cache.
+ */
+struct CompactObjectPtr {
+  // Format:
+  //  |        Addr (39b)        |  Size (22b)  | S(1b) | H(1b) | N(1b) |
+  //                Addr: (address - kVolatileSttAddr) / 8.
+  //                Size: data size of the object in the (head) segment.
+  //                   S: small obj bit.
+  //                   H: head obj bit.
+  //                   N: non-null bit.
+public:
+  using RetCode = ObjectPtr::RetCode;
+
+  CompactObjectPtr() noexcept;
+
+  bool null() const noexcept;
+  void reset() noexcept;
+  /* Unpacks the pointer. It can be stale by the time it is used unless the
+   * caller holds an EpochGuard and checks the pointer again; see apply(). */
+  ObjectPtr get() const noexcept;
+  void store(const ObjectPtr &optr) noexcept;
+  static bool packable(const ObjectPtr &optr) noexcept;
+
+  bool is_small_obj() const noexcept;
+  size_t data_size_in_segment() const noexcept;
+  bool is_victim() const noexcept;
+  /* Compact pointers are not tagged, see ObjectPtr::key_id(). */
+  uint64_t key_id() const noexcept;
+
+  /* Runs @op(ObjectPtr &) on the unpacked pointer; reruns it if @op fails
+   * because GC moved the object meanwhile. */
+  template <typename Op> bool apply(Op &&op);
+
+  bool copy_from(const void *src, size_t len, int64_t offset = 0);
+  bool copy_to(void *dst, size_t len, int64_t offset = 0);
+  bool copy_from_iov(const ObjectIOVec *iov, int nr_iov);
+  bool copy_to_iov(const ObjectIOVec *iov, int nr_iov);
+  bool cmpxchg(int64_t offset, uint64_t oldval, uint64_t newval);
+  RetCode free() noexcept;
+
+private:
+  constexpr static uint32_t kAddrShift = 25;
+  constexpr static uint32_t kSizeShift = 3;
+  constexpr static uint64_t kSizeMask = (1ull << 22) - 1;
+  constexpr static uint64_t kSmallObjBit = 1ull << 2;
+  constexpr static uint64_t kHeadObjBit = 1ull << 1;
+  constexpr static uint64_t kNonNullBit = 1ull << 0;
+
+  static uint64_t pack(const ObjectPtr &optr) noexcept;
+  static ObjectPtr unpack(uint64_t raw) noexcept;
+  uint64_t load() const noexcept;
+
+  uint64_t raw_;
+};
+
+static_assert(sizeof(CompactObjectPtr) == 8,
+              "CompactObjectPtr is not correctly packed!");
+static_assert((kVolatileEndAddr - kVolatileSttAddr) / kSmallObjSizeUnit <=
+                  (1ull << 39),
+              "Volatile range does not fit in CompactObjectPtr!");
+static_assert(kLogSegmentSize < (1ull << 22),
+              "Segment size does not fit in CompactObjectPtr!");
+
 template <class T> bool load_hdr(T &hdr, ObjectPtr &optr) noexcept;
 template <class T> bool store_hdr(const T &hdr, ObjectPtr &optr) noexcept;
 
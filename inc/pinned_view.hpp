@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "obj_locker.hpp"
+#include "object.hpp"
+#include "utils.hpp"
+
+namespace midas {
+
+/** Pin counts of log segments, shared by readers and the evacuator.
+ * Readers pin the segment holding an object to read it in place; the
+ * evacuator must lock a segment before scanning, evacuating or destroying
+ * it, which fails while the segment is pinned. Segments hash into a fixed
+ * table, so a collision can only make a segment look pinned (or locked)
+ * for a while, never the opposite.
+ */
+class SegmentPins {
+public:
+  SegmentPins();
+
+  /* Reader side. Fails if the evacuator holds the segment of @addr. */
+  bool pin(uint64_t addr) noexcept;
+  void unpin(uint64_t addr) noexcept;
+  /* Whether the segment of @addr may be pinned (false positives only). */
+  bool pinned(uint64_t addr) noexcept;
+  /* Evacuator side. Fails if the segment of @addr is pinned. */
+  bool lock(uint64_t addr) noexcept;
+  void unlock(uint64_t addr) noexcept;
+
+  static inline SegmentPins *global_segment_pins() noexcept;
+
+private:
+  constexpr static int kNumSlots = 1 << 12;
+  constexpr static int64_t kLockedBit = 1ll << 62;
+
+  struct alignas(64) Slot { // avoid false sharing among hot segments
+    std::atomic_int64_t cnt{0};
+  };
+
+  std::atomic_int64_t &slot(uint64_t addr) noexcept;
+
+  Slot slots_[kNumSlots];
+};
+
+/** Read-only view of (part of) a soft object that avoids copying it out.
+ * If the requested range sits contiguously in one segment, the view points
+ * directly into soft memory and pins that segment so it is neither
+ * evacuated nor freed while the view is alive. Otherwise (e.g., a large
+ * object split across segments) it falls back to a private copy.
+ *
+ * Views must be short-lived: a pinned segment cannot be reclaimed, so hold
+ * them only while inspecting the data and never across blocking calls.
+ */
+class PinnedView {
+public:
+  PinnedView() noexcept;
+  PinnedView(ObjectPtr &optr, size_t len, int64_t offset = 0);
+  PinnedView(CompactObjectPtr &optr, size_t len, int64_t offset = 0);
+  PinnedView(PinnedView &&other) noexcept;
+  PinnedView &operator=(PinnedView &&other) noexcept;
+  PinnedView(const PinnedView &) = delete;
+  PinnedView &operator=(const PinnedView &) = delete;
+  ~PinnedView();
+
+  /* Whether a view may be reading @optr in place. Writers must then write a
+   * new object rather than overwrite it. */
+  static bool viewed(ObjectPtr &optr) noexcept;
+
+  const void *data() const noexcept;
+  size_t size() const noexcept;
+  template <typename T> const T *as() const noexcept;
+  /* Whether the view reads soft memory in place (vs. a private copy). */
+  bool pinned() const noexcept;
+  explicit operator bool() const noexcept;
+
+  void reset() noexcept;
+
+private:
+  bool pin(ObjectPtr &optr, size_t len, int64_t offset);
+
+  constexpr static bool kEnablePinning = true;
+  constexpr static uint64_t kPinWarnUs = 10 * 1000; // 10ms
+
+  const void *data_;
+  size_t size_;
+  uint64_t pinned_addr_; // 0 if not pinned
+  uint64_t pin_stt_us_;
+  std::unique_ptr<char[]> copy_;
+};
+
+} // namespace midas
+
+#include "impl/pinned_view.ipp"
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 
@@ -12,6 +13,7 @@ public:
   ResilientFunc(uint64_t stt_ip_, uint64_t end_ip_);
   void init(void *func_addr);
   bool contain(uint64_t fault_ip);
+  uint64_t start_ip() const noexcept;
   bool omitted_frame_pointer;
   uint64_t fail_entry;
 
@@ -20,7 +22,45 @@ private:
   uint64_t end_ip;
 };
 
-DECL_RESILIENT_FUNC(bool, rmemcpy, void *dst, const void *src, size_t len);
+/* rmemcpy kernels. rmemcpy() picks one of them at runtime, according to the
+ * features of the running CPU and the copy length. */
+DECL_RESILIENT_FUNC(bool, rmemcpy_v128, void *dst, const void *src, size_t len);
+DECL_RESILIENT_FUNC(bool, rmemcpy_v256, void *dst, const void *src, size_t len);
+DECL_RESILIENT_FUNC(bool, rmemcpy_v512, void *dst, const void *src, size_t len);
+DECL_RESILIENT_FUNC(bool, rmemcpy_rep, void *dst, const void *src, size_t len);
+// non-temporal stores that bypass the cache
+DECL_RESILIENT_FUNC(bool, rmemcpy_nt128, void *dst, const void *src,
+                    size_t len);
+DECL_RESILIENT_FUNC(bool, rmemcpy_nt512, void *dst, const void *src,
+                    size_t len);
+
+using RMemcpyFunc = bool (*)(void *dst, const void *src, size_t len);
+
+struct RMemcpyConfig {
+  std::atomic<RMemcpyFunc> copy;        // fastest vector kernel
+  std::atomic<RMemcpyFunc> stream;      // non-temporal kernel
+  std::atomic<size_t> rep_threshold;    // use rep movsb from this length
+  std::atomic<size_t> stream_threshold; // use stream from this length
+};
+/* Set up for the baseline x86-64 ISA, then upgraded at startup to the best
+ * kernels the CPU supports. rmemcpy_calibrate() refines the thresholds. */
+extern RMemcpyConfig rmemcpy_config;
+
+bool rmemcpy(void *dst, const void *src, size_t len);
+/* For the evacuator. Copies of at least kNTCopyMinLen bytes use non-temporal
+ * stores, so that GC does not flush the working sets of mutators. */
+bool rmemcpy_nt(void *dst, const void *src, size_t len);
+/* Benchmarks the kernels on the running CPU and updates rmemcpy_config.
+ * Takes about a second; safe to call while other threads copy. */
+void rmemcpy_calibrate();
+
+/* Fault-tolerant kernels over soft memory. All return false on faults and
+ * pass their results out through the last argument. */
+DECL_RESILIENT_FUNC(bool, rmemcmp, const void *lhs, const void *rhs,
+                    size_t len, int *result);
+DECL_RESILIENT_FUNC(bool, rhash, const void *data, size_t len, uint64_t *hash);
+DECL_RESILIENT_FUNC(bool, rmemfind, const void *data, size_t len,
+                    const void *needle, size_t nlen, int64_t *pos);
 } // namespace midas
 
 #include "impl/resilient_func.ipp"
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <boost/interprocess/shared_memory_object.hpp>
 #include <condition_variable>
 #include <cstddef>
+#include <deque>
 #include <list>
 #include <map>
 #include <memory>
@@ -15,6 +16,7 @@
 
 #include "qpair.hpp"
 #include "shm_types.hpp"
+#include "stats_board.hpp"
 #include "utils.hpp"
 
 namespace midas {
@@ -61,15 +63,23 @@ private:
 };
 
 class BaseSoftMemPool; // defined in base_soft_mem_pool.hpp
+class Runtime;         // defined in runtime.hpp
 class ResourceManager {
 public:
   ResourceManager(BaseSoftMemPool *cpool = nullptr,
                   const std::string &daemon_name = kNameCtrlQ) noexcept;
+  /* A pool in a shared runtime, which talks to the daemon on its behalf. */
+  ResourceManager(BaseSoftMemPool *cpool,
+                  std::shared_ptr<Runtime> runtime) noexcept;
   ~ResourceManager() noexcept;
 
   int64_t AllocRegion(bool overcommit = false) noexcept;
   void FreeRegion(int64_t rid) noexcept;
   void FreeRegions(size_t size = kRegionSize) noexcept;
+  /* Frees @rid once no mutator can be accessing it (see epoch.hpp). */
+  void RetireRegion(int64_t rid) noexcept;
+  /* Frees retired regions that have become safe. Returns #regions freed. */
+  int64_t ReclaimRetired() noexcept;
   inline VRange GetRegion(int64_t region_id) noexcept;
 
   void UpdateLimit(size_t size) noexcept;
@@ -92,15 +102,21 @@ public:
   void prof_reclaim_stt();
   void prof_reclaim_end(int nr_thds, double dur_s);
 
+  inline Runtime *runtime() const noexcept;
+
   static std::shared_ptr<ResourceManager> global_manager_shared_ptr() noexcept;
   static ResourceManager *global_manager() noexcept;
 
 private:
   int connect(const std::string &daemon_name = kNameCtrlQ) noexcept;
   int disconnect() noexcept;
+  int request(const CtrlMsg &msg, CtrlMsg *ack) noexcept;
   size_t free_region(std::shared_ptr<Region> region, bool enforce) noexcept;
+  bool apply_limit(uint64_t new_limit, bool force) noexcept;
 
   void pressure_handler();
+  void stats_publisher();
+  void publish_stats() noexcept;
   void do_update_limit(CtrlMsg &msg);
   void do_force_reclaim(CtrlMsg &msg);
   void do_profile_stats(CtrlMsg &msg);
@@ -115,18 +131,31 @@ private:
   uint64_t id_;
   std::mutex mtx_;
   std::condition_variable cv_;
-  QPair txqp_;
-  QPair rxqp_;
+  std::shared_ptr<QPair> txqp_;
+  std::shared_ptr<QPair> rxqp_;
+  // serializes request/reply round trips on txqp_
+  std::shared_ptr<std::mutex> conn_mtx_;
+  std::shared_ptr<Runtime> runtime_; // nullptr if connected on its own
 
   // regions
-  uint64_t region_limit_;
+  // the runtime moves limits between its pools without their mtx_
+  std::atomic_uint64_t region_limit_;
   std::map<int64_t, std::shared_ptr<Region>> region_map_;
   std::list<std::shared_ptr<Region>> freelist_;
+  // destroyed segments' regions waiting for mutators to leave, in epoch order
+  std::mutex retired_mtx_;
+  std::deque<std::pair<uint64_t, int64_t>> retired_; // (epoch, region id)
+  std::atomic_int_fast64_t nr_retired_{0};
 
   std::atomic_int_fast64_t nr_pending_;
   std::shared_ptr<std::thread> handler_thd_;
   bool stop_;
 
+  // stats published to the daemon through shared memory
+  std::unique_ptr<StatsBoard> stats_board_;
+  StatsSnapshot board_stats_;
+  std::shared_ptr<std::thread> publisher_thd_;
+
   // stats
   struct AllocTputStats {
     // Updated by ResourceManager
@@ -147,6 +176,8 @@ private:
     float accum_evac_dur{0};
     float accum_nr_reclaimed{0};
   } stats_;
+
+  friend class Runtime;
 };
 
 } // namespace midas
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "qpair.hpp"
+#include "shm_types.hpp"
+#include "stats_board.hpp"
+#include "utils.hpp"
+
+namespace midas {
+
+class Evacuator;       // defined in evacuator.hpp
+class Region;          // defined in resource_manager.hpp
+class ResourceManager; // defined in resource_manager.hpp
+
+/** Process-level runtime shared by all soft memory pools of a process.
+ *
+ * Pools share one daemon connection (the daemon sees a single client), one set
+ * of GC threads, and one reserve of unmapped regions. Each pool remains its
+ * own accounting and eviction domain with its own region limit. The runtime
+ * splits the process-wide limit granted by the daemon among its pools, and
+ * moves idle budget from one pool to another locally without asking the
+ * daemon.
+ *
+ * Disabled by default; call Runtime::enable() before creating any pool.
+ */
+class Runtime {
+public:
+  Runtime(const std::string &daemon_name = kNameCtrlQ);
+  ~Runtime();
+
+  static void enable() noexcept;
+  static bool enabled() noexcept;
+  static std::shared_ptr<Runtime> global_runtime_shared_ptr() noexcept;
+  static Runtime *global_runtime() noexcept;
+
+  uint64_t id() const noexcept;
+  size_t num_pools() noexcept;
+  uint64_t region_limit() const noexcept;
+
+private:
+  /** Called by ResourceManagers of the pools */
+  void attach(ResourceManager *rmanager);
+  void detach(ResourceManager *rmanager);
+  /* Moves up to @nr_regions of budget to @rmanager from the unassigned budget
+   * and idle budget of other pools, or, if @rmanager is below its fair share,
+   * from pools above theirs. Returns #regions granted. */
+  int64_t grow(ResourceManager *rmanager, int64_t nr_regions);
+  void update_limit(ResourceManager *rmanager, size_t size);
+  // region reserve
+  std::shared_ptr<Region> take_region();
+  bool stash_region(std::shared_ptr<Region> region);
+  bool release_region(std::shared_ptr<Region> region);
+  void trim_reserve();
+
+  /** Called by Evacuators of the pools */
+  void signal_gc(Evacuator *evacuator);
+  void cancel_gc(Evacuator *evacuator);
+  void gc_worker();
+
+  /** Interacting with the daemon */
+  int connect(const std::string &daemon_name);
+  int disconnect();
+  int request(const CtrlMsg &msg, CtrlMsg *ack);
+  void pressure_handler();
+  void do_update_limit(CtrlMsg &msg, bool force);
+  void do_profile_stats(CtrlMsg &msg);
+  void stats_publisher();
+  /* Splits a new process limit among pools. Returns pools to shrink. */
+  std::vector<std::pair<ResourceManager *, uint64_t>> partition();
+  uint64_t nr_held_regions();
+
+  constexpr static int64_t kGrowChunk = 16; // min #regions moved per grow
+  constexpr static int32_t kNumGCThds = 2;
+
+  uint64_t id_;
+  std::shared_ptr<QPair> txqp_;
+  std::shared_ptr<QPair> rxqp_;
+  std::shared_ptr<std::mutex> conn_mtx_;
+  std::mutex apply_mtx_; // keeps pools alive while shrinking them
+
+  std::mutex mtx_; // guards everything below
+  std::vector<ResourceManager *> pools_;
+  std::unordered_map<ResourceManager *, uint64_t> requests_; // in bytes
+  uint64_t region_limit_;   // granted to the whole process by the daemon
+  uint64_t free_budget_;    // not yet handed out to any pool
+  std::list<std::shared_ptr<Region>> reserve_;
+  StatsSnapshot detached_stats_; // counters of pools that are gone
+
+  std::mutex gc_mtx_;
+  std::condition_variable gc_cv_;
+  std::deque<Evacuator *> gc_queue_;
+  std::vector<Evacuator *> gc_running_;
+  std::vector<std::thread> gc_thds_;
+
+  bool stop_;
+  std::shared_ptr<std::thread> handler_thd_;
+  std::unique_ptr<StatsBoard> stats_board_;
+  std::shared_ptr<std::thread> publisher_thd_;
+
+  static std::atomic_bool enabled_;
+
+  friend class ResourceManager;
+  friend class Evacuator;
+};
+
+} // namespace midas
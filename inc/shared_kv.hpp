@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstdint>
+#include <memory>
+#include <pthread.h>
+#include <string>
+
+#include "qpair.hpp"
+
+namespace midas {
+
+/** A read-mostly key-value cache in one shared memory object, which all
+ * processes on the host attach to by name; e.g. the workers of a prefork
+ * service share one copy instead of keeping one each. The daemon creates the
+ * store on its first attach and charges it to the memory budget until the
+ * last attached process detaches or dies. Values are appended to a
+ * log-structured ring of @capacity bytes and the oldest ones are dropped as
+ * it wraps around. The index is set-associative with kWays entries per
+ * cache-line bucket, and holds log positions rather than pointers since each
+ * process maps the store at its own address. Readers take no locks and never
+ * write to the store: they validate a bucket seqlock and the log head, so a
+ * concurrent update or wrap turns into a retry or a miss, never torn data.
+ * Writers serialize on a robust process-shared mutex, which is taken over if
+ * its holder dies. */
+class SharedKV {
+public:
+  /* Attaches to the store @name, or has the daemon create it if it does not
+   * exist yet; @capacity and @nr_buckets only matter to the creator. */
+  SharedKV(const std::string &name, size_t capacity,
+           size_t nr_buckets = kDefaultBuckets) noexcept;
+  ~SharedKV() noexcept;
+  bool valid() const noexcept;
+
+  /* The value is malloc()ed and owned by the caller. */
+  void *get(const void *key, size_t klen, size_t *vlen);
+  /* Copies the first @vlen bytes of the value. */
+  bool get(const void *key, size_t klen, void *value, size_t vlen);
+  template <typename K, typename V> std::unique_ptr<V> get(const K &k);
+
+  bool set(const void *key, size_t klen, const void *value, size_t vlen);
+  template <typename K, typename V> bool set(const K &k, const V &v);
+
+  bool remove(const void *key, size_t klen);
+  template <typename K> bool remove(const K &k);
+
+  /* Counted per process, so that readers stay write-free. */
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t nr_sets;
+  };
+  Stats get_stats() const noexcept;
+  size_t capacity() const noexcept;
+  /* Kept by the daemon; crashed processes are dropped within seconds. */
+  uint32_t nr_attached() const noexcept;
+
+private:
+  struct Header {
+    std::atomic_uint32_t nr_attached; // kept by the daemon, must come first
+    std::atomic_uint32_t ready;
+    uint64_t magic;
+    uint64_t nr_buckets;
+    uint64_t log_size;
+    // bucket under update + 1, to fix its seqlock if the writer dies
+    std::atomic_uint64_t dirty_bucket;
+    std::atomic_uint64_t head; // bytes ever appended to the log
+    pthread_mutex_t writer;    // robust and process-shared
+  };
+  /* An entry is | tag (16b) | log position + 1 (48b) |, 0 if empty. */
+  constexpr static int kWays = 7;
+  struct Bucket {
+    std::atomic_uint64_t seq; // odd while an update is in progress
+    std::atomic_uint64_t entries[kWays];
+  };
+  static_assert(sizeof(Bucket) == 64, "Bucket must fill a cache line");
+  struct RecordHdr {
+    uint64_t key_hash;
+    uint32_t klen;
+    uint32_t vlen;
+  };
+
+  static uint64_t hash_(const void *key, size_t klen) noexcept;
+  static size_t layout_size(uint64_t nr_buckets, uint64_t log_size) noexcept;
+  /* Sends @op for the store to the daemon. Returns its reply code, or
+   * CONN_FAIL if the daemon does not answer. */
+  CtrlRetCode request(CtrlOpCode op, uint64_t size,
+                      uint64_t *store_size) noexcept;
+  bool attach(const std::string &name, size_t capacity,
+              size_t nr_buckets) noexcept;
+  void detach() noexcept;
+
+  /* Returns the way of @key's entry in @bucket, or -1. */
+  int lookup(const Bucket &bucket, uint64_t key_hash, const void *key,
+             size_t klen, uint64_t *pos, RecordHdr *hdr) const noexcept;
+  /* Checks the record at @pos against @key, false if it is overwritten. */
+  bool read_record(uint64_t pos, uint64_t key_hash, const void *key,
+                   size_t klen, RecordHdr *hdr) const noexcept;
+  bool intact(uint64_t pos) const noexcept;
+  /* Locates @key's record, consistently with concurrent writers. */
+  bool find(const void *key, size_t klen, uint64_t *pos,
+            size_t *vlen) noexcept;
+
+  bool lock_writer() noexcept;
+  void unlock_writer() noexcept;
+  void begin_update(uint64_t bucket_idx) noexcept;
+  void end_update(uint64_t bucket_idx) noexcept;
+
+  constexpr static uint64_t kMagic = 0x6d69646173'6b76ull; // "midaskv"
+  constexpr static size_t kDefaultBuckets = 64 * 1024;
+  constexpr static uint64_t kPosBits = 48;
+  constexpr static uint64_t kPosMask = (1ull << kPosBits) - 1;
+  constexpr static int kMaxReadRetry = 64;
+  constexpr static int kAttachTimeoutMs = 1000;
+  constexpr static int kDaemonTimeout = 3; // in seconds
+
+  uint64_t id_;
+  uint64_t name_hash_;
+  std::unique_ptr<QPair> qp_; // to the daemon, and our ack queue back
+  std::unique_ptr<boost::interprocess::mapped_region> region_;
+  Header *hdr_{nullptr};
+  Bucket *buckets_{nullptr};
+  char *log_{nullptr};
+  uint64_t bucket_mask_{0};
+  uint64_t log_size_{0};
+
+  std::atomic_uint64_t hits_{0};
+  std::atomic_uint64_t misses_{0};
+  std::atomic_uint64_t nr_sets_{0};
+};
+
+} // namespace midas
+
+#include "impl/shared_kv.ipp"
@@ -18,6 +18,9 @@ enum CtrlOpCode {
   PROF_STATS,
   SET_WEIGHT,
   SET_LAT_CRITICAL,
+  // shared KV stores; attach replies CONN_SUCC to the one that created it
+  SHKV_ATTACH,
+  SHKV_DETACH,
 };
 
 enum CtrlRetCode {
@@ -83,6 +86,12 @@ static inline const std::string get_region_list_shm_name(uint64_t uuid) {
   return "regions-" + std::to_string(uuid);
 }
 
+/* Shared KV stores are created by the daemon, which keeps the number of
+ * processes attached to a store in its first 4 bytes. */
+static inline const std::string get_shared_kv_name(uint64_t name_hash) {
+  return "shkv-" + std::to_string(name_hash);
+}
+
 } // namespace utils
 
 } // namespace midas
\ No newline at end of file
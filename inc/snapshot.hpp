@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace midas {
+
+/** Snapshot files keep a data structure's live key-value pairs across
+ * process restarts, so that a new process starts warm. A file is a stream
+ * of self-checked blocks of about kBlockSize bytes, each holding the records
+ * of one hotness class (the objects' accessed bits when dumped):
+ *    | BlockHdr | Record | Record | ...
+ * and each record is
+ *    | KeyLen (4B) | ValueLen (4B) | Deadline (8B) | Key | Value |
+ * where the deadline is the key's expiry time in wall-clock ms, 0 if none.
+ * Blocks are independent so that loaders read them in parallel, hottest
+ * first. */
+namespace snapshot {
+struct BlockHdr {
+  uint32_t magic;
+  uint32_t hotness;
+  uint32_t nr_records;
+  uint32_t len; // of the records
+  uint64_t checksum;
+};
+static_assert(sizeof(BlockHdr) == 24, "BlockHdr is not correctly aligned!");
+
+struct Record {
+  const void *key;
+  size_t klen;
+  const void *value;
+  size_t vlen;
+  uint64_t deadline_ms;
+};
+
+constexpr static uint32_t kMagic = 0x736e6170; // "snap"
+constexpr static uint32_t kNrHotness = 4;      // the range of accessed bits
+constexpr static size_t kBlockSize = 1024 * 1024;
+constexpr static size_t kRecordHdrSize = 16;
+
+/* Wall-clock time, which unlike Time survives reboots. */
+uint64_t now_ms() noexcept;
+} // namespace snapshot
+
+/** Streams records into a snapshot. The file is written under a temporary
+ * name and only replaces @path once finished, so a crash never leaves a
+ * truncated snapshot behind. */
+class SnapshotWriter {
+public:
+  SnapshotWriter(const std::string &path);
+  ~SnapshotWriter();
+  bool ready() const noexcept;
+
+  bool add(const snapshot::Record &record, uint32_t hotness);
+  /* Flushes all blocks, syncs the file, moves it into place and syncs its
+   * directory. */
+  bool finish();
+  uint64_t nr_records() const noexcept;
+
+private:
+  bool flush(uint32_t hotness);
+
+  const std::string path_;
+  const std::string tmp_path_;
+  int fd_{-1};
+  bool failed_{false};
+  uint64_t nr_records_{0};
+  // a block being filled per hotness class
+  std::vector<char> blocks_[snapshot::kNrHotness];
+  uint32_t nr_block_records_[snapshot::kNrHotness]{};
+};
+
+/** Reads a snapshot block by block. Blocks are indexed hottest first, and
+ * can be read concurrently. Corrupted blocks are skipped, and a truncated
+ * tail ends the snapshot. */
+class SnapshotReader {
+public:
+  SnapshotReader(const std::string &path);
+  ~SnapshotReader();
+  bool ready() const noexcept;
+
+  size_t nr_blocks() const noexcept;
+  /* Reads block @idx into @buf, false if it is corrupted. */
+  bool read_block(size_t idx, std::vector<char> &buf) const;
+  /* Decodes the next record of a block read into @buf, at @offset. */
+  static bool next_record(const std::vector<char> &buf, size_t &offset,
+                          snapshot::Record *record) noexcept;
+
+private:
+  struct BlockRef {
+    uint64_t offset;
+    snapshot::BlockHdr hdr;
+  };
+
+  int fd_{-1};
+  std::vector<BlockRef> blocks_;
+};
+
+} // namespace midas
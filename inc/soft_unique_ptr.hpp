@@ -4,6 +4,7 @@
 #include <memory>
 
 #include "object.hpp"
+#include "pinned_view.hpp"
 #include "transient_ptr.hpp"
 #include <optional>
 
@@ -31,6 +32,8 @@ public:
 
   // Access
   T read(ReconArgs... args);
+  /* Zero-copy read, reconstructing the value on misses. */
+  PinnedView view(ReconArgs... args);
   void write(const T &);
   bool cmpxchg(const T &oldval, const T &newval);
 
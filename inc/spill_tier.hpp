@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace midas {
+
+/** A tier on local disk for evicted objects that are expensive to rebuild.
+ * The evacuator appends such objects to an in-memory segment, which is
+ * handed to a writer thread once full and written out to a log-structured
+ * spill file; the file is a ring of fixed-size segment slots, so the oldest
+ * segment is overwritten when the tier is full. Objects are dropped rather
+ * than waiting for the writer if it falls kNrBuffers - 1 segments behind,
+ * so the evacuator never waits for the disk. A miss that finds the object
+ * in the compact in-memory index reads it back with pread (outside the
+ * tier's lock, so lookups proceed in parallel) and re-admits it to soft
+ * memory. Every record carries its key, length and checksum, so a read that
+ * races with a slot being overwritten is detected and served as a plain
+ * miss. The tier holds no authoritative
+ * state: the file is truncated when the tier is created, removed when it is
+ * destroyed, and the tier can be reset at any time. */
+class SpillTier {
+public:
+  /* Spills objects whose tagged cost (see CostTable) is at least
+   * @min_cost cycles, or all of them if @min_cost is 0. */
+  SpillTier(const std::string &path, size_t capacity, uint64_t min_cost = 0);
+  ~SpillTier();
+  bool ready() const noexcept;
+
+  /* Replaces @key's entry; objects larger than a segment, or that come
+   * while the writer is behind, are dropped. */
+  bool put(const void *key, const void *data, size_t len);
+  /* Reads @key's entry back into @buf and drops it. */
+  bool take(const void *key, std::vector<char> &buf);
+  void remove(const void *key) noexcept;
+  /* Drops all entries and starts over from the first slot. */
+  void reset() noexcept;
+
+  uint64_t min_cost() const noexcept;
+
+  struct Stats {
+    uint64_t nr_spilled;
+    uint64_t spilled_bytes;
+    uint64_t nr_lookups;
+    uint64_t nr_hits;
+    uint64_t read_cycles;
+  };
+  Stats get_stats() const noexcept;
+  size_t capacity() const noexcept;
+
+private:
+  struct RecordHdr {
+    uint64_t key;
+    uint32_t len;
+    uint32_t checksum;
+  };
+  struct Entry {
+    uint64_t seg_id;
+    uint32_t offset; // of the record header within its segment
+    uint32_t len;
+  };
+  struct Segment {
+    uint64_t id;
+    uint32_t used;
+    std::unique_ptr<char[]> data;
+  };
+  static uint32_t checksum(const void *data, size_t len) noexcept;
+  bool seal_locked() noexcept;
+  const char *buffered_locked(uint64_t seg_id) const noexcept;
+  void write_segment(const Segment &segment) noexcept;
+  void writer_loop();
+
+  constexpr static uint32_t kSegmentSize = 4 * 1024 * 1024; // 4MB
+  // the active segment and those waiting to be written
+  constexpr static int kNrBuffers = 3;
+
+  const std::string path_;
+  const uint64_t nr_slots_;
+  const uint64_t min_cost_;
+  int fd_{-1};
+
+  std::mutex mtx_;
+  std::unordered_map<const void *, Entry> map_;
+  // keys appended to each slot, to drop their entries when it is reused
+  std::vector<std::vector<const void *>> slot_keys_;
+  uint64_t active_id_{0};
+  uint32_t active_used_{0};
+  std::unique_ptr<char[]> active_; // the segment being filled
+  std::deque<Segment> sealed_;     // to be written, oldest first
+  std::vector<std::unique_ptr<char[]>> free_bufs_;
+
+  std::condition_variable writer_cv_;
+  bool terminated_{false};
+  std::thread writer_;
+
+  std::atomic_uint64_t nr_spilled_{0};
+  std::atomic_uint64_t spilled_bytes_{0};
+  std::atomic_uint64_t nr_lookups_{0};
+  std::atomic_uint64_t nr_hits_{0};
+  std::atomic_uint64_t read_cycles_{0};
+};
+
+} // namespace midas
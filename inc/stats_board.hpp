@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace midas {
+
+/* One snapshot of a client's stats. Counters are cumulative so that readers
+ * can take deltas at their own pace; gauges are the latest values. */
+struct StatsSnapshot {
+  // cache stats
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t miss_cycles;
+  uint64_t miss_bytes;
+  uint64_t saved_cycles; // miss penalty saved by hits, estimated
+  // victim cache stats
+  uint64_t vhits;
+  // compressed tier stats
+  uint64_t ctier_lookups;
+  uint64_t ctier_hits;
+  uint64_t ctier_raw_bytes;        // of the objects put into the tier
+  uint64_t ctier_compressed_bytes; // of the objects put into the tier
+  uint64_t ctier_decompress_cycles;
+  // resource stats
+  uint64_t nr_regions;
+  uint64_t region_limit;
+  float alloc_tput;
+  float reclaim_tput;
+  // full threshold
+  uint32_t headroom;
+  uint64_t timestamp; // of the last update, in steady_clock us
+};
+
+/** A seqlock-protected shared memory page where a client publishes its stats
+ * and the daemon reads them without any message round trip. There is a
+ * single writer per board (the client's publisher thread).
+ */
+class StatsBoard {
+public:
+  /* @create: true for the publishing client, false for the reading daemon */
+  StatsBoard(uint64_t id, bool create) noexcept;
+  ~StatsBoard() noexcept;
+
+  inline bool valid() const noexcept;
+  inline void publish(const StatsSnapshot &snapshot) noexcept;
+  /* Returns false if no consistent snapshot was taken after a few retries. */
+  inline bool read(StatsSnapshot *snapshot) const noexcept;
+
+  static inline uint64_t now_us() noexcept;
+  static inline void remove(uint64_t id) noexcept;
+
+private:
+  struct Page {
+    std::atomic_uint64_t seq; // odd while an update is in progress
+    StatsSnapshot data;
+  };
+  static_assert(sizeof(Page) <= 4096, "StatsBoard must fit in a page");
+
+  constexpr static int kMaxReadRetry = 64;
+
+  uint64_t id_;
+  bool owner_;
+  std::unique_ptr<boost::interprocess::mapped_region> region_;
+  Page *page_;
+};
+
+namespace utils {
+static inline const std::string get_stats_board_name(uint64_t id) {
+  return "stats-" + std::to_string(id);
+}
+} // namespace utils
+
+} // namespace midas
+
+#include "impl/stats_board.ipp"
@@ -7,13 +7,17 @@
 #include <vector>
 
 #include "cache_manager.hpp"
+#include "codec.hpp"
 #include "construct_args.hpp"
 #include "log.hpp"
 #include "object.hpp"
+#include "pinned_view.hpp"
 #include "time.hpp"
 
 namespace midas {
 
+/** Values are stored through midas::Codec<Tp>, so non-flat types such as
+ * std::string work once they have a codec. */
 template <size_t NBuckets, typename Key, typename Tp,
           typename Hash = std::hash<Key>, typename Pred = std::equal_to<Key>,
           typename Alloc = LogAllocator, typename Lock = std::mutex>
@@ -25,8 +29,16 @@ public:
 
   template <typename K1> std::unique_ptr<Tp> get(K1 &&key);
   template <typename K1> bool get(K1 &&key, Tp &v);
+  /* Zero-copy read; an empty view on misses (no re-construction). Writers
+   * leave viewed values intact and store the key's new value elsewhere. */
+  template <typename K1> PinnedView get_view(K1 &&key);
+  /* Succeeds without allocating if the pool's admission filter rejects a
+   * new key, as if the value was evicted at once. */
   template <typename K1, typename Tp1> bool set(const K1 &key, const Tp1 &v);
   template <typename K1> bool remove(K1 &&key);
+  /* Tags the key's value with the cycles to rebuild it (see CostTable).
+   * Re-constructed values are tagged with their construct time. */
+  template <typename K1> bool set_cost(K1 &&key, uint64_t cycles);
   bool clear();
   // std::vector<Pair> get_all_pairs();
 
@@ -45,6 +57,19 @@ private:
   bool iterate_list(uint64_t key_hash, K1 &&key, BNPtr *&prev_next,
                     BNPtr &node);
   template <typename K1> BNPtr *find(K1 &&key, bool remove = false);
+
+  /* The value follows the key, as a raw Tp for fixed-size codecs, or as
+   * | Len (8B) | encoded Tp (Len B) | otherwise. */
+  constexpr static bool kFixedValue = Codec<Tp>::kFixedSize;
+  constexpr static size_t kValueOffset =
+      kFixedValue ? sizeof(Key) : sizeof(Key) + sizeof(size_t);
+  template <typename Tp1> static size_t value_size(const Tp1 &v);
+  bool load_value(ObjectPtr &pair, Tp &v);
+  template <typename Tp1>
+  bool store_value(ObjectPtr &pair, const Tp1 &v, bool fresh,
+                   const void *k = nullptr);
+  PinnedView view_value(ObjectPtr &pair);
+
   Lock locks_[NBuckets];
   BucketNode *buckets_[NBuckets];
 
@@ -1,19 +1,28 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <cstring>
 #include <iterator>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "robinhood.h"
 
 #include "cache_manager.hpp"
+#include "codec.hpp"
 #include "construct_args.hpp"
+#include "expiry.hpp"
 #include "log.hpp"
 #include "object.hpp"
+#include "pinned_view.hpp"
+#include "snapshot.hpp"
 #include "time.hpp"
 
 namespace midas {
@@ -86,16 +95,48 @@ public:
   template <typename K> kv_types::Value get(const K &k);
   template <typename K, typename V> std::unique_ptr<V> get(const K &k);
   bool get(const void *key, size_t klen, void *value, size_t vlen);
+  /* Zero-copy read; an empty view on misses (no re-construction). Writers
+   * leave viewed values intact and store the key's new value elsewhere, so
+   * the view keeps the value it was taken with. */
+  PinnedView get_view(const void *key, size_t klen);
+  template <typename K> PinnedView get_view(const K &k);
 
-  bool set(const void *key, size_t klen, const void *value, size_t vlen);
-  bool set(const kv_types::Key &key, const kv_types::CValue &value);
-  template <typename K> bool set(const K &k, const kv_types::CValue &value);
-  template <typename K, typename V> bool set(const K &k, const V &v);
+  /* If the pool's admission filter rejects a new key, nothing is allocated
+   * and the set still succeeds, as if the value was evicted at once. The
+   * same goes for add() and set_as(). A @ttl_ms of 0 stores the value
+   * without a TTL, replacing any previous one, as add() and set_as() do. */
+  bool set(const void *key, size_t klen, const void *value, size_t vlen,
+           uint64_t ttl_ms = 0);
+  bool set(const kv_types::Key &key, const kv_types::CValue &value,
+           uint64_t ttl_ms = 0);
+  template <typename K>
+  bool set(const K &k, const kv_types::CValue &value, uint64_t ttl_ms = 0);
+  template <typename K, typename V>
+  bool set(const K &k, const V &v, uint64_t ttl_ms = 0);
 
   bool remove(const void *key, size_t klen);
   bool remove(const kv_types::Key &key);
   template <typename K> bool remove(const K &k);
 
+  /* Tags the key's value with the cycles to rebuild it (see CostTable).
+   * Re-constructed values are tagged with their construct time. */
+  bool set_cost(const void *key, size_t klen, uint64_t cycles);
+  template <typename K> bool set_cost(const K &k, uint64_t cycles);
+
+  /* Expiration. Expired keys read as misses and are freed in the background
+   * within about 10ms. expire() sets the key's TTL, or removes it if
+   * @ttl_ms is 0, and fails on missing keys. ttl() returns the remaining ms,
+   * -1 if the key has no TTL, or -2 if it is missing. */
+  bool expire(const void *key, size_t klen, uint64_t ttl_ms);
+  template <typename K> bool expire(const K &k, uint64_t ttl_ms);
+  int64_t ttl(const void *key, size_t klen);
+  template <typename K> int64_t ttl(const K &k);
+
+  /** Typed Interfaces. Keys and values are (de)serialized by midas::Codec,
+   * straight from/into soft memory. get_as() does not re-construct. */
+  template <typename K, typename V> bool get_as(const K &k, V &v);
+  template <typename K, typename V> bool set_as(const K &k, const V &v);
+
   /* V should be addable such as [u]int[_64_t]. */
   template <typename V>
   bool inc(const void *key, size_t klen, V offset, V *value);
@@ -108,6 +149,14 @@ public:
   bool clear();
   // std::vector<Pair> get_all_pairs();
 
+  /** Warm Restart. dump() streams the live pairs, their TTLs and hotness into
+   * a snapshot at @path, skipping evicted ones; load() reads a snapshot back
+   * with @nr_threads threads, hottest first, and stops once the pool's limit
+   * is reached. Keys set before load() win over the snapshot's. Both return
+   * the number of pairs, or -1 if the snapshot cannot be written/read. */
+  int64_t dump(const std::string &path);
+  int64_t load(const std::string &path, int nr_threads = kLoadThreads);
+
   /** Ordered Set Interfaces */
   enum class UpdateType { // mimicing Redis-plus-plus
     EXIST,
@@ -140,6 +189,17 @@ public:
   int bremove(const std::vector<kv_types::Key> &keys);
   template <typename K> int bremove(const std::vector<K> &keys);
 
+  /* Bulk loading for warm-up. Inserts the pairs that are not in the KV yet,
+   * as add() does but bypassing the admission filter. All objects are
+   * allocated and filled before any bucket lock is taken, so that locks are
+   * only held to link them. @ttls_ms is either empty or has one TTL per pair.
+   * Returns #pairs inserted; stops early if the pool runs out of memory. */
+  int bload(const std::vector<kv_types::Key> &keys,
+            const std::vector<kv_types::CValue> &values,
+            const std::vector<uint64_t> &ttls_ms = {});
+  template <typename K, typename V>
+  int bload(const std::vector<K> &keys, const std::vector<V> &values);
+
   // User can also mark a section with batch_[stt|end] and manually bget_single
   void batch_stt(kv_types::BatchPlug &plug);
   int batch_end(kv_types::BatchPlug &plug);
@@ -158,22 +218,47 @@ private:
     uint64_t key_hash;
     ObjectPtr pair;
     BucketNode *next;
+    uint64_t expire_at; // in us, 0 if the key has no TTL
   };
   using BNPtr = BucketNode *;
+  struct ExpiryTimer {
+    uint64_t key_hash;
+    BNPtr node; // validated against the bucket before use
+    uint64_t expire_at;
+  };
 
   static inline uint64_t hash_(const void *key, size_t klen);
   void *get_(const void *key, size_t klen, void *value, size_t *vlen,
              kv_types::BatchPlug *plug, bool construct);
   BNPtr create_node(uint64_t hash, const void *k, size_t kn, const void *v,
                     size_t vn);
+  bool refill_node(BNPtr node, const void *k, size_t kn, const void *v,
+                   size_t vn);
   BNPtr delete_node(BNPtr *prev_next, BNPtr node);
   bool iterate_list(uint64_t hash, const void *k, size_t kn, size_t *vn,
                     BNPtr *&prev_next, BNPtr &node);
   BNPtr *find(void *k, size_t kn, bool remove = false);
+  static inline bool expired(BNPtr node, uint64_t now_us);
+  void set_expiry(BNPtr node, uint64_t ttl_ms);
+  void schedule_expiry(const ExpiryTimer &timer);
+  void expire_node(const ExpiryTimer &timer, uint64_t now_us);
+  void expiry_loop();
+  void stop_expiry();
   Lock locks_[NBuckets];
   BucketNode *buckets_[NBuckets];
 
   CachePool *pool_;
+
+  // the expiry thread is started on the first TTL and ticks the wheel
+  constexpr static uint64_t kExpiryTickMs = 10;
+  std::mutex expiry_mtx_;
+  std::condition_variable expiry_cv_;
+  bool expiry_terminated_{false};
+  TimerWheel<ExpiryTimer> wheel_;
+  std::shared_ptr<std::thread> expiry_thd_;
+
+  constexpr static int kLoadThreads = 4;
+  constexpr static int kLoadPrefetchDist = 8; // in pairs
 };
 
 } // namespace midas
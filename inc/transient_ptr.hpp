@@ -28,7 +28,8 @@ public:
   bool copy_from(const void *src, size_t len, int64_t offset = 0);
   bool copy_to(void *dst, size_t len, int64_t offset = 0);
   /**
-   * Ops with two transient references (this & src/dst).
+   * Ops with two transient references (this & src/dst). Used by evacuation,
+   * so copies of kNTCopyMinLen or more bypass the cache.
    */
   bool copy_from(const TransientPtr &src, size_t len, int64_t from_offset = 0,
                  int64_t to_offset = 0);
@@ -15,15 +15,8 @@ CacheManager::CacheManager() : terminated_(false), profiler_(nullptr) {
 StatsMsg CacheManager::profile_pools() {
   StatsMsg stats{0};
   std::unique_lock<std::mutex> ul(mtx_);
-  for (auto &[_, pool] : pools_) {
-    uint64_t curr_ts = Time::get_us_stt();
-    uint64_t prev_ts = pool->stats.timestamp;
-    if (pool->stats.hits || pool->stats.misses) {
-      pool->profile_stats(&stats);
-    }
-    pool->stats.reset();
-    pool->stats.timestamp = curr_ts;
-  }
+  for (auto &[_, pool] : pools_)
+    pool->profile_stats(&stats);
   ul.unlock();
   return stats;
 }
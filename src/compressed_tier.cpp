@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "compressed_tier.hpp"
+#include "lz_codec.hpp"
+#include "time.hpp"
+
+namespace midas {
+
+CompressedTier::CompressedTier(size_t capacity)
+    : max_segments_(std::max<size_t>(capacity / kSegmentSize, 1)) {}
+
+bool CompressedTier::put(const void *key, const void *data, size_t len) {
+  // compress outside of the lock, GC threads call this concurrently
+  static thread_local std::vector<char> scratch;
+  scratch.resize(lz::bound(len));
+  auto clen = lz::compress(data, len, scratch.data(), scratch.size());
+
+  std::unique_lock<std::mutex> ul(mtx_);
+  map_.erase(key);
+  if (!clen || clen >= len || clen > kSegmentSize)
+    return false;
+  if (segments_.empty() || segments_.back().used + clen > kSegmentSize) {
+    while (segments_.size() >= max_segments_)
+      drop_oldest_locked();
+    segments_.push_back(Segment{next_seg_id_++, 0,
+                                std::make_unique<char[]>(kSegmentSize), {}});
+  }
+  auto &segment = segments_.back();
+  std::memcpy(segment.data.get() + segment.used, scratch.data(), clen);
+  map_[key] = Entry{segment.id, segment.used, static_cast<uint32_t>(clen),
+                    static_cast<uint32_t>(len)};
+  segment.keys.push_back(key);
+  segment.used += clen;
+  ul.unlock();
+
+  nr_stored_.fetch_add(1, std::memory_order_relaxed);
+  raw_bytes_.fetch_add(len, std::memory_order_relaxed);
+  compressed_bytes_.fetch_add(clen, std::memory_order_relaxed);
+  return true;
+}
+
+bool CompressedTier::take(const void *key, std::vector<char> &buf) {
+  static thread_local std::vector<char> scratch;
+  nr_lookups_.fetch_add(1, std::memory_order_relaxed);
+
+  std::unique_lock<std::mutex> ul(mtx_);
+  auto iter = map_.find(key);
+  if (iter == map_.cend())
+    return false;
+  auto entry = iter->second;
+  map_.erase(iter);
+  // segment ids are consecutive, so the entry's segment is found by offset
+  auto &segment = segments_[entry.seg_id - segments_.front().id];
+  scratch.resize(entry.len);
+  std::memcpy(scratch.data(), segment.data.get() + entry.offset, entry.len);
+  ul.unlock();
+
+  auto stt = Time::get_cycles_stt();
+  buf.resize(entry.raw_len);
+  if (!lz::decompress(scratch.data(), entry.len, buf.data(), entry.raw_len))
+    return false;
+  auto end = Time::get_cycles_end();
+  nr_hits_.fetch_add(1, std::memory_order_relaxed);
+  decompress_cycles_.fetch_add(end - stt, std::memory_order_relaxed);
+  return true;
+}
+
+void CompressedTier::remove(const void *key) noexcept {
+  std::unique_lock<std::mutex> ul(mtx_);
+  map_.erase(key);
+}
+
+/* Only drops the entries that still point into the segment; the others have
+ * been replaced or removed since. */
+void CompressedTier::drop_oldest_locked() noexcept {
+  auto &segment = segments_.front();
+  for (auto key : segment.keys) {
+    auto iter = map_.find(key);
+    if (iter != map_.cend() && iter->second.seg_id == segment.id)
+      map_.erase(iter);
+  }
+  segments_.pop_front();
+}
+
+CompressedTier::Stats CompressedTier::get_stats() const noexcept {
+  return Stats{nr_stored_.load(std::memory_order_relaxed),
+               raw_bytes_.load(std::memory_order_relaxed),
+               compressed_bytes_.load(std::memory_order_relaxed),
+               nr_lookups_.load(std::memory_order_relaxed),
+               nr_hits_.load(std::memory_order_relaxed),
+               decompress_cycles_.load(std::memory_order_relaxed)};
+}
+
+size_t CompressedTier::capacity() const noexcept {
+  return max_segments_ * kSegmentSize;
+}
+
+size_t CompressedTier::size() const noexcept {
+  std::unique_lock<std::mutex> ul(mtx_);
+  return segments_.size() * kSegmentSize;
+}
+
+} // namespace midas
@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+#include "epoch.hpp"
+#include "logging.hpp"
+
+namespace midas {
+
+thread_local EpochManager::LocalRecord EpochManager::local_;
+
+EpochManager::LocalRecord::~LocalRecord() {
+  if (!record)
+    return;
+  record->epoch.store(kQuiescent, std::memory_order_release);
+  record->in_use.store(false, std::memory_order_release);
+  record = nullptr;
+  exhausted = true; // do not take a record again during thread teardown
+}
+
+EpochManager::Record *EpochManager::acquire_record() noexcept {
+  for (int32_t i = 0; i < kMaxRecords; i++) {
+    auto &record = records_[i];
+    bool in_use = false;
+    if (record.in_use.load(std::memory_order_relaxed) ||
+        !record.in_use.compare_exchange_strong(in_use, true))
+      continue;
+    int32_t nr_records = nr_records_.load();
+    while (nr_records < i + 1 &&
+           !nr_records_.compare_exchange_weak(nr_records, i + 1))
+      ;
+    return &record;
+  }
+  local_.exhausted = true;
+  MIDAS_LOG(kWarning) << "Too many threads for epoch protection, "
+                         "fall back to fault handling";
+  return nullptr;
+}
+
+uint64_t EpochManager::advance() noexcept { return global_epoch_.fetch_add(1); }
+
+uint64_t EpochManager::min_active() noexcept {
+  // pairs with the fence in enter()
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  uint64_t min_epoch = kQuiescent;
+  int32_t nr_records = nr_records_.load(std::memory_order_acquire);
+  for (int32_t i = 0; i < nr_records; i++)
+    min_epoch = std::min(
+        min_epoch, records_[i].epoch.load(std::memory_order_acquire));
+  return min_epoch;
+}
+
+} // namespace midas
@@ -11,15 +11,51 @@
 
 #include "cache_manager.hpp"
 #include "evacuator.hpp"
+#include "evict_notify.hpp"
+#include "eviction_policy.hpp"
 #include "log.hpp"
 #include "logging.hpp"
 #include "object.hpp"
+#include "pinned_view.hpp"
 #include "resource_manager.hpp"
+#include "runtime.hpp"
 #include "time.hpp"
 #include "utils.hpp"
 
 namespace midas {
+
+Evacuator::Evacuator(BaseSoftMemPool *pool,
+                     std::shared_ptr<ResourceManager> rmanager,
+                     std::shared_ptr<LogAllocator> allocator)
+    : pool_(pool), rmanager_(rmanager), allocator_(allocator),
+      runtime_(rmanager->runtime()), terminated_(false) {
+  init();
+}
+
+void Evacuator::signal_gc() {
+  if (runtime_) {
+    runtime_->signal_gc(this);
+    return;
+  }
+  std::unique_lock<std::mutex> ul(gc_mtx_);
+  gc_cv_.notify_all();
+}
+
+Evacuator::~Evacuator() {
+  terminated_ = true;
+  if (runtime_)
+    runtime_->cancel_gc(this);
+  else
+    signal_gc();
+  if (gc_thd_) {
+    gc_thd_->join();
+    gc_thd_.reset();
+  }
+}
+
 void Evacuator::init() {
+  if (runtime_) // GC rounds are run by the runtime's GC threads
+    return;
   gc_thd_ = std::make_shared<std::thread>([&]() {
     while (!terminated_) {
       {
@@ -27,24 +63,29 @@ void Evacuator::init() {
         gc_cv_.wait(
             lk, [this] { return terminated_ || rmanager_->reclaim_trigger(); });
       }
-      auto succ = false;
-      auto nr_evac_thds = rmanager_->reclaim_nr_thds();
-      if (nr_evac_thds == 1) {
-        succ = serial_gc();
-      } else {
-        for (int i = 0; i < 3; i++) {
-          succ = parallel_gc(nr_evac_thds);
-          if (succ)
-            break;
-        }
-      }
-
-      if (!succ)
-        force_reclaim();
+      run_gc();
     }
   });
 }
 
+void Evacuator::run_gc() {
+  auto succ = false;
+  auto nr_evac_thds = rmanager_->reclaim_nr_thds();
+  if (nr_evac_thds == 1) {
+    succ = serial_gc();
+  } else {
+    for (int i = 0; i < 3; i++) {
+      succ = parallel_gc(nr_evac_thds);
+      if (succ)
+        break;
+    }
+  }
+
+  if (!succ)
+    force_reclaim();
+  rmanager_->ReclaimRetired();
+}
+
 int64_t Evacuator::gc(SegmentList &stash_list) {
   if (!rmanager_->reclaim_trigger())
     return 0;
@@ -53,9 +94,11 @@ int64_t Evacuator::gc(SegmentList &stash_list) {
   int nr_scanned = 0;
   int nr_evaced = 0;
   auto &segments = allocator_->segments_;
+  auto pins = SegmentPins::global_segment_pins();
 
   auto stt = chrono_utils::now();
   while (rmanager_->reclaim_trigger()) {
+    rmanager_->ReclaimRetired();
     auto segment = segments.pop_front();
     if (!segment) {
       nr_skipped++;
@@ -73,11 +116,20 @@ int64_t Evacuator::gc(SegmentList &stash_list) {
       }
       continue;
     }
+    auto seg_addr = segment->start_addr_;
+    if (!pins->lock(seg_addr)) { // readers hold pinned views into it
+      segments.push_back(segment);
+      nr_skipped++;
+      if (nr_skipped > rmanager_->NumRegionLimit())
+        return -1;
+      continue;
+    }
     EvacState ret = scan_segment(segment.get(), true);
     nr_scanned++;
-    if (ret == EvacState::Fault)
+    if (ret == EvacState::Fault) {
+      pins->unlock(seg_addr);
       continue;
-    else if (ret == EvacState::Fail)
+    } else if (ret == EvacState::Fail)
       goto put_back;
     // must have ret == EvacState::Succ now
 
@@ -89,12 +141,15 @@ int64_t Evacuator::gc(SegmentList &stash_list) {
     else if (ret == EvacState::DelayRelease)
       goto stash;
     // must have ret == EvacState::Succ or ret == EvacState::Fault now
+    pins->unlock(seg_addr);
     nr_evaced++;
     continue;
   put_back:
+    pins->unlock(seg_addr);
     segments.push_back(segment);
     continue;
   stash:
+    pins->unlock(seg_addr);
     stash_list.push_back(segment);
     continue;
   }
@@ -119,9 +174,11 @@ bool Evacuator::serial_gc() {
   int64_t nr_scanned = 0;
   int64_t nr_evaced = 0;
   auto &segments = allocator_->segments_;
+  auto pins = SegmentPins::global_segment_pins();
 
   auto stt = chrono_utils::now();
   while (rmanager_->reclaim_trigger()) {
+    rmanager_->ReclaimRetired();
     auto segment = segments.pop_front();
     if (!segment) {
       nr_skipped++;
@@ -139,11 +196,20 @@ bool Evacuator::serial_gc() {
       }
       continue;
     }
+    auto seg_addr = segment->start_addr_;
+    if (!pins->lock(seg_addr)) { // readers hold pinned views into it
+      segments.push_back(segment);
+      nr_skipped++;
+      if (nr_skipped > rmanager_->NumRegionLimit())
+        goto done;
+      continue;
+    }
     EvacState ret = scan_segment(segment.get(), true);
     nr_scanned++;
-    if (ret == EvacState::Fault)
+    if (ret == EvacState::Fault) {
+      pins->unlock(seg_addr);
       continue;
-    else if (ret == EvacState::Fail)
+    } else if (ret == EvacState::Fail)
       goto put_back;
     // must have ret == EvacState::Succ now
     assert(ret == EvacState::Succ);
@@ -158,9 +224,11 @@ bool Evacuator::serial_gc() {
       segment->destroy();
     }
     // must have ret == EvacState::Succ or ret == EvacState::Fault now
+    pins->unlock(seg_addr);
     nr_evaced++;
     continue;
   put_back:
+    pins->unlock(seg_addr);
     segments.push_back(segment);
     continue;
   }
@@ -196,10 +264,17 @@ bool Evacuator::parallel_gc(int nr_workers) {
   gc_thds.clear();
 
   auto &segments = allocator_->segments_;
+  auto pins = SegmentPins::global_segment_pins();
   while (!stash_list.empty()) {
     auto segment = stash_list.pop_front();
+    auto seg_addr = segment->start_addr_;
+    if (!pins->lock(seg_addr)) { // pinned since, retry in later rounds
+      segments.push_back(segment);
+      continue;
+    }
     // segment->destroy();
     EvacState ret = evac_segment(segment.get());
+    pins->unlock(seg_addr);
     if (ret == EvacState::DelayRelease)
       segments.push_back(segment);
     else if (ret != EvacState::Succ) {
@@ -226,15 +301,26 @@ int64_t Evacuator::force_reclaim() {
   for (int i = 0; i < nr_workers; i++) {
     thds.emplace_back([&] {
       auto &segments = allocator_->segments_;
+      auto pins = SegmentPins::global_segment_pins();
+      uint64_t nr_pinned = 0;
       while (rmanager_->NumRegionAvail() <= 0) {
         auto segment = segments.pop_front();
         if (!segment)
           break;
+        auto seg_addr = segment->start_addr_;
+        if (!pins->lock(seg_addr)) { // pins are short, reclaim others first
+          segments.push_back(segment);
+          if (++nr_pinned > rmanager_->NumRegionLimit())
+            break;
+          continue;
+        }
         if (segment.use_count() != 1) {
           MIDAS_LOG(kError) << segment << " " << segment.use_count();
         }
         assert(segment.use_count() <= 2);
-        segment->destroy();
+        // forced: mutators still on it are recovered by the fault handler
+        segment->destroy(/* deferred = */ false);
+        pins->unlock(seg_addr);
         nr_reclaimed++;
       }
     });
@@ -268,11 +354,76 @@ inline RetCode Evacuator::iterate_segment(LogSegment *segment, uint64_t &pos,
   return ret;
 }
 
+/* Must be called on a locked object before it is freed. */
+inline void Evacuator::track_evicted(EvictBatch *batch, ObjectPtr &optr) {
+  if (!batch)
+    return;
+  auto rref = optr.get_rref_addr();
+  if (!rref)
+    return;
+  uint64_t tag = 0;
+  uint64_t size = optr.data_size_in_segment();
+  if (pool_->evict_tag_enabled() && size >= sizeof(tag) &&
+      !optr.obj_.copy_to(&tag, sizeof(tag), optr.hdr_size()))
+    tag = 0;
+  batch->add(rref, size, tag);
+}
+
+/* Must be called on a locked object head before it is freed. Objects go to
+ * the spill tier if they are expensive enough, to the compressed tier
+ * otherwise. Large objects are not stashed, but their stale entries must
+ * go. */
+inline void Evacuator::stash_evicted(ObjectPtr &optr) {
+  auto ctier = pool_->get_compressed_tier();
+  auto spill = pool_->get_spill_tier();
+  if (!ctier && !spill)
+    return;
+  auto rref = optr.get_rref(); // null for compact pointers, not restored
+  if (!rref)
+    return;
+  static thread_local std::vector<char> buf;
+  auto size = optr.data_size_in_segment();
+  buf.resize(size);
+  bool readable = optr.is_small_obj() &&
+                  optr.obj_.copy_to(buf.data(), size, optr.hdr_size());
+  bool spilled = false;
+  if (spill) {
+    if (readable &&
+        pool_->get_obj_cost(optr.rref_key_id()) >= spill->min_cost())
+      spilled = spill->put(rref, buf.data(), size);
+    else
+      spill->remove(rref);
+  }
+  if (ctier) {
+    if (readable && !spilled)
+      ctier->put(rref, buf.data(), size);
+    else
+      ctier->remove(rref);
+  }
+}
+
+/* Must be called on a locked, present object head. The policy's updates to
+ * @meta_hdr are for the caller to store if the object is kept. */
+inline bool Evacuator::policy_evicts(EvictionPolicy *policy,
+                                     MetaObjectHdr &meta_hdr,
+                                     ObjectPtr &optr) {
+  return policy->scan(meta_hdr, optr.rref_key_id(),
+                      optr.data_size_in_segment());
+}
+
 inline EvacState Evacuator::scan_segment(LogSegment *segment, bool deactivate) {
   if (!segment_ready(segment))
     return EvacState::Fail;
   segment->set_alive_bytes(kMaxAliveBytes);
 
+  // evictions are reported to the app once per segment
+  EvictBatch evicted;
+  auto batch = pool_->evict_notify_enabled() ? &evicted : nullptr;
+  auto policy = pool_->get_evict_policy();
+  // expired objects are dead: freed without asking the policy or stashing
+  auto expiry = pool_->get_obj_expiry();
+  auto now = expiry ? Time::get_us() : 0;
+
   int alive_bytes = 0;
   // counters
   int nr_present = 0;
@@ -301,10 +452,12 @@ inline EvacState Evacuator::scan_segment(LogSegment *segment, bool deactivate) {
       else {
         if (meta_hdr.is_present()) {
           nr_present++;
-          if (!deactivate) {
+          bool expired =
+              expiry && expiry->expired(obj_ptr.get_rref_addr(), now);
+          if (!deactivate && !expired) {
             alive_bytes += obj_size;
-          } else if (meta_hdr.is_accessed()) {
-            meta_hdr.dec_accessed();
+          } else if (!expired &&
+                     !policy_evicts(policy.get(), meta_hdr, obj_ptr)) {
             if (!store_hdr(meta_hdr, obj_ptr))
               goto faulted;
             nr_deactivated++;
@@ -314,12 +467,15 @@ inline EvacState Evacuator::scan_segment(LogSegment *segment, bool deactivate) {
             // assert(rref);
             // if (!rref)
             //   MIDAS_LOG(kError) << "null rref detected";
+            track_evicted(batch, obj_ptr);
+            if (!expired)
+              stash_evicted(obj_ptr);
             auto ret = obj_ptr.free(/* locked = */ true);
             if (ret == RetCode::FaultLocal)
               goto faulted;
             // small objs are impossible to fault on other regions
             assert(ret != RetCode::FaultOther);
-            if (rref && !rref->is_victim()) {
+            if (rref && !expired && !rref->is_victim()) {
               auto vcache = pool_->get_vcache();
               vcache->put(rref, nullptr);
             }
@@ -338,10 +494,12 @@ inline EvacState Evacuator::scan_segment(LogSegment *segment, bool deactivate) {
         if (meta_hdr.is_present()) {
           nr_present++;
           if (!meta_hdr.is_continue()) { // head segment
-            if (!deactivate) {
+            bool expired =
+                expiry && expiry->expired(obj_ptr.get_rref_addr(), now);
+            if (!deactivate && !expired) {
               alive_bytes += obj_size;
-            } else if (meta_hdr.is_accessed()) {
-              meta_hdr.dec_accessed();
+            } else if (!expired &&
+                       !policy_evicts(policy.get(), meta_hdr, obj_ptr)) {
               if (!store_hdr(meta_hdr, obj_ptr))
                 goto faulted;
               nr_deactivated++;
@@ -351,12 +509,15 @@ inline EvacState Evacuator::scan_segment(LogSegment *segment, bool deactivate) {
               // assert(rref);
               // if (!rref)
               //   MIDAS_LOG(kError) << "null rref detected";
+              track_evicted(batch, obj_ptr);
+              if (!expired)
+                stash_evicted(obj_ptr);
               // This will free all segments belonging to the same object
               auto ret = obj_ptr.free(/* locked = */ true);
               if (ret == RetCode::FaultLocal)
                 goto faulted;
               // do nothing when ret == FaultOther and continue scanning
-              if (rref && !rref->is_victim()) {
+              if (rref && !expired && !rref->is_victim()) {
                 auto vcache = pool_->get_vcache();
                 vcache->put(rref, nullptr);
               }
@@ -402,12 +563,14 @@ inline EvacState Evacuator::scan_segment(LogSegment *segment, bool deactivate) {
                     << ", nr_faulted: " << nr_faulted << ", alive ratio: "
                     << static_cast<float>(segment->alive_bytes_) /
                            kLogSegmentSize;
+  if (batch)
+    pool_->notify_evicted(evicted);
 
   assert(ret != RetCode::FaultOther);
   if (ret == RetCode::FaultLocal || nr_faulted) {
     if (!kEnableFaultHandler)
       MIDAS_LOG(kError) << "segment is unmapped under the hood";
-    segment->destroy();
+    segment->destroy(/* deferred = */ false);
     return EvacState::Fault;
   }
   segment->set_alive_bytes(alive_bytes);
@@ -522,7 +685,7 @@ inline EvacState Evacuator::evac_segment(LogSegment *segment) {
   if (ret == RetCode::FaultLocal || nr_faulted) {
     if (!kEnableFaultHandler)
       MIDAS_LOG(kError) << "segment is unmapped under the hood";
-    segment->destroy();
+    segment->destroy(/* deferred = */ false);
     return EvacState::Fault;
   }
   if (nr_contd_objs)
@@ -600,7 +763,7 @@ inline EvacState Evacuator::free_segment(LogSegment *segment) {
   if (ret == RetCode::FaultLocal || nr_faulted) {
     if (!kEnableFaultHandler)
       MIDAS_LOG(kError) << "segment is unmapped under the hood";
-    segment->destroy();
+    segment->destroy(/* deferred = */ false);
     return EvacState::Fault;
   }
   if (nr_contd_objs)
@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "eviction_policy.hpp"
+#include "object.hpp"
+
+namespace midas {
+
+/** CostTable */
+CostTable::CostTable()
+    : classes_(std::make_unique<std::atomic_uint8_t[]>(1ull << kTableBits)) {}
+
+uint8_t CostTable::to_class(uint64_t cycles) noexcept {
+  if (!cycles)
+    return 0;
+  int exp = 63 - __builtin_clzll(cycles);
+  uint64_t mantissa =
+      (exp >= 2 ? cycles >> (exp - 2) : cycles << (2 - exp)) & 3;
+  return std::min<uint64_t>(exp * 4 + mantissa + 1, 0xff);
+}
+
+uint64_t CostTable::to_cycles(uint8_t cost_class) noexcept {
+  if (!cost_class)
+    return 0;
+  int exp = (cost_class - 1) / 4;
+  uint64_t mantissa = (cost_class - 1) % 4;
+  return exp >= 2 ? (4 + mantissa) << (exp - 2) : (4 + mantissa) >> (2 - exp);
+}
+
+void CostTable::set(uint64_t key, uint64_t cycles) noexcept {
+  classes_[EvictionPolicy::key_hash(key) >> (64 - kTableBits)].store(
+      to_class(cycles), std::memory_order_relaxed);
+}
+
+uint64_t CostTable::get(uint64_t key) const noexcept {
+  return to_cycles(
+      classes_[EvictionPolicy::key_hash(key) >> (64 - kTableBits)].load(
+          std::memory_order_relaxed));
+}
+
+/** EvictionPolicy */
+std::shared_ptr<EvictionPolicy>
+EvictionPolicy::create(EvictPolicyType type, std::shared_ptr<CostTable> costs) {
+  switch (type) {
+  case EvictPolicyType::LFUAging:
+    return std::make_shared<LFUAgingPolicy>();
+  case EvictPolicyType::S3FIFO:
+    return std::make_shared<S3FIFOPolicy>();
+  case EvictPolicyType::LRUK:
+    return std::make_shared<LRUKPolicy>();
+  case EvictPolicyType::GDSF:
+    return std::make_shared<GDSFPolicy>(costs);
+  case EvictPolicyType::Clock:
+  default:
+    return std::make_shared<ClockPolicy>();
+  }
+}
+
+const char *EvictionPolicy::name(EvictPolicyType type) noexcept {
+  switch (type) {
+  case EvictPolicyType::Clock:
+    return "clock";
+  case EvictPolicyType::LFUAging:
+    return "lfu-aging";
+  case EvictPolicyType::S3FIFO:
+    return "s3-fifo";
+  case EvictPolicyType::LRUK:
+    return "lru-k";
+  case EvictPolicyType::GDSF:
+    return "gdsf";
+  }
+  return "unknown";
+}
+
+/** LFU-aging */
+LFUAgingPolicy::LFUAgingPolicy()
+    : freqs_(std::make_unique<std::atomic_uint8_t[]>(1ull << kTableBits)) {}
+
+EvictPolicyType LFUAgingPolicy::type() const noexcept {
+  return EvictPolicyType::LFUAging;
+}
+
+bool LFUAgingPolicy::scan(MetaObjectHdr &hdr, uint64_t key,
+                          size_t size) noexcept {
+  auto &freq = freqs_[key_hash(key) >> (64 - kTableBits)];
+  uint32_t f = freq.load(std::memory_order_relaxed);
+  f = std::min<uint32_t>(f - (f + 7) / 8 + hdr.get_accessed(), 0xff);
+  hdr.clr_accessed();
+  freq.store(f, std::memory_order_relaxed);
+  return f == 0;
+}
+
+/** S3-FIFO */
+S3FIFOPolicy::S3FIFOPolicy()
+    : main_(
+          std::make_unique<std::atomic_uint64_t[]>((1ull << kMainBits) / 64)),
+      ghost_(std::make_unique<std::atomic_uint32_t[]>(1ull << kGhostBits)) {}
+
+EvictPolicyType S3FIFOPolicy::type() const noexcept {
+  return EvictPolicyType::S3FIFO;
+}
+
+bool S3FIFOPolicy::test_main(uint64_t hash) const noexcept {
+  auto idx = hash >> (64 - kMainBits);
+  auto word = main_[idx / 64].load(std::memory_order_relaxed);
+  return word & (1ull << (idx % 64));
+}
+
+void S3FIFOPolicy::set_main(uint64_t hash, bool in_main) noexcept {
+  auto idx = hash >> (64 - kMainBits);
+  auto mask = 1ull << (idx % 64);
+  if (in_main)
+    main_[idx / 64].fetch_or(mask, std::memory_order_relaxed);
+  else
+    main_[idx / 64].fetch_and(~mask, std::memory_order_relaxed);
+}
+
+/* Fingerprints are the low 32 bits, never 0 which marks an empty slot. */
+bool S3FIFOPolicy::ghost_hit(uint64_t hash) noexcept {
+  auto &slot = ghost_[hash >> (64 - kGhostBits)];
+  uint32_t fp = static_cast<uint32_t>(hash) | 1;
+  return slot.compare_exchange_strong(fp, 0, std::memory_order_relaxed);
+}
+
+void S3FIFOPolicy::ghost_add(uint64_t hash) noexcept {
+  ghost_[hash >> (64 - kGhostBits)].store(static_cast<uint32_t>(hash) | 1,
+                                          std::memory_order_relaxed);
+}
+
+bool S3FIFOPolicy::scan(MetaObjectHdr &hdr, uint64_t key,
+                        size_t size) noexcept {
+  auto hash = key_hash(key);
+  if (test_main(hash)) { // CLOCK within main
+    if (hdr.is_accessed()) {
+      hdr.dec_accessed();
+      return false;
+    }
+    set_main(hash, false);
+    return true;
+  }
+  // small: the insertion itself counts as one access
+  if (hdr.get_accessed() > 1 || ghost_hit(hash)) {
+    set_main(hash, true);
+    hdr.dec_accessed();
+    return false;
+  }
+  ghost_add(hash);
+  return true;
+}
+
+/** LRU-K */
+LRUKPolicy::LRUKPolicy()
+    : ages_(std::make_unique<std::atomic_uint8_t[]>(1ull << kTableBits)) {
+  for (uint64_t i = 0; i < (1ull << kTableBits); i++)
+    ages_[i].store(kNever << 4 | kNever, std::memory_order_relaxed);
+}
+
+EvictPolicyType LRUKPolicy::type() const noexcept {
+  return EvictPolicyType::LRUK;
+}
+
+/* Entries are kept on eviction so that a recently evicted object which is
+ * inserted back still has its history. */
+bool LRUKPolicy::scan(MetaObjectHdr &hdr, uint64_t key,
+                      size_t size) noexcept {
+  auto &entry = ages_[key_hash(key) >> (64 - kTableBits)];
+  uint8_t ages = entry.load(std::memory_order_relaxed);
+  uint8_t last = std::min<uint8_t>((ages & 0xf) + 1, kNever);
+  uint8_t prev = std::min<uint8_t>((ages >> 4) + 1, kNever);
+  auto nr_accessed = hdr.get_accessed();
+  hdr.clr_accessed();
+  if (nr_accessed > 1) {
+    last = prev = 0;
+  } else if (nr_accessed == 1) {
+    prev = last;
+    last = 0;
+  }
+  entry.store(prev << 4 | last, std::memory_order_relaxed);
+  return prev >= kWindow;
+}
+
+/** GDSF */
+GDSFPolicy::GDSFPolicy(std::shared_ptr<CostTable> costs)
+    : costs_(costs),
+      entries_(std::make_unique<std::atomic_uint16_t[]>(1ull << kTableBits)) {}
+
+EvictPolicyType GDSFPolicy::type() const noexcept {
+  return EvictPolicyType::GDSF;
+}
+
+/* Racy but good enough: concurrent scanners may lose each other's samples. */
+void GDSFPolicy::update_avg(std::atomic<double> &avg, double sample) noexcept {
+  auto curr = avg.load(std::memory_order_relaxed);
+  avg.store(curr ? curr + (sample - curr) * kAvgWeight : sample,
+            std::memory_order_relaxed);
+}
+
+bool GDSFPolicy::scan(MetaObjectHdr &hdr, uint64_t key,
+                      size_t size) noexcept {
+  auto &entry = entries_[key_hash(key) >> (64 - kTableBits)];
+  uint16_t val = entry.load(std::memory_order_relaxed);
+  uint32_t credit = val & 0xff;
+  auto nr_accessed = hdr.get_accessed();
+  uint32_t freq = std::min<uint32_t>((val >> 8) / 2 + nr_accessed, 0xff);
+  hdr.clr_accessed();
+  if (nr_accessed) {
+    uint64_t cost = costs_ ? costs_->get(key) : 0;
+    double density = avg_density_.load(std::memory_order_relaxed);
+    if (cost) {
+      density = static_cast<double>(cost) / std::max<size_t>(size, 1);
+      update_avg(avg_density_, density);
+    }
+    double priority = freq * density;
+    update_avg(avg_priority_, priority);
+    double refill = kBaseCredit * priority /
+                    avg_priority_.load(std::memory_order_relaxed);
+    credit = std::max(credit, static_cast<uint32_t>(std::min(refill, 255.)));
+  }
+  if (credit == 0) {
+    entry.store(freq << 8, std::memory_order_relaxed);
+    return true;
+  }
+  entry.store(freq << 8 | (credit - 1), std::memory_order_relaxed);
+  return false;
+}
+
+} // namespace midas
@@ -76,10 +76,13 @@ inline bool LogSegment::free(ObjectPtr &ptr) {
   return ptr.free() == RetCode::Succ;
 }
 
-void LogSegment::destroy() noexcept {
+void LogSegment::destroy(bool deferred) noexcept {
   destroyed_ = true;
   auto *rmanager = owner_->pool_->get_rmanager();
-  rmanager->FreeRegion(region_id_);
+  if (deferred)
+    rmanager->RetireRegion(region_id_);
+  else
+    rmanager->FreeRegion(region_id_);
   alive_bytes_ = kMaxAliveBytes;
 }
 
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "lz_codec.hpp"
+
+namespace midas {
+namespace lz {
+
+constexpr static int kHashBits = 12;
+constexpr static size_t kMinMatch = 4;
+constexpr static size_t kLastLiterals = 5; // the tail is always literals
+constexpr static size_t kMaxOffset = 65535;
+
+static inline uint32_t read32(const uint8_t *p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t hash4(uint32_t v) {
+  return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+/* Writes the part of a length that did not fit in its token field. */
+static inline bool put_length(uint8_t *&op, const uint8_t *oend, size_t len) {
+  for (; len >= 255; len -= 255) {
+    if (op >= oend)
+      return false;
+    *op++ = 255;
+  }
+  if (op >= oend)
+    return false;
+  *op++ = static_cast<uint8_t>(len);
+  return true;
+}
+
+static inline bool get_length(const uint8_t *&ip, const uint8_t *iend,
+                              size_t &len) {
+  uint8_t b;
+  do {
+    if (ip >= iend)
+      return false;
+    b = *ip++;
+    len += b;
+  } while (b == 255);
+  return true;
+}
+
+/* @match_len is 0 for the last sequence, which has no match. */
+static inline bool put_sequence(uint8_t *&op, const uint8_t *oend,
+                                const uint8_t *lits, size_t nr_lits,
+                                size_t offset, size_t match_len) {
+  if (op >= oend)
+    return false;
+  auto token = op++;
+  size_t ml = match_len ? match_len - kMinMatch : 0;
+  *token = std::min<size_t>(nr_lits, 15) << 4 | std::min<size_t>(ml, 15);
+  if (nr_lits >= 15 && !put_length(op, oend, nr_lits - 15))
+    return false;
+  if (static_cast<size_t>(oend - op) < nr_lits)
+    return false;
+  std::memcpy(op, lits, nr_lits);
+  op += nr_lits;
+  if (!match_len)
+    return true;
+  if (oend - op < 2)
+    return false;
+  *op++ = offset & 0xff;
+  *op++ = offset >> 8;
+  return ml < 15 || put_length(op, oend, ml - 15);
+}
+
+size_t compress(const void *src, size_t len, void *dst, size_t cap) noexcept {
+  auto base = static_cast<const uint8_t *>(src);
+  auto end = base + len;
+  auto ip = base;
+  auto anchor = base;
+  auto op = static_cast<uint8_t *>(dst);
+  auto oend = op + cap;
+
+  uint32_t table[1 << kHashBits] = {}; // last position of each 4-byte hash
+  if (len > kMinMatch + kLastLiterals) {
+    auto limit = end - kLastLiterals - kMinMatch; // last match start
+    while (ip <= limit) {
+      auto seq = read32(ip);
+      auto &slot = table[hash4(seq)];
+      auto ref = base + slot;
+      slot = static_cast<uint32_t>(ip - base);
+      if (ref >= ip || static_cast<size_t>(ip - ref) > kMaxOffset ||
+          read32(ref) != seq) {
+        ip++;
+        continue;
+      }
+      auto match_end = ip + kMinMatch;
+      auto match_limit = end - kLastLiterals;
+      while (match_end < match_limit && *match_end == ref[match_end - ip])
+        match_end++;
+      if (!put_sequence(op, oend, anchor, ip - anchor, ip - ref,
+                        match_end - ip))
+        return 0;
+      ip = anchor = match_end;
+    }
+  }
+  if (!put_sequence(op, oend, anchor, end - anchor, 0, 0))
+    return 0;
+  return op - static_cast<uint8_t *>(dst);
+}
+
+bool decompress(const void *src, size_t clen, void *dst, size_t len) noexcept {
+  auto ip = static_cast<const uint8_t *>(src);
+  auto iend = ip + clen;
+  auto obase = static_cast<uint8_t *>(dst);
+  auto op = obase;
+  auto oend = obase + len;
+
+  while (ip < iend) {
+    uint8_t token = *ip++;
+    size_t nr_lits = token >> 4;
+    if (nr_lits == 15 && !get_length(ip, iend, nr_lits))
+      return false;
+    if (static_cast<size_t>(iend - ip) < nr_lits ||
+        static_cast<size_t>(oend - op) < nr_lits)
+      return false;
+    std::memcpy(op, ip, nr_lits);
+    ip += nr_lits;
+    op += nr_lits;
+    if (ip == iend) // the last sequence
+      break;
+
+    if (iend - ip < 2)
+      return false;
+    size_t offset = ip[0] | ip[1] << 8;
+    ip += 2;
+    size_t match_len = token & 15;
+    if (match_len == 15 && !get_length(ip, iend, match_len))
+      return false;
+    match_len += kMinMatch;
+    if (offset == 0 || offset > static_cast<size_t>(op - obase) ||
+        static_cast<size_t>(oend - op) < match_len)
+      return false;
+    auto ref = op - offset;
+    if (offset >= match_len) {
+      std::memcpy(op, ref, match_len);
+    } else { // overlapping, i.e. a repeated pattern
+      for (size_t i = 0; i < match_len; i++)
+        op[i] = ref[i];
+    }
+    op += match_len;
+  }
+  return op == oend;
+}
+
+} // namespace lz
+} // namespace midas
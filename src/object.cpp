@@ -1,6 +1,9 @@
+#include <memory>
+
 #include "object.hpp"
 #include "logging.hpp"
 #include "obj_locker.hpp"
+#include "resilient_func.hpp"
 #include "utils.hpp"
 
 namespace midas {
@@ -25,6 +28,7 @@ void ObjectPtr::unlock(LockID id) {
 }
 
 RetCode ObjectPtr::free(bool locked) noexcept {
+  EpochGuard guard;
   if (locked)
     return is_small_obj() ? free_small() : free_large();
 
@@ -40,30 +44,27 @@ RetCode ObjectPtr::free(bool locked) noexcept {
 }
 
 bool ObjectPtr::copy_from_small(const void *src, size_t len, int64_t offset) {
-  auto ret = false;
-  if (null())
-    return false;
-  auto lock_id = lock();
-  if (lock_id == INV_LOCK_ID) // lock failed as obj_ has just been reset.
-    return false;
-  if (!null()) {
-    MetaObjectHdr meta_hdr;
-    if (!load_hdr(meta_hdr, *this))
-      goto done;
-    if (!meta_hdr.is_present())
-      goto done;
-    meta_hdr.inc_accessed();
-    if (!store_hdr(meta_hdr, *this))
-      goto done;
-
-    ret = obj_.copy_from(src, len, hdr_size() + offset);
-  }
-done:
-  unlock(lock_id);
-  return ret;
+  ObjectIOVec iov{const_cast<void *>(src), len, offset};
+  return copy_iov_small(&iov, 1, /* to_obj = */ true);
 }
 
 bool ObjectPtr::copy_to_small(void *dst, size_t len, int64_t offset) {
+  ObjectIOVec iov{dst, len, offset};
+  return copy_iov_small(&iov, 1, /* to_obj = */ false);
+}
+
+bool ObjectPtr::copy_from_large(const void *src, size_t len, int64_t offset) {
+  ObjectIOVec iov{const_cast<void *>(src), len, offset};
+  return copy_iov_large(&iov, 1, /* to_obj = */ true);
+}
+
+bool ObjectPtr::copy_to_large(void *dst, size_t len, int64_t offset) {
+  ObjectIOVec iov{dst, len, offset};
+  return copy_iov_large(&iov, 1, /* to_obj = */ false);
+}
+
+bool ObjectPtr::copy_iov_small(const ObjectIOVec *iov, int nr_iov,
+                               bool to_obj) {
   auto ret = false;
   if (null())
     return false;
@@ -80,14 +81,21 @@ bool ObjectPtr::copy_to_small(void *dst, size_t len, int64_t offset) {
     if (!store_hdr(meta_hdr, *this))
       goto done;
 
-    ret = obj_.copy_to(dst, len, hdr_size() + offset);
+    for (int i = 0; i < nr_iov; i++) {
+      const auto &vec = iov[i];
+      if (!(to_obj ? obj_.copy_from(vec.buf, vec.len, hdr_size() + vec.offset)
+                   : obj_.copy_to(vec.buf, vec.len, hdr_size() + vec.offset)))
+        goto done;
+    }
+    ret = true;
   }
 done:
   unlock(lock_id);
   return ret;
 }
 
-bool ObjectPtr::copy_from_large(const void *src, size_t len, int64_t offset) {
+bool ObjectPtr::copy_iov_large(const ObjectIOVec *iov, int nr_iov,
+                               bool to_obj) {
   auto ret = false;
   if (null())
     return false;
@@ -104,37 +112,9 @@ bool ObjectPtr::copy_from_large(const void *src, size_t len, int64_t offset) {
     if (!store_hdr(meta_hdr, *this))
       goto done;
 
-    int64_t remaining_offset = offset;
-    ObjectPtr optr = *this;
-    while (remaining_offset > 0) {
-      if (optr.null())
-        goto fail_free;
-      if (remaining_offset < optr.data_size_in_segment())
-        break;
-      remaining_offset -= optr.data_size_in_segment();
-
-      if (iter_large(optr) != RetCode::Succ)
-        goto fail_free;
-    }
-    assert(remaining_offset < optr.data_size_in_segment());
-    // Now optr is pointing to the first part for copy
-    int64_t remaining_len = len;
-    while (remaining_len > 0) {
-      const auto copy_len = std::min<int64_t>(
-          remaining_len, optr.data_size_in_segment() - remaining_offset);
-      if (!optr.obj_.copy_from(src, copy_len,
-                               sizeof(LargeObjectHdr) + remaining_offset))
+    for (int i = 0; i < nr_iov; i++)
+      if (!copy_large_locked(iov[i], to_obj))
         goto fail_free;
-      remaining_offset = 0; // copy from the beginning for the following parts
-      remaining_len -= copy_len;
-      if (remaining_len <= 0)
-        break;
-      src = reinterpret_cast<const void *>(reinterpret_cast<uint64_t>(src) +
-                                           copy_len);
-
-      if (iter_large(optr) != RetCode::Succ)
-        goto fail_free;
-    }
     ret = true;
   }
 
@@ -148,12 +128,62 @@ fail_free:
   return ret;
 }
 
-bool ObjectPtr::copy_to_large(void *dst, size_t len, int64_t offset) {
-  auto ret = false;
-  if (null())
+// Must have the head chunk locked
+bool ObjectPtr::copy_large_locked(const ObjectIOVec &vec, bool to_obj) {
+  int64_t remaining_offset = vec.offset;
+  ObjectPtr optr = *this;
+  while (remaining_offset > 0) {
+    if (optr.null())
+      return false;
+    if (remaining_offset < optr.data_size_in_segment())
+      break;
+    remaining_offset -= optr.data_size_in_segment();
+
+    if (iter_large(optr) != RetCode::Succ)
+      return false;
+  }
+  assert(remaining_offset < optr.data_size_in_segment());
+  // Now optr is pointing to the first part for copy
+  auto buf = reinterpret_cast<uint64_t>(vec.buf);
+  int64_t remaining_len = vec.len;
+  while (remaining_len > 0) {
+    const auto copy_len = std::min<int64_t>(
+        remaining_len, optr.data_size_in_segment() - remaining_offset);
+    const auto obj_offset = sizeof(LargeObjectHdr) + remaining_offset;
+    if (!(to_obj ? optr.obj_.copy_from(reinterpret_cast<const void *>(buf),
+                                       copy_len, obj_offset)
+                 : optr.obj_.copy_to(reinterpret_cast<void *>(buf), copy_len,
+                                     obj_offset)))
+      return false;
+    remaining_offset = 0; // copy from the beginning for the following parts
+    remaining_len -= copy_len;
+    if (remaining_len <= 0)
+      break;
+    buf += copy_len;
+
+    if (iter_large(optr) != RetCode::Succ)
+      return false;
+  }
+  return true;
+}
+
+/* Runs @kernel (a resilient function) on the data address of the range. */
+template <typename Kernel>
+bool ObjectPtr::run_kernel(size_t len, int64_t offset, Kernel &&kernel) {
+  EpochGuard guard;
+  if (null() || offset < 0)
     return false;
+  if (offset + len > data_size_in_segment()) {
+    if (is_small_obj()) // beyond the object
+      return false;
+    auto buf = std::make_unique<char[]>(len);
+    if (!copy_to(buf.get(), len, offset))
+      return false;
+    return kernel(buf.get());
+  }
+  auto ret = false;
   auto lock_id = lock();
-  if (lock_id == INV_LOCK_ID)
+  if (lock_id == INV_LOCK_ID) // lock failed as obj_ has just been reset.
     return false;
   if (!null()) {
     MetaObjectHdr meta_hdr;
@@ -164,47 +194,53 @@ bool ObjectPtr::copy_to_large(void *dst, size_t len, int64_t offset) {
     meta_hdr.inc_accessed();
     if (!store_hdr(meta_hdr, *this))
       goto done;
-
-    int64_t remaining_offset = offset;
-    ObjectPtr optr = *this;
-    while (remaining_offset > 0) {
-      if (optr.null())
-        goto fail_free;
-      if (remaining_offset < optr.data_size_in_segment())
-        break;
-      remaining_offset -= optr.data_size_in_segment();
-
-      if (iter_large(optr) != RetCode::Succ)
-        goto fail_free;
-    }
-    // Now optr is pointing to the first part for copy
-    int64_t remaining_len = len;
-    while (remaining_len > 0) {
-      const auto copy_len = std::min<int64_t>(
-          remaining_len, optr.data_size_in_segment() - remaining_offset);
-      if (!optr.obj_.copy_to(dst, copy_len,
-                             sizeof(LargeObjectHdr) + remaining_offset))
-        goto fail_free;
-      remaining_offset = 0; // copy from the beginning for the following parts
-      remaining_len -= copy_len;
-      if (remaining_len <= 0)
-        break;
-      dst =
-          reinterpret_cast<void *>(reinterpret_cast<uint64_t>(dst) + copy_len);
-
-      if (iter_large(optr) != RetCode::Succ)
-        goto fail_free;
-    }
-    ret = true;
+    ret = kernel(reinterpret_cast<const void *>(obj_.to_normal_address() +
+                                                hdr_size() + offset));
   }
-
 done:
   unlock(lock_id);
   return ret;
+}
 
-fail_free:
-  free_large();
-  unlock(lock_id);
+bool ObjectPtr::compare(const void *buf, size_t len, int64_t offset,
+                        int *result) {
+  return run_kernel(len, offset, [&](const void *data) {
+    return rmemcmp(data, buf, len, result);
+  });
+}
+
+bool ObjectPtr::hash(size_t len, int64_t offset, uint64_t *hash) {
+  return run_kernel(len, offset,
+                    [&](const void *data) { return rhash(data, len, hash); });
+}
+
+bool ObjectPtr::find(const void *needle, size_t nlen, size_t len,
+                     int64_t offset, int64_t *pos) {
+  return run_kernel(len, offset, [&](const void *data) {
+    return rmemfind(data, len, needle, nlen, pos);
+  });
+}
+
+RetCode CompactObjectPtr::free() noexcept {
+  EpochGuard guard;
+  auto ret = RetCode::Fail;
+  while (true) {
+    auto raw = load();
+    if (!(raw & kNonNullBit))
+      break;
+    auto optr = unpack(raw);
+    auto lock_id = optr.lock();
+    if (lock_id == INV_LOCK_ID)
+      break;
+    // GC moves objects under their locks, so the check below is stable
+    const bool moved = load() != raw;
+    if (!moved)
+      ret = optr.free(/* locked = */ true);
+    ObjectPtr::unlock(lock_id);
+    if (!moved)
+      break;
+  }
+  reset();
   return ret;
 }
 
@@ -1,10 +1,23 @@
+#include <algorithm>
+#include <cpuid.h>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <immintrin.h>
+#include <iterator>
+#include <limits>
 
+#include "logging.hpp"
 #include "resilient_func.hpp"
+#include "time.hpp"
 #include "utils.hpp"
 
+/* The library is built for the baseline x86-64 ISA. Wider kernels are
+ * compiled for their own ISA and only called if the CPU supports it. */
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+
 namespace midas {
 
 // Must have len < 16 bytes. Manually unroll instructions for data < 16 bytes.
@@ -64,16 +77,17 @@ FORCE_INLINE void rmemcpy_avx128(void *dst, const void *src, size_t len) {
   if (dst_aligned && src_aligned)
     for (; nr_vwords > 0; nr_vwords--, src_vec++, dst_vec++)
       _mm_store_si128(dst_vec, _mm_load_si128(src_vec));
-  else
+  else // SSE2 only; lddqu would require SSE3
     for (; nr_vwords > 0; nr_vwords--, src_vec++, dst_vec++)
-      _mm_storeu_si128(dst_vec, _mm_lddqu_si128(src_vec));
+      _mm_storeu_si128(dst_vec, _mm_loadu_si128(src_vec));
 
   if (len)
     rmemcpy_small(dst_vec, src_vec, len);
 }
 
 /** YIFAN: In my experience it is not faster than avx128 for most cases. */
-FORCE_INLINE void rmemcpy_avx256(void *dst, const void *src, size_t len) {
+TARGET_AVX2 FORCE_INLINE void rmemcpy_avx256(void *dst, const void *src,
+                                             size_t len) {
   /* dst, src -> 32 bytes addresses
    * len -> divided into multiple of 32 */
   auto *dst_vec = reinterpret_cast<__m256i *>(dst);
@@ -89,14 +103,13 @@ FORCE_INLINE void rmemcpy_avx256(void *dst, const void *src, size_t len) {
 }
 
 /** YIFAN: In my experience it is not faster than avx128 for most cases. */
-FORCE_INLINE void rmemcpy_avx_unroll(void *dst, const void *src, size_t len) {
-  /* dst, src -> 256 byte aligned
-   * len -> multiple of 256 */
+TARGET_AVX512 FORCE_INLINE void rmemcpy_avx_unroll(void *dst, const void *src,
+                                                   size_t len) {
   auto *dst_vec = reinterpret_cast<__m512i *>(dst);
   const auto *src_vec = reinterpret_cast<const __m512i *>(src);
   size_t nr_vwords = len / sizeof(__m512i);
   len -= nr_vwords * sizeof(__m512i);
-  for (; nr_vwords > 0; nr_vwords -= 4, src_vec += 4, dst_vec += 4) {
+  for (; nr_vwords >= 4; nr_vwords -= 4, src_vec += 4, dst_vec += 4) {
     _mm512_storeu_si512(dst_vec + 0, _mm512_loadu_si512(src_vec));
     _mm512_storeu_si512(dst_vec + 1, _mm512_loadu_si512(src_vec + 1));
     _mm512_storeu_si512(dst_vec + 2, _mm512_loadu_si512(src_vec + 2));
@@ -110,11 +123,53 @@ FORCE_INLINE void rmemcpy_avx_unroll(void *dst, const void *src, size_t len) {
   }
 }
 
-/**
- * YIFAN: within 20% overhead compared to std::memcpy for small data (< 16
- * bytes). ~30% faster than std::memcpy for large data (>= 512 bytes).
+/* Streaming stores need an aligned dst, so the head is copied normally. The
+ * written lines are not cached: use only for data that is not read soon. */
+FORCE_INLINE void rmemcpy_stream128(void *dst, const void *src, size_t len) {
+  /* len >= 16 */
+  size_t head = -reinterpret_cast<uint64_t>(dst) & (sizeof(__m128i) - 1);
+  rmemcpy_tiny(reinterpret_cast<uint8_t *>(dst),
+               reinterpret_cast<const uint8_t *>(src), head);
+  auto *dst_vec = reinterpret_cast<__m128i *>(
+      reinterpret_cast<uint8_t *>(dst) + head);
+  const auto *src_vec = reinterpret_cast<const __m128i *>(
+      reinterpret_cast<const uint8_t *>(src) + head);
+  len -= head;
+
+  size_t nr_vwords = len / sizeof(__m128i);
+  len -= nr_vwords * sizeof(__m128i);
+  for (; nr_vwords > 0; nr_vwords--, src_vec++, dst_vec++)
+    _mm_stream_si128(dst_vec, _mm_loadu_si128(src_vec));
+  _mm_sfence();
+
+  if (len)
+    rmemcpy_small(dst_vec, src_vec, len);
+}
+
+TARGET_AVX512 FORCE_INLINE void rmemcpy_stream512(void *dst, const void *src,
+                                                  size_t len) {
+  /* len >= 64 */
+  size_t head = -reinterpret_cast<uint64_t>(dst) & (sizeof(__m512i) - 1);
+  rmemcpy_small(dst, src, head);
+  auto *dst_vec = reinterpret_cast<__m512i *>(
+      reinterpret_cast<uint8_t *>(dst) + head);
+  const auto *src_vec = reinterpret_cast<const __m512i *>(
+      reinterpret_cast<const uint8_t *>(src) + head);
+  len -= head;
+
+  size_t nr_vwords = len / sizeof(__m512i);
+  len -= nr_vwords * sizeof(__m512i);
+  for (; nr_vwords > 0; nr_vwords--, src_vec++, dst_vec++)
+    _mm512_stream_si512(dst_vec, _mm512_loadu_si512(src_vec));
+  _mm_sfence();
+
+  if (len)
+    rmemcpy_small(dst_vec, src_vec, len);
+}
+
+/* Handles the cases shared by all kernels. Returns true if the copy is done.
  */
-bool rmemcpy(void *dst, const void *src, size_t len) {
+FORCE_INLINE bool rmemcpy_short(void *dst, const void *src, size_t len) {
   if (src == dst || len == 0)
     return true;
   if (UNLIKELY(len < sizeof(__m128i))) { // sizeof(__m128i) == 16
@@ -122,9 +177,278 @@ bool rmemcpy(void *dst, const void *src, size_t len) {
                  reinterpret_cast<const uint8_t *>(src), len);
     return true;
   }
-  rmemcpy_avx128(dst, src, len);
+  return false;
+}
+
+/**
+ * YIFAN: within 20% overhead compared to std::memcpy for small data (< 16
+ * bytes). ~30% faster than std::memcpy for large data (>= 512 bytes).
+ */
+bool rmemcpy_v128(void *dst, const void *src, size_t len) {
+  if (!rmemcpy_short(dst, src, len))
+    rmemcpy_avx128(dst, src, len);
+  return true;
+}
+DELIM_FUNC_IMPL(rmemcpy_v128)
+
+TARGET_AVX2 bool rmemcpy_v256(void *dst, const void *src, size_t len) {
+  if (!rmemcpy_short(dst, src, len))
+    rmemcpy_avx256(dst, src, len);
+  return true;
+}
+DELIM_FUNC_IMPL(rmemcpy_v256)
+
+TARGET_AVX512 bool rmemcpy_v512(void *dst, const void *src, size_t len) {
+  if (!rmemcpy_short(dst, src, len))
+    rmemcpy_avx_unroll(dst, src, len);
+  return true;
+}
+DELIM_FUNC_IMPL(rmemcpy_v512)
+
+bool rmemcpy_rep(void *dst, const void *src, size_t len) {
+  if (!rmemcpy_short(dst, src, len))
+    rmemcpy_ermsb(dst, src, len);
   return true;
 }
-DELIM_FUNC_IMPL(rmemcpy)
+DELIM_FUNC_IMPL(rmemcpy_rep)
+
+bool rmemcpy_nt128(void *dst, const void *src, size_t len) {
+  if (!rmemcpy_short(dst, src, len))
+    rmemcpy_stream128(dst, src, len);
+  return true;
+}
+DELIM_FUNC_IMPL(rmemcpy_nt128)
+
+TARGET_AVX512 bool rmemcpy_nt512(void *dst, const void *src, size_t len) {
+  if (rmemcpy_short(dst, src, len))
+    return true;
+  if (len < sizeof(__m512i))
+    rmemcpy_avx128(dst, src, len);
+  else
+    rmemcpy_stream512(dst, src, len);
+  return true;
+}
+DELIM_FUNC_IMPL(rmemcpy_nt512)
+
+/**
+ * Kernels below read soft memory in place. Like rmemcpy they must stay leaf
+ * functions that neither call out nor spill callee-saved registers, so that
+ * the fault handler can return false from any faulting instruction.
+ */
+bool rmemcmp(const void *lhs, const void *rhs, size_t len, int *result) {
+  auto l = reinterpret_cast<const uint8_t *>(lhs);
+  auto r = reinterpret_cast<const uint8_t *>(rhs);
+  for (; len >= sizeof(uint64_t); len -= sizeof(uint64_t)) {
+    if (*reinterpret_cast<const uint64_t *>(l) !=
+        *reinterpret_cast<const uint64_t *>(r))
+      break; // the differing byte is located below
+    l += sizeof(uint64_t);
+    r += sizeof(uint64_t);
+  }
+  for (; len > 0; len--, l++, r++) {
+    if (*l != *r) {
+      *result = *l < *r ? -1 : 1;
+      return true;
+    }
+  }
+  *result = 0;
+  return true;
+}
+DELIM_FUNC_IMPL(rmemcmp)
+
+/* Same as robin_hood::hash_bytes(), so it agrees with hashes computed over
+ * normal memory. */
+bool rhash(const void *data, size_t len, uint64_t *hash) {
+  constexpr static uint64_t m = 0xc6a4a7935bd1e995ull;
+  constexpr static uint64_t seed = 0xe17a1465ull;
+  constexpr static unsigned int r = 47;
+
+  auto data64 = reinterpret_cast<const uint64_t *>(data);
+  uint64_t h = seed ^ (len * m);
+  const size_t n_blocks = len / 8;
+  for (size_t i = 0; i < n_blocks; i++) {
+    uint64_t k;
+    __builtin_memcpy(&k, data64 + i, sizeof(k)); // unaligned load
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+  auto data8 = reinterpret_cast<const uint8_t *>(data64 + n_blocks);
+  const size_t tail = len & 7u;
+  if (tail) {
+    for (size_t i = tail; i > 0; i--)
+      h ^= static_cast<uint64_t>(data8[i - 1]) << ((i - 1) * 8);
+    h *= m;
+  }
+  h ^= h >> r;
+  *hash = h;
+  return true;
+}
+DELIM_FUNC_IMPL(rhash)
+
+bool rmemfind(const void *data, size_t len, const void *needle, size_t nlen,
+              int64_t *pos) {
+  auto d = reinterpret_cast<const uint8_t *>(data);
+  auto n = reinterpret_cast<const uint8_t *>(needle);
+  *pos = -1;
+  if (nlen == 0 || nlen > len) {
+    *pos = nlen == 0 ? 0 : -1;
+    return true;
+  }
+  for (size_t i = 0; i + nlen <= len; i++) {
+    if (d[i] != n[0])
+      continue;
+    size_t j = 1;
+    while (j < nlen && d[i + j] == n[j])
+      j++;
+    if (j == nlen) {
+      *pos = i;
+      return true;
+    }
+  }
+  return true;
+}
+DELIM_FUNC_IMPL(rmemfind)
+
+/** Runtime dispatch of rmemcpy */
+constexpr static size_t kNoThreshold = std::numeric_limits<size_t>::max();
+
+RMemcpyConfig rmemcpy_config = {
+    {rmemcpy_v128}, {rmemcpy_nt128}, {kNoThreshold}, {kNoThreshold}};
+
+// enhanced rep movsb, CPUID.(EAX=7, ECX=0):EBX[9]
+static bool cpu_has_erms() {
+  uint32_t eax, ebx, ecx, edx;
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    return false;
+  return ebx & (1u << 9);
+}
+
+/* Runs before main(). rmemcpy_config is usable before that as well since it
+ * is statically initialized with the baseline kernels. */
+__attribute__((constructor)) static void rmemcpy_select() {
+  __builtin_cpu_init();
+  auto &cfg = rmemcpy_config;
+  if (__builtin_cpu_supports("avx512f")) {
+    cfg.copy = rmemcpy_v512;
+    cfg.stream = rmemcpy_nt512;
+  } else if (__builtin_cpu_supports("avx2")) {
+    cfg.copy = rmemcpy_v256;
+  }
+}
+
+constexpr static size_t kCalibBufSize = 32ul << 20; // beyond most LLCs
+constexpr static size_t kCalibBytes = 16ul << 20;   // copied per measurement
+constexpr static int kCalibRounds = 3;
+constexpr static size_t kCalibLens[] = {256,       1024,    4096,
+                                        16 << 10,  64 << 10, 256 << 10,
+                                        1ul << 20, 4ul << 20, 16ul << 20};
+constexpr static size_t kNumCalibLens = std::size(kCalibLens);
+constexpr static size_t kCalibShortLen = 64 << 10; // lengths served by copy
+
+struct RMemcpyKernel {
+  const char *name;
+  RMemcpyFunc func;
+  double time[kNumCalibLens];
+};
+
+/* Best-of-rounds time to copy kCalibBytes in pieces of @len. The copies
+ * cycle through a window of 64 pieces, which stays in cache for short
+ * lengths and misses it for long ones, as real copies tend to. */
+static double time_copy(RMemcpyFunc func, uint8_t *dst, const uint8_t *src,
+                        size_t len) {
+  const size_t window = std::min(kCalibBufSize, len * 64);
+  const size_t nr_copies = std::max<size_t>(1, kCalibBytes / len);
+  double best = std::numeric_limits<double>::max();
+  for (int round = 0; round < kCalibRounds; round++) {
+    size_t offset = 0;
+    auto stt = chrono_utils::now();
+    for (size_t i = 0; i < nr_copies; i++) {
+      func(dst + offset, src + offset, len);
+      offset += len;
+      if (offset + len > window)
+        offset = 0;
+    }
+    auto end = chrono_utils::now();
+    best = std::min(best, chrono_utils::duration(stt, end));
+  }
+  return best;
+}
+
+/* Shortest calibrated length from which @fast beats @slow on every longer
+ * length as well. */
+static size_t crossover(const double *fast, const double *slow) {
+  size_t threshold = kNoThreshold;
+  for (int i = kNumCalibLens - 1; i >= 0 && fast[i] < slow[i]; i--)
+    threshold = kCalibLens[i];
+  return threshold;
+}
+
+void rmemcpy_calibrate() {
+  auto src =
+      reinterpret_cast<uint8_t *>(aligned_alloc(kPageSize, kCalibBufSize));
+  auto dst =
+      reinterpret_cast<uint8_t *>(aligned_alloc(kPageSize, kCalibBufSize));
+  if (!src || !dst) {
+    MIDAS_LOG(kError) << "Failed to allocate calibration buffers";
+    free(src);
+    free(dst);
+    return;
+  }
+  std::memset(src, 0xab, kCalibBufSize);
+  std::memset(dst, 0, kCalibBufSize);
+
+  const bool avx512 = __builtin_cpu_supports("avx512f");
+  RMemcpyKernel kernels[] = {
+      {"v128", rmemcpy_v128},
+      {"v256", __builtin_cpu_supports("avx2") ? rmemcpy_v256 : nullptr},
+      {"v512", avx512 ? rmemcpy_v512 : nullptr},
+      {"rep", cpu_has_erms() ? rmemcpy_rep : nullptr},
+      {"nt", avx512 ? rmemcpy_nt512 : rmemcpy_nt128}};
+  auto &rep = kernels[3];
+  auto &stream = kernels[4];
+  for (auto &kernel : kernels) {
+    for (size_t i = 0; i < kNumCalibLens; i++)
+      kernel.time[i] = kernel.func
+                           ? time_copy(kernel.func, dst, src, kCalibLens[i])
+                           : std::numeric_limits<double>::max();
+  }
+  free(src);
+  free(dst);
+
+  // the vector kernel that is fastest on the short lengths it serves
+  RMemcpyKernel *copy = &kernels[0];
+  double best = std::numeric_limits<double>::max();
+  for (int k = 0; k < 3; k++) { // v128, v256, v512
+    if (!kernels[k].func)
+      continue;
+    double total = 0;
+    for (size_t i = 0; i < kNumCalibLens && kCalibLens[i] < kCalibShortLen; i++)
+      total += kernels[k].time[i];
+    if (total < best) {
+      best = total;
+      copy = &kernels[k];
+    }
+  }
+  double temporal[kNumCalibLens];
+  for (size_t i = 0; i < kNumCalibLens; i++)
+    temporal[i] = std::min(copy->time[i], rep.time[i]);
+  const auto rep_threshold = crossover(rep.time, copy->time);
+  const auto stream_threshold = crossover(stream.time, temporal);
+
+  auto &cfg = rmemcpy_config;
+  cfg.copy = copy->func;
+  cfg.stream = stream.func;
+  cfg.rep_threshold = rep_threshold;
+  cfg.stream_threshold = stream_threshold;
+  MIDAS_LOG(kInfo) << "rmemcpy calibrated: copy = " << copy->name
+                   << ", rep from "
+                   << (rep_threshold == kNoThreshold ? 0 : rep_threshold)
+                   << "B, stream from "
+                   << (stream_threshold == kNoThreshold ? 0 : stream_threshold)
+                   << "B (0 = never)";
+}
 
-} // namespace midas
\ No newline at end of file
+} // namespace midas
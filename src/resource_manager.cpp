@@ -9,13 +9,16 @@
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "base_soft_mem_pool.hpp"
 #include "cache_manager.hpp"
+#include "epoch.hpp"
 #include "evacuator.hpp"
 #include "logging.hpp"
 #include "qpair.hpp"
 #include "resource_manager.hpp"
+#include "runtime.hpp"
 #include "shm_types.hpp"
 #include "time.hpp"
 #include "utils.hpp"
@@ -29,6 +32,10 @@ constexpr static int32_t kMonitorTimeout = 1; // seconds
 constexpr static int32_t kDisconnTimeout = 3; // seconds
 constexpr static bool kEnableFreeList = true;
 constexpr static int32_t kFreeListSize = 512;
+constexpr static bool kEnableStatsBoard = true;
+constexpr static auto kStatsPublishInterval = std::chrono::milliseconds(100);
+// update alloc tput and print the pools' reports every 5s
+constexpr static int32_t kAllocTputRounds = 50;
 
 std::atomic_int64_t Region::global_mapped_rid_{0};
 
@@ -66,25 +73,52 @@ void Region::free() noexcept {
 ResourceManager::ResourceManager(BaseSoftMemPool *cpool,
                                  const std::string &daemon_name) noexcept
     : cpool_(cpool), id_(get_unique_id()), region_limit_(0),
-      txqp_(std::make_shared<QSingle>(utils::get_sq_name(daemon_name, false),
-                                      false),
-            std::make_shared<QSingle>(utils::get_ackq_name(daemon_name, id_),
-                                      true)),
-      rxqp_(std::to_string(id_), true), stop_(false), nr_pending_(0), stats_() {
+      txqp_(std::make_shared<QPair>(
+          std::make_shared<QSingle>(utils::get_sq_name(daemon_name, false),
+                                    false),
+          std::make_shared<QSingle>(utils::get_ackq_name(daemon_name, id_),
+                                    true))),
+      rxqp_(std::make_shared<QPair>(std::to_string(id_), true)),
+      conn_mtx_(std::make_shared<std::mutex>()), runtime_(nullptr),
+      stop_(false), nr_pending_(0), board_stats_(), stats_() {
   handler_thd_ = std::make_shared<std::thread>([&]() { pressure_handler(); });
   if (!cpool_)
     cpool_ = CachePool::global_cache_pool();
   assert(cpool_);
+  // the board must exist before the daemon maps it on connection
+  if (kEnableStatsBoard) {
+    stats_board_ = std::make_unique<StatsBoard>(id_, true);
+    if (stats_board_->valid())
+      publisher_thd_ =
+          std::make_shared<std::thread>([&]() { stats_publisher(); });
+  }
   connect(daemon_name);
 }
 
+ResourceManager::ResourceManager(BaseSoftMemPool *cpool,
+                                 std::shared_ptr<Runtime> runtime) noexcept
+    : cpool_(cpool), id_(runtime->id_), region_limit_(0),
+      txqp_(runtime->txqp_), rxqp_(runtime->rxqp_),
+      conn_mtx_(runtime->conn_mtx_), runtime_(runtime), stop_(false),
+      nr_pending_(0), board_stats_(), stats_() {
+  assert(cpool_);
+  // budget is handed out by the runtime on demand
+  runtime_->attach(this);
+}
+
 ResourceManager::~ResourceManager() noexcept {
+  if (runtime_) { // the connection belongs to the runtime
+    runtime_->detach(this);
+    return;
+  }
   stop_ = true;
   handler_thd_->join();
+  if (publisher_thd_)
+    publisher_thd_->join();
 
   disconnect();
-  rxqp_.destroy();
-  txqp_.RecvQ().destroy();
+  rxqp_->destroy();
+  txqp_->RecvQ().destroy();
 }
 
 std::shared_ptr<ResourceManager>
@@ -101,8 +135,8 @@ int64_t ResourceManager::reclaim_target() noexcept {
   constexpr static float kAvailRatioThresh = 0.01;
   int64_t nr_avail = NumRegionAvail();
   int64_t nr_limit = NumRegionLimit();
-  if (nr_limit <= 1)
-    return 0;
+  if (nr_limit <= 1) // too small for a headroom, only free up the next region
+    return std::max<int64_t>(1 - nr_avail, 0);
   int64_t target_avail = nr_limit * kAvailRatioThresh;
   int64_t nr_to_reclaim = nr_pending_;
   auto headroom = std::max<int64_t>(reclaim_headroom(), target_avail);
@@ -145,7 +179,7 @@ int32_t ResourceManager::reclaim_nr_thds() noexcept {
 }
 
 /** Profiling for stats */
-inline void ResourceManager::prof_alloc_tput() {
+void ResourceManager::prof_alloc_tput() {
   auto time = Time::get_us();
   if (stats_.prev_time == 0) { // init
     stats_.prev_time = time;
@@ -195,8 +229,8 @@ int ResourceManager::connect(const std::string &daemon_name) noexcept {
     unsigned int prio = 0;
     CtrlMsg msg{.id = id_, .op = CtrlOpCode::CONNECT};
 
-    txqp_.send(&msg, sizeof(CtrlMsg));
-    int ret = txqp_.recv(&msg, sizeof(CtrlMsg));
+    txqp_->send(&msg, sizeof(CtrlMsg));
+    int ret = txqp_->recv(&msg, sizeof(CtrlMsg));
     if (ret) {
       return -1;
     }
@@ -214,14 +248,20 @@ int ResourceManager::connect(const std::string &daemon_name) noexcept {
   return 0;
 }
 
+int ResourceManager::request(const CtrlMsg &msg, CtrlMsg *ack) noexcept {
+  std::unique_lock<std::mutex> ul(*conn_mtx_);
+  txqp_->send(&msg, sizeof(msg));
+  return txqp_->recv(ack, sizeof(*ack));
+}
+
 int ResourceManager::disconnect() noexcept {
   std::unique_lock<std::mutex> lk(mtx_);
   try {
     unsigned int prio = 0;
     CtrlMsg msg{.id = id_, .op = CtrlOpCode::DISCONNECT};
 
-    txqp_.send(&msg, sizeof(CtrlMsg));
-    int ret = txqp_.timed_recv(&msg, sizeof(CtrlMsg), kDisconnTimeout);
+    txqp_->send(&msg, sizeof(CtrlMsg));
+    int ret = txqp_->timed_recv(&msg, sizeof(CtrlMsg), kDisconnTimeout);
     if (ret)
       return -1;
     if (msg.op == CtrlOpCode::DISCONNECT && msg.ret == CtrlRetCode::CONN_SUCC)
@@ -242,7 +282,7 @@ void ResourceManager::pressure_handler() {
 
   while (!stop_) {
     CtrlMsg msg;
-    if (rxqp_.timed_recv(&msg, sizeof(msg), kMonitorTimeout) != 0)
+    if (rxqp_->timed_recv(&msg, sizeof(msg), kMonitorTimeout) != 0)
       continue;
 
     MIDAS_LOG(kDebug) << "PressureHandler recved msg " << msg.op;
@@ -264,20 +304,22 @@ void ResourceManager::pressure_handler() {
   }
 }
 
-void ResourceManager::do_update_limit(CtrlMsg &msg) {
-  assert(msg.mmsg.size != 0);
-  auto new_region_limit = msg.mmsg.size;
+bool ResourceManager::apply_limit(uint64_t new_limit, bool force) noexcept {
   MIDAS_LOG(kInfo) << "Client " << id_ << " update limit: " << region_limit_
-                   << "->" << new_region_limit;
-  region_limit_ = new_region_limit;
+                   << "->" << new_limit;
+  region_limit_ = new_limit;
+  if (force) {
+    force_reclaim();
+    return true;
+  }
 
-  CtrlMsg ack{.op = CtrlOpCode::UPDLIMIT, .ret = CtrlRetCode::MEM_SUCC};
+  bool succ = true;
   if (NumRegionAvail() < 0) { // under memory pressure
     auto before_usage = NumRegionInUse();
     MIDAS_LOG_PRINTF(kInfo, "Memory shrinkage: %ld to reclaim (%ld->%ld).\n",
                      -NumRegionAvail(), NumRegionInUse(), NumRegionLimit());
     if (!reclaim()) // failed to reclaim enough memory
-      ack.ret = CtrlRetCode::MEM_FAIL;
+      succ = false;
     auto after_usage = NumRegionInUse();
     auto nr_reclaimed = before_usage - after_usage;
     MIDAS_LOG_PRINTF(kInfo, "Memory shrinkage: %ld reclaimed (%ld/%ld).\n",
@@ -285,22 +327,25 @@ void ResourceManager::do_update_limit(CtrlMsg &msg) {
   } else if (reclaim_trigger()) { // concurrent GC if needed
     cpool_->get_evacuator()->signal_gc();
   }
+  return succ;
+}
+
+void ResourceManager::do_update_limit(CtrlMsg &msg) {
+  assert(msg.mmsg.size != 0);
+  CtrlMsg ack{.op = CtrlOpCode::UPDLIMIT, .ret = CtrlRetCode::MEM_SUCC};
+  if (!apply_limit(msg.mmsg.size, false))
+    ack.ret = CtrlRetCode::MEM_FAIL;
   ack.mmsg.size = region_map_.size() + freelist_.size();
-  rxqp_.send(&ack, sizeof(ack));
+  rxqp_->send(&ack, sizeof(ack));
 }
 
 void ResourceManager::do_force_reclaim(CtrlMsg &msg) {
   assert(msg.mmsg.size != 0);
-  auto new_region_limit = msg.mmsg.size;
-  MIDAS_LOG(kInfo) << "Client " << id_ << " update limit: " << region_limit_
-                   << "->" << new_region_limit;
-  region_limit_ = new_region_limit;
-
-  force_reclaim();
+  apply_limit(msg.mmsg.size, true);
 
   CtrlMsg ack{.op = CtrlOpCode::UPDLIMIT, .ret = CtrlRetCode::MEM_SUCC};
   ack.mmsg.size = region_map_.size() + freelist_.size();
-  rxqp_.send(&ack, sizeof(ack));
+  rxqp_->send(&ack, sizeof(ack));
 }
 
 void ResourceManager::do_profile_stats(CtrlMsg &msg) {
@@ -308,7 +353,30 @@ void ResourceManager::do_profile_stats(CtrlMsg &msg) {
   cpool_->profile_stats(&stats);
   prof_alloc_tput();
   stats.headroom = stats_.headroom;
-  rxqp_.send(&stats, sizeof(stats));
+  rxqp_->send(&stats, sizeof(stats));
+}
+
+void ResourceManager::stats_publisher() {
+  int32_t rounds = 0;
+  while (!stop_) {
+    if (++rounds % kAllocTputRounds == 0) {
+      prof_alloc_tput();
+      cpool_->profile_stats();
+    }
+    publish_stats();
+    std::this_thread::sleep_for(kStatsPublishInterval);
+  }
+}
+
+void ResourceManager::publish_stats() noexcept {
+  cpool_->collect_stats(&board_stats_);
+  board_stats_.nr_regions = NumRegionInUse();
+  board_stats_.region_limit = NumRegionLimit();
+  board_stats_.alloc_tput = stats_.alloc_tput;
+  board_stats_.reclaim_tput = stats_.reclaim_tput;
+  board_stats_.headroom = stats_.headroom;
+  board_stats_.timestamp = StatsBoard::now_us();
+  stats_board_->publish(board_stats_);
 }
 
 void ResourceManager::do_disconnect(CtrlMsg &msg) {
@@ -368,20 +436,24 @@ bool ResourceManager::force_reclaim() {
 void ResourceManager::SetWeight(float weight) noexcept {
   CtrlMsg msg{
       .id = id_, .op = CtrlOpCode::SET_WEIGHT, .mmsg = {.weight = weight}};
-  txqp_.send(&msg, sizeof(msg));
+  txqp_->send(&msg, sizeof(msg));
 }
 
 void ResourceManager::SetLatCritical(bool value) noexcept {
   CtrlMsg msg{.id = id_,
               .op = CtrlOpCode::SET_LAT_CRITICAL,
               .mmsg = {.lat_critical = value}};
-  txqp_.send(&msg, sizeof(msg));
+  txqp_->send(&msg, sizeof(msg));
 }
 
 void ResourceManager::UpdateLimit(size_t size) noexcept {
+  if (runtime_) { // the runtime asks for the sum of its pools' requests
+    runtime_->update_limit(this, size);
+    return;
+  }
   CtrlMsg msg{
       .id = id_, .op = CtrlOpCode::UPDLIMIT_REQ, .mmsg = {.size = size}};
-  txqp_.send(&msg, sizeof(msg));
+  txqp_->send(&msg, sizeof(msg));
 }
 
 int64_t ResourceManager::AllocRegion(bool overcommit) noexcept {
@@ -393,6 +465,11 @@ retry:
     return -1;
   }
   retry_cnt++;
+  // pools in a shared runtime borrow idle budget before evicting their data
+  if (runtime_ && !overcommit && NumRegionAvail() <= reclaim_headroom())
+    runtime_->grow(this, reclaim_headroom() - NumRegionAvail() + 1);
+  if (!overcommit && NumRegionAvail() <= 0) // retired regions may be safe now
+    ReclaimRetired();
   if (!overcommit && reclaim_trigger()) {
     if (NumRegionAvail() <= 0) { // block waiting for reclamation
       if (kEnableFaultHandler && retry_cnt >= kMaxAllocRetry / 2)
@@ -403,11 +480,17 @@ retry:
       cpool_->get_evacuator()->signal_gc();
   }
 
-  // 1) Fast path. Allocate from freelist
+  // 1) Fast path. Allocate from freelist (or the runtime's region reserve)
   std::unique_lock<std::mutex> lk(mtx_);
+  std::shared_ptr<Region> reserved;
   if (!freelist_.empty()) {
-    auto region = freelist_.back();
+    reserved = freelist_.back();
     freelist_.pop_back();
+  } else if (runtime_ && (overcommit || NumRegionAvail() > 0)) {
+    reserved = runtime_->take_region();
+  }
+  if (reserved) {
+    auto region = std::move(reserved);
     region->map();
     int64_t region_id = region->ID();
     region_map_[region_id] = region;
@@ -424,17 +507,17 @@ retry:
   CtrlMsg msg{.id = id_,
               .op = overcommit ? CtrlOpCode::OVERCOMMIT : CtrlOpCode::ALLOC,
               .mmsg = {.size = kRegionSize}};
-  txqp_.send(&msg, sizeof(msg));
-
-  unsigned prio;
   CtrlMsg ret_msg;
-  int ret = txqp_.recv(&ret_msg, sizeof(ret_msg));
+  int ret = request(msg, &ret_msg);
   if (ret) {
     MIDAS_LOG(kError) << "Allocation error: " << ret;
     return -1;
   }
   if (ret_msg.ret != CtrlRetCode::MEM_SUCC) {
     lk.unlock();
+    // budget taken from other pools frees up once they evict down to it
+    if (runtime_ && !overcommit)
+      std::this_thread::sleep_for(kReclaimTimeout);
     goto retry;
   }
 
@@ -466,6 +549,36 @@ void ResourceManager::FreeRegion(int64_t rid) noexcept {
   }
 }
 
+void ResourceManager::RetireRegion(int64_t rid) noexcept {
+  // the segment is unlinked already, so mutators entering from now on
+  // cannot reach the region
+  auto epoch = EpochManager::global_epoch_manager()->advance();
+  {
+    std::unique_lock<std::mutex> ul(retired_mtx_);
+    retired_.emplace_back(epoch, rid);
+  }
+  nr_retired_++;
+  ReclaimRetired();
+}
+
+int64_t ResourceManager::ReclaimRetired() noexcept {
+  if (nr_retired_ == 0)
+    return 0;
+  auto min_epoch = EpochManager::global_epoch_manager()->min_active();
+  std::vector<int64_t> rids;
+  {
+    std::unique_lock<std::mutex> ul(retired_mtx_);
+    while (!retired_.empty() && retired_.front().first < min_epoch) {
+      rids.emplace_back(retired_.front().second);
+      retired_.pop_front();
+    }
+  }
+  nr_retired_ -= rids.size();
+  for (auto rid : rids)
+    FreeRegion(rid);
+  return rids.size();
+}
+
 void ResourceManager::FreeRegions(size_t size) noexcept {
   std::unique_lock<std::mutex> lk(mtx_);
   size_t total_freed = 0;
@@ -497,19 +610,22 @@ inline size_t ResourceManager::free_region(std::shared_ptr<Region> region,
           memory allocated by the evacuator);
    *  (3) freelist is not full.
    */
-  if (kEnableFreeList && !enforce && NumRegionAvail() > 0 &&
-      freelist_.size() < kFreeListSize) {
-    region->unmap();
-    freelist_.emplace_back(region);
-  } else {
+  bool stashed = false;
+  if (kEnableFreeList && !enforce && NumRegionAvail() > 0) {
+    if (runtime_) { // stash into the reserve shared with other pools
+      stashed = runtime_->stash_region(region);
+    } else if (freelist_.size() < kFreeListSize) {
+      region->unmap();
+      freelist_.emplace_back(region);
+      stashed = true;
+    }
+  }
+  if (!stashed) {
     CtrlMsg msg{.id = id_,
                 .op = CtrlOpCode::FREE,
                 .mmsg = {.region_id = rid, .size = rsize}};
-    txqp_.send(&msg, sizeof(msg));
-
     CtrlMsg ack;
-    unsigned prio;
-    int ret = txqp_.recv(&ack, sizeof(ack));
+    int ret = request(msg, &ack);
     assert(ret == 0);
     if (ack.op != CtrlOpCode::FREE || ack.ret != CtrlRetCode::MEM_SUCC)
       return -1;
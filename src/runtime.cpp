@@ -0,0 +1,526 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base_soft_mem_pool.hpp"
+#include "evacuator.hpp"
+#include "logging.hpp"
+#include "qpair.hpp"
+#include "resource_manager.hpp"
+#include "runtime.hpp"
+#include "shm_types.hpp"
+#include "stats_board.hpp"
+#include "utils.hpp"
+
+namespace midas {
+constexpr static int32_t kMonitorTimeout = 1; // seconds
+constexpr static int32_t kDisconnTimeout = 3; // seconds
+constexpr static int32_t kReserveSize = 512;  // max #regions in the reserve
+constexpr static bool kEnableStatsBoard = true;
+constexpr static auto kStatsPublishInterval = std::chrono::milliseconds(100);
+// update alloc tput and print the pools' reports every 5s
+constexpr static int32_t kAllocTputRounds = 50;
+
+std::atomic_bool Runtime::enabled_{false};
+
+Runtime::Runtime(const std::string &daemon_name)
+    : id_(get_unique_id()),
+      txqp_(std::make_shared<QPair>(
+          std::make_shared<QSingle>(utils::get_sq_name(daemon_name, false),
+                                    false),
+          std::make_shared<QSingle>(utils::get_ackq_name(daemon_name, id_),
+                                    true))),
+      rxqp_(std::make_shared<QPair>(std::to_string(id_), true)),
+      conn_mtx_(std::make_shared<std::mutex>()), region_limit_(0),
+      free_budget_(0), detached_stats_(), stop_(false) {
+  // the board must exist before the daemon maps it on connection
+  if (kEnableStatsBoard) {
+    stats_board_ = std::make_unique<StatsBoard>(id_, true);
+    if (!stats_board_->valid())
+      stats_board_.reset();
+  }
+  connect(daemon_name);
+  handler_thd_ = std::make_shared<std::thread>([&]() { pressure_handler(); });
+  if (stats_board_)
+    publisher_thd_ = std::make_shared<std::thread>([&]() { stats_publisher(); });
+  for (int i = 0; i < kNumGCThds; i++)
+    gc_thds_.emplace_back([&]() { gc_worker(); });
+}
+
+Runtime::~Runtime() {
+  {
+    std::unique_lock<std::mutex> ul(gc_mtx_);
+    stop_ = true;
+    gc_cv_.notify_all();
+  }
+  for (auto &thd : gc_thds_)
+    thd.join();
+  handler_thd_->join();
+  if (publisher_thd_)
+    publisher_thd_->join();
+  reserve_.clear();
+
+  disconnect();
+  rxqp_->destroy();
+  txqp_->RecvQ().destroy();
+}
+
+void Runtime::enable() noexcept { enabled_ = true; }
+
+bool Runtime::enabled() noexcept { return enabled_; }
+
+std::shared_ptr<Runtime> Runtime::global_runtime_shared_ptr() noexcept {
+  static std::mutex mtx_;
+  static std::shared_ptr<Runtime> runtime_;
+  if (runtime_)
+    return runtime_;
+  std::unique_lock<std::mutex> ul(mtx_);
+  if (runtime_)
+    return runtime_;
+  runtime_ = std::make_shared<Runtime>();
+  return runtime_;
+}
+
+Runtime *Runtime::global_runtime() noexcept {
+  return global_runtime_shared_ptr().get();
+}
+
+uint64_t Runtime::id() const noexcept { return id_; }
+
+size_t Runtime::num_pools() noexcept {
+  std::unique_lock<std::mutex> ul(mtx_);
+  return pools_.size();
+}
+
+uint64_t Runtime::region_limit() const noexcept { return region_limit_; }
+
+/** Pool membership */
+void Runtime::attach(ResourceManager *rmanager) {
+  std::unique_lock<std::mutex> ul(mtx_);
+  pools_.emplace_back(rmanager);
+  MIDAS_LOG(kInfo) << "Runtime " << id_ << " attached a pool, "
+                   << pools_.size() << " pools in total";
+}
+
+void Runtime::detach(ResourceManager *rmanager) {
+  std::unique_lock<std::mutex> apply_ul(apply_mtx_);
+  std::list<std::shared_ptr<Region>> regions;
+  {
+    std::unique_lock<std::mutex> ul(rmanager->mtx_);
+    for (auto &[_, region] : rmanager->region_map_)
+      regions.emplace_back(region);
+    rmanager->region_map_.clear();
+    regions.splice(regions.end(), rmanager->freelist_);
+  }
+
+  std::unique_lock<std::mutex> ul(mtx_);
+  pools_.erase(std::remove(pools_.begin(), pools_.end(), rmanager),
+               pools_.end());
+  requests_.erase(rmanager);
+  free_budget_ += rmanager->region_limit_;
+  rmanager->region_limit_ = 0;
+  // keep published counters monotonic for the daemon
+  const auto &stats = rmanager->board_stats_;
+  detached_stats_.hits += stats.hits;
+  detached_stats_.misses += stats.misses;
+  detached_stats_.miss_cycles += stats.miss_cycles;
+  detached_stats_.miss_bytes += stats.miss_bytes;
+  detached_stats_.saved_cycles += stats.saved_cycles;
+  detached_stats_.vhits += stats.vhits;
+  detached_stats_.ctier_lookups += stats.ctier_lookups;
+  detached_stats_.ctier_hits += stats.ctier_hits;
+  detached_stats_.ctier_raw_bytes += stats.ctier_raw_bytes;
+  detached_stats_.ctier_compressed_bytes += stats.ctier_compressed_bytes;
+  detached_stats_.ctier_decompress_cycles += stats.ctier_decompress_cycles;
+  MIDAS_LOG(kInfo) << "Runtime " << id_ << " detached a pool, "
+                   << pools_.size() << " pools left";
+  ul.unlock();
+
+  // hand the regions over to the other pools, or back to the daemon
+  for (auto &region : regions)
+    if (!stash_region(region))
+      release_region(region);
+}
+
+/** Local budget */
+int64_t Runtime::grow(ResourceManager *rmanager, int64_t nr_regions) {
+  nr_regions = std::max(nr_regions, kGrowChunk);
+  std::unique_lock<std::mutex> ul(mtx_);
+  auto iter = requests_.find(rmanager);
+  if (iter != requests_.cend()) { // never beyond what the pool asked for
+    int64_t nr_requested = iter->second / kRegionSize;
+    nr_regions = std::min<int64_t>(nr_regions,
+                                   nr_requested - rmanager->region_limit_);
+  }
+  if (nr_regions <= 0)
+    return 0;
+
+  int64_t nr_granted = std::min<int64_t>(nr_regions, free_budget_);
+  free_budget_ -= nr_granted;
+  // a pool below its fair share may also take donors' headroom
+  bool starving = rmanager->region_limit_ < region_limit_ / pools_.size();
+  for (auto pool : pools_) {
+    if (nr_granted >= nr_regions)
+      break;
+    if (pool == rmanager)
+      continue;
+    // otherwise leave donors their headroom so they do not start evicting
+    int64_t nr_idle = pool->NumRegionAvail();
+    if (!starving)
+      nr_idle -= pool->stats_.headroom;
+    if (nr_idle <= 0)
+      continue;
+    int64_t nr_moved = std::min(nr_idle, nr_regions - nr_granted);
+    pool->region_limit_ -= nr_moved;
+    nr_granted += nr_moved;
+  }
+  // still short, a starving pool takes budget from pools above their fair
+  // share, which then evict down to their new limits as standalone pools do
+  int64_t fair_share = region_limit_ / pools_.size();
+  for (auto pool : pools_) {
+    if (!starving || nr_granted >= nr_regions)
+      break;
+    int64_t nr_excess = static_cast<int64_t>(pool->region_limit_) - fair_share;
+    if (pool == rmanager || nr_excess <= 0)
+      continue;
+    int64_t nr_moved = std::min(nr_excess, nr_regions - nr_granted);
+    pool->region_limit_ -= nr_moved;
+    nr_granted += nr_moved;
+    pool->cpool_->get_evacuator()->signal_gc();
+  }
+  rmanager->region_limit_ += nr_granted;
+  if (nr_granted)
+    MIDAS_LOG(kDebug) << "Runtime " << id_ << " moved " << nr_granted
+                      << " regions to a pool, now "
+                      << rmanager->region_limit_;
+  return nr_granted;
+}
+
+void Runtime::update_limit(ResourceManager *rmanager, size_t size) {
+  std::unique_lock<std::mutex> ul(mtx_);
+  requests_[rmanager] = size;
+  uint64_t nr_requested = size / kRegionSize;
+  bool shrink = rmanager->region_limit_ > nr_requested;
+  if (shrink) {
+    free_budget_ += rmanager->region_limit_ - nr_requested;
+    rmanager->region_limit_ = nr_requested;
+  }
+  uint64_t total_size = 0;
+  for (auto pool : pools_) {
+    auto iter = requests_.find(pool);
+    total_size += iter != requests_.cend() ? iter->second
+                                           : pool->region_limit_ * kRegionSize;
+  }
+  ul.unlock();
+
+  if (shrink)
+    rmanager->cpool_->get_evacuator()->signal_gc();
+  CtrlMsg msg{
+      .id = id_, .op = CtrlOpCode::UPDLIMIT_REQ, .mmsg = {.size = total_size}};
+  txqp_->send(&msg, sizeof(msg));
+}
+
+/** Splits a new process limit among pools. Growth goes to the unassigned
+ * budget and is handed out on demand; a shrink is spread over pools in
+ * proportion to their limits. Must be called with mtx_ held. */
+std::vector<std::pair<ResourceManager *, uint64_t>> Runtime::partition() {
+  std::vector<std::pair<ResourceManager *, uint64_t>> shrinks;
+  uint64_t nr_assigned = 0;
+  for (auto pool : pools_)
+    nr_assigned += pool->region_limit_;
+  if (nr_assigned <= region_limit_) {
+    free_budget_ = region_limit_ - nr_assigned;
+    return shrinks;
+  }
+
+  uint64_t nr_excess = nr_assigned - region_limit_;
+  uint64_t nr_cut = 0;
+  for (auto pool : pools_) {
+    uint64_t limit = pool->region_limit_;
+    uint64_t cut = std::min<uint64_t>(
+        limit, (nr_excess * limit + nr_assigned - 1) / nr_assigned);
+    if (cut == 0)
+      continue;
+    nr_cut += cut;
+    shrinks.emplace_back(pool, limit - cut);
+  }
+  free_budget_ = nr_cut > nr_excess ? nr_cut - nr_excess : 0;
+  return shrinks;
+}
+
+/* Must be called with mtx_ held. */
+uint64_t Runtime::nr_held_regions() {
+  uint64_t nr_regions = reserve_.size();
+  for (auto pool : pools_)
+    nr_regions += pool->NumRegionInUse();
+  return nr_regions;
+}
+
+/** Region reserve */
+std::shared_ptr<Region> Runtime::take_region() {
+  std::unique_lock<std::mutex> ul(mtx_);
+  if (reserve_.empty())
+    return nullptr;
+  auto region = reserve_.back();
+  reserve_.pop_back();
+  return region;
+}
+
+bool Runtime::stash_region(std::shared_ptr<Region> region) {
+  std::unique_lock<std::mutex> ul(mtx_);
+  if (reserve_.size() >= kReserveSize || nr_held_regions() > region_limit_)
+    return false;
+  region->unmap();
+  reserve_.emplace_back(std::move(region));
+  return true;
+}
+
+bool Runtime::release_region(std::shared_ptr<Region> region) {
+  CtrlMsg msg{.id = id_,
+              .op = CtrlOpCode::FREE,
+              .mmsg = {.region_id = static_cast<int64_t>(region->ID()),
+                       .size = static_cast<uint64_t>(region->Size())}};
+  CtrlMsg ack;
+  if (request(msg, &ack) != 0 || ack.op != CtrlOpCode::FREE ||
+      ack.ret != CtrlRetCode::MEM_SUCC) {
+    MIDAS_LOG(kError) << "Failed to free region " << region->ID();
+    return false;
+  }
+  return true;
+}
+
+/* Gives cached regions back to the daemon when the process holds more than
+ * its limit. */
+void Runtime::trim_reserve() {
+  std::unique_lock<std::mutex> ul(mtx_);
+  while (!reserve_.empty() && nr_held_regions() > region_limit_) {
+    auto region = reserve_.back();
+    reserve_.pop_back();
+    ul.unlock();
+    release_region(region);
+    ul.lock();
+  }
+}
+
+/** Shared GC threads */
+void Runtime::signal_gc(Evacuator *evacuator) {
+  std::unique_lock<std::mutex> ul(gc_mtx_);
+  if (evacuator->terminated_ ||
+      std::find(gc_queue_.cbegin(), gc_queue_.cend(), evacuator) !=
+          gc_queue_.cend())
+    return;
+  gc_queue_.emplace_back(evacuator);
+  gc_cv_.notify_all();
+}
+
+void Runtime::cancel_gc(Evacuator *evacuator) {
+  std::unique_lock<std::mutex> ul(gc_mtx_);
+  gc_queue_.erase(std::remove(gc_queue_.begin(), gc_queue_.end(), evacuator),
+                  gc_queue_.end());
+  gc_cv_.wait(ul, [&] {
+    return std::find(gc_running_.cbegin(), gc_running_.cend(), evacuator) ==
+           gc_running_.cend();
+  });
+}
+
+void Runtime::gc_worker() {
+  std::unique_lock<std::mutex> ul(gc_mtx_);
+  while (true) {
+    gc_cv_.wait(ul, [&] { return stop_ || !gc_queue_.empty(); });
+    if (stop_)
+      return;
+    auto evacuator = gc_queue_.front();
+    gc_queue_.pop_front();
+    gc_running_.emplace_back(evacuator);
+    ul.unlock();
+
+    auto rmanager = evacuator->rmanager_;
+    if (rmanager->reclaim_trigger())
+      evacuator->run_gc();
+
+    ul.lock();
+    gc_running_.erase(
+        std::find(gc_running_.begin(), gc_running_.end(), evacuator));
+    // keep collecting while the pool is short of memory, like a GC thread
+    if (!evacuator->terminated_ && rmanager->reclaim_trigger() &&
+        std::find(gc_queue_.cbegin(), gc_queue_.cend(), evacuator) ==
+            gc_queue_.cend())
+      gc_queue_.emplace_back(evacuator);
+    gc_cv_.notify_all();
+  }
+}
+
+/** Interacting with the daemon */
+int Runtime::connect(const std::string &daemon_name) {
+  std::unique_lock<std::mutex> ul(*conn_mtx_);
+  try {
+    CtrlMsg msg{.id = id_, .op = CtrlOpCode::CONNECT};
+
+    txqp_->send(&msg, sizeof(CtrlMsg));
+    int ret = txqp_->recv(&msg, sizeof(CtrlMsg));
+    if (ret) {
+      return -1;
+    }
+    if (msg.op == CtrlOpCode::CONNECT && msg.ret == CtrlRetCode::CONN_SUCC)
+      MIDAS_LOG(kInfo) << "Runtime connection established.";
+    else {
+      MIDAS_LOG(kError) << "Runtime connection failed.";
+      abort();
+    }
+    std::unique_lock<std::mutex> lk(mtx_);
+    region_limit_ = msg.mmsg.size / kRegionSize;
+    free_budget_ = region_limit_;
+  } catch (boost::interprocess::interprocess_exception &e) {
+    MIDAS_LOG(kError) << e.what();
+  }
+
+  return 0;
+}
+
+int Runtime::disconnect() {
+  std::unique_lock<std::mutex> ul(*conn_mtx_);
+  try {
+    CtrlMsg msg{.id = id_, .op = CtrlOpCode::DISCONNECT};
+
+    txqp_->send(&msg, sizeof(CtrlMsg));
+    int ret = txqp_->timed_recv(&msg, sizeof(CtrlMsg), kDisconnTimeout);
+    if (ret)
+      return -1;
+    if (msg.op == CtrlOpCode::DISCONNECT && msg.ret == CtrlRetCode::CONN_SUCC)
+      MIDAS_LOG(kInfo) << "Runtime connection destroyed.";
+    else {
+      MIDAS_LOG(kError) << "Runtime disconnection failed.";
+      return -1;
+    }
+  } catch (boost::interprocess::interprocess_exception &e) {
+    MIDAS_LOG(kError) << e.what();
+  }
+
+  return 0;
+}
+
+int Runtime::request(const CtrlMsg &msg, CtrlMsg *ack) {
+  std::unique_lock<std::mutex> ul(*conn_mtx_);
+  txqp_->send(&msg, sizeof(msg));
+  return txqp_->recv(ack, sizeof(*ack));
+}
+
+void Runtime::pressure_handler() {
+  MIDAS_LOG(kInfo) << "runtime pressure handler thd is running...";
+
+  while (!stop_) {
+    CtrlMsg msg;
+    if (rxqp_->timed_recv(&msg, sizeof(msg), kMonitorTimeout) != 0)
+      continue;
+
+    MIDAS_LOG(kDebug) << "Runtime recved msg " << msg.op;
+    switch (msg.op) {
+    case UPDLIMIT:
+      do_update_limit(msg, false);
+      break;
+    case FORCE_RECLAIM:
+      do_update_limit(msg, true);
+      break;
+    case PROF_STATS:
+      do_profile_stats(msg);
+      break;
+    case DISCONNECT:
+      MIDAS_LOG(kInfo) << "Runtime " << id_ << " Disconnected!";
+      exit(-1);
+    default:
+      MIDAS_LOG(kError) << "Recved unknown message: " << msg.op;
+    }
+  }
+}
+
+void Runtime::do_update_limit(CtrlMsg &msg, bool force) {
+  assert(msg.mmsg.size != 0);
+  std::unique_lock<std::mutex> apply_ul(apply_mtx_);
+  std::unique_lock<std::mutex> ul(mtx_);
+  MIDAS_LOG(kInfo) << "Runtime " << id_ << " update limit: " << region_limit_
+                   << "->" << msg.mmsg.size;
+  region_limit_ = msg.mmsg.size;
+  auto shrinks = partition();
+  ul.unlock();
+
+  // cached regions are the cheapest to give back
+  trim_reserve();
+  bool succ = true;
+  for (auto &[pool, limit] : shrinks)
+    succ &= pool->apply_limit(limit, force);
+  trim_reserve();
+
+  CtrlMsg ack{.op = CtrlOpCode::UPDLIMIT,
+              .ret = succ ? CtrlRetCode::MEM_SUCC : CtrlRetCode::MEM_FAIL};
+  ul.lock();
+  ack.mmsg.size = nr_held_regions();
+  ul.unlock();
+  rxqp_->send(&ack, sizeof(ack));
+}
+
+void Runtime::do_profile_stats(CtrlMsg &msg) {
+  StatsMsg stats{0};
+  double total_penalty = 0;
+  std::unique_lock<std::mutex> ul(mtx_);
+  for (auto pool : pools_) {
+    StatsMsg pool_stats{0};
+    pool->cpool_->profile_stats(&pool_stats);
+    pool->prof_alloc_tput();
+    stats.hits += pool_stats.hits;
+    stats.misses += pool_stats.misses;
+    stats.vhits += pool_stats.vhits;
+    stats.headroom += pool->stats_.headroom;
+    total_penalty += pool_stats.miss_penalty * pool_stats.misses;
+  }
+  ul.unlock();
+  stats.miss_penalty = stats.misses ? total_penalty / stats.misses : 0.;
+  rxqp_->send(&stats, sizeof(stats));
+}
+
+/* Publishes the sum over all pools, as the daemon sees a single client. */
+void Runtime::stats_publisher() {
+  int32_t rounds = 0;
+  while (!stop_) {
+    bool update_tput = ++rounds % kAllocTputRounds == 0;
+    std::unique_lock<std::mutex> ul(mtx_);
+    StatsSnapshot total = detached_stats_;
+    for (auto pool : pools_) {
+      if (update_tput) {
+        pool->prof_alloc_tput();
+        pool->cpool_->profile_stats();
+      }
+      auto &stats = pool->board_stats_;
+      pool->cpool_->collect_stats(&stats);
+      total.hits += stats.hits;
+      total.misses += stats.misses;
+      total.miss_cycles += stats.miss_cycles;
+      total.miss_bytes += stats.miss_bytes;
+      total.saved_cycles += stats.saved_cycles;
+      total.vhits += stats.vhits;
+      total.ctier_lookups += stats.ctier_lookups;
+      total.ctier_hits += stats.ctier_hits;
+      total.ctier_raw_bytes += stats.ctier_raw_bytes;
+      total.ctier_compressed_bytes += stats.ctier_compressed_bytes;
+      total.ctier_decompress_cycles += stats.ctier_decompress_cycles;
+      total.nr_regions += pool->NumRegionInUse();
+      total.alloc_tput += pool->stats_.alloc_tput;
+      total.reclaim_tput =
+          std::max(total.reclaim_tput, pool->stats_.reclaim_tput);
+      total.headroom += pool->stats_.headroom;
+    }
+    total.region_limit = region_limit_;
+    ul.unlock();
+    total.timestamp = StatsBoard::now_us();
+    stats_board_->publish(total);
+    std::this_thread::sleep_for(kStatsPublishInterval);
+  }
+}
+
+} // namespace midas
@@ -0,0 +1,424 @@
+#include <algorithm>
+#include <atomic>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "logging.hpp"
+#include "resource_manager.hpp"
+#include "robinhood.h"
+#include "shared_kv.hpp"
+#include "utils.hpp"
+
+namespace midas {
+
+constexpr static size_t kHeaderSize = 128; // buckets start two lines in
+
+/* Log bytes are read while a writer may be overwriting them, so they are
+ * loaded as relaxed atomics (word-wise where aligned) and never with plain
+ * loads. Readers check the copy afterwards with a fence and the seqlock or
+ * the log head; writers store with relaxed atomics likewise. */
+static void load_relaxed(void *dst, const char *src, size_t len) noexcept {
+  auto d = static_cast<char *>(dst);
+  for (; len && reinterpret_cast<uintptr_t>(src) % 8; len--)
+    *d++ = __atomic_load_n(src++, __ATOMIC_RELAXED);
+  for (; len >= 8; len -= 8, src += 8, d += 8) {
+    auto word = __atomic_load_n(reinterpret_cast<const uint64_t *>(src),
+                                __ATOMIC_RELAXED);
+    std::memcpy(d, &word, sizeof(word));
+  }
+  for (; len; len--)
+    *d++ = __atomic_load_n(src++, __ATOMIC_RELAXED);
+}
+
+static void store_relaxed(char *dst, const void *src, size_t len) noexcept {
+  auto s = static_cast<const char *>(src);
+  for (; len && reinterpret_cast<uintptr_t>(dst) % 8; len--)
+    __atomic_store_n(dst++, *s++, __ATOMIC_RELAXED);
+  for (; len >= 8; len -= 8, dst += 8, s += 8) {
+    uint64_t word;
+    std::memcpy(&word, s, sizeof(word));
+    __atomic_store_n(reinterpret_cast<uint64_t *>(dst), word, __ATOMIC_RELAXED);
+  }
+  for (; len; len--)
+    __atomic_store_n(dst++, *s++, __ATOMIC_RELAXED);
+}
+
+static bool equal_relaxed(const char *src, const void *data,
+                          size_t len) noexcept {
+  char buf[64];
+  auto d = static_cast<const char *>(data);
+  for (size_t off = 0; off < len; off += sizeof(buf)) {
+    auto n = std::min(sizeof(buf), len - off);
+    load_relaxed(buf, src + off, n);
+    if (std::memcmp(buf, d + off, n) != 0)
+      return false;
+  }
+  return true;
+}
+
+SharedKV::SharedKV(const std::string &name, size_t capacity,
+                   size_t nr_buckets) noexcept
+    : id_(get_unique_id()), name_hash_(hash_(name.data(), name.size())) {
+  static_assert(sizeof(Header) <= kHeaderSize, "Header is too large");
+  static_assert(offsetof(Header, nr_attached) == 0,
+                "The daemon keeps nr_attached at the store's start");
+  qp_ = std::make_unique<QPair>(
+      std::make_shared<QSingle>(utils::get_sq_name(kNameCtrlQ, false), false),
+      std::make_shared<QSingle>(utils::get_ackq_name(kNameCtrlQ, id_), true));
+  if (!attach(name, capacity, nr_buckets)) {
+    region_.reset();
+    hdr_ = nullptr;
+  }
+}
+
+SharedKV::~SharedKV() noexcept {
+  if (hdr_)
+    detach();
+  qp_->RecvQ().destroy();
+}
+
+bool SharedKV::valid() const noexcept { return hdr_ != nullptr; }
+
+uint64_t SharedKV::hash_(const void *key, size_t klen) noexcept {
+  return klen == sizeof(uint64_t)
+             ? robin_hood::hash_int(*(reinterpret_cast<const uint64_t *>(key)))
+             : robin_hood::hash_bytes(key, klen);
+}
+
+size_t SharedKV::layout_size(uint64_t nr_buckets, uint64_t log_size) noexcept {
+  return kHeaderSize + nr_buckets * sizeof(Bucket) + log_size;
+}
+
+CtrlRetCode SharedKV::request(CtrlOpCode op, uint64_t size,
+                              uint64_t *store_size) noexcept {
+  CtrlMsg msg{.id = id_,
+              .op = op,
+              .mmsg{.region_id = static_cast<int64_t>(name_hash_),
+                    .size = size}};
+  if (qp_->send(&msg, sizeof(msg)) != 0 ||
+      qp_->timed_recv(&msg, sizeof(msg), kDaemonTimeout) != 0 ||
+      msg.op != op) {
+    MIDAS_LOG(kError) << "Daemon did not answer shared KV request " << op;
+    return CtrlRetCode::CONN_FAIL;
+  }
+  if (store_size)
+    *store_size = msg.mmsg.size;
+  return msg.ret;
+}
+
+/* The daemon creates the store zero-filled, which is an empty index, and
+ * tells its creator to set up the header while others wait for it. */
+bool SharedKV::attach(const std::string &name, size_t capacity,
+                      size_t nr_buckets) noexcept {
+  using namespace boost::interprocess;
+  uint64_t nr = 64;
+  while (nr < nr_buckets)
+    nr <<= 1;
+  uint64_t log_size = round_up_to_align(capacity, 8);
+  uint64_t size = 0;
+  auto ret = request(CtrlOpCode::SHKV_ATTACH,
+                     capacity ? layout_size(nr, log_size) : 0, &size);
+  if (ret != CtrlRetCode::CONN_SUCC && ret != CtrlRetCode::MEM_SUCC) {
+    MIDAS_LOG(kError) << "Failed to attach to shared KV " << name;
+    return false;
+  }
+  const bool creator = ret == CtrlRetCode::CONN_SUCC;
+  try {
+    shared_memory_object shm(
+        open_only, utils::get_shared_kv_name(name_hash_).c_str(), read_write);
+    region_ = std::make_unique<mapped_region>(shm, read_write);
+  } catch (interprocess_exception &e) {
+    MIDAS_LOG(kError) << "Failed to map shared KV " << name << ": "
+                      << e.what();
+    detach();
+    return false;
+  }
+  auto base = reinterpret_cast<char *>(region_->get_address());
+  auto hdr = reinterpret_cast<Header *>(base);
+  if (creator) {
+    hdr->magic = kMagic;
+    hdr->nr_buckets = nr;
+    hdr->log_size = log_size;
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&hdr->writer, &attr);
+    pthread_mutexattr_destroy(&attr);
+    hdr->ready.store(1, std::memory_order_release);
+  }
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(kAttachTimeoutMs);
+  while (!hdr->ready.load(std::memory_order_acquire)) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      MIDAS_LOG(kError) << "Shared KV " << name << " is never ready";
+      detach();
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  if (hdr->magic != kMagic || region_->get_size() < size ||
+      size < layout_size(hdr->nr_buckets, hdr->log_size)) {
+    MIDAS_LOG(kError) << "Shared KV " << name << " is corrupted";
+    detach();
+    return false;
+  }
+  hdr_ = hdr;
+  buckets_ = reinterpret_cast<Bucket *>(base + kHeaderSize);
+  log_ = base + kHeaderSize + hdr->nr_buckets * sizeof(Bucket);
+  bucket_mask_ = hdr->nr_buckets - 1;
+  log_size_ = hdr->log_size;
+  return true;
+}
+
+void SharedKV::detach() noexcept {
+  if (request(CtrlOpCode::SHKV_DETACH, 0, nullptr) != CtrlRetCode::CONN_SUCC)
+    MIDAS_LOG(kWarning) << "Failed to detach from shared KV " << name_hash_;
+}
+
+/* A record at @pos is intact until the log head gets a full ring past it.
+ * Writers move the head before they overwrite anything, so checking it
+ * after reading a record tells whether the read raced with a wrap. */
+bool SharedKV::intact(uint64_t pos) const noexcept {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return hdr_->head.load(std::memory_order_relaxed) <= pos + log_size_;
+}
+
+bool SharedKV::read_record(uint64_t pos, uint64_t key_hash, const void *key,
+                           size_t klen, RecordHdr *hdr) const noexcept {
+  auto off = pos % log_size_;
+  if (off + sizeof(RecordHdr) > log_size_)
+    return false;
+  load_relaxed(hdr, log_ + off, sizeof(RecordHdr));
+  if (hdr->key_hash != key_hash || hdr->klen != klen ||
+      off + sizeof(RecordHdr) + klen + hdr->vlen > log_size_)
+    return false;
+  if (!equal_relaxed(log_ + off + sizeof(RecordHdr), key, klen))
+    return false;
+  return intact(pos);
+}
+
+int SharedKV::lookup(const Bucket &bucket, uint64_t key_hash, const void *key,
+                     size_t klen, uint64_t *pos,
+                     RecordHdr *hdr) const noexcept {
+  auto tag = key_hash >> kPosBits;
+  for (int way = 0; way < kWays; way++) {
+    auto entry = bucket.entries[way].load(std::memory_order_relaxed);
+    if (!entry || (entry >> kPosBits) != tag)
+      continue;
+    auto p = (entry & kPosMask) - 1;
+    if (read_record(p, key_hash, key, klen, hdr)) {
+      *pos = p;
+      return way;
+    }
+  }
+  return -1;
+}
+
+bool SharedKV::find(const void *key, size_t klen, uint64_t *pos,
+                    size_t *vlen) noexcept {
+  if (!hdr_)
+    return false;
+  auto key_hash = hash_(key, klen);
+  auto &bucket = buckets_[key_hash & bucket_mask_];
+  for (int retry = 0; retry < kMaxReadRetry; retry++) {
+    auto seq = bucket.seq.load(std::memory_order_acquire);
+    if (seq & 1) { // the writer may have been preempted
+      std::this_thread::yield();
+      continue;
+    }
+    RecordHdr hdr;
+    auto way = lookup(bucket, key_hash, key, klen, pos, &hdr);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (bucket.seq.load(std::memory_order_relaxed) != seq)
+      continue;
+    if (way < 0)
+      return false;
+    *vlen = hdr.vlen;
+    return true;
+  }
+  return false;
+}
+
+/* A record overwritten while being copied may have been rewritten since,
+ * so the key is looked up again. */
+void *SharedKV::get(const void *key, size_t klen, size_t *vlen) {
+  uint64_t pos;
+  size_t stored_vn;
+  for (int retry = 0; retry < kMaxReadRetry; retry++) {
+    if (!find(key, klen, &pos, &stored_vn))
+      break;
+    auto value = malloc(stored_vn ? stored_vn : 1);
+    auto off = pos % log_size_ + sizeof(RecordHdr) + klen;
+    load_relaxed(value, log_ + off, stored_vn);
+    if (intact(pos)) {
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      if (vlen)
+        *vlen = stored_vn;
+      return value;
+    }
+    free(value);
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  return nullptr;
+}
+
+bool SharedKV::get(const void *key, size_t klen, void *value, size_t vlen) {
+  uint64_t pos;
+  size_t stored_vn;
+  for (int retry = 0; retry < kMaxReadRetry; retry++) {
+    if (!find(key, klen, &pos, &stored_vn) || stored_vn < vlen)
+      break;
+    auto off = pos % log_size_ + sizeof(RecordHdr) + klen;
+    load_relaxed(value, log_ + off, vlen);
+    if (intact(pos)) {
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+/* Records never wrap around the ring, nor take more than a quarter of it.
+ * The entry goes to the key's own way, or to an empty, overwritten or else
+ * the oldest one. */
+bool SharedKV::set(const void *key, size_t klen, const void *value,
+                   size_t vlen) {
+  if (!hdr_)
+    return false;
+  uint64_t rec_len = round_up_to_align(sizeof(RecordHdr) + klen + vlen, 8);
+  if (rec_len > log_size_ / 4)
+    return false;
+  auto key_hash = hash_(key, klen);
+  auto bucket_idx = key_hash & bucket_mask_;
+  auto &bucket = buckets_[bucket_idx];
+  RecordHdr rec{key_hash, static_cast<uint32_t>(klen),
+                static_cast<uint32_t>(vlen)};
+
+  if (!lock_writer())
+    return false;
+  auto pos = hdr_->head.load(std::memory_order_relaxed);
+  auto off = pos % log_size_;
+  if (off + rec_len > log_size_) {
+    pos += log_size_ - off;
+    off = 0;
+  }
+  if (pos + rec_len >= kPosMask) { // entries cannot address it any more
+    unlock_writer();
+    return false;
+  }
+  hdr_->head.store(pos + rec_len, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  store_relaxed(log_ + off, &rec, sizeof(rec));
+  store_relaxed(log_ + off + sizeof(rec), key, klen);
+  store_relaxed(log_ + off + sizeof(rec) + klen, value, vlen);
+
+  uint64_t old_pos;
+  RecordHdr old_rec;
+  int way = lookup(bucket, key_hash, key, klen, &old_pos, &old_rec);
+  if (way < 0) {
+    uint64_t oldest = kPosMask;
+    for (int i = 0; i < kWays; i++) {
+      auto entry = bucket.entries[i].load(std::memory_order_relaxed);
+      auto p = entry & kPosMask;
+      if (!entry || !intact(p - 1)) {
+        way = i;
+        break;
+      }
+      if (p < oldest) {
+        oldest = p;
+        way = i;
+      }
+    }
+  }
+  begin_update(bucket_idx);
+  bucket.entries[way].store((key_hash >> kPosBits) << kPosBits | (pos + 1),
+                            std::memory_order_relaxed);
+  end_update(bucket_idx);
+  unlock_writer();
+  nr_sets_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool SharedKV::remove(const void *key, size_t klen) {
+  if (!hdr_)
+    return false;
+  auto key_hash = hash_(key, klen);
+  auto bucket_idx = key_hash & bucket_mask_;
+  auto &bucket = buckets_[bucket_idx];
+
+  if (!lock_writer())
+    return false;
+  uint64_t pos;
+  RecordHdr rec;
+  int way = lookup(bucket, key_hash, key, klen, &pos, &rec);
+  if (way >= 0) {
+    begin_update(bucket_idx);
+    bucket.entries[way].store(0, std::memory_order_relaxed);
+    end_update(bucket_idx);
+  }
+  unlock_writer();
+  return way >= 0;
+}
+
+/* If the holder died, its update, if any, is finished off by closing the
+ * bucket's seqlock. Its entry is either stored or not, and only ever points
+ * to a complete record. */
+bool SharedKV::lock_writer() noexcept {
+  int ret = pthread_mutex_lock(&hdr_->writer);
+  if (ret == EOWNERDEAD) {
+    MIDAS_LOG(kWarning) << "Took over the writer lock of a dead process";
+    auto dirty = hdr_->dirty_bucket.load(std::memory_order_relaxed);
+    if (dirty) {
+      auto &seq = buckets_[dirty - 1].seq;
+      auto val = seq.load(std::memory_order_relaxed);
+      if (val & 1)
+        seq.store(val + 1, std::memory_order_release);
+      hdr_->dirty_bucket.store(0, std::memory_order_relaxed);
+    }
+    ret = pthread_mutex_consistent(&hdr_->writer);
+  }
+  if (ret != 0) {
+    MIDAS_LOG(kError) << "Failed to lock shared KV: " << strerror(ret);
+    return false;
+  }
+  return true;
+}
+
+void SharedKV::unlock_writer() noexcept {
+  pthread_mutex_unlock(&hdr_->writer);
+}
+
+void SharedKV::begin_update(uint64_t bucket_idx) noexcept {
+  hdr_->dirty_bucket.store(bucket_idx + 1, std::memory_order_relaxed);
+  auto &seq = buckets_[bucket_idx].seq;
+  seq.store(seq.load(std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void SharedKV::end_update(uint64_t bucket_idx) noexcept {
+  auto &seq = buckets_[bucket_idx].seq;
+  seq.store(seq.load(std::memory_order_relaxed) + 1,
+            std::memory_order_release);
+  hdr_->dirty_bucket.store(0, std::memory_order_relaxed);
+}
+
+SharedKV::Stats SharedKV::get_stats() const noexcept {
+  return Stats{hits_.load(std::memory_order_relaxed),
+               misses_.load(std::memory_order_relaxed),
+               nr_sets_.load(std::memory_order_relaxed)};
+}
+
+size_t SharedKV::capacity() const noexcept { return log_size_; }
+
+uint32_t SharedKV::nr_attached() const noexcept {
+  return hdr_ ? hdr_->nr_attached.load(std::memory_order_relaxed) : 0;
+}
+
+} // namespace midas
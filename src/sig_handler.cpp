@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <bits/types/siginfo_t.h>
 #include <cassert>
 #include <csignal>
@@ -17,25 +18,49 @@ extern "C" void print_callstack(siginfo_t *info, ucontext_t *ctx);
 
 namespace midas {
 void SigHandler::init() {
-  // register rmemcpy
-  register_func(reinterpret_cast<uint64_t>(&rmemcpy),
-                reinterpret_cast<uint64_t>(&rmemcpy_end));
+  if (!funcs.empty()) // already initialized
+    return;
+  // register resilient functions
+  register_func(reinterpret_cast<uint64_t>(&rmemcpy_v128),
+                reinterpret_cast<uint64_t>(&rmemcpy_v128_end));
+  register_func(reinterpret_cast<uint64_t>(&rmemcpy_v256),
+                reinterpret_cast<uint64_t>(&rmemcpy_v256_end));
+  register_func(reinterpret_cast<uint64_t>(&rmemcpy_v512),
+                reinterpret_cast<uint64_t>(&rmemcpy_v512_end));
+  register_func(reinterpret_cast<uint64_t>(&rmemcpy_rep),
+                reinterpret_cast<uint64_t>(&rmemcpy_rep_end));
+  register_func(reinterpret_cast<uint64_t>(&rmemcpy_nt128),
+                reinterpret_cast<uint64_t>(&rmemcpy_nt128_end));
+  register_func(reinterpret_cast<uint64_t>(&rmemcpy_nt512),
+                reinterpret_cast<uint64_t>(&rmemcpy_nt512_end));
+  register_func(reinterpret_cast<uint64_t>(&rmemcmp),
+                reinterpret_cast<uint64_t>(&rmemcmp_end));
+  register_func(reinterpret_cast<uint64_t>(&rhash),
+                reinterpret_cast<uint64_t>(&rhash_end));
+  register_func(reinterpret_cast<uint64_t>(&rmemfind),
+                reinterpret_cast<uint64_t>(&rmemfind_end));
 }
 
+/* Functions are kept sorted by their start ip for the dispatcher. They are
+ * registered before any soft memory is touched, so the signal handler never
+ * races with an insertion. */
 void SigHandler::register_func(uint64_t stt_ip, uint64_t end_ip) {
   assert(stt_ip <= end_ip);
-  funcs.emplace_back(stt_ip, end_ip);
+  auto pos = std::upper_bound(
+      funcs.begin(), funcs.end(), stt_ip,
+      [](uint64_t ip, const ResilientFunc &f) { return ip < f.start_ip(); });
+  funcs.emplace(pos, stt_ip, end_ip);
 }
 
 ResilientFunc *SigHandler::dispatcher(uint64_t ip) {
-  ResilientFunc *ret = nullptr;
-  for (auto &f : funcs) {
-    if (f.contain(ip)) {
-      ret = &f;
-      break;
-    }
-  }
-  return ret;
+  // the last function starting before ip is the only candidate
+  auto pos = std::upper_bound(
+      funcs.begin(), funcs.end(), ip,
+      [](uint64_t ip, const ResilientFunc &f) { return ip < f.start_ip(); });
+  if (pos == funcs.begin())
+    return nullptr;
+  --pos;
+  return pos->contain(ip) ? &*pos : nullptr;
 }
 
 bool SigHandler::softfault_handler(siginfo_t *info, ucontext_t *ctx) {
@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logging.hpp"
+#include "robinhood.h"
+#include "snapshot.hpp"
+
+namespace midas {
+
+namespace snapshot {
+uint64_t now_ms() noexcept {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+static uint64_t checksum(const void *data, size_t len) noexcept {
+  return robin_hood::hash_bytes(data, len);
+}
+
+static bool write_all(int fd, const void *data, size_t len) noexcept {
+  auto ptr = static_cast<const char *>(data);
+  while (len > 0) {
+    auto ret = write(fd, ptr, len);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      return false;
+    ptr += ret;
+    len -= ret;
+  }
+  return true;
+}
+
+static bool pread_all(int fd, void *data, size_t len, off_t off) noexcept {
+  auto ptr = static_cast<char *>(data);
+  while (len > 0) {
+    auto ret = pread(fd, ptr, len, off);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      return false;
+    ptr += ret;
+    len -= ret;
+    off += ret;
+  }
+  return true;
+}
+
+static bool fsync_dir(const std::string &path) noexcept {
+  auto slash = path.rfind('/');
+  auto dir = slash == std::string::npos ? std::string(".")
+                                        : path.substr(0, slash + 1);
+  int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  bool succ = fsync(fd) == 0;
+  close(fd);
+  return succ;
+}
+} // namespace snapshot
+
+SnapshotWriter::SnapshotWriter(const std::string &path)
+    : path_(path), tmp_path_(path + ".tmp") {
+  fd_ = open(tmp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+             0600);
+  if (fd_ < 0)
+    MIDAS_LOG(kError) << "Failed to create snapshot " << tmp_path_ << ": "
+                      << strerror(errno);
+  for (auto &block : blocks_)
+    block.reserve(snapshot::kBlockSize);
+}
+
+/* An unfinished snapshot is dropped. */
+SnapshotWriter::~SnapshotWriter() {
+  if (fd_ < 0)
+    return;
+  close(fd_);
+  unlink(tmp_path_.c_str());
+}
+
+bool SnapshotWriter::ready() const noexcept { return fd_ >= 0 && !failed_; }
+
+bool SnapshotWriter::add(const snapshot::Record &record, uint32_t hotness) {
+  if (!ready())
+    return false;
+  hotness = std::min(hotness, snapshot::kNrHotness - 1);
+  auto &block = blocks_[hotness];
+  auto rec_len = snapshot::kRecordHdrSize + record.klen + record.vlen;
+  if (!block.empty() && block.size() + rec_len > snapshot::kBlockSize &&
+      !flush(hotness))
+    return false;
+  uint32_t lens[] = {static_cast<uint32_t>(record.klen),
+                     static_cast<uint32_t>(record.vlen)};
+  auto pos = block.size();
+  block.resize(pos + rec_len);
+  auto dst = block.data() + pos;
+  std::memcpy(dst, lens, sizeof(lens));
+  std::memcpy(dst + sizeof(lens), &record.deadline_ms, sizeof(uint64_t));
+  std::memcpy(dst + snapshot::kRecordHdrSize, record.key, record.klen);
+  std::memcpy(dst + snapshot::kRecordHdrSize + record.klen, record.value,
+              record.vlen);
+  nr_block_records_[hotness]++;
+  nr_records_++;
+  return true;
+}
+
+bool SnapshotWriter::flush(uint32_t hotness) {
+  auto &block = blocks_[hotness];
+  if (block.empty())
+    return true;
+  snapshot::BlockHdr hdr{snapshot::kMagic, hotness, nr_block_records_[hotness],
+                         static_cast<uint32_t>(block.size()),
+                         snapshot::checksum(block.data(), block.size())};
+  if (!snapshot::write_all(fd_, &hdr, sizeof(hdr)) ||
+      !snapshot::write_all(fd_, block.data(), block.size())) {
+    MIDAS_LOG(kError) << "Failed to write snapshot " << tmp_path_ << ": "
+                      << strerror(errno);
+    failed_ = true;
+    return false;
+  }
+  block.clear();
+  nr_block_records_[hotness] = 0;
+  return true;
+}
+
+bool SnapshotWriter::finish() {
+  if (!ready())
+    return false;
+  for (uint32_t hotness = 0; hotness < snapshot::kNrHotness; hotness++)
+    if (!flush(hotness))
+      return false;
+  if (fsync(fd_) != 0 || rename(tmp_path_.c_str(), path_.c_str()) != 0) {
+    MIDAS_LOG(kError) << "Failed to save snapshot " << path_ << ": "
+                      << strerror(errno);
+    failed_ = true;
+    return false;
+  }
+  close(fd_);
+  fd_ = -1;
+  // the rename is only durable once the directory is synced too
+  if (!snapshot::fsync_dir(path_)) {
+    MIDAS_LOG(kError) << "Failed to sync the directory of snapshot " << path_
+                      << ": " << strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+uint64_t SnapshotWriter::nr_records() const noexcept { return nr_records_; }
+
+/* Only the block headers are read here, to index the blocks. */
+SnapshotReader::SnapshotReader(const std::string &path) {
+  fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd_ < 0) {
+    MIDAS_LOG(kInfo) << "No snapshot at " << path;
+    return;
+  }
+  struct stat st;
+  if (fstat(fd_, &st) != 0) {
+    close(fd_);
+    fd_ = -1;
+    return;
+  }
+  uint64_t offset = 0;
+  while (offset + sizeof(snapshot::BlockHdr) <=
+         static_cast<uint64_t>(st.st_size)) {
+    BlockRef ref{offset, {}};
+    if (!snapshot::pread_all(fd_, &ref.hdr, sizeof(ref.hdr), offset) ||
+        ref.hdr.magic != snapshot::kMagic)
+      break;
+    offset += sizeof(ref.hdr) + ref.hdr.len;
+    if (offset > static_cast<uint64_t>(st.st_size))
+      break;
+    blocks_.push_back(ref);
+  }
+  if (offset != static_cast<uint64_t>(st.st_size))
+    MIDAS_LOG(kWarning) << "Snapshot " << path << " is truncated at "
+                        << offset;
+  std::stable_sort(blocks_.begin(), blocks_.end(),
+                   [](const BlockRef &a, const BlockRef &b) {
+                     return a.hdr.hotness > b.hdr.hotness;
+                   });
+}
+
+SnapshotReader::~SnapshotReader() {
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+bool SnapshotReader::ready() const noexcept { return fd_ >= 0; }
+
+size_t SnapshotReader::nr_blocks() const noexcept { return blocks_.size(); }
+
+bool SnapshotReader::read_block(size_t idx, std::vector<char> &buf) const {
+  if (idx >= blocks_.size())
+    return false;
+  const auto &ref = blocks_[idx];
+  buf.resize(ref.hdr.len);
+  if (!snapshot::pread_all(fd_, buf.data(), buf.size(),
+                           ref.offset + sizeof(ref.hdr)) ||
+      snapshot::checksum(buf.data(), buf.size()) != ref.hdr.checksum) {
+    MIDAS_LOG(kWarning) << "Skipped corrupted snapshot block at "
+                        << ref.offset;
+    return false;
+  }
+  return true;
+}
+
+bool SnapshotReader::next_record(const std::vector<char> &buf, size_t &offset,
+                                 snapshot::Record *record) noexcept {
+  if (offset + snapshot::kRecordHdrSize > buf.size())
+    return false;
+  uint32_t lens[2];
+  auto src = buf.data() + offset;
+  std::memcpy(lens, src, sizeof(lens));
+  std::memcpy(&record->deadline_ms, src + sizeof(lens), sizeof(uint64_t));
+  size_t rec_len = snapshot::kRecordHdrSize + lens[0] + lens[1];
+  if (offset + rec_len > buf.size())
+    return false;
+  record->key = src + snapshot::kRecordHdrSize;
+  record->klen = lens[0];
+  record->value = src + snapshot::kRecordHdrSize + lens[0];
+  record->vlen = lens[1];
+  offset += rec_len;
+  return true;
+}
+
+} // namespace midas
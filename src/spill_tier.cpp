@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <unistd.h>
+#include <vector>
+
+#include "logging.hpp"
+#include "robinhood.h"
+#include "spill_tier.hpp"
+#include "time.hpp"
+
+namespace midas {
+
+SpillTier::SpillTier(const std::string &path, size_t capacity,
+                     uint64_t min_cost)
+    : path_(path), nr_slots_(std::max<size_t>(capacity / kSegmentSize, 2)),
+      min_cost_(min_cost), slot_keys_(nr_slots_),
+      active_(std::make_unique<char[]>(kSegmentSize)) {
+  fd_ = open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd_ < 0) {
+    MIDAS_LOG(kError) << "Failed to open spill file " << path_ << ": "
+                      << strerror(errno);
+    return;
+  }
+  for (int i = 1; i < kNrBuffers; i++)
+    free_bufs_.emplace_back(std::make_unique<char[]>(kSegmentSize));
+  writer_ = std::thread([&] { writer_loop(); });
+}
+
+/* Sealed segments that are not written yet are dropped with the file. */
+SpillTier::~SpillTier() {
+  if (fd_ < 0)
+    return;
+  {
+    std::unique_lock<std::mutex> ul(mtx_);
+    terminated_ = true;
+  }
+  writer_cv_.notify_all();
+  writer_.join();
+  close(fd_);
+  unlink(path_.c_str());
+}
+
+bool SpillTier::ready() const noexcept { return fd_ >= 0; }
+
+uint32_t SpillTier::checksum(const void *data, size_t len) noexcept {
+  return static_cast<uint32_t>(robin_hood::hash_bytes(data, len));
+}
+
+/* A failed write is only logged: reads of its records fail their checks
+ * and turn into misses. */
+void SpillTier::write_segment(const Segment &segment) noexcept {
+  auto slot_off = (segment.id % nr_slots_) * kSegmentSize;
+  for (uint32_t done = 0; done < segment.used;) {
+    auto ret = pwrite(fd_, segment.data.get() + done, segment.used - done,
+                      slot_off + done);
+    if (ret <= 0) {
+      MIDAS_LOG(kError) << "Failed to write spill segment " << segment.id
+                        << ": " << strerror(errno);
+      break;
+    }
+    done += ret;
+  }
+}
+
+/* Segments stay readable from memory until they are written. */
+void SpillTier::writer_loop() {
+  std::unique_lock<std::mutex> ul(mtx_);
+  while (true) {
+    writer_cv_.wait(ul, [&] { return terminated_ || !sealed_.empty(); });
+    if (terminated_)
+      return;
+    auto &segment = sealed_.front(); // only popped here
+    ul.unlock();
+    write_segment(segment);
+    ul.lock();
+    free_bufs_.emplace_back(std::move(segment.data));
+    sealed_.pop_front();
+  }
+}
+
+/* Hands the active segment to the writer and moves on to the next slot,
+ * whose previous segment is dropped from the index. Fails if the writer has
+ * no buffer to spare. */
+bool SpillTier::seal_locked() noexcept {
+  if (free_bufs_.empty())
+    return false;
+  sealed_.emplace_back(Segment{active_id_, active_used_, std::move(active_)});
+  active_ = std::move(free_bufs_.back());
+  free_bufs_.pop_back();
+  writer_cv_.notify_one();
+  active_id_++;
+  active_used_ = 0;
+  // keys re-put since live in newer segments, which are kept
+  auto &keys = slot_keys_[active_id_ % nr_slots_];
+  for (auto key : keys) {
+    auto iter = map_.find(key);
+    if (iter != map_.cend() && iter->second.seg_id + nr_slots_ <= active_id_)
+      map_.erase(iter);
+  }
+  keys.clear();
+  return true;
+}
+
+const char *SpillTier::buffered_locked(uint64_t seg_id) const noexcept {
+  if (seg_id == active_id_)
+    return active_.get();
+  for (const auto &segment : sealed_)
+    if (segment.id == seg_id)
+      return segment.data.get();
+  return nullptr;
+}
+
+bool SpillTier::put(const void *key, const void *data, size_t len) {
+  if (fd_ < 0)
+    return false;
+  size_t rec_len = sizeof(RecordHdr) + len;
+  RecordHdr hdr{reinterpret_cast<uint64_t>(key), static_cast<uint32_t>(len),
+                checksum(data, len)};
+
+  std::unique_lock<std::mutex> ul(mtx_);
+  map_.erase(key);
+  if (rec_len > kSegmentSize)
+    return false;
+  if (active_used_ + rec_len > kSegmentSize && !seal_locked())
+    return false;
+  auto rec = active_.get() + active_used_;
+  std::memcpy(rec, &hdr, sizeof(hdr));
+  std::memcpy(rec + sizeof(hdr), data, len);
+  map_[key] = Entry{active_id_, active_used_, static_cast<uint32_t>(len)};
+  slot_keys_[active_id_ % nr_slots_].push_back(key);
+  active_used_ += rec_len;
+  ul.unlock();
+
+  nr_spilled_.fetch_add(1, std::memory_order_relaxed);
+  spilled_bytes_.fetch_add(len, std::memory_order_relaxed);
+  return true;
+}
+
+bool SpillTier::take(const void *key, std::vector<char> &buf) {
+  static thread_local std::vector<char> scratch;
+  nr_lookups_.fetch_add(1, std::memory_order_relaxed);
+
+  std::unique_lock<std::mutex> ul(mtx_);
+  auto iter = map_.find(key);
+  if (iter == map_.cend())
+    return false;
+  auto entry = iter->second;
+  map_.erase(iter);
+  buf.resize(entry.len);
+  auto segment = buffered_locked(entry.seg_id);
+  if (segment) { // not written out yet
+    std::memcpy(buf.data(), segment + entry.offset + sizeof(RecordHdr),
+                entry.len);
+    ul.unlock();
+    nr_hits_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  ul.unlock();
+
+  auto stt = Time::get_cycles_stt();
+  size_t rec_len = sizeof(RecordHdr) + entry.len;
+  off_t off = (entry.seg_id % nr_slots_) * kSegmentSize + entry.offset;
+  scratch.resize(rec_len);
+  auto ret = pread(fd_, scratch.data(), rec_len, off);
+  if (ret != static_cast<ssize_t>(rec_len))
+    return false;
+  RecordHdr hdr;
+  std::memcpy(&hdr, scratch.data(), sizeof(hdr));
+  auto data = scratch.data() + sizeof(hdr);
+  if (hdr.key != reinterpret_cast<uint64_t>(key) || hdr.len != entry.len ||
+      hdr.checksum != checksum(data, entry.len))
+    return false;
+  std::memcpy(buf.data(), data, entry.len);
+  auto end = Time::get_cycles_end();
+  nr_hits_.fetch_add(1, std::memory_order_relaxed);
+  read_cycles_.fetch_add(end - stt, std::memory_order_relaxed);
+  return true;
+}
+
+void SpillTier::remove(const void *key) noexcept {
+  std::unique_lock<std::mutex> ul(mtx_);
+  map_.erase(key);
+}
+
+void SpillTier::reset() noexcept {
+  std::unique_lock<std::mutex> ul(mtx_);
+  map_.clear();
+  for (auto &keys : slot_keys_)
+    keys.clear();
+  // ids go on so that segments still being written are not mistaken for
+  // new ones
+  active_id_ = (active_id_ / nr_slots_ + 1) * nr_slots_;
+  active_used_ = 0;
+  if (fd_ >= 0 && ftruncate(fd_, 0) != 0)
+    MIDAS_LOG(kWarning) << "Failed to truncate spill file " << path_;
+}
+
+uint64_t SpillTier::min_cost() const noexcept { return min_cost_; }
+
+SpillTier::Stats SpillTier::get_stats() const noexcept {
+  return Stats{nr_spilled_.load(std::memory_order_relaxed),
+               spilled_bytes_.load(std::memory_order_relaxed),
+               nr_lookups_.load(std::memory_order_relaxed),
+               nr_hits_.load(std::memory_order_relaxed),
+               read_cycles_.load(std::memory_order_relaxed)};
+}
+
+size_t SpillTier::capacity() const noexcept {
+  return nr_slots_ * kSegmentSize;
+}
+
+} // namespace midas
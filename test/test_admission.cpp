@@ -0,0 +1,99 @@
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "admission.hpp"
+#include "cache_manager.hpp"
+#include "robinhood.h"
+#include "sync_kv.hpp"
+#include "test_value.hpp"
+
+constexpr static size_t kCacheSize = 1024ull * 1024 * 32; // 32MB
+constexpr static int kNBuckets = (1 << 20);
+constexpr static int kNumHot = 64 * 1024;
+constexpr static int kNumCold = 1024 * 1024;
+constexpr static int kNumRounds = 8;
+
+using Value = TestValue<64>;
+
+/* Drives the sketch directly: one-hit wonders only get in through the
+ * window, keys seen before always do, and counts fade with aging. */
+bool test_filter() {
+  constexpr static int kNumKeys = 10000;
+  midas::AdmissionFilter filter(kNumKeys);
+  int nr_admitted = 0;
+  for (uint64_t i = 0; i < kNumKeys; i++)
+    nr_admitted += filter.admit(robin_hood::hash_int(i));
+  bool succ = nr_admitted > 0 && nr_admitted < kNumKeys / 50;
+
+  auto hot = robin_hood::hash_int(kNumKeys);
+  for (int i = 0; i < 15; i++)
+    filter.record(hot);
+  succ &= filter.estimate(hot) == 15 && filter.admit(hot);
+  // one sample period of other keys halves the hot key's count at least once
+  for (uint64_t i = 0; i < 10 * 16384; i++)
+    filter.record(robin_hood::hash_int(kNumKeys + 1 + i % kNumKeys));
+  succ &= filter.estimate(hot) < 15;
+  return succ;
+}
+
+/* A hot set read every round, interleaved with a one-pass scan of cold keys
+ * that alone exceeds the cache. Returns the hot set hit ratio. */
+double run_scan(midas::CachePool *pool, int *nr_wrong) {
+  auto kv = std::make_unique<midas::SyncKV<kNBuckets>>(pool);
+  for (uint64_t i = 0; i < kNumHot; i++)
+    kv->set(i, Value::make(i));
+
+  int64_t nr_hits = 0, nr_lookups = 0;
+  constexpr static int kColdPerRound = kNumCold / kNumRounds;
+  for (int round = 0; round < kNumRounds; round++) {
+    for (uint64_t i = kNumHot + round * kColdPerRound;
+         i < kNumHot + (round + 1) * kColdPerRound; i++)
+      kv->set(i, Value::make(i));
+    for (uint64_t i = 0; i < kNumHot; i++) {
+      nr_lookups++;
+      auto v = kv->get<uint64_t, Value>(i);
+      if (!v) {
+        kv->set(i, Value::make(i));
+        continue;
+      }
+      nr_hits++;
+      auto expected = Value::make(i);
+      if (memcmp(v.get(), &expected, sizeof(Value)) != 0)
+        (*nr_wrong)++;
+    }
+  }
+  kv->clear();
+  return static_cast<double>(nr_hits) / nr_lookups;
+}
+
+int main() {
+  bool succ = test_filter();
+  std::cout << "Filter test " << (succ ? "passed!" : "failed!") << std::endl;
+
+  auto cmanager = midas::CacheManager::global_cache_manager();
+  auto with_pool = [&](const std::string &name, bool admission,
+                       int *nr_wrong, uint64_t *nr_rejected) {
+    cmanager->create_pool(name);
+    auto pool = cmanager->get_pool(name);
+    pool->update_limit(kCacheSize);
+    if (admission)
+      pool->enable_admission();
+    auto hit_ratio = run_scan(pool, nr_wrong);
+    if (admission)
+      *nr_rejected = pool->get_admission()->nr_rejected();
+    cmanager->delete_pool(name);
+    return hit_ratio;
+  };
+  int nr_wrong = 0;
+  uint64_t nr_rejected = 0;
+  auto base_ratio = with_pool("no_admission", false, &nr_wrong, nullptr);
+  auto tinylfu_ratio = with_pool("tinylfu", true, &nr_wrong, &nr_rejected);
+  std::cout << "Hot set hit ratio: " << base_ratio << " without admission, "
+            << tinylfu_ratio << " with TinyLFU (" << nr_rejected
+            << " inserts rejected), " << nr_wrong << " wrong" << std::endl;
+  succ = nr_wrong == 0 && nr_rejected > 0 && tinylfu_ratio > 0;
+  std::cout << "Scan test " << (succ ? "passed!" : "failed!") << std::endl;
+  return 0;
+}
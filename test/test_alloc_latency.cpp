@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "resource_manager.hpp"
+#include "utils.hpp"
+
+constexpr static int kNumClients = 64;
+constexpr static int kNumRegions = 16; // per client, below the initial limit
+constexpr static int kNumRounds = 5; // plus one to warm up the daemon
+// a serialized daemon takes ~5ms at p99 with 64 clients on a single core
+constexpr static double kMaxP99Us = 10 * 1000;
+
+/* Returns the p99 of ALLOC round trips in one round. */
+double run_round() {
+  std::vector<std::vector<double>> latencies(kNumClients);
+  std::vector<std::thread> thds;
+  std::atomic_int nr_ready{0};
+  for (int tid = 0; tid < kNumClients; tid++) {
+    thds.push_back(std::thread([&, tid]() {
+      // every ResourceManager connects to the daemon as a separate client
+      auto rmanager = std::make_unique<midas::ResourceManager>();
+      // connects are not timed, so start allocating all together
+      nr_ready++;
+      while (nr_ready < kNumClients)
+        std::this_thread::yield();
+      for (int i = 0; i < kNumRegions; i++) {
+        auto stt = std::chrono::steady_clock::now();
+        rmanager->AllocRegion();
+        auto end = std::chrono::steady_clock::now();
+        latencies[tid].emplace_back(
+            std::chrono::duration<double, std::micro>(end - stt).count());
+      }
+      for (int i = 0; i < kNumRegions; i++)
+        rmanager->FreeRegions();
+    }));
+  }
+  for (auto &thd : thds)
+    thd.join();
+
+  std::vector<double> all;
+  for (auto &lats : latencies)
+    all.insert(all.end(), lats.begin(), lats.end());
+  std::sort(all.begin(), all.end());
+  auto percentile = [&](double p) { return all[(all.size() - 1) * p]; };
+  std::cout << "ALLOC round-trip latency of " << kNumClients
+            << " clients (us): p50 " << percentile(0.5) << ", p90 "
+            << percentile(0.9) << ", p99 " << percentile(0.99) << ", max "
+            << all.back() << std::endl;
+  return percentile(0.99);
+}
+
+int main(int argc, char *argv[]) {
+  run_round();
+  // single rounds are noisy, so check the median round
+  std::vector<double> p99s;
+  for (int i = 0; i < kNumRounds; i++)
+    p99s.emplace_back(run_round());
+  std::sort(p99s.begin(), p99s.end());
+  auto p99 = p99s[kNumRounds / 2];
+  std::cout << "Median p99 (us): " << p99 << std::endl;
+  std::cout << "Tail latency test "
+            << (p99 <= kMaxP99Us ? "passed!" : "failed!") << std::endl;
+  return 0;
+}
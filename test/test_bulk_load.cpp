@@ -0,0 +1,112 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cache_manager.hpp"
+#include "sync_kv.hpp"
+#include "test_value.hpp"
+
+constexpr static size_t kCacheSize = 1024ull * 1024 * 32; // 32MB
+constexpr static int kNBuckets = (1 << 20);
+constexpr static int kNumObjs = 64 * 1024; // 6MB
+constexpr static int kBatchSize = 1024;
+
+using Value = TestValue<64>;
+
+using KV = midas::SyncKV<kNBuckets>;
+
+/* Existing keys and the first of duplicated keys win, and TTLs apply. */
+bool test_semantics(midas::CachePool *pool) {
+  auto kv = std::make_unique<KV>(pool);
+  kv->set(1ul, Value::make(100));
+  std::vector<uint64_t> keys = {0, 1, 2, 2, 3};
+  std::vector<Value> vals;
+  for (auto key : keys)
+    vals.emplace_back(Value::make(key + vals.size()));
+  std::vector<midas::kv_types::Key> raw_keys;
+  std::vector<midas::kv_types::CValue> raw_vals;
+  for (int i = 0; i < keys.size(); i++) {
+    raw_keys.emplace_back(&keys[i], sizeof(uint64_t));
+    raw_vals.emplace_back(&vals[i], sizeof(Value));
+  }
+  std::vector<uint64_t> ttls_ms = {0, 0, 0, 0, 50};
+  bool succ = kv->bload(raw_keys, raw_vals, ttls_ms) == 3;
+  auto v = kv->get<uint64_t, Value>(1ul);
+  succ &= v && v->idx == 100;
+  v = kv->get<uint64_t, Value>(2ul);
+  succ &= v && v->idx == 4;
+  succ &= kv->ttl(0ul) == -1 && kv->ttl(3ul) > 0;
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  succ &= !kv->get<uint64_t, Value>(3ul);
+  kv->clear();
+  return succ;
+}
+
+/* Loads kNumObjs pairs with set() or bload(), and checks them all. */
+bool run_load(midas::CachePool *pool, bool bulk, double *mops) {
+  std::vector<uint64_t> keys(kNumObjs);
+  std::vector<Value> vals(kNumObjs);
+  for (uint64_t i = 0; i < kNumObjs; i++) {
+    keys[i] = i;
+    vals[i] = Value::make(i);
+  }
+  auto kv = std::make_unique<KV>(pool);
+  auto stt = std::chrono::steady_clock::now();
+  int nr_loaded = 0;
+  if (bulk) {
+    for (int i = 0; i < kNumObjs; i += kBatchSize) {
+      std::vector<uint64_t> batch_keys(keys.begin() + i,
+                                       keys.begin() + i + kBatchSize);
+      std::vector<Value> batch_vals(vals.begin() + i,
+                                    vals.begin() + i + kBatchSize);
+      nr_loaded += kv->bload(batch_keys, batch_vals);
+    }
+  } else {
+    for (int i = 0; i < kNumObjs; i++)
+      nr_loaded += kv->set(keys[i], vals[i]);
+  }
+  auto end = std::chrono::steady_clock::now();
+  auto dur_us = std::chrono::duration<double, std::micro>(end - stt).count();
+  *mops = kNumObjs / dur_us;
+  int nr_hits = 0;
+  for (uint64_t i = 0; i < kNumObjs; i++) {
+    auto v = kv->get<uint64_t, Value>(i);
+    if (v && v->idx == i && v->valid())
+      nr_hits++;
+  }
+  kv->clear();
+  // the pool may evict some, but most must have made it
+  return nr_loaded == kNumObjs && nr_hits > kNumObjs * 0.9;
+}
+
+int main() {
+  auto cmanager = midas::CacheManager::global_cache_manager();
+  auto with_pool = [&](const std::string &name, auto &&func) {
+    cmanager->create_pool(name);
+    auto pool = cmanager->get_pool(name);
+    pool->update_limit(kCacheSize);
+    bool succ = func(pool);
+    cmanager->delete_pool(name);
+    return succ;
+  };
+
+  bool succ = with_pool("bload", test_semantics);
+  std::cout << "Semantics test " << (succ ? "passed!" : "failed!")
+            << std::endl;
+
+  double set_mops = 0;
+  double bload_mops = 0;
+  succ = with_pool("set", [&](midas::CachePool *pool) {
+    return run_load(pool, false, &set_mops);
+  });
+  succ &= with_pool("bload_tput", [&](midas::CachePool *pool) {
+    return run_load(pool, true, &bload_mops);
+  });
+  std::cout << "set(): " << set_mops << " Mops, bload(): " << bload_mops
+            << " Mops" << std::endl;
+  std::cout << "Load test " << (succ ? "passed!" : "failed!") << std::endl;
+  return 0;
+}
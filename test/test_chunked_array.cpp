@@ -0,0 +1,106 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "array.hpp"
+#include "cache_manager.hpp"
+#include "chunked_array.hpp"
+
+constexpr static int kNumThds = 8;
+constexpr static int kNumElems = 1 << 20; // 8MB of uint64_t
+constexpr static int kRangeLen = 1000;    // spans chunk boundaries
+
+inline uint64_t value_of(int idx) { return idx * 0x9E3779B97F4A7C15ull; }
+
+template <typename Arr> void fill(Arr &arr) {
+  std::vector<std::thread> thds;
+  for (int tid = 0; tid < kNumThds; tid++) {
+    thds.emplace_back([&, tid]() {
+      for (int i = tid; i < kNumElems; i += kNumThds)
+        arr.set(i, value_of(i));
+    });
+  }
+  for (auto &thd : thds)
+    thd.join();
+}
+
+template <typename Arr> double scan(Arr &arr, int &nr_missed) {
+  auto stt = std::chrono::steady_clock::now();
+  nr_missed = 0;
+  for (int i = 0; i < kNumElems; i++) {
+    auto v = arr.get(i);
+    if (!v || *v != value_of(i))
+      nr_missed++;
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - stt).count();
+}
+
+int main() {
+  auto cache_manager = midas::CacheManager::global_cache_manager();
+  cache_manager->create_pool("chunked");
+  auto pool = cache_manager->get_pool("chunked");
+  pool->update_limit(1ull * 1024 * 1024 * 1024); // 1GB
+
+  midas::ChunkedArray<uint64_t> chunked(pool, kNumElems);
+  fill(chunked);
+
+  // unset elements in a written chunk must not be returned
+  midas::ChunkedArray<uint64_t> partial(pool, 64);
+  partial.set(3, 3);
+  bool succ = partial.get(3) && *partial.get(3) == 3 && !partial.get(2) &&
+              partial.get_range(3, 5, std::vector<uint64_t>(5).data()) == 1;
+
+  int nr_failed = 0;
+  std::vector<uint64_t> buf(kRangeLen);
+  for (int i = 0; i < kNumElems; i += kRangeLen) {
+    int n = chunked.get_range(i, kRangeLen, buf.data());
+    if (n != std::min(kRangeLen, kNumElems - i)) {
+      nr_failed++;
+      continue;
+    }
+    for (int j = 0; j < n; j++)
+      if (buf[j] != value_of(i + j))
+        nr_failed++;
+  }
+  for (int i = 0; i < kRangeLen; i++)
+    buf[i] = value_of(i + 1);
+  if (chunked.set_range(kNumElems - kRangeLen / 2, kRangeLen, buf.data()) !=
+      kRangeLen / 2)
+    nr_failed++;
+  else if (*chunked.get(kNumElems - 1) != value_of(kRangeLen / 2))
+    nr_failed++;
+  for (int i = 0; i < kRangeLen / 2; i++)
+    buf[i] = value_of(kNumElems - kRangeLen / 2 + i);
+  chunked.set_range(kNumElems - kRangeLen / 2, kRangeLen / 2, buf.data());
+
+  int nr_missed = 0;
+  double chunked_time = scan(chunked, nr_missed);
+  std::cout << "ChunkedArray<uint64_t, " << chunked.chunk_len()
+            << "> sequential scan: " << chunked_time << "s, " << nr_missed
+            << " missed" << std::endl;
+
+  auto stt = std::chrono::steady_clock::now();
+  for (int i = 0; i < kNumElems; i += kRangeLen)
+    chunked.get_range(i, kRangeLen, buf.data());
+  auto end = std::chrono::steady_clock::now();
+  std::cout << "ChunkedArray<uint64_t, " << chunked.chunk_len()
+            << "> range scan: "
+            << std::chrono::duration<double>(end - stt).count() << "s"
+            << std::endl;
+
+  midas::Array<uint64_t> array(pool, kNumElems);
+  fill(array);
+  int nr_array_missed = 0;
+  double array_time = scan(array, nr_array_missed);
+  std::cout << "Array<uint64_t> sequential scan: " << array_time << "s, "
+            << nr_array_missed << " missed" << std::endl;
+
+  if (succ && nr_failed == 0 && nr_missed == 0)
+    std::cout << "Test passed!" << std::endl;
+  else
+    std::cout << "Test failed! " << nr_failed << " range errors" << std::endl;
+  return 0;
+}
@@ -0,0 +1,209 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cache_manager.hpp"
+#include "codec.hpp"
+#include "sync_hashmap.hpp"
+#include "sync_kv.hpp"
+
+constexpr static size_t kCacheSize = 1024ull * 1024 * 1024; // 1GB
+constexpr static int kNBuckets = (1 << 16);
+constexpr static int kNumObjs = 100000;
+
+/* A non-contiguous type with a user-provided codec. */
+struct Record {
+  uint64_t id;
+  std::string name;
+  std::vector<uint32_t> scores;
+
+  bool operator==(const Record &other) const {
+    return id == other.id && name == other.name && scores == other.scores;
+  }
+};
+
+namespace midas {
+template <> struct Codec<Record> {
+  constexpr static bool kFixedSize = false;
+  static size_t size(const Record &r) noexcept {
+    return sizeof(uint64_t) * 2 + r.name.size() +
+           r.scores.size() * sizeof(uint32_t);
+  }
+  static const void *contiguous(const Record &r) noexcept { return nullptr; }
+  static bool encode(const Record &r, void *buf, size_t len) noexcept {
+    if (len != size(r))
+      return false;
+    auto p = reinterpret_cast<char *>(buf);
+    uint64_t name_len = r.name.size();
+    std::memcpy(p, &r.id, sizeof(uint64_t));
+    std::memcpy(p + sizeof(uint64_t), &name_len, sizeof(uint64_t));
+    std::memcpy(p + sizeof(uint64_t) * 2, r.name.data(), name_len);
+    std::memcpy(p + sizeof(uint64_t) * 2 + name_len, r.scores.data(),
+                r.scores.size() * sizeof(uint32_t));
+    return true;
+  }
+  static bool decode(Record &r, const void *buf, size_t len) {
+    if (len < sizeof(uint64_t) * 2)
+      return false;
+    auto p = reinterpret_cast<const char *>(buf);
+    uint64_t name_len = 0;
+    std::memcpy(&r.id, p, sizeof(uint64_t));
+    std::memcpy(&name_len, p + sizeof(uint64_t), sizeof(uint64_t));
+    auto scores_len = len - sizeof(uint64_t) * 2 - name_len;
+    r.name.assign(p + sizeof(uint64_t) * 2, name_len);
+    r.scores.resize(scores_len / sizeof(uint32_t));
+    std::memcpy(r.scores.data(), p + sizeof(uint64_t) * 2 + name_len,
+                scores_len);
+    return true;
+  }
+};
+} // namespace midas
+
+struct Flat {
+  uint64_t a;
+  double b;
+  char c[16];
+};
+
+Record make_record(uint64_t i) {
+  Record r;
+  r.id = i;
+  r.name = "record-" + std::to_string(i);
+  r.scores.resize(i % 8 + 1);
+  for (size_t j = 0; j < r.scores.size(); j++)
+    r.scores[j] = i * 7 + j;
+  return r;
+}
+
+std::string make_str(uint64_t i) {
+  return "value-" + std::to_string(i) + std::string(i % 64, 'x');
+}
+
+bool test_hashmap(midas::CachePool *pool) {
+  auto strs = std::make_unique<
+      midas::SyncHashMap<kNBuckets, uint64_t, std::string>>(pool);
+  auto recs =
+      std::make_unique<midas::SyncHashMap<kNBuckets, uint64_t, Record>>(pool);
+  for (uint64_t i = 0; i < kNumObjs; i++) {
+    if (!strs->set(i, make_str(i)) || !recs->set(i, make_record(i)))
+      return false;
+  }
+  // overwrite with shorter (in place) and longer (reallocated) values
+  for (uint64_t i = 0; i < kNumObjs; i += 2)
+    strs->set(i, std::string(i % 3 ? "s" : "a much longer value than before"));
+
+  int nr_wrong = 0;
+  for (uint64_t i = 0; i < kNumObjs; i++) {
+    std::string s;
+    auto expected =
+        i % 2 ? make_str(i)
+              : std::string(i % 3 ? "s" : "a much longer value than before");
+    if (!strs->get(i, s) || s != expected)
+      nr_wrong++;
+    auto r = recs->get(i);
+    if (!r || !(*r == make_record(i)))
+      nr_wrong++;
+  }
+  return nr_wrong == 0;
+}
+
+bool test_kv(midas::CachePool *pool) {
+  auto kvs = std::make_unique<midas::SyncKV<kNBuckets>>(pool);
+  int nr_wrong = 0;
+  for (uint64_t i = 0; i < kNumObjs; i++) {
+    std::vector<uint32_t> vec(i % 16, i);
+    Flat flat{i, i * 0.5, "flat"};
+    if (!kvs->set_as("vec-" + std::to_string(i), vec) ||
+        !kvs->set_as(i, flat))
+      nr_wrong++;
+  }
+  for (uint64_t i = 0; i < kNumObjs; i++) {
+    std::vector<uint32_t> vec;
+    Flat flat;
+    if (!kvs->get_as("vec-" + std::to_string(i), vec) ||
+        vec != std::vector<uint32_t>(i % 16, i))
+      nr_wrong++;
+    if (!kvs->get_as(i, flat) || flat.a != i || flat.b != i * 0.5 ||
+        strcmp(flat.c, "flat") != 0)
+      nr_wrong++;
+  }
+  return nr_wrong == 0;
+}
+
+/* A shorter value keeps the object's space, so growing back fits in place. */
+bool test_capacity(midas::CachePool *pool) {
+  auto kvs = std::make_unique<midas::SyncKV<kNBuckets>>(pool);
+  const uint64_t key = 0;
+  const std::string long_str(200, 'l');
+  auto addr_of = [&]() {
+    auto view = kvs->get_view(key);
+    return view.pinned() ? view.data() : nullptr;
+  };
+  std::string s;
+  bool succ = kvs->set_as(key, long_str);
+  auto addr = addr_of();
+  succ &= addr && kvs->set_as(key, std::string("s")) &&
+          kvs->get_as(key, s) && s == "s";
+  succ &= kvs->set_as(key, std::string(150, 'm')) && kvs->get_as(key, s) &&
+          s == std::string(150, 'm');
+  return succ && addr_of() == addr;
+}
+
+/* Manual serialization into a heap buffer vs. encoding into soft memory. */
+void bench_kv(midas::CachePool *pool) {
+  auto kvs = std::make_unique<midas::SyncKV<kNBuckets>>(pool);
+  std::vector<Record> recs;
+  for (uint64_t i = 0; i < kNumObjs; i++)
+    recs.emplace_back(make_record(i));
+
+  auto manual_set = [&]() {
+    for (uint64_t i = 0; i < kNumObjs; i++) {
+      auto len = midas::Codec<Record>::size(recs[i]);
+      auto buf = malloc(len);
+      midas::Codec<Record>::encode(recs[i], buf, len);
+      kvs->set(&i, sizeof(i), buf, len);
+      free(buf);
+    }
+  };
+  auto codec_set = [&]() {
+    for (uint64_t i = 0; i < kNumObjs; i++)
+      kvs->set_as(i, recs[i]);
+  };
+  double manual_dur = 0, codec_dur = 0;
+  constexpr static int kNumRounds = 4;
+  for (int round = 0; round < kNumRounds; round++) {
+    auto stt = std::chrono::high_resolution_clock::now();
+    manual_set();
+    auto mid = std::chrono::high_resolution_clock::now();
+    codec_set();
+    auto end = std::chrono::high_resolution_clock::now();
+    manual_dur += std::chrono::duration<double>(mid - stt).count();
+    codec_dur += std::chrono::duration<double>(end - mid).count();
+  }
+  std::cout << "Set " << kNumObjs << " records x " << kNumRounds
+            << ": manual " << manual_dur << "s, codec " << codec_dur << "s"
+            << std::endl;
+}
+
+int main() {
+  auto cmanager = midas::CacheManager::global_cache_manager();
+  cmanager->create_pool("codec");
+  auto pool = cmanager->get_pool("codec");
+  pool->update_limit(kCacheSize);
+
+  bool succ = test_hashmap(pool);
+  std::cout << "SyncHashMap codec test " << (succ ? "passed!" : "failed!")
+            << std::endl;
+  succ = test_kv(pool);
+  std::cout << "SyncKV codec test " << (succ ? "passed!" : "failed!")
+            << std::endl;
+  succ = test_capacity(pool);
+  std::cout << "Capacity test " << (succ ? "passed!" : "failed!")
+            << std::endl;
+  bench_kv(pool);
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "array.hpp"
+#include "cache_manager.hpp"
+#include "evict_notify.hpp"
+#include "object.hpp"
+#include "test_value.hpp"
+
+constexpr static size_t kCacheSize = 1024ull * 1024 * 32; // 32MB
+constexpr static int kNumObjs = 1024 * 1024;
+constexpr static int kNumRounds = 4;
+constexpr static size_t kLargeSize = 5 * 1024 * 1024; // spans 3 segments
+
+using Value = TestValue<64>;
+
+/* Packing keeps everything ObjectPtr needs, for small and large objects. */
+bool test_pack(midas::CachePool *pool) {
+  bool succ = true;
+  for (size_t size : {size_t(8), size_t(1000), kLargeSize}) {
+    midas::CompactObjectPtr cptr;
+    std::vector<char> src(size), dst(size);
+    for (size_t i = 0; i < size; i++)
+      src[i] = static_cast<char>(i * 7 + size);
+    if (!pool->alloc_to(size, &cptr) || !cptr.copy_from(src.data(), size) ||
+        !cptr.copy_to(dst.data(), size) || src != dst)
+      succ = false;
+    auto optr = cptr.get();
+    if (optr.is_small_obj() != cptr.is_small_obj() || !optr.is_head_obj() ||
+        optr.data_size_in_segment() != cptr.data_size_in_segment() ||
+        optr.get_rref_addr() != &cptr || optr.get_rref() != nullptr)
+      succ = false;
+    pool->free(cptr);
+    if (!cptr.null())
+      succ = false;
+  }
+  return succ;
+}
+
+/* Overwrites and re-reads the array under memory pressure, so that GC both
+ * evicts objects (resetting slots) and moves the hot ones (updating slots).
+ * Every hit must return the latest value of its slot. */
+template <typename Ptr> bool test_array(midas::CachePool *pool) {
+  midas::Array<Value, Ptr> array(pool, kNumObjs);
+  int nr_wrong = 0;
+  int64_t nr_hits = 0;
+  for (int round = 0; round < kNumRounds; round++) {
+    for (int i = 0; i < kNumObjs; i++)
+      array.set(i, Value::make(i, round));
+    for (int i = 0; i < kNumObjs; i++) {
+      auto v = array.get(i);
+      if (!v)
+        continue;
+      nr_hits++;
+      auto expected = Value::make(i, round);
+      if (memcmp(v.get(), &expected, sizeof(Value)) != 0)
+        nr_wrong++;
+    }
+  }
+  std::cout << sizeof(Ptr) << "B pointers: " << nr_hits << " hits, "
+            << nr_wrong << " wrong" << std::endl;
+  return nr_wrong == 0 && nr_hits > 0;
+}
+
+/* GC resets evicted compact pointers and reports their addresses. The state
+ * is static as GC threads may deliver notifications after the test ends. */
+static std::unique_ptr<midas::CompactObjectPtr[]> cptrs;
+static std::atomic_int64_t nr_foreign{0}, nr_alive{0};
+
+bool test_evict(midas::CachePool *pool) {
+  cptrs = std::make_unique<midas::CompactObjectPtr[]>(kNumObjs);
+  pool->set_evict_batch_func([](const midas::EvictedObject *objs, size_t nr) {
+    for (size_t i = 0; i < nr; i++) {
+      auto cptr = reinterpret_cast<midas::CompactObjectPtr *>(objs[i].rref);
+      if (cptr < cptrs.get() || cptr >= cptrs.get() + kNumObjs)
+        nr_foreign++;
+      else if (!cptr->null())
+        nr_alive++;
+    }
+  });
+  for (int i = 0; i < kNumObjs; i++) {
+    auto v = Value::make(i, 0);
+    if (pool->alloc_to(sizeof(Value), &cptrs[i]))
+      cptrs[i].copy_from(&v, sizeof(Value));
+  }
+  int nr_evicted = 0;
+  for (int i = 0; i < kNumObjs; i++) {
+    if (cptrs[i].null())
+      nr_evicted++;
+    pool->free(cptrs[i]);
+  }
+  std::cout << "Evicted " << nr_evicted << " compact pointers, " << nr_foreign
+            << " foreign, " << nr_alive << " alive" << std::endl;
+  return nr_evicted > 0 && nr_foreign == 0 && nr_alive == 0;
+}
+
+int main() {
+  auto cmanager = midas::CacheManager::global_cache_manager();
+  cmanager->create_pool("compact_ptr");
+  auto pool = cmanager->get_pool("compact_ptr");
+  pool->update_limit(kCacheSize);
+
+  bool succ = test_pack(pool);
+  std::cout << "Pack test " << (succ ? "passed!" : "failed!") << std::endl;
+  succ = test_array<midas::ObjectPtr>(pool) &&
+         test_array<midas::CompactObjectPtr>(pool);
+  std::cout << "Array test " << (succ ? "passed!" : "failed!") << std::endl;
+  cmanager->create_pool("compact_evict");
+  auto evict_pool = cmanager->get_pool("compact_evict");
+  evict_pool->update_limit(kCacheSize);
+  succ = test_evict(evict_pool);
+  std::cout << "Evict test " << (succ ? "passed!" : "failed!") << std::endl;
+  return 0;
+}
@@ -0,0 +1,140 @@
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cache_manager.hpp"
+#include "compressed_tier.hpp"
+#include "lz_codec.hpp"
+#include "sync_kv.hpp"
+
+constexpr static size_t kCacheSize = 1024ull * 1024 * 32; // 32MB
+constexpr static size_t kTierSize = 1024ull * 1024 * 32;  // 32MB
+constexpr static int kNBuckets = (1 << 20);
+constexpr static int kNumObjs = 128 * 1024;
+constexpr static int kPostLen = 512;
+
+struct Post {
+  uint64_t id;
+  char text[kPostLen];
+};
+
+/* Text-like values: words drawn from a small vocabulary. */
+Post make_post(uint64_t id) {
+  static const char *words[] = {"the ",    "midas ", "cache ", "soft ",
+                                "memory ", "posts ", "about ", "today ",
+                                "friend ", "photo ", "great ", "and "};
+  std::mt19937 rng(id);
+  Post post;
+  post.id = id;
+  size_t len = 0;
+  while (len < kPostLen) {
+    auto word = words[rng() % (sizeof(words) / sizeof(words[0]))];
+    auto n = std::min(strlen(word), kPostLen - len);
+    memcpy(post.text + len, word, n);
+    len += n;
+  }
+  return post;
+}
+
+bool round_trip(const std::vector<char> &src) {
+  std::vector<char> comp(midas::lz::bound(src.size()));
+  std::vector<char> out(src.size());
+  auto clen = midas::lz::compress(src.data(), src.size(), comp.data(),
+                                  comp.size());
+  if (!clen || !midas::lz::decompress(comp.data(), clen, out.data(),
+                                      out.size()) || out != src)
+    return false;
+  // truncated or mis-sized input must be rejected, never overrun
+  return !midas::lz::decompress(comp.data(), clen, out.data(),
+                                out.size() + 1) &&
+         (src.empty() ||
+          !midas::lz::decompress(comp.data(), clen - 1, out.data(),
+                                 out.size()));
+}
+
+bool test_codec() {
+  std::mt19937 rng(42);
+  bool succ = true;
+  for (size_t len = 0; len < 64; len++) {
+    std::vector<char> src(len);
+    for (auto &c : src)
+      c = rng() % 3;
+    succ &= round_trip(src);
+  }
+  for (size_t len : {1000, 70000, 300000}) {
+    std::vector<char> random(len), runs(len), text(len);
+    for (size_t i = 0; i < len; i++) {
+      random[i] = rng();
+      runs[i] = (i / 1000) % 7;
+    }
+    for (size_t i = 0; i < len; i += sizeof(Post)) {
+      auto post = make_post(i);
+      memcpy(text.data() + i, &post, std::min(sizeof(Post), len - i));
+    }
+    succ &= round_trip(random) && round_trip(runs) && round_trip(text);
+  }
+  auto post = make_post(0);
+  std::vector<char> comp(midas::lz::bound(sizeof(post)));
+  auto clen =
+      midas::lz::compress(&post, sizeof(post), comp.data(), comp.size());
+  std::cout << "A " << sizeof(post) << "B post compresses to " << clen << "B"
+            << std::endl;
+  return succ && clen < sizeof(post) * 3 / 4;
+}
+
+/* Writes twice as many posts as the pool holds, then reads them all back.
+ * Returns the hit ratio. */
+double run_posts(midas::CachePool *pool, int *nr_wrong) {
+  auto kv = std::make_unique<midas::SyncKV<kNBuckets>>(pool);
+  for (uint64_t i = 0; i < kNumObjs; i++)
+    kv->set(i, make_post(i));
+  int nr_hits = 0;
+  for (uint64_t i = 0; i < kNumObjs; i++) {
+    auto post = kv->get<uint64_t, Post>(i);
+    if (!post)
+      continue;
+    nr_hits++;
+    auto expected = make_post(i);
+    if (memcmp(post.get(), &expected, sizeof(Post)) != 0)
+      (*nr_wrong)++;
+  }
+  kv->clear();
+  return static_cast<double>(nr_hits) / kNumObjs;
+}
+
+int main() {
+  bool succ = test_codec();
+  std::cout << "Codec test " << (succ ? "passed!" : "failed!") << std::endl;
+
+  auto cmanager = midas::CacheManager::global_cache_manager();
+  auto with_pool = [&](const std::string &name, size_t tier_size,
+                       int *nr_wrong) {
+    cmanager->create_pool(name);
+    auto pool = cmanager->get_pool(name);
+    pool->update_limit(kCacheSize);
+    if (tier_size)
+      pool->enable_compressed_tier(tier_size);
+    auto hit_ratio = run_posts(pool, nr_wrong);
+    if (tier_size) {
+      auto stats = pool->get_compressed_tier()->get_stats();
+      std::cout << "Compressed tier: " << stats.nr_hits << "/"
+                << stats.nr_lookups << " hits, compression ratio "
+                << static_cast<double>(stats.raw_bytes) /
+                       stats.compressed_bytes
+                << std::endl;
+    }
+    cmanager->delete_pool(name);
+    return hit_ratio;
+  };
+  int nr_wrong = 0;
+  auto base_ratio = with_pool("no_tier", 0, &nr_wrong);
+  auto tier_ratio = with_pool("compressed_tier", kTierSize, &nr_wrong);
+  std::cout << "Hit ratio: " << base_ratio << " without the tier, "
+            << tier_ratio << " with it, " << nr_wrong << " wrong" << std::endl;
+  succ = nr_wrong == 0 && tier_ratio > base_ratio;
+  std::cout << "Tier test " << (succ ? "passed!" : "failed!") << std::endl;
+  return 0;
+}
@@ -0,0 +1,93 @@
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "epoch.hpp"
+
+constexpr static int kNumThds = 8;
+constexpr static int kNumSwaps = 100000;
+constexpr static int kBufLen = 64;
+constexpr static uint8_t kPoison = 0xdd;
+
+struct Buffer {
+  uint8_t data[kBufLen];
+};
+
+bool test_blocking() {
+  auto emanager = midas::EpochManager::global_epoch_manager();
+  std::atomic_bool entered{false}, leave{false};
+  std::thread thd([&]() {
+    midas::EpochGuard guard;
+    entered = true;
+    while (!leave)
+      std::this_thread::yield();
+  });
+  while (!entered)
+    std::this_thread::yield();
+  auto epoch = emanager->advance();
+  bool blocked = emanager->min_active() <= epoch;
+  leave = true;
+  thd.join();
+  bool released = emanager->min_active() > epoch;
+  return blocked && released;
+}
+
+/* Readers dereference a shared buffer that the writer keeps replacing.
+ * Retired buffers are poisoned right before being freed, so a reader that
+ * sees poison read a buffer freed too early. */
+bool test_reclaim() {
+  auto emanager = midas::EpochManager::global_epoch_manager();
+  std::atomic<Buffer *> shared{new Buffer()};
+  memset(shared.load()->data, 1, kBufLen);
+  std::atomic_bool stop{false};
+  std::atomic_int64_t nr_poisoned{0};
+
+  std::vector<std::thread> thds;
+  for (int i = 0; i < kNumThds; i++) {
+    thds.emplace_back([&]() {
+      while (!stop) {
+        midas::EpochGuard guard;
+        auto buf = shared.load();
+        for (int j = 0; j < kBufLen; j++)
+          if (buf->data[j] == kPoison) {
+            nr_poisoned++;
+            break;
+          }
+      }
+    });
+  }
+
+  std::deque<std::pair<uint64_t, Buffer *>> retired;
+  for (int i = 0; i < kNumSwaps; i++) {
+    auto buf = new Buffer();
+    memset(buf->data, i % 100 + 1, kBufLen);
+    auto old = shared.exchange(buf);
+    retired.emplace_back(emanager->advance(), old);
+    auto min_epoch = emanager->min_active();
+    while (!retired.empty() && retired.front().first < min_epoch) {
+      memset(retired.front().second->data, kPoison, kBufLen);
+      delete retired.front().second;
+      retired.pop_front();
+    }
+  }
+  stop = true;
+  for (auto &thd : thds)
+    thd.join();
+  for (auto &[_, buf] : retired)
+    delete buf;
+  delete shared.load();
+  return nr_poisoned == 0;
+}
+
+int main() {
+  bool succ = test_blocking();
+  std::cout << "Blocking test " << (succ ? "passed!" : "failed!") << std::endl;
+  bool reclaimed = test_reclaim();
+  std::cout << "Reclaim test " << (reclaimed ? "passed!" : "failed!")
+            << std::endl;
+  return 0;
+}
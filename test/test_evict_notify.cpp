@@ -0,0 +1,75 @@
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "cache_manager.hpp"
+#include "evict_notify.hpp"
+
+constexpr static size_t kCacheSize = 1024ull * 1024 * 32; // 32MB
+constexpr static int kNumObjs = 1024 * 1024;
+constexpr static int kObjSize = 64; // 64MB in total, forces eviction
+constexpr static size_t kQueueCap = 2 * kNumObjs;
+
+int main() {
+  auto cmanager = midas::CacheManager::global_cache_manager();
+  cmanager->create_pool("evict_notify");
+  auto pool = cmanager->get_pool("evict_notify");
+  pool->update_limit(kCacheSize);
+
+  std::atomic_int64_t nr_batches{0}, nr_notified{0};
+  pool->set_evict_batch_func(
+      [&](const midas::EvictedObject *objs, size_t nr) {
+        nr_batches++;
+        nr_notified += nr;
+      });
+  auto queue = pool->enable_evict_queue(kQueueCap);
+  pool->set_evict_tag(true);
+
+  auto optrs = std::make_unique<midas::ObjectPtr[]>(kNumObjs);
+  char buf[kObjSize];
+  memset(buf, 0, sizeof(buf));
+  int nr_failed = 0;
+  for (uint64_t i = 0; i < kNumObjs; i++) {
+    *reinterpret_cast<uint64_t *>(buf) = i;
+    if (!pool->alloc_to(kObjSize, &optrs[i]) ||
+        !optrs[i].copy_from(buf, kObjSize))
+      nr_failed++;
+  }
+
+  std::vector<midas::EvictedObject> evicted(kQueueCap);
+  auto nr_drained = queue->drain(evicted.data(), evicted.size());
+  int nr_foreign = 0, nr_mistagged = 0, nr_alive = 0;
+  for (size_t i = 0; i < nr_drained; i++) {
+    auto &obj = evicted[i];
+    int64_t idx =
+        reinterpret_cast<midas::ObjectPtr *>(obj.rref) - optrs.get();
+    if (idx < 0 || idx >= kNumObjs) {
+      nr_foreign++;
+      continue;
+    }
+    if (obj.tag != static_cast<uint64_t>(idx))
+      nr_mistagged++;
+    if (!optrs[idx].null())
+      nr_alive++;
+  }
+  int nr_evicted = 0;
+  for (int i = 0; i < kNumObjs; i++)
+    if (optrs[i].null())
+      nr_evicted++;
+
+  std::cout << "Evicted " << nr_evicted << " objs, notified " << nr_notified
+            << " in " << nr_batches << " batches, drained " << nr_drained
+            << " (" << queue->nr_dropped() << " dropped)" << std::endl;
+  if (nr_drained > 0 && nr_foreign == 0 && nr_mistagged == 0 &&
+      nr_alive == 0 && nr_drained <= nr_evicted + nr_failed)
+    std::cout << "Test passed!" << std::endl;
+  else
+    std::cout << "Test failed! " << nr_foreign << " foreign, " << nr_mistagged
+              << " mistagged, " << nr_alive << " alive" << std::endl;
+
+  for (int i = 0; i < kNumObjs; i++)
+    pool->free(optrs[i]);
+  return 0;
+}
@@ -0,0 +1,221 @@
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "array.hpp"
+#include "cache_manager.hpp"
+#include "eviction_policy.hpp"
+#include "object.hpp"
+#include "sync_kv.hpp"
+#include "test_value.hpp"
+
+constexpr static size_t kCacheSize = 1024ull * 1024 * 32; // 32MB
+constexpr static int kNumHot = 64 * 1024;
+constexpr static int kNumCold = 1024 * 1024;
+constexpr static int kNumRounds = 8;
+constexpr static size_t kKVCacheSize = 1024ull * 1024 * 16; // 16MB
+constexpr static int kNBuckets = (1 << 20);
+constexpr static int kNumGhosts = 16 * 1024;
+constexpr static int kNumFlood = 256 * 1024;
+
+using midas::EvictPolicyType;
+
+using Value = TestValue<64>;
+
+midas::MetaObjectHdr accessed_hdr(int nr_accessed) {
+  midas::MetaObjectHdr hdr;
+  hdr.set_present();
+  for (int i = 0; i < nr_accessed; i++)
+    hdr.inc_accessed();
+  return hdr;
+}
+
+/* Scans the object of @key once per entry of @accesses, after that many
+ * accesses, and returns the scan at which it was evicted (-1 if never). */
+template <size_t N>
+int first_eviction(midas::EvictionPolicy *policy, uint64_t key,
+                   const int (&accesses)[N]) {
+  auto hdr = accessed_hdr(0);
+  for (size_t i = 0; i < N; i++) {
+    for (int j = 0; j < accesses[i]; j++)
+      hdr.inc_accessed();
+    if (policy->scan(hdr, key, sizeof(Value)))
+      return i;
+  }
+  return -1;
+}
+
+/* Replays fixed access patterns on synthetic headers. */
+bool test_decisions() {
+  uint64_t a = 1, b = 2;
+  bool succ = true;
+
+  auto clock = midas::EvictionPolicy::create(EvictPolicyType::Clock);
+  succ &= first_eviction(clock.get(), a, {3, 0, 0, 0, 0}) == 3;
+  succ &= first_eviction(clock.get(), b, {1, 0}) == 1;
+
+  auto lfu = midas::EvictionPolicy::create(EvictPolicyType::LFUAging);
+  succ &= first_eviction(lfu.get(), a, {1, 0}) == 1;
+  // frequently accessed objects outlive CLOCK's 3 idle scans
+  succ &= first_eviction(lfu.get(), b, {3, 3, 3, 3, 3, 3, 0, 0, 0, 0}) == -1;
+
+  auto s3 = midas::EvictionPolicy::create(EvictPolicyType::S3FIFO);
+  // inserted but never read: out of small at once, then back via the ghost
+  succ &= first_eviction(s3.get(), a, {1}) == 0;
+  succ &= first_eviction(s3.get(), a, {1, 0}) == 1;
+  // read once after insertion: promoted to main, then aged like CLOCK
+  succ &= first_eviction(s3.get(), b, {2, 2, 0, 0, 0}) == 4;
+
+  auto lruk = midas::EvictionPolicy::create(EvictPolicyType::LRUK);
+  succ &= first_eviction(lruk.get(), a, {1}) == 0;
+  // accessed twice: kept until the second-to-last access leaves the window
+  succ &= first_eviction(lruk.get(), b, {2, 0, 0, 0, 0}) == 4;
+  // the history outlives the eviction: re-inserting counts as the 2nd access
+  succ &= first_eviction(lruk.get(), a, {1, 0, 0, 0, 0}) == 3;
+
+  using midas::CostTable;
+  for (uint64_t cycles : {1ull, 3ull, 1000ull, 123456789ull}) {
+    auto rounded = CostTable::to_cycles(CostTable::to_class(cycles));
+    succ &= rounded <= cycles && rounded * 5 / 4 >= cycles;
+  }
+  auto costs = std::make_shared<midas::CostTable>();
+  costs->set(a, 1000000);
+  costs->set(b, 1000);
+  auto gdsf = midas::EvictionPolicy::create(EvictPolicyType::GDSF, costs);
+  // the first object sets the average priority, the cheap one falls short
+  succ &= first_eviction(gdsf.get(), a, {1, 0, 0, 0}) == 2;
+  succ &= first_eviction(gdsf.get(), b, {1}) == 0;
+  return succ;
+}
+
+/* A hot set read every round, interleaved with a one-pass scan of cold
+ * objects that alone exceeds the cache. */
+bool test_scan_resistance(midas::CachePool *pool) {
+  midas::Array<Value> hot(pool, kNumHot);
+  midas::Array<Value> cold(pool, kNumCold);
+  for (int i = 0; i < kNumHot; i++)
+    hot.set(i, Value::make(i));
+
+  int nr_wrong = 0;
+  int64_t nr_hits = 0, nr_lookups = 0;
+  constexpr static int kColdPerRound = kNumCold / kNumRounds;
+  for (int round = 0; round < kNumRounds; round++) {
+    for (int i = round * kColdPerRound; i < (round + 1) * kColdPerRound; i++)
+      cold.set(i, Value::make(i));
+    for (int i = 0; i < kNumHot; i++) {
+      nr_lookups++;
+      auto v = hot.get(i);
+      if (!v) {
+        hot.set(i, Value::make(i));
+        continue;
+      }
+      nr_hits++;
+      auto expected = Value::make(i);
+      if (memcmp(v.get(), &expected, sizeof(Value)) != 0)
+        nr_wrong++;
+    }
+  }
+  auto type = pool->get_evict_policy()->type();
+  std::cout << midas::EvictionPolicy::name(type) << ": hot set hit ratio "
+            << static_cast<double>(nr_hits) / nr_lookups << ", " << nr_wrong
+            << " wrong" << std::endl;
+  return nr_wrong == 0 && nr_hits > 0;
+}
+
+/* Two equally popular sets that do not both fit, one 1000x as expensive to
+ * rebuild as the other. GDSF should keep the expensive one. */
+bool test_cost_aware(midas::CachePool *pool) {
+  constexpr static int kNumEach = kNumCold / 2;
+  midas::Array<Value> pricey(pool, kNumEach);
+  midas::Array<Value> cheap(pool, kNumEach);
+  for (int i = 0; i < kNumEach; i++) {
+    pricey.set_cost(i, 1000000);
+    cheap.set_cost(i, 1000);
+  }
+  int64_t pricey_hits = 0, cheap_hits = 0;
+  for (int round = 0; round < kNumRounds; round++) {
+    for (int i = 0; i < kNumEach; i++) {
+      for (auto array : {&pricey, &cheap}) {
+        if (array->get(i))
+          (array == &pricey ? pricey_hits : cheap_hits)++;
+        else
+          array->set(i, Value::make(i));
+      }
+    }
+  }
+  std::cout << "gdsf: expensive hits " << pricey_hits << ", cheap hits "
+            << cheap_hits << std::endl;
+  return pricey_hits > cheap_hits;
+}
+
+/* Keys written once, evicted, and written back are ghost hits under S3FIFO
+ * and go to main, while as many new keys written along with them go through
+ * small again. The ghost must recognize the keys though their bucket nodes
+ * and pointers are new. */
+bool test_ghost_hits(midas::CachePool *pool) {
+  auto kv = std::make_unique<midas::SyncKV<kNBuckets>>(pool);
+  uint64_t next_cold = 3 * kNumGhosts;
+  auto flood = [&](int nr_keys) {
+    for (int i = 0; i < nr_keys; i++, next_cold++)
+      kv->set(next_cold, Value::make(next_cold));
+  };
+  // ghosts are keys [0, kNumGhosts), new keys come right after them
+  for (uint64_t i = 0; i < kNumGhosts; i++)
+    kv->set(i, Value::make(i));
+  flood(kNumFlood);
+  int nr_left = 0;
+  for (uint64_t i = 0; i < kNumGhosts; i++)
+    nr_left += kv->get<uint64_t, Value>(i) != nullptr;
+
+  for (uint64_t i = 0; i < kNumGhosts; i++) {
+    kv->set(i, Value::make(i));
+    kv->set(kNumGhosts + i, Value::make(kNumGhosts + i));
+  }
+  flood(kNumFlood / 2);
+  int ghost_hits = 0, new_hits = 0;
+  for (uint64_t i = 0; i < kNumGhosts; i++) {
+    ghost_hits += kv->get<uint64_t, Value>(i) != nullptr;
+    new_hits += kv->get<uint64_t, Value>(kNumGhosts + i) != nullptr;
+  }
+  std::cout << "s3fifo: " << nr_left << " left after the first flood, "
+            << ghost_hits << " ghost hits, " << new_hits << " new hits"
+            << std::endl;
+  kv->clear();
+  return nr_left < kNumGhosts / 10 && ghost_hits > new_hits * 2;
+}
+
+int main() {
+  bool succ = test_decisions();
+  std::cout << "Decision test " << (succ ? "passed!" : "failed!") << std::endl;
+
+  // each test gets a fresh pool, deleted so that its GC stops with it
+  auto cmanager = midas::CacheManager::global_cache_manager();
+  auto with_pool = [&](EvictPolicyType type, auto test) {
+    auto name = std::string("policy_") + midas::EvictionPolicy::name(type);
+    cmanager->create_pool(name);
+    auto pool = cmanager->get_pool(name);
+    pool->update_limit(kCacheSize);
+    pool->set_evict_policy(type);
+    bool succ = test(pool);
+    cmanager->delete_pool(name);
+    return succ;
+  };
+  succ = true;
+  for (auto type : {EvictPolicyType::Clock, EvictPolicyType::LFUAging,
+                    EvictPolicyType::S3FIFO, EvictPolicyType::LRUK,
+                    EvictPolicyType::GDSF})
+    succ &= with_pool(type, test_scan_resistance);
+  std::cout << "Scan resistance test " << (succ ? "passed!" : "failed!")
+            << std::endl;
+  succ = with_pool(EvictPolicyType::GDSF, test_cost_aware);
+  std::cout << "Cost-aware test " << (succ ? "passed!" : "failed!")
+            << std::endl;
+  succ = with_pool(EvictPolicyType::S3FIFO, [&](midas::CachePool *pool) {
+    pool->update_limit(kKVCacheSize);
+    return test_ghost_hits(pool);
+  });
+  std::cout << "Ghost hit test " << (succ ? "passed!" : "failed!")
+            << std::endl;
+  return 0;
+}
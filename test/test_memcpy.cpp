@@ -11,6 +11,9 @@ constexpr static int kBufLens[] = {
     1,  2,  3,  4,  5,  6,  7,  8,   9,   10,  11,  12,   13,   14,
     15, 16, 24, 32, 48, 64, 80, 128, 199, 256, 512, 1024, 2048, 4096};
 
+// long and misaligned lengths for the vector and streaming kernels
+constexpr static int kLongBufLens[] = {4095, 4096, 65536 + 7, (1 << 20) + 3};
+
 constexpr static int kPerfBufLen = 8;
 constexpr static int kNumRepeat = 5000000;
 
@@ -59,6 +62,50 @@ void correctness() {
               << std::endl;
 }
 
+/* Every kernel available on this CPU, misaligned on both ends. */
+void kernel_correctness() {
+  struct {
+    const char *name;
+    midas::RMemcpyFunc func;
+    int supported;
+  } kernels[] = {
+      {"v128", midas::rmemcpy_v128, 1},
+      {"v256", midas::rmemcpy_v256, __builtin_cpu_supports("avx2")},
+      {"v512", midas::rmemcpy_v512, __builtin_cpu_supports("avx512f")},
+      {"rep", midas::rmemcpy_rep, 1},
+      {"nt128", midas::rmemcpy_nt128, 1},
+      {"nt512", midas::rmemcpy_nt512, __builtin_cpu_supports("avx512f")}};
+  int nr_test = 0;
+  int nr_succ = 0;
+  for (auto &kernel : kernels) {
+    if (!kernel.supported)
+      continue;
+    auto check = [&](int len) {
+      char *src = reinterpret_cast<char *>(malloc(len + 1));
+      char *dst = reinterpret_cast<char *>(malloc(len + 3));
+      random_fill(src + 1, len);
+      bool ret = kernel.func(dst + 3, src + 1, len);
+      if (!ret || !is_same(src + 1, dst + 3, len))
+        std::cout << kernel.name << "(len = " << len << ") is wrong!"
+                  << std::endl;
+      else
+        nr_succ++;
+      nr_test++;
+      free(src);
+      free(dst);
+    };
+    for (auto len : kBufLens)
+      check(len);
+    for (auto len : kLongBufLens)
+      check(len);
+  }
+  if (nr_succ == nr_test)
+    std::cout << "Kernel test passed! Correct." << std::endl;
+  else
+    std::cout << "Kernel test failed! " << nr_succ << "/" << nr_test
+              << " succeeded. " << std::endl;
+}
+
 void performance(int buf_len) {
   std::cout << "Perf test -- buf length = " << buf_len << std::endl;
   char *src = new char[buf_len];
@@ -110,6 +157,9 @@ void perf_loop() {
 
 int main() {
   correctness();
+  kernel_correctness();
+  // select the kernels and thresholds for this CPU before measuring
+  midas::rmemcpy_calibrate();
   perf_loop();
 
   return 0;
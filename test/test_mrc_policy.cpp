@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../daemon/inc/mrc.hpp"
+
+/** Offline harness for the MRC policy. It replays a stats trace (recorded
+ * from the daemon profiler, or synthesized from known curves), builds the
+ * per-client MRCs the daemon would see, and compares the saved penalty of the
+ * MRC allocation against the allocations of the existing policies.
+ *
+ * Trace format, one profiling round of one client per line:
+ *   <round> <client> <regions> <hits> <misses> <vhits> <penalty>
+ */
+constexpr static uint64_t kBudget = 1024;     // in regions
+constexpr static uint64_t kGhostRegions = 32; // 64MB victim cache
+constexpr static int kNumRounds = 200;
+constexpr static int64_t kCliffHangerStep = 16;
+
+struct TraceRecord {
+  int round;
+  int client;
+  uint64_t regions;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t vhits;
+  double penalty;
+};
+
+struct ClientModel {
+  std::string name;
+  double penalty;
+  std::function<double(uint64_t)> misses; // ground truth misses per round
+};
+
+static std::vector<ClientModel> make_models() {
+  constexpr double kReqs = 100000;
+  return {
+      {"zipf", 1.0,
+       [=](uint64_t x) {
+         return kReqs * (1 - std::sqrt(std::min(1.0, x / 800.)));
+       }},
+      {"cliff", 4.0,
+       [=](uint64_t x) { return x < 300 ? kReqs : kReqs * 0.05; }},
+      {"scan", 2.0,
+       [=](uint64_t x) { return kReqs * std::max(0.0, 1 - x / 600.); }},
+      {"cold", 8.0, [=](uint64_t x) { return kReqs * 0.99; }},
+  };
+}
+
+static std::vector<TraceRecord>
+synthesize_trace(const std::vector<ClientModel> &models) {
+  std::mt19937 mt(42);
+  std::normal_distribution<double> noise(1.0, 0.05);
+  // clients are profiled at whatever sizes earlier rebalancing left them
+  std::uniform_int_distribution<int64_t> size_dist(1, kBudget);
+  std::vector<TraceRecord> trace;
+  std::vector<int64_t> sizes(models.size());
+  for (int r = 0; r < kNumRounds; r++) {
+    for (int c = 0; c < models.size(); c++) {
+      const auto &m = models[c];
+      sizes[c] = size_dist(mt);
+      double reqs = m.misses(0);
+      double misses = m.misses(sizes[c]) * noise(mt);
+      double vhits = misses - m.misses(sizes[c] + kGhostRegions);
+      misses = std::min(reqs, misses);
+      trace.push_back({r, c, static_cast<uint64_t>(sizes[c]),
+                       static_cast<uint64_t>(reqs - misses),
+                       static_cast<uint64_t>(misses),
+                       static_cast<uint64_t>(std::max(0.0, vhits)),
+                       m.penalty});
+    }
+  }
+  return trace;
+}
+
+static std::vector<TraceRecord> load_trace(const std::string &path) {
+  std::vector<TraceRecord> trace;
+  std::ifstream ifs(path);
+  std::string line;
+  while (std::getline(ifs, line)) {
+    if (line.empty() || line[0] == '#')
+      continue;
+    std::istringstream iss(line);
+    TraceRecord rec;
+    if (iss >> rec.round >> rec.client >> rec.regions >> rec.hits >>
+        rec.misses >> rec.vhits >> rec.penalty)
+      trace.push_back(rec);
+  }
+  return trace;
+}
+
+/* Ground truth comes from the models for synthetic traces, and from the
+ * curves learned over the whole trace otherwise. */
+static double evaluate(const std::vector<midas::mrc::Demand> &truth,
+                       const std::vector<uint64_t> &alloc) {
+  double saved = 0.;
+  for (int i = 0; i < truth.size(); i++)
+    saved += midas::mrc::saved_penalty(truth[i], alloc[i]);
+  return saved;
+}
+
+int main(int argc, char *argv[]) {
+  auto models = make_models();
+  bool recorded = argc > 1;
+  auto trace = recorded ? load_trace(argv[1]) : synthesize_trace(models);
+  int nr_clients = 0;
+  for (const auto &rec : trace)
+    nr_clients = std::max(nr_clients, rec.client + 1);
+  if (nr_clients == 0) {
+    std::cerr << "Empty trace!" << std::endl;
+    return -1;
+  }
+
+  // replay the trace as the daemon profiler would
+  std::vector<midas::MissRatioCurve> curves(nr_clients);
+  std::vector<double> penalties(nr_clients, 0.);
+  std::vector<double> vhits(nr_clients, 0.), hit_ratios(nr_clients, 0.),
+      vhit_ratios(nr_clients, 0.);
+  for (const auto &rec : trace) {
+    curves[rec.client].record(rec.regions, rec.hits, rec.misses, rec.vhits,
+                              kGhostRegions);
+    penalties[rec.client] = rec.penalty;
+    vhits[rec.client] = rec.vhits;
+    double accesses = rec.hits + rec.misses;
+    hit_ratios[rec.client] = accesses ? rec.hits / accesses : 0.;
+    vhit_ratios[rec.client] =
+        accesses ? (rec.hits + rec.vhits) / (accesses + rec.vhits) : 0.;
+  }
+
+  std::vector<midas::mrc::Demand> demands(nr_clients), truth(nr_clients);
+  for (int i = 0; i < nr_clients; i++) {
+    demands[i] = {curves[i].convex_hull(), penalties[i], 1, kBudget};
+    truth[i] = demands[i];
+    if (!recorded) { // sample the ground truth densely
+      truth[i].hull.clear();
+      for (uint64_t x = 0; x <= kBudget; x++)
+        truth[i].hull.push_back({x, models[i].misses(x)});
+    }
+  }
+
+  // MRC
+  auto mrc_alloc = midas::mrc::solve(demands, kBudget);
+  // Static: even split
+  std::vector<uint64_t> static_alloc(nr_clients, kBudget / nr_clients);
+  // Midas: proportional to log2(perf_gain), as on_mem_expand
+  std::vector<uint64_t> midas_alloc(nr_clients, 1);
+  {
+    double total_gain = 0.;
+    std::vector<double> gains(nr_clients, 0.);
+    for (int i = 0; i < nr_clients; i++) {
+      double perf_gain = penalties[i] * vhits[i];
+      gains[i] = perf_gain > 1 ? std::log2(perf_gain) : 0.;
+      total_gain += gains[i];
+    }
+    for (int i = 0; i < nr_clients; i++)
+      if (total_gain > 0)
+        midas_alloc[i] =
+            std::max<uint64_t>(1, gains[i] / total_gain * kBudget);
+  }
+  // CliffHanger: hill-climb by moving steps from the client with the lowest
+  // victim-cache hit ratio gradient to the one with the highest.
+  std::vector<uint64_t> ch_alloc(nr_clients, kBudget / nr_clients);
+  for (int r = 0; r < kNumRounds; r++) {
+    std::vector<double> grads(nr_clients);
+    for (int i = 0; i < nr_clients; i++) {
+      auto &truth_i = truth[i];
+      double accesses = midas::mrc::hull_misses_at(truth_i.hull, 0);
+      double m0 = midas::mrc::hull_misses_at(truth_i.hull, ch_alloc[i]);
+      double m1 = midas::mrc::hull_misses_at(truth_i.hull,
+                                             ch_alloc[i] + kGhostRegions);
+      grads[i] = accesses ? (m0 - m1) / accesses : 0.;
+    }
+    int victim = std::min_element(grads.begin(), grads.end()) - grads.begin();
+    int winner = std::max_element(grads.begin(), grads.end()) - grads.begin();
+    int64_t step = std::min<int64_t>(kCliffHangerStep, ch_alloc[victim] - 1);
+    ch_alloc[victim] -= step;
+    ch_alloc[winner] += step;
+  }
+  // Optimal on the ground truth via DP, for reference
+  constexpr static int kGranularity = 8;
+  const int nr_units = kBudget / kGranularity;
+  std::vector<double> best(nr_units + 1, 0.);
+  for (int i = 0; i < nr_clients; i++) {
+    std::vector<double> next(nr_units + 1, 0.);
+    for (int u = 0; u <= nr_units; u++)
+      for (int k = 0; k <= u; k++)
+        next[u] = std::max(next[u],
+                           best[u - k] + midas::mrc::saved_penalty(
+                                             truth[i], k * kGranularity));
+    best = next;
+  }
+  const double optimal = best[nr_units];
+
+  struct Row {
+    std::string policy;
+    std::vector<uint64_t> alloc;
+  };
+  std::vector<Row> rows{{"Static", static_alloc},
+                        {"Midas", midas_alloc},
+                        {"CliffHanger", ch_alloc},
+                        {"MRC", mrc_alloc}};
+  std::cout << std::setw(12) << "Policy" << std::setw(16) << "SavedPenalty"
+            << std::setw(10) << "OfOpt" << "  Allocation" << std::endl;
+  double mrc_saved = 0., best_other = 0.;
+  for (const auto &row : rows) {
+    double saved = evaluate(truth, row.alloc);
+    std::cout << std::setw(12) << row.policy << std::setw(16) << std::fixed
+              << std::setprecision(0) << saved << std::setw(9)
+              << std::setprecision(1) << saved / optimal * 100 << "%  ";
+    for (auto a : row.alloc)
+      std::cout << a << " ";
+    std::cout << std::endl;
+    if (row.policy == "MRC")
+      mrc_saved = saved;
+    else
+      best_other = std::max(best_other, saved);
+  }
+
+  if (mrc_saved + 1e-6 < best_other || mrc_saved < 0.9 * optimal) {
+    std::cout << "Test failed!" << std::endl;
+    return -1;
+  }
+  std::cout << "Test passed!" << std::endl;
+  return 0;
+}
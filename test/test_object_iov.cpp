@@ -0,0 +1,87 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "cache_manager.hpp"
+#include "object.hpp"
+
+constexpr static size_t kCacheSize = 1024ull * 1024 * 512; // 512MB
+constexpr static size_t kSmallSize = 128;
+constexpr static size_t kLargeSize = 5 * 1024 * 1024; // spans 3 segments
+constexpr static int kNumOps = 1000000;
+
+bool test_iov(midas::CachePool *pool, size_t obj_size) {
+  midas::ObjectPtr optr;
+  if (!pool->alloc_to(obj_size, &optr))
+    return false;
+
+  // three pieces: the head, a range around the middle, and the tail
+  size_t piece_len = std::min<size_t>(obj_size / 4, 1024 * 1024);
+  int64_t offsets[] = {0, static_cast<int64_t>(obj_size / 2 - piece_len / 2),
+                       static_cast<int64_t>(obj_size - piece_len)};
+  std::vector<std::vector<char>> srcs, dsts;
+  midas::ObjectIOVec src_iov[3], dst_iov[3];
+  for (int i = 0; i < 3; i++) {
+    srcs.emplace_back(piece_len);
+    dsts.emplace_back(piece_len);
+    for (size_t j = 0; j < piece_len; j++)
+      srcs[i][j] = static_cast<char>(i * 31 + j);
+    src_iov[i] = {srcs[i].data(), piece_len, offsets[i]};
+    dst_iov[i] = {dsts[i].data(), piece_len, offsets[i]};
+  }
+  if (!optr.copy_from_iov(src_iov, 3) || !optr.copy_to_iov(dst_iov, 3))
+    return false;
+  bool succ = true;
+  for (int i = 0; i < 3; i++) {
+    std::vector<char> single(piece_len);
+    if (!optr.copy_to(single.data(), piece_len, offsets[i]) ||
+        single != srcs[i] || dsts[i] != srcs[i])
+      succ = false;
+  }
+  pool->free(optr);
+  return succ;
+}
+
+/* The four writes of a KV insert, one by one vs. as a single iov. */
+void bench_iov(midas::CachePool *pool) {
+  midas::ObjectPtr optr;
+  if (!pool->alloc_to(kSmallSize, &optr))
+    return;
+  size_t klen = 16, vlen = 64;
+  char key[16] = {}, value[64] = {};
+  auto stt = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < kNumOps; i++) {
+    optr.copy_from(&klen, sizeof(size_t), 0);
+    optr.copy_from(&vlen, sizeof(size_t), 8);
+    optr.copy_from(key, klen, 16);
+    optr.copy_from(value, vlen, 32);
+  }
+  auto mid = std::chrono::high_resolution_clock::now();
+  midas::ObjectIOVec iov[] = {{&klen, sizeof(size_t), 0},
+                              {&vlen, sizeof(size_t), 8},
+                              {key, klen, 16},
+                              {value, vlen, 32}};
+  for (int i = 0; i < kNumOps; i++)
+    optr.copy_from_iov(iov, 4);
+  auto end = std::chrono::high_resolution_clock::now();
+  std::cout << kNumOps << " inserts: 4x copy_from "
+            << std::chrono::duration<double>(mid - stt).count()
+            << "s, copy_from_iov "
+            << std::chrono::duration<double>(end - mid).count() << "s"
+            << std::endl;
+  pool->free(optr);
+}
+
+int main() {
+  auto cmanager = midas::CacheManager::global_cache_manager();
+  cmanager->create_pool("iov");
+  auto pool = cmanager->get_pool("iov");
+  pool->update_limit(kCacheSize);
+
+  bool succ = test_iov(pool, kSmallSize) && test_iov(pool, kLargeSize);
+  std::cout << "IOV test " << (succ ? "passed!" : "failed!") << std::endl;
+  bench_iov(pool);
+  return 0;
+}
@@ -0,0 +1,139 @@
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "cache_manager.hpp"
+#include "pinned_view.hpp"
+#include "sync_hashmap.hpp"
+#include "sync_kv.hpp"
+
+constexpr static size_t kCacheSize = 1024ull * 1024 * 100; // 100MB
+constexpr static int kNBuckets = (1 << 16);
+constexpr static int kNumObjs = 4096;
+constexpr static int kVLen = 16 * 1024;   // large objects
+constexpr static int kNumChurnThds = 4;
+constexpr static int kNumChurnObjs = 40960; // 640MB, forces GC & eviction
+constexpr static int kNumHeldViews = 16;
+
+struct Value {
+  uint64_t data[kVLen / sizeof(uint64_t)];
+  void fill(uint64_t key) {
+    for (size_t i = 0; i < kVLen / sizeof(uint64_t); i++)
+      data[i] = key * 31 + i;
+  }
+  bool check(uint64_t key) const {
+    for (size_t i = 0; i < kVLen / sizeof(uint64_t); i++)
+      if (data[i] != key * 31 + i)
+        return false;
+    return true;
+  }
+};
+
+/* SyncHashMap leaves viewed values intact on updates too. */
+bool test_hashmap(midas::CachePool *pool) {
+  auto map =
+      std::make_unique<midas::SyncHashMap<kNBuckets, uint64_t, Value>>(pool);
+  auto value = std::make_unique<Value>();
+  std::vector<midas::PinnedView> held;
+  for (uint64_t key = 0; key < kNumHeldViews; key++) {
+    value->fill(key);
+    map->set(key, *value);
+    held.emplace_back(map->get_view(key));
+  }
+  bool succ = true;
+  for (uint64_t key = 0; key < kNumHeldViews; key++) {
+    value->fill(key + 1);
+    succ &= map->set(key, *value);
+    auto updated = map->get(key);
+    succ &= updated && updated->check(key + 1);
+  }
+  for (uint64_t key = 0; key < kNumHeldViews; key++)
+    succ &= held[key] && held[key].as<Value>()->check(key);
+  held.clear();
+  map->clear();
+  return succ;
+}
+
+int main() {
+  auto cmanager = midas::CacheManager::global_cache_manager();
+  cmanager->create_pool("pinned");
+  auto pool = cmanager->get_pool("pinned");
+  pool->update_limit(kCacheSize);
+  auto kvs = std::make_unique<midas::SyncKV<kNBuckets>>(pool);
+
+  auto value = std::make_unique<Value>();
+  for (uint64_t key = 0; key < kNumObjs; key++) {
+    value->fill(key);
+    kvs->set(key, *value);
+  }
+
+  int nr_pinned = 0, nr_copied = 0, nr_missed = 0, nr_wrong = 0;
+  for (uint64_t key = 0; key < kNumObjs; key++) {
+    auto view = kvs->get_view(key);
+    if (!view) {
+      nr_missed++;
+      continue;
+    }
+    view.pinned() ? nr_pinned++ : nr_copied++;
+    if (view.size() != kVLen || !view.as<Value>()->check(key))
+      nr_wrong++;
+  }
+  std::cout << "Views: " << nr_pinned << " pinned, " << nr_copied
+            << " copied, " << nr_missed << " missed, " << nr_wrong
+            << " wrong" << std::endl;
+
+  // Views held across heavy GC must stay readable and unchanged.
+  std::vector<midas::PinnedView> held;
+  std::vector<uint64_t> held_keys;
+  for (uint64_t key = 0; key < kNumObjs && held.size() < kNumHeldViews;
+       key++) {
+    auto view = kvs->get_view(key);
+    if (view.pinned()) {
+      held.emplace_back(std::move(view));
+      held_keys.emplace_back(key);
+    }
+  }
+  // Same-size updates of viewed keys must not overwrite the held values.
+  int nr_updated = 0;
+  for (auto key : held_keys) {
+    value->fill(key + 1);
+    kvs->set(key, *value);
+    auto updated = kvs->get_view(key);
+    if (updated && updated.as<Value>()->check(key + 1))
+      nr_updated++;
+  }
+  std::vector<std::thread> thds;
+  for (int tid = 0; tid < kNumChurnThds; tid++) {
+    thds.emplace_back([&, tid]() {
+      auto value = std::make_unique<Value>();
+      for (uint64_t i = 0; i < kNumChurnObjs / kNumChurnThds; i++) {
+        uint64_t key = kNumObjs + tid * kNumChurnObjs + i;
+        value->fill(key);
+        kvs->set(key, *value);
+      }
+    });
+  }
+  for (auto &thd : thds)
+    thd.join();
+  int nr_corrupted = 0;
+  for (size_t i = 0; i < held.size(); i++)
+    if (!held[i].as<Value>()->check(held_keys[i]))
+      nr_corrupted++;
+  std::cout << "Held " << held.size() << " views across updates and GC, "
+            << nr_updated << " updated, " << nr_corrupted << " corrupted"
+            << std::endl;
+  held.clear();
+
+  bool hashmap_succ = test_hashmap(pool);
+  std::cout << "HashMap views " << (hashmap_succ ? "kept" : "overwritten")
+            << std::endl;
+
+  if (hashmap_succ && nr_pinned > 0 && nr_wrong == 0 && nr_corrupted == 0 &&
+      nr_updated == static_cast<int>(held_keys.size()))
+    std::cout << "Test passed!" << std::endl;
+  else
+    std::cout << "Test failed!" << std::endl;
+  return 0;
+}
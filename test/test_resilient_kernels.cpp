@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cache_manager.hpp"
+#include "object.hpp"
+#include "resilient_func.hpp"
+#include "robinhood.h"
+#include "sig_handler.hpp"
+#include "utils.hpp"
+
+constexpr static int kNumRepeat = 100000;
+constexpr static int kMaxLen = 256;
+constexpr static size_t kCacheSize = 1024ull * 1024 * 512; // 512MB
+constexpr static size_t kLargeSize = 5 * 1024 * 1024;     // spans 3 segments
+
+static int sign(int x) { return (x > 0) - (x < 0); }
+
+bool test_correctness() {
+  std::mt19937 rng(42);
+  std::vector<uint8_t> lhs(kMaxLen), rhs(kMaxLen);
+  int nr_wrong = 0;
+  for (int i = 0; i < kNumRepeat; i++) {
+    size_t len = rng() % kMaxLen;
+    for (size_t j = 0; j < len; j++)
+      lhs[j] = rhs[j] = rng() % 4; // small alphabet for frequent matches
+    if (len && rng() % 2)
+      rhs[rng() % len] = rng() % 4;
+
+    int result = 0;
+    if (!midas::rmemcmp(lhs.data(), rhs.data(), len, &result) ||
+        sign(result) != sign(std::memcmp(lhs.data(), rhs.data(), len)))
+      nr_wrong++;
+
+    uint64_t hash = 0;
+    if (!midas::rhash(lhs.data(), len, &hash) ||
+        hash != robin_hood::hash_bytes(lhs.data(), len))
+      nr_wrong++;
+
+    size_t nlen = rng() % 4 + 1;
+    int64_t pos = 0;
+    auto expected = std::string(lhs.begin(), lhs.begin() + len)
+                        .find(std::string(rhs.begin(), rhs.begin() + nlen));
+    int64_t expected_pos =
+        expected == std::string::npos ? -1 : static_cast<int64_t>(expected);
+    if (nlen > len)
+      expected_pos = -1;
+    if (!midas::rmemfind(lhs.data(), len, rhs.data(), nlen, &pos) ||
+        pos != expected_pos)
+      nr_wrong++;
+  }
+  return nr_wrong == 0;
+}
+
+/* Faults on unmapped soft memory must return false instead of crashing. */
+bool test_faults() {
+  auto inv_addr = reinterpret_cast<const void *>(midas::kVolatileSttAddr +
+                                                 0x100200300);
+  uint8_t buf[kMaxLen] = {};
+  int nr_succ = 0;
+  for (int i = 0; i < kNumRepeat; i++) {
+    int result;
+    uint64_t hash;
+    int64_t pos;
+    nr_succ += midas::rmemcmp(inv_addr, buf, kMaxLen, &result);
+    nr_succ += midas::rhash(inv_addr, kMaxLen, &hash);
+    nr_succ += midas::rmemfind(inv_addr, kMaxLen, buf, 4, &pos);
+  }
+  return nr_succ == 0;
+}
+
+/* ObjectPtr kernels run in place, or on a copy when spanning segments. */
+bool test_object(midas::CachePool *pool, size_t obj_size) {
+  midas::ObjectPtr optr;
+  if (!pool->alloc_to(obj_size, &optr))
+    return false;
+  std::vector<uint8_t> data(obj_size);
+  for (size_t i = 0; i < obj_size; i++)
+    data[i] = static_cast<uint8_t>(i * 131 + 7);
+  if (!optr.copy_from(data.data(), obj_size))
+    return false;
+
+  bool succ = true;
+  size_t len = std::min<size_t>(obj_size / 2, 1024 * 1024);
+  int64_t offsets[] = {0, static_cast<int64_t>(obj_size / 2 - len / 2),
+                       static_cast<int64_t>(obj_size - len)};
+  for (auto offset : offsets) {
+    auto src = data.data() + offset;
+    int result = 1;
+    uint64_t hash = 0;
+    int64_t pos = 0;
+    if (!optr.compare(src, len, offset, &result) || result != 0 ||
+        !optr.hash(len, offset, &hash) ||
+        hash != robin_hood::hash_bytes(src, len) ||
+        !optr.find(src + len - 8, 8, len, offset, &pos) ||
+        static_cast<size_t>(pos) > len - 8 ||
+        std::memcmp(src + pos, src + len - 8, 8) != 0)
+      succ = false;
+  }
+  // ranges beyond the object are rejected rather than read
+  uint64_t hash = 0;
+  if (optr.hash(len, obj_size - len + 8, &hash) || optr.hash(8, -8, &hash))
+    succ = false;
+  pool->free(optr);
+  return succ;
+}
+
+int main() {
+  auto sig_handler = midas::SigHandler::global_sighandler();
+  sig_handler->init();
+
+  bool succ = test_correctness();
+  std::cout << "Correctness test " << (succ ? "passed!" : "failed!")
+            << std::endl;
+  succ = test_faults();
+  std::cout << "Fault test " << (succ ? "passed!" : "failed!") << std::endl;
+
+  auto cmanager = midas::CacheManager::global_cache_manager();
+  cmanager->create_pool("kernels");
+  auto pool = cmanager->get_pool("kernels");
+  pool->update_limit(kCacheSize);
+  succ = test_object(pool, kMaxLen) && test_object(pool, kLargeSize);
+  std::cout << "ObjectPtr kernel test " << (succ ? "passed!" : "failed!")
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,120 @@
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "shared_kv.hpp"
+#include "test_value.hpp"
+
+constexpr static size_t kCapacity = 4ull * 1024 * 1024; // 4MB
+constexpr static size_t kNBuckets = 16 * 1024;
+constexpr static int kNumWorkers = 4;
+constexpr static int kNumKeys = 2000;
+constexpr static int kNumRounds = 200;
+constexpr static int kReapTimeoutS = 15; // the daemon checks every 5s
+
+const std::string kName = "midas-test-shared-kv";
+
+using Value = TestValue<256>;
+
+bool consistent(const Value &v, uint64_t key) {
+  return v.idx == key && v.valid();
+}
+
+/* A worker attaches by name and keeps reading while the parent rewrites all
+ * keys: every value read must be whole, and none may be missing. */
+int run_worker() {
+  midas::SharedKV kv(kName, 0);
+  if (!kv.valid())
+    return 1;
+  int nr_wrong = 0;
+  uint64_t max_version = 0;
+  while (max_version < kNumRounds) {
+    for (uint64_t key = 0; key < kNumKeys; key++) {
+      Value v;
+      if (!kv.get(&key, sizeof(key), &v, sizeof(v)) || !consistent(v, key))
+        nr_wrong++;
+      else
+        max_version = std::max(max_version, v.version);
+    }
+  }
+  auto stats = kv.get_stats();
+  return nr_wrong == 0 && stats.hits > 0 ? 0 : 2;
+}
+
+bool test_workers(midas::SharedKV &kv) {
+  for (uint64_t key = 0; key < kNumKeys; key++)
+    kv.set(key, Value::make(key, 0));
+  std::vector<pid_t> workers;
+  for (int i = 0; i < kNumWorkers; i++) {
+    auto pid = fork();
+    if (pid == 0)
+      _exit(run_worker());
+    workers.push_back(pid);
+  }
+  for (uint64_t version = 1; version <= kNumRounds; version++)
+    for (uint64_t key = 0; key < kNumKeys; key++)
+      kv.set(key, Value::make(key, version));
+  bool succ = true;
+  for (auto pid : workers) {
+    int status = 0;
+    waitpid(pid, &status, 0);
+    succ &= WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }
+  return succ && kv.nr_attached() == 1;
+}
+
+/* Writing a few times the capacity drops the oldest values only. */
+bool test_wrap(midas::SharedKV &kv) {
+  constexpr static uint64_t kNumVals = 4 * kCapacity / sizeof(Value);
+  for (uint64_t key = 0; key < kNumVals; key++)
+    kv.set(key, Value::make(key, 0));
+  bool succ = !kv.get<uint64_t, Value>(0ul);
+  int nr_hits = 0;
+  for (uint64_t key = kNumVals - 1000; key < kNumVals; key++) {
+    auto v = kv.get<uint64_t, Value>(key);
+    if (v && consistent(*v, key))
+      nr_hits++;
+  }
+  uint64_t key = kNumVals - 1;
+  succ &= kv.remove(key) && !kv.get<uint64_t, Value>(key);
+  return succ && nr_hits > 900;
+}
+
+/* A writer killed at any point, possibly holding the writer lock, must not
+ * block the others for good, and the daemon must notice it has gone. */
+bool test_crash(midas::SharedKV &kv) {
+  auto pid = fork();
+  if (pid == 0) {
+    midas::SharedKV child(kName, 0);
+    for (uint64_t version = 0;; version++)
+      child.set(version % kNumKeys, Value::make(version % kNumKeys, version));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+  bool succ = true;
+  for (uint64_t key = 0; key < kNumKeys; key++) {
+    succ &= kv.set(key, Value::make(key, 0));
+    auto v = kv.get<uint64_t, Value>(key);
+    succ &= v && consistent(*v, key);
+  }
+  for (int i = 0; i < kReapTimeoutS * 10 && kv.nr_attached() != 1; i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  return succ && kv.nr_attached() == 1;
+}
+
+int main() {
+  midas::SharedKV kv(kName, kCapacity, kNBuckets);
+  bool succ = kv.valid() && test_workers(kv);
+  std::cout << "Worker test " << (succ ? "passed!" : "failed!") << std::endl;
+  succ = test_wrap(kv);
+  std::cout << "Wrap test " << (succ ? "passed!" : "failed!") << std::endl;
+  succ = test_crash(kv);
+  std::cout << "Crash test " << (succ ? "passed!" : "failed!") << std::endl;
+  return 0;
+}
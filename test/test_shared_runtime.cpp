@@ -0,0 +1,81 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cache_manager.hpp"
+#include "log.hpp"
+#include "object.hpp"
+#include "resource_manager.hpp"
+#include "runtime.hpp"
+
+constexpr static int kNumPools = 32;
+constexpr static int kObjSize = 4000;
+constexpr static int kNumObjs = 1000; // ~4MB per pool
+
+int get_nr_threads() {
+  std::ifstream ifs("/proc/self/status");
+  std::string key;
+  while (ifs >> key) {
+    if (key == "Threads:") {
+      int nr_thds;
+      ifs >> nr_thds;
+      return nr_thds;
+    }
+  }
+  return -1;
+}
+
+int main() {
+  midas::Runtime::enable();
+  auto cache_manager = midas::CacheManager::global_cache_manager();
+  auto runtime = midas::Runtime::global_runtime();
+  int nr_base_thds = get_nr_threads();
+
+  std::vector<std::vector<midas::ObjectPtr>> objs(kNumPools);
+  int nr_failed = 0;
+  for (int i = 0; i < kNumPools; i++) {
+    std::string pool_name = "test" + std::to_string(i);
+    cache_manager->create_pool(pool_name);
+    auto pool = cache_manager->get_pool(pool_name);
+    auto allocator = pool->get_allocator();
+    objs[i].resize(kNumObjs);
+    for (auto &obj : objs[i])
+      if (!allocator->alloc_to(kObjSize, &obj))
+        nr_failed++;
+  }
+
+  int nr_thds = get_nr_threads();
+  std::cout << "Runtime " << runtime->id() << ": " << runtime->num_pools()
+            << " pools, limit " << runtime->region_limit() << " regions, "
+            << nr_thds - nr_base_thds << " extra threads" << std::endl;
+  uint64_t nr_regions = 0;
+  for (int i = 0; i < kNumPools; i++) {
+    auto rmanager =
+        cache_manager->get_pool("test" + std::to_string(i))->get_rmanager();
+    nr_regions += rmanager->NumRegionInUse();
+  }
+  std::cout << "Regions in use: " << nr_regions << ", failed allocs "
+            << nr_failed << std::endl;
+
+  // pools must share the budget and must not spawn threads of their own
+  // (reclaim threads come and go); late pools take budget from earlier ones
+  // rather than failing
+  bool succ = runtime->num_pools() == kNumPools &&
+              nr_thds - nr_base_thds < kNumPools && nr_regions > 0 &&
+              nr_failed == 0;
+  for (int i = 0; i < kNumPools; i++) {
+    auto pool = cache_manager->get_pool("test" + std::to_string(i));
+    for (auto &obj : objs[i])
+      if (!obj.null())
+        pool->get_allocator()->free(obj);
+    cache_manager->delete_pool("test" + std::to_string(i));
+  }
+  succ &= runtime->num_pools() == 0;
+
+  if (succ)
+    std::cout << "Test passed!" << std::endl;
+  else
+    std::cout << "Test failed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,164 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "cache_manager.hpp"
+#include "snapshot.hpp"
+#include "sync_kv.hpp"
+#include "test_value.hpp"
+
+constexpr static size_t kCacheSize = 1024ull * 1024 * 32;     // 32MB
+constexpr static size_t kSmallCacheSize = 1024ull * 1024 * 8; // 8MB
+constexpr static int kNBuckets = (1 << 20);
+constexpr static int kNumObjs = 8 * 1024;     // 4MB
+constexpr static int kNumBigObjs = 24 * 1024; // 12MB
+
+const std::string kPath = "/tmp/midas-test.snapshot";
+
+using Value = TestValue<512>;
+
+/* Blocks come back hottest first, and a corrupted block or a truncated tail
+ * only loses the records in it. */
+bool test_format() {
+  constexpr static int kNumRecords = 4096; // 2 blocks per hotness class
+  midas::SnapshotWriter writer(kPath);
+  bool succ = writer.ready();
+  for (uint64_t i = 0; i < kNumRecords; i++) {
+    auto v = Value::make(i);
+    midas::snapshot::Record record{&i, sizeof(i), &v, sizeof(v), 0};
+    succ &= writer.add(record, i % 2 ? 3 : 0);
+  }
+  succ &= writer.finish() && writer.nr_records() == kNumRecords;
+
+  auto count = [](const midas::SnapshotReader &reader, bool *hot_first) {
+    std::vector<char> buf;
+    midas::snapshot::Record record;
+    int nr_records = 0;
+    bool cold_seen = false;
+    for (size_t idx = 0; idx < reader.nr_blocks(); idx++) {
+      if (!reader.read_block(idx, buf))
+        continue;
+      size_t offset = 0;
+      while (midas::SnapshotReader::next_record(buf, offset, &record)) {
+        uint64_t key = *reinterpret_cast<const uint64_t *>(record.key);
+        auto v = reinterpret_cast<const Value *>(record.value);
+        if (record.vlen != sizeof(Value) || v->idx != key)
+          return -1;
+        cold_seen |= key % 2 == 0;
+        if (key % 2 && cold_seen)
+          *hot_first = false;
+        nr_records++;
+      }
+    }
+    return nr_records;
+  };
+  bool hot_first = true;
+  {
+    midas::SnapshotReader reader(kPath);
+    succ &= reader.nr_blocks() == 4 && count(reader, &hot_first) == kNumRecords;
+  }
+  // corrupt the first block, then cut the tail of the last one
+  auto file = fopen(kPath.c_str(), "r+");
+  fseek(file, sizeof(midas::snapshot::BlockHdr) + 8, SEEK_SET);
+  fputc(0x5a, file);
+  fseek(file, 0, SEEK_END);
+  auto size = ftell(file);
+  fclose(file);
+  succ &= truncate(kPath.c_str(), size - 100) == 0;
+  {
+    midas::SnapshotReader reader(kPath);
+    auto nr_records = count(reader, &hot_first);
+    succ &= reader.nr_blocks() == 3 && nr_records > 0 &&
+            nr_records < kNumRecords;
+  }
+  unlink(kPath.c_str());
+  return succ && hot_first;
+}
+
+/* Pairs and TTLs survive a dump and a load into another pool; keys that
+ * expired in between are dropped, and keys set before load() are kept. */
+bool test_round_trip(midas::CacheManager *cmanager) {
+  int64_t nr_dumped = 0;
+  {
+    cmanager->create_pool("dump");
+    auto pool = cmanager->get_pool("dump");
+    pool->update_limit(kCacheSize);
+    auto kv = std::make_unique<midas::SyncKV<kNBuckets>>(pool);
+    for (uint64_t i = 0; i < kNumObjs; i++)
+      kv->set(i, Value::make(i), i == 0 ? 50 : (i == 1 ? 60000 : 0));
+    nr_dumped = kv->dump(kPath);
+    kv.reset();
+    cmanager->delete_pool("dump");
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  cmanager->create_pool("load");
+  auto pool = cmanager->get_pool("load");
+  pool->update_limit(kCacheSize);
+  auto kv = std::make_unique<midas::SyncKV<kNBuckets>>(pool);
+  kv->set(2ul, Value::make(0));
+  auto nr_loaded = kv->load(kPath);
+  bool succ = nr_dumped == kNumObjs && nr_loaded == kNumObjs - 2;
+  succ &= kv->ttl(0ul) == -2 && kv->ttl(1ul) > 50000 && kv->ttl(3ul) == -1;
+  auto v = kv->get<uint64_t, Value>(2ul);
+  succ &= v && v->idx == 0;
+  int nr_hits = 0;
+  for (uint64_t i = 3; i < kNumObjs; i++) {
+    auto v = kv->get<uint64_t, Value>(i);
+    if (v && v->idx == i && v->valid())
+      nr_hits++;
+  }
+  std::cout << "Dumped " << nr_dumped << ", loaded " << nr_loaded << ", "
+            << nr_hits << " hits" << std::endl;
+  kv.reset();
+  cmanager->delete_pool("load");
+  unlink(kPath.c_str());
+  // the pool may evict some, but most must have made it
+  return succ && nr_hits > (kNumObjs - 3) * 0.9;
+}
+
+/* Loading into a smaller pool stops at its limit. */
+bool test_limit(midas::CacheManager *cmanager) {
+  int64_t nr_dumped = 0;
+  {
+    cmanager->create_pool("dump_big");
+    auto pool = cmanager->get_pool("dump_big");
+    pool->update_limit(kCacheSize);
+    auto kv = std::make_unique<midas::SyncKV<kNBuckets>>(pool);
+    for (uint64_t i = 0; i < kNumBigObjs; i++)
+      kv->set(i, Value::make(i));
+    nr_dumped = kv->dump(kPath);
+    kv.reset();
+    cmanager->delete_pool("dump_big");
+  }
+  cmanager->create_pool("load_small");
+  auto pool = cmanager->get_pool("load_small");
+  pool->update_limit(kSmallCacheSize);
+  auto kv = std::make_unique<midas::SyncKV<kNBuckets>>(pool);
+  auto nr_loaded = kv->load(kPath);
+  std::cout << "Dumped " << nr_dumped << ", loaded " << nr_loaded
+            << " into a smaller pool" << std::endl;
+  kv.reset();
+  cmanager->delete_pool("load_small");
+  unlink(kPath.c_str());
+  return nr_loaded > 0 &&
+         nr_loaded * sizeof(Value) <= kSmallCacheSize && nr_loaded < nr_dumped;
+}
+
+int main() {
+  bool succ = test_format();
+  std::cout << "Format test " << (succ ? "passed!" : "failed!") << std::endl;
+
+  auto cmanager = midas::CacheManager::global_cache_manager();
+  succ = test_round_trip(cmanager);
+  std::cout << "Round trip test " << (succ ? "passed!" : "failed!")
+            << std::endl;
+  succ = test_limit(cmanager);
+  std::cout << "Limit test " << (succ ? "passed!" : "failed!") << std::endl;
+  return 0;
+}
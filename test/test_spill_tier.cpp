@@ -0,0 +1,147 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "cache_manager.hpp"
+#include "spill_tier.hpp"
+#include "sync_kv.hpp"
+#include "test_value.hpp"
+
+constexpr static size_t kCacheSize = 1024ull * 1024 * 32;  // 32MB
+constexpr static size_t kSpillSize = 1024ull * 1024 * 256; // 256MB
+constexpr static int kNBuckets = (1 << 20);
+constexpr static int kNumObjs = 128 * 1024;
+
+using Value = TestValue<512>;
+
+std::string temp_path() {
+  char path[] = "/tmp/midas_spill_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd >= 0)
+    close(fd);
+  return path;
+}
+
+/* Drives the tier directly, through the in-memory segment, the file, a full
+ * wrap around the ring of slots, removal and reset. */
+bool test_tier() {
+  constexpr static int kNumEntries = 64 * 1024; // 32MB, wraps 12MB
+  auto path = temp_path();
+  midas::SpillTier tier(path, 12 * 1024 * 1024);
+  std::vector<uint64_t> keys(kNumEntries);
+  bool succ = tier.ready();
+  int nr_put = 0; // puts fail while the writer is behind
+  for (int i = 0; i < kNumEntries; i++) {
+    auto v = Value::make(i);
+    nr_put += tier.put(&keys[i], &v, sizeof(v));
+  }
+  succ &= nr_put > kNumEntries / 2;
+  std::vector<char> buf;
+  succ &= !tier.take(&keys[0], buf); // overwritten by the wrap
+  int nr_hits = 0;
+  for (int i = kNumEntries / 2; i < kNumEntries; i++) {
+    auto v = Value::make(i);
+    if (!tier.take(&keys[i], buf))
+      continue;
+    nr_hits++;
+    succ &= buf.size() == sizeof(v) && memcmp(buf.data(), &v, sizeof(v)) == 0;
+  }
+  succ &= nr_hits > kNumEntries / 8 && !tier.take(&keys[kNumEntries - 1], buf);
+
+  auto v = Value::make(0);
+  tier.put(&keys[0], &v, sizeof(v));
+  tier.remove(&keys[0]);
+  succ &= !tier.take(&keys[0], buf);
+  tier.put(&keys[0], &v, sizeof(v));
+  tier.reset();
+  succ &= !tier.take(&keys[0], buf);
+  return succ;
+}
+
+/* A key re-put into a newer segment survives its old slot being reused. */
+bool test_reput() {
+  constexpr static int kSegRecords = 4 * 1024 * 1024 / (sizeof(Value) + 16);
+  auto path = temp_path();
+  midas::SpillTier tier(path, 12 * 1024 * 1024); // 3 slots
+  std::vector<uint64_t> keys(kSegRecords * 7 / 2);
+  auto put = [&](const void *key, uint64_t idx) {
+    auto v = Value::make(idx);
+    while (!tier.put(key, &v, sizeof(v))) // wait for the writer
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  };
+  uint64_t reput_key = 0;
+  put(&reput_key, 0);
+  for (int i = 0; i < kSegRecords * 3 / 2; i++) // into the 2nd segment
+    put(&keys[i], i);
+  put(&reput_key, 1);
+  for (size_t i = kSegRecords * 3 / 2; i < keys.size(); i++) // into the 4th
+    put(&keys[i], i);
+  std::vector<char> buf;
+  auto v = Value::make(1);
+  bool succ = tier.ready() && tier.take(&reput_key, buf) &&
+              buf.size() == sizeof(v) &&
+              memcmp(buf.data(), &v, sizeof(v)) == 0;
+  succ &= !tier.take(&keys[0], buf); // its slot was reused
+  return succ;
+}
+
+/* Writes 4x as much as the pool holds, then reads it all back. Returns the
+ * hit ratio. */
+double run_kv(midas::CachePool *pool, int *nr_wrong) {
+  auto kv = std::make_unique<midas::SyncKV<kNBuckets>>(pool);
+  for (uint64_t i = 0; i < kNumObjs; i++)
+    kv->set(i, Value::make(i));
+  int nr_hits = 0;
+  for (uint64_t i = 0; i < kNumObjs; i++) {
+    auto v = kv->get<uint64_t, Value>(i);
+    if (!v)
+      continue;
+    nr_hits++;
+    auto expected = Value::make(i);
+    if (memcmp(v.get(), &expected, sizeof(Value)) != 0)
+      (*nr_wrong)++;
+  }
+  kv->clear();
+  return static_cast<double>(nr_hits) / kNumObjs;
+}
+
+int main() {
+  bool succ = test_tier();
+  std::cout << "Tier test " << (succ ? "passed!" : "failed!") << std::endl;
+  succ = test_reput();
+  std::cout << "Re-put test " << (succ ? "passed!" : "failed!") << std::endl;
+
+  auto cmanager = midas::CacheManager::global_cache_manager();
+  auto with_pool = [&](const std::string &name, bool spill, int *nr_wrong) {
+    cmanager->create_pool(name);
+    auto pool = cmanager->get_pool(name);
+    pool->update_limit(kCacheSize);
+    auto path = temp_path();
+    if (spill && !pool->enable_spill_tier(path, kSpillSize))
+      return -1.;
+    auto hit_ratio = run_kv(pool, nr_wrong);
+    if (spill) {
+      auto stats = pool->get_spill_tier()->get_stats();
+      std::cout << "Spill tier: " << stats.nr_spilled << " spilled, "
+                << stats.nr_hits << "/" << stats.nr_lookups << " hits"
+                << std::endl;
+    }
+    cmanager->delete_pool(name);
+    unlink(path.c_str());
+    return hit_ratio;
+  };
+  int nr_wrong = 0;
+  auto base_ratio = with_pool("no_spill", false, &nr_wrong);
+  auto spill_ratio = with_pool("spill", true, &nr_wrong);
+  std::cout << "Hit ratio: " << base_ratio << " without spilling, "
+            << spill_ratio << " with it, " << nr_wrong << " wrong" << std::endl;
+  succ = nr_wrong == 0 && spill_ratio > base_ratio;
+  std::cout << "Pool test " << (succ ? "passed!" : "failed!") << std::endl;
+  return 0;
+}
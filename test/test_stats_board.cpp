@@ -0,0 +1,55 @@
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+#include "stats_board.hpp"
+
+constexpr static uint64_t kBoardId = 0x5747'5350;
+constexpr static uint64_t kNumUpdates = 10'000'000;
+
+int main(int argc, char *argv[]) {
+  midas::StatsBoard writer(kBoardId, true);
+  midas::StatsBoard reader(kBoardId, false);
+  if (!writer.valid() || !reader.valid()) {
+    std::cout << "Failed to map the stats board!" << std::endl;
+    return -1;
+  }
+  midas::StatsSnapshot snapshot{};
+  if (reader.read(&snapshot)) {
+    std::cout << "Read an unpublished board!" << std::endl;
+    return -1;
+  }
+
+  std::atomic_bool done{false};
+  std::thread publisher([&] {
+    midas::StatsSnapshot snapshot{};
+    for (uint64_t i = 1; i <= kNumUpdates; i++) {
+      snapshot.hits = snapshot.misses = snapshot.vhits = i;
+      writer.publish(snapshot);
+      if (i % 10000 == 0)
+        std::this_thread::yield();
+    }
+    done = true;
+  });
+
+  uint64_t nr_reads = 0, nr_torn = 0, last = 0, nr_backward = 0;
+  while (!done) {
+    if (!reader.read(&snapshot))
+      continue;
+    nr_reads++;
+    if (snapshot.hits != snapshot.misses || snapshot.hits != snapshot.vhits)
+      nr_torn++;
+    if (snapshot.hits < last)
+      nr_backward++;
+    last = snapshot.hits;
+  }
+  publisher.join();
+
+  if (nr_torn || nr_backward) {
+    std::cout << "Test failed! " << nr_torn << " torn and " << nr_backward
+              << " stale snapshots in " << nr_reads << " reads" << std::endl;
+    return -1;
+  }
+  std::cout << "Test passed! " << nr_reads << " consistent reads" << std::endl;
+  return 0;
+}
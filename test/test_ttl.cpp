@@ -0,0 +1,149 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cache_manager.hpp"
+#include "expiry.hpp"
+#include "sync_kv.hpp"
+#include "test_value.hpp"
+
+constexpr static size_t kCacheSize = 1024ull * 1024 * 32; // 32MB
+constexpr static int kNBuckets = (1 << 20);
+constexpr static int kNumObjs = 16 * 1024; // 8MB per wave
+constexpr static uint64_t kTTLMs = 200;
+
+using Value = TestValue<512>;
+
+/* Every timer must fire at its tick, neither before nor after, including
+ * the ones that cascade down from every level and one beyond the top. */
+bool test_wheel() {
+  constexpr static uint64_t kTickUs = 1000;
+  const std::vector<uint64_t> deadlines = {
+      0,    1,      63,     64,     65,       4095,     4096,
+      4097, 262143, 262144, 300000, 16777215, 16777216, 20000000};
+  midas::TimerWheel<uint64_t> wheel(kTickUs, 0);
+  for (auto tick : deadlines)
+    wheel.add(tick * kTickUs, tick);
+  bool succ = wheel.size() == deadlines.size();
+  std::vector<uint64_t> due;
+  size_t nr_fired = 0;
+  for (auto tick : deadlines) {
+    if (tick) {
+      wheel.advance((tick - 1) * kTickUs, due);
+      succ &= due.empty();
+    }
+    wheel.advance(tick * kTickUs, due);
+    succ &= due.size() == 1 && due[0] == tick;
+    nr_fired += due.size();
+    due.clear();
+  }
+  return succ && nr_fired == deadlines.size() && wheel.size() == 0;
+}
+
+/* Clearing a key must leave the deadlines of other keys alone, and keys
+ * must never take the deadlines of the keys they collide with. */
+bool test_table() {
+  midas::ExpiryTable table;
+  uint64_t keys[2];
+  bool succ = true;
+  table.set(&keys[0], 2000);
+  succ &= !table.expired(&keys[0], 1999) && table.expired(&keys[0], 2000);
+  succ &= !table.expired(&keys[1], 2000);
+  table.set(&keys[1], 0);
+  succ &= table.expired(&keys[0], 2000);
+  table.set(&keys[0], 0);
+  succ &= !table.expired(&keys[0], 2000);
+
+  constexpr static int kNumKeys = 1 << 20; // 4x the table's slots
+  std::vector<uint64_t> many(kNumKeys);
+  for (int i = 0; i < kNumKeys; i += 2)
+    table.set(&many[i], 2000);
+  int nr_expired = 0;
+  for (int i = 0; i < kNumKeys; i++) {
+    bool expired = table.expired(&many[i], 2000);
+    succ &= !expired || i % 2 == 0;
+    nr_expired += expired;
+  }
+  return succ && nr_expired > 0;
+}
+
+bool test_kv(midas::CachePool *pool) {
+  auto kv = std::make_unique<midas::SyncKV<kNBuckets>>(pool);
+  bool succ = true;
+  for (uint64_t i = 0; i < 4; i++)
+    succ &= kv->set(i, Value::make(i), i < 2 ? 50 : 0);
+  succ &= kv->ttl(0ul) > 0 && kv->ttl(0ul) <= 50 && kv->ttl(2ul) == -1 &&
+          kv->ttl(100ul) == -2;
+  succ &= kv->expire(1ul, 10000) && kv->ttl(1ul) > 9000; // extended
+  succ &= kv->expire(2ul, 50) && kv->ttl(2ul) > 0;
+  succ &= kv->expire(3ul, 50) && kv->expire(3ul, 0) && kv->ttl(3ul) == -1;
+  succ &= !kv->expire(100ul, 50);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  succ &= !kv->get<uint64_t, Value>(0ul) && kv->ttl(0ul) == -2;
+  succ &= kv->get<uint64_t, Value>(1ul) && !kv->get<uint64_t, Value>(2ul);
+  succ &= kv->get<uint64_t, Value>(3ul) != nullptr;
+  // a plain set drops the TTL
+  succ &= kv->set(1ul, Value::make(1)) && kv->ttl(1ul) == -1;
+  kv->clear();
+  return succ;
+}
+
+/* Writes a wave of short-lived values and, once they expire, a wave of
+ * persistent ones; together they exceed what the pool keeps. Expired values
+ * must be gone and must not push out live ones. Returns the hit ratio of the
+ * persistent wave. */
+double run_waves(midas::CachePool *pool, uint64_t ttl_ms, int *nr_live) {
+  auto kv = std::make_unique<midas::SyncKV<kNBuckets>>(pool);
+  for (uint64_t i = 0; i < kNumObjs; i++)
+    kv->set(i, Value::make(i), ttl_ms);
+  std::this_thread::sleep_for(std::chrono::milliseconds(kTTLMs * 2));
+  for (uint64_t i = kNumObjs; i < kNumObjs * 2; i++)
+    kv->set(i, Value::make(i));
+  int nr_hits = 0;
+  for (uint64_t i = kNumObjs; i < kNumObjs * 2; i++) {
+    auto v = kv->get<uint64_t, Value>(i);
+    if (v && v->idx == i)
+      nr_hits++;
+  }
+  for (uint64_t i = 0; i < kNumObjs; i++)
+    if (kv->get<uint64_t, Value>(i))
+      (*nr_live)++;
+  kv->clear();
+  return static_cast<double>(nr_hits) / kNumObjs;
+}
+
+int main() {
+  bool succ = test_wheel() && test_table();
+  std::cout << "Wheel test " << (succ ? "passed!" : "failed!") << std::endl;
+
+  auto cmanager = midas::CacheManager::global_cache_manager();
+  cmanager->create_pool("ttl");
+  auto pool = cmanager->get_pool("ttl");
+  pool->update_limit(kCacheSize);
+  succ = test_kv(pool);
+  cmanager->delete_pool("ttl");
+  std::cout << "KV test " << (succ ? "passed!" : "failed!") << std::endl;
+
+  auto with_pool = [&](const std::string &name, uint64_t ttl_ms,
+                       int *nr_live) {
+    cmanager->create_pool(name);
+    auto pool = cmanager->get_pool(name);
+    pool->update_limit(kCacheSize);
+    auto hit_ratio = run_waves(pool, ttl_ms, nr_live);
+    cmanager->delete_pool(name);
+    return hit_ratio;
+  };
+  int nr_base_live = 0;
+  int nr_expired_live = 0;
+  auto base_ratio = with_pool("no_ttl", 0, &nr_base_live);
+  auto ttl_ratio = with_pool("ttl_waves", kTTLMs, &nr_expired_live);
+  std::cout << "Hit ratio: " << base_ratio << " without TTLs, " << ttl_ratio
+            << " with them, " << nr_expired_live << " expired keys live"
+            << std::endl;
+  succ = nr_expired_live == 0 && ttl_ratio >= base_ratio;
+  std::cout << "Pool test " << (succ ? "passed!" : "failed!") << std::endl;
+  return 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/* A flat value of Size bytes for the tests. Its payload derives from the
+ * index and version, so readers can check it without keeping a copy. */
+template <size_t Size> struct TestValue {
+  uint64_t idx;
+  uint64_t version;
+  char data[Size - 2 * sizeof(uint64_t)];
+
+  static TestValue make(uint64_t idx, uint64_t version = 0) {
+    TestValue v;
+    v.idx = idx;
+    v.version = version;
+    for (size_t i = 0; i < sizeof(v.data); i++)
+      v.data[i] = v.byte_at(i);
+    return v;
+  }
+
+  /* Whether the payload matches the index and version, i.e., the value was
+   * not torn or corrupted. */
+  bool valid() const {
+    for (size_t i = 0; i < sizeof(data); i++)
+      if (data[i] != byte_at(i))
+        return false;
+    return true;
+  }
+
+private:
+  char byte_at(size_t i) const {
+    return static_cast<char>(idx * 31 + version + i);
+  }
+};